@@ -8,6 +8,7 @@
 #include "sparse_linear_algebra/matrix_multiplication/offline/fake_triple_provider.hpp"
 #include "sparse_linear_algebra/matrix_multiplication/rows-dense.hpp"
 #include "sparse_linear_algebra/oblivious_map/basic_oblivious_map.hpp"
+#include "sparse_linear_algebra/oblivious_map/cuckoo_oblivious_map.hpp"
 #include "sparse_linear_algebra/oblivious_map/poly_oblivious_map.hpp"
 #include "sparse_linear_algebra/oblivious_map/sorting_oblivious_map.hpp"
 #include "sparse_linear_algebra/util/get_ceil.hpp"
@@ -62,6 +63,8 @@ KNNProtocol<T>::KNNProtocol(
           {poly, std::make_shared<poly_oblivious_map<int, int>>(
                      *channel, statistical_security, true)},
           {scs, std::make_shared<sorting_oblivious_map<int, int>>(*channel)},
+          {cuckoo, std::make_shared<cuckoo_oblivious_map<int, int>>(
+                       *channel, statistical_security)},
       }),
       precision_(precision),
       mul_type_(mt),
@@ -128,6 +131,13 @@ void KNNProtocol<T>::computeSimilarities(mpc_utils::Benchmarker* benchmarker) {
   using sparse_linear_algebra::matrix_multiplication::offline::
       FakeTripleProvider;
 
+  // Buffers shared by the multiplications of all chunks, so only the first one
+  // allocates them.
+  multiplication_workspace<T> workspace;
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> server_chunk, client_dense;
+  if (mul_type_ == dense) {
+    client_dense = client_matrix_;
+  }
   for (int row = 0; row < num_documents_server_; row += chunk_size_) {
     // The last chunk might be smaller.
     int this_chunk_size = chunk_size_;
@@ -152,13 +162,11 @@ void KNNProtocol<T>::computeSimilarities(mpc_utils::Benchmarker* benchmarker) {
         channel_->sync();
         mpc_utils::Benchmarker::MaybeBenchmarkFunction(
             benchmarker, "Matrix Multiplication", [&] {
-              result_matrix_.middleRows(row, this_chunk_size) =
-                  matrix_multiplication_dense(
-                      Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>(
-                          server_matrix_.middleRows(row, this_chunk_size)),
-                      Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>(
-                          client_matrix_),
-                      *channel_, party_id_, triples, dense_chunk_size);
+              server_chunk = server_matrix_.middleRows(row, this_chunk_size);
+              matrix_multiplication_dense(
+                  server_chunk, client_dense, *channel_, party_id_, triples,
+                  result_matrix_.middleRows(row, this_chunk_size),
+                  dense_chunk_size, dense_multiplication_options(), &workspace);
             });
         break;
       }
@@ -176,12 +184,13 @@ void KNNProtocol<T>::computeSimilarities(mpc_utils::Benchmarker* benchmarker) {
         channel_->sync();
         mpc_utils::Benchmarker::MaybeBenchmarkFunction(
             benchmarker, "Matrix Multiplication", [&] {
-              result_matrix_.middleRows(row, this_chunk_size) =
-                  matrix_multiplication_cols_rows(
-                      server_matrix_.middleRows(row, this_chunk_size),
-                      client_matrix_, *pir_protocols_[pir_type_], *channel_,
-                      party_id_, triples, dense_chunk_size,
-                      num_nonzeros_server_, num_nonzeros_client_, benchmarker);
+              matrix_multiplication_cols_rows(
+                  server_matrix_.middleRows(row, this_chunk_size),
+                  client_matrix_, *pir_protocols_[pir_type_], *channel_,
+                  party_id_, triples,
+                  result_matrix_.middleRows(row, this_chunk_size),
+                  dense_chunk_size, num_nonzeros_server_, num_nonzeros_client_,
+                  benchmarker, dense_multiplication_options(), &workspace);
             });
         break;
       }
@@ -252,6 +261,7 @@ std::vector<int> KNNProtocol<T>::topK(mpc_utils::Benchmarker* benchmarker) {
 }
 
 // Template instantiations
+template class KNNProtocol<uint32_t>;
 template class KNNProtocol<uint64_t>;
 
 }  // namespace knn
@@ -12,7 +12,7 @@ namespace applications {
 namespace knn {
 
 enum MulType { dense, sparse };
-enum PirType { basic, poly, scs };
+enum PirType { basic, poly, scs, cuckoo };
 
 // Encapsulation class for running KNN.
 template <typename T>
@@ -10,6 +10,9 @@ void KNNConfig::validate() {
   if (statistical_security <= 0) {
     BOOST_THROW_EXCEPTION(po::error("'statistical_security' must be positive"));
   }
+  if (ring_bits != 32 && ring_bits != 64) {
+    BOOST_THROW_EXCEPTION(po::error("'ring_bits' must be 32 or 64"));
+  }
   if (num_documents.size() == 0) {
     BOOST_THROW_EXCEPTION(
         po::error("'num_documents' must be passed at least once"));
@@ -92,7 +95,7 @@ void KNNConfig::validate() {
     } catch (const std::out_of_range &e) {
       BOOST_THROW_EXCEPTION(
           po::error("'pir_type' must be either "
-                    "`basic`, `poly`, or `scs`"));
+                    "`basic`, `poly`, `scs`, or `cuckoo`"));
     }
   }
   mpc_config::validate();
@@ -120,10 +123,14 @@ KNNConfig::KNNConfig() : mpc_config() {
       "multiplication_type", po::value(&multiplication_types_raw)->composing(),
       "Multiplication type: dense | sparse; can be passed multiple times")(
       "pir_type", po::value(&pir_types_raw)->composing(),
-      "PIR type: basic | poly | scs; can be passed multiple times")(
+      "PIR type: basic | poly | scs | cuckoo; can be passed multiple "
+      "times")(
       "statistical_security,s",
       po::value(&statistical_security)->default_value(40),
-      "Statistical security parameter; used only for pir_type=poly")(
+      "Statistical security parameter; used only for pir_type=poly and "
+      "pir_type=cuckoo")(
+      "ring_bits", po::value(&ring_bits)->default_value(64),
+      "Bit width of the ring the shares live in: 32 | 64")(
       "max_runs", po::value(&max_runs)->default_value(-1),
       "Maximum number of runs. Default is unlimited")(
       "measure_communication",
@@ -21,6 +21,7 @@ class KNNConfig : public virtual mpc_config {
       {"basic", PirType::basic},
       {"poly", PirType::poly},
       {"scs", PirType::scs},
+      {"cuckoo", PirType::cuckoo},
   };
   std::map<std::string, MulType> mul_type_converison_table{
       {"dense", MulType::dense},
@@ -39,6 +40,7 @@ class KNNConfig : public virtual mpc_config {
   std::vector<PirType> pir_types;
 
   int16_t statistical_security;
+  int ring_bits;
   ssize_t max_runs;
   KNNConfig();
   bool measure_communication;
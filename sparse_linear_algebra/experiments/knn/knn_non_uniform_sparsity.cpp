@@ -54,10 +54,10 @@ void GenerateRandomMatrices(
   client_matrix->setFromTriplets(triplets_B.begin(), triplets_B.end());
 }
 
-void RunExperiments(comm_channel *channel, int party_id,
-                    int16_t statistical_security, int precision,
-                    const KNNConfig &conf) {
-  using T = uint64_t;
+template <typename T>
+void RunExperimentsWithRing(comm_channel *channel, int party_id,
+                            int16_t statistical_security, int precision,
+                            const KNNConfig &conf) {
   size_t num_experiments =
       std::max({conf.num_documents.size(), conf.num_selected.size(),
                 conf.chunk_size.size(), conf.vocabulary_size.size(),
@@ -118,6 +118,19 @@ void RunExperiments(comm_channel *channel, int party_id,
   }
 }
 
+// Runs all experiments with shares of the bit width given in `conf`.
+void RunExperiments(comm_channel *channel, int party_id,
+                    int16_t statistical_security, int precision,
+                    const KNNConfig &conf) {
+  if (conf.ring_bits == 32) {
+    RunExperimentsWithRing<uint32_t>(channel, party_id, statistical_security,
+                                     precision, conf);
+  } else {
+    RunExperimentsWithRing<uint64_t>(channel, party_id, statistical_security,
+                                     precision, conf);
+  }
+}
+
 }  // namespace knn
 }  // namespace experiments
 }  // namespace sparse_linear_algebra
@@ -6,8 +6,12 @@
 #include "sparse_linear_algebra/matrix_multiplication/cols-rows.hpp"
 #include "sparse_linear_algebra/matrix_multiplication/dense.hpp"
 #include "sparse_linear_algebra/matrix_multiplication/offline/fake_triple_provider.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/seeded_fake_triple_provider.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/slicing_triple_provider.hpp"
 #include "sparse_linear_algebra/matrix_multiplication/rows-dense.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/secure_multiply.hpp"
 #include "sparse_linear_algebra/oblivious_map/basic_oblivious_map.hpp"
+#include "sparse_linear_algebra/oblivious_map/cuckoo_oblivious_map.hpp"
 #include "sparse_linear_algebra/oblivious_map/oblivious_map.hpp"
 #include "sparse_linear_algebra/oblivious_map/poly_oblivious_map.hpp"
 #include "sparse_linear_algebra/oblivious_map/sorting_oblivious_map.hpp"
@@ -23,6 +27,12 @@ class matrix_multiplication_config : public virtual mpc_config {
     if (party_id < 0 || party_id > 1) {
       BOOST_THROW_EXCEPTION(po::error("'party' must be 0 or 1"));
     }
+    if (num_threads <= 0) {
+      BOOST_THROW_EXCEPTION(po::error("'num_threads' must be positive"));
+    }
+    if (ring_bits != 16 && ring_bits != 32 && ring_bits != 64) {
+      BOOST_THROW_EXCEPTION(po::error("'ring_bits' must be 16, 32 or 64"));
+    }
     if (statistical_security <= 0) {
       BOOST_THROW_EXCEPTION(
           po::error("'statistical_security' must be positive"));
@@ -76,28 +86,35 @@ class matrix_multiplication_config : public virtual mpc_config {
       BOOST_THROW_EXCEPTION(
           po::error("'multiplication_type' must be passed at least once"));
     }
+    if (bandwidth <= 0 || latency < 0) {
+      BOOST_THROW_EXCEPTION(po::error(
+          "'bandwidth' must be positive and 'latency' non-negative"));
+    }
     if (pir_types.size() == 0) {
       for (auto& mult_type : multiplication_types) {
-        if (mult_type != "dense") {
+        if (mult_type != "dense" && mult_type != "auto") {
           BOOST_THROW_EXCEPTION(
               po::error("'pir_type' must be passed at least once if "
-                        "'multiplication_type'' is not \"dense\""));
+                        "'multiplication_type'' is not \"dense\" or "
+                        "\"auto\""));
         }
       }
     }
     for (auto& mult_type : multiplication_types) {
       if (mult_type != "dense" && mult_type != "cols_rows" &&
-          mult_type != "rows_dense" && mult_type != "cols_dense") {
-        BOOST_THROW_EXCEPTION(
-            po::error("'multiplication_type' must be either "
-                      "`cols_dense`, `rows_dense`, `cols_rows`, or `dense`"));
+          mult_type != "rows_dense" && mult_type != "cols_dense" &&
+          mult_type != "auto") {
+        BOOST_THROW_EXCEPTION(po::error(
+            "'multiplication_type' must be either "
+            "`cols_dense`, `rows_dense`, `cols_rows`, `dense`, or `auto`"));
       }
     }
     for (auto& pir_type : pir_types) {
-      if (pir_type != "basic" && pir_type != "poly" && pir_type != "scs") {
+      if (pir_type != "basic" && pir_type != "poly" && pir_type != "scs" &&
+          pir_type != "cuckoo") {
         BOOST_THROW_EXCEPTION(
             po::error("'pir_type' must be either "
-                      "`basic`, `poly` or `scs`"));
+                      "`basic`, `poly`, `scs` or `cuckoo`"));
       }
     }
     mpc_config::validate();
@@ -112,6 +129,13 @@ class matrix_multiplication_config : public virtual mpc_config {
   std::vector<std::string> multiplication_types;
   std::vector<std::string> pir_types;
   int16_t statistical_security;
+  int num_threads;
+  int ring_bits;
+  bool single_round;
+  bool shared_v;
+  bool seeded_triples;
+  double bandwidth;
+  double latency;
   ssize_t max_runs;
   bool skip_verification;
   bool measure_communication;
@@ -133,13 +157,32 @@ class matrix_multiplication_config : public virtual mpc_config {
         "Number of non-zero rows/columns in the client's matrix B; can be "
         "passed multiple times")(
         "multiplication_type", po::value(&multiplication_types)->composing(),
-        "Multiplication type: dense | cols_rows | cols_dense | rows_dense; can "
-        "be passed multiple times")(
+        "Multiplication type: dense | cols_rows | cols_dense | rows_dense | "
+        "auto; can be passed multiple times")(
         "pir_type", po::value(&pir_types)->composing(),
-        "PIR type: basic | poly | scs; can be passed multiple "
+        "PIR type: basic | poly | scs | cuckoo; can be passed multiple "
         "times")("statistical_security,s",
                  po::value(&statistical_security)->default_value(40),
-                 "Statistical security parameter; used only for pir_type=poly")(
+                 "Statistical security parameter; used only for "
+                 "pir_type=poly and pir_type=cuckoo")(
+        "num_threads", po::value(&num_threads)->default_value(1),
+        "Number of threads used for local products in dense multiplications")(
+        "ring_bits", po::value(&ring_bits)->default_value(64),
+        "Bit width of the ring the shares live in: 16 | 32 | 64")(
+        "single_round", po::bool_switch(&single_round)->default_value(false),
+        "Open the masks of all chunks of a dense multiplication at once")(
+        "shared_v", po::bool_switch(&shared_v)->default_value(false),
+        "Use a triple family with a shared V, so that the masked right-hand "
+        "side of a dense multiplication is opened only once")(
+        "seeded_triples",
+        po::bool_switch(&seeded_triples)->default_value(false),
+        "Queue only a seed per fake triple and expand it on use, on all cores")(
+        "bandwidth", po::value(&bandwidth)->default_value(1.25e8),
+        "Bytes per second in each direction; used only for "
+        "multiplication_type=auto")(
+        "latency", po::value(&latency)->default_value(5e-4),
+        "Seconds per communication round; used only for "
+        "multiplication_type=auto")(
         "max_runs", po::value(&max_runs)->default_value(-1),
         "Maximum number of runs. Default is unlimited")(
         "skip_verification",
@@ -151,23 +194,18 @@ class matrix_multiplication_config : public virtual mpc_config {
   }
 };
 
-// generates random matrices and multiplies them using multiplication triples
-int main(int argc, const char* argv[]) {
+// Runs all configured experiments with shares in the ring of integers modulo
+// 2^(8 * sizeof(T)).
+template <typename T>
+int run_experiments(const matrix_multiplication_config& conf, party& p,
+                    comm_channel& channel) {
   using sparse_linear_algebra::matrix_multiplication::offline::
       FakeTripleProvider;
-  using T = uint64_t;
-  // parse config
-  matrix_multiplication_config conf;
-  try {
-    conf.parse(argc, argv);
-  } catch (boost::program_options::error& e) {
-    std::cerr << e.what() << "\n";
-    return 1;
-  }
-  // connect to other party
-  party p(conf);
-  auto channel = p.connect_to(1 - p.get_id(), conf.measure_communication);
-
+  using sparse_linear_algebra::matrix_multiplication::offline::
+      SeededFakeTripleProvider;
+  using sparse_linear_algebra::matrix_multiplication::offline::
+      SlicingTripleProvider;
+  using sparse_linear_algebra::matrix_multiplication::offline::TripleProvider;
   std::map<std::string, std::shared_ptr<oblivious_map<size_t, size_t>>>
       protos_perm{
           {"basic",
@@ -176,12 +214,16 @@ int main(int argc, const char* argv[]) {
                        channel, conf.statistical_security)},
           {"scs",
            std::make_shared<sorting_oblivious_map<size_t, size_t>>(channel)},
+          {"cuckoo", std::make_shared<cuckoo_oblivious_map<size_t, size_t>>(
+                         channel, conf.statistical_security)},
       };
   std::map<std::string, std::shared_ptr<oblivious_map<size_t, T>>> protos_val{
       {"basic", std::make_shared<basic_oblivious_map<size_t, T>>(channel)},
       {"poly", std::make_shared<poly_oblivious_map<size_t, T>>(
                    channel, conf.statistical_security)},
       {"scs", std::make_shared<sorting_oblivious_map<size_t, T>>(channel)},
+      {"cuckoo", std::make_shared<cuckoo_oblivious_map<size_t, T>>(
+                     channel, conf.statistical_security)},
   };
   using dense_matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
   int seed = 12345;  // seed random number generator deterministically
@@ -214,15 +256,51 @@ int main(int argc, const char* argv[]) {
       if (chunk_size > 4096) {
         // avoid memory errors
         chunk_size = 2048;
-        // this will affect running times a little
-        // TODO: make triplegenerator more general to support
-        // triples for different chunk sizes
-        if (dense_rows % chunk_size) {
+        // Without triple families, the last chunk uses a triple sliced to its
+        // size. The chunks of a family all have the same size, though, so this
+        // will affect running times a little.
+        if (conf.shared_v && dense_rows % chunk_size) {
           dense_rows = dense_rows + chunk_size - (dense_rows % chunk_size);
           std::cout << "Adjusting " << (mult_type == "rows_dense" ? "k_A" : "l")
                     << " to " << dense_rows << "\n";
         }
       }
+      dense_multiplication_options options;
+      options.num_threads = conf.num_threads;
+      options.single_round = conf.single_round;
+      options.shared_v = conf.shared_v;
+      options.exact_shape = !conf.shared_v;
+      size_t num_chunks = (dense_rows + chunk_size - 1) / chunk_size;
+      // Precomputes either one triple per chunk or a single family.
+      auto precompute = [&](auto& triples, int num_chunks) {
+        if (conf.shared_v) {
+          triples.PrecomputeFamilies(1, num_chunks);
+        } else {
+          triples.Precompute(num_chunks);
+        }
+      };
+      // Creates the configured fake triple provider for multiplying a
+      // (rows x inner) with an (inner x cols) matrix in `num_chunks` chunks.
+      auto make_fake_triples = [&](auto is_shared, int rows, int inner,
+                                   int cols, int num_chunks) {
+        constexpr bool shared = decltype(is_shared)::value;
+        auto generate = [&](auto triples) {
+          benchmarker.BenchmarkFunction("Fake Triple Generation", [&] {
+            precompute(*triples, num_chunks);
+          });
+          // Serves a smaller last chunk by slicing a triple for a full chunk.
+          return std::unique_ptr<TripleProvider<T, shared>>(
+              new SlicingTripleProvider<T, shared>(std::move(triples)));
+        };
+        if (conf.seeded_triples) {
+          return generate(
+              std::unique_ptr<SeededFakeTripleProvider<T, shared>>(
+                  new SeededFakeTripleProvider<T, shared>(rows, inner, cols,
+                                                          p.get_id())));
+        }
+        return generate(std::unique_ptr<FakeTripleProvider<T, shared>>(
+            new FakeTripleProvider<T, shared>(rows, inner, cols, p.get_id())));
+      };
       Eigen::SparseMatrix<T, Eigen::RowMajor> A(l, m);
       Eigen::SparseMatrix<T, Eigen::ColMajor> B(m, n);
       std::cout << "Generating random data\n";
@@ -256,57 +334,70 @@ int main(int argc, const char* argv[]) {
       try {
         dense_matrix C, C2;
         if (mult_type == "dense") {
-          FakeTripleProvider<T> triples(chunk_size, m, n, p.get_id());
           channel.sync();
-          benchmarker.BenchmarkFunction("Fake Triple Generation", [&] {
-            triples.Precompute(l / chunk_size);
-          });
+          auto triples = make_fake_triples(std::false_type(), chunk_size, m, n,
+                                           num_chunks);
 
           channel.sync();
           benchmarker.BenchmarkFunction("Matrix Multiplication", [&] {
             C = matrix_multiplication_dense(dense_matrix(A), dense_matrix(B),
-                                            channel, p.get_id(), triples,
-                                            chunk_size);
+                                            channel, p.get_id(), *triples,
+                                            chunk_size, options);
           });
         } else if (mult_type == "cols_rows") {
-          FakeTripleProvider<T> triples(chunk_size, k_A + k_B, n, p.get_id());
           channel.sync();
-          benchmarker.BenchmarkFunction("Fake Triple Generation", [&] {
-            triples.Precompute(l / chunk_size);
-          });
+          auto triples = make_fake_triples(std::false_type(), chunk_size,
+                                           k_A + k_B, n, num_chunks);
 
           channel.sync();
           benchmarker.BenchmarkFunction("Matrix Multiplication", [&] {
             C = matrix_multiplication_cols_rows(
-                A, B, *protos_perm[type], channel, p.get_id(), triples,
-                chunk_size, k_A, k_B, &benchmarker);
+                A, B, *protos_perm[type], channel, p.get_id(), *triples,
+                chunk_size, k_A, k_B, &benchmarker, options);
           });
         } else if (mult_type == "cols_dense") {
-          FakeTripleProvider<T, true> triples(chunk_size, k_A, n, p.get_id());
           channel.sync();
-          benchmarker.BenchmarkFunction("Fake Triple Generation", [&] {
-            triples.Precompute(l / chunk_size);
-          });
+          auto triples = make_fake_triples(std::true_type(), chunk_size, k_A,
+                                           n, num_chunks);
 
           channel.sync();
           benchmarker.BenchmarkFunction("Matrix Multiplication", [&] {
             C = matrix_multiplication_cols_dense(
                 A, dense_matrix(B), *protos_val[type], channel, p.get_id(),
-                triples, chunk_size, k_A, &benchmarker);
+                *triples, chunk_size, k_A, &benchmarker, options);
           });
         } else if (mult_type == "rows_dense") {
-          FakeTripleProvider<T, false> triples(chunk_size, m, n, p.get_id());
           channel.sync();
-          benchmarker.BenchmarkFunction("Fake Triple Generation", [&] {
-            triples.Precompute(k_A / chunk_size);
-          });
+          auto triples = make_fake_triples(std::false_type(), chunk_size, m, n,
+                                           num_chunks);
 
           channel.sync();
           benchmarker.BenchmarkFunction("Matrix Multiplication", [&] {
-            C = matrix_multiplication_rows_dense(A, dense_matrix(B), channel,
-                                                 p.get_id(), triples,
-                                                 chunk_size, k_A, &benchmarker);
+            C = matrix_multiplication_rows_dense(
+                A, dense_matrix(B), channel, p.get_id(), *triples, chunk_size,
+                k_A, &benchmarker, options);
+          });
+        } else if (mult_type == "auto") {
+          secure_multiply_options auto_options;
+          auto_options.network.bandwidth = conf.bandwidth;
+          auto_options.network.latency = conf.latency;
+          auto_options.planner.statistical_security = conf.statistical_security;
+          auto_options.dense = options;
+          // triples are generated once the plan is known, so their generation
+          // time is included in the multiplication time
+          auto make_triples = [&](const multiplication_plan& plan,
+                                  auto is_shared) {
+            return make_fake_triples(is_shared, plan.chunk_size,
+                                     plan.dense_inner, plan.n,
+                                     plan.num_chunks);
+          };
+          multiplication_plan plan;
+          channel.sync();
+          benchmarker.BenchmarkFunction("Matrix Multiplication", [&] {
+            C = secure_multiply(A, B, channel, p.get_id(), make_triples,
+                                auto_options, &benchmarker, &plan);
           });
+          std::cout << "Plan: " << plan.to_string() << "\n";
         } else {
           BOOST_THROW_EXCEPTION(
               std::runtime_error("Unknown multiplication_type"));
@@ -352,4 +443,28 @@ int main(int argc, const char* argv[]) {
       }
     }
   }
+  return 0;
+}
+
+// generates random matrices and multiplies them using multiplication triples
+int main(int argc, const char* argv[]) {
+  // parse config
+  matrix_multiplication_config conf;
+  try {
+    conf.parse(argc, argv);
+  } catch (boost::program_options::error& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  // connect to other party
+  party p(conf);
+  auto channel = p.connect_to(1 - p.get_id(), conf.measure_communication);
+  switch (conf.ring_bits) {
+    case 16:
+      return run_experiments<uint16_t>(conf, p, channel);
+    case 32:
+      return run_experiments<uint32_t>(conf, p, channel);
+    default:
+      return run_experiments<uint64_t>(conf, p, channel);
+  }
 }
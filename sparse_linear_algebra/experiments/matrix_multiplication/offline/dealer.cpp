@@ -0,0 +1,223 @@
+// Generates triples with a trusted dealer. Run three processes: parties 0 and
+// 1 request triples through DealerTripleProvider, and party 2 is the dealer.
+// All of them must be passed the same configuration.
+
+#include "sparse_linear_algebra/matrix_multiplication/offline/dealer_triple_provider.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/triple_dealer.hpp"
+#include "mpc_utils/benchmarker.hpp"
+#include "mpc_utils/mpc_config.hpp"
+#include "mpc_utils/party.hpp"
+#include "sparse_linear_algebra/util/get_ceil.hpp"
+
+// Party ID of the dealer.
+constexpr int kDealer = 2;
+
+class DealerConfig : public virtual mpc_config {
+ protected:
+  void validate() {
+    namespace po = boost::program_options;
+    if (party_id < 0 || party_id > kDealer) {
+      BOOST_THROW_EXCEPTION(po::error("'party' must be 0, 1 or 2"));
+    }
+    if (rows_server.size() == 0) {
+      BOOST_THROW_EXCEPTION(
+          po::error("'rows_server' must be passed at least once"));
+    }
+    for (auto l : rows_server) {
+      if (l <= 0) {
+        BOOST_THROW_EXCEPTION(po::error("'rows_server' must be positive"));
+      }
+    }
+    if (inner_dim.size() == 0) {
+      BOOST_THROW_EXCEPTION(
+          po::error("'inner_dim' must be passed at least once"));
+    }
+    for (auto m : inner_dim) {
+      if (m <= 0) {
+        BOOST_THROW_EXCEPTION(po::error("'inner_dim' must be positive"));
+      }
+    }
+    if (cols_client.size() == 0) {
+      BOOST_THROW_EXCEPTION(
+          po::error("'cols_client' must be passed at least once"));
+    }
+    for (auto n : cols_client) {
+      if (n <= 0) {
+        BOOST_THROW_EXCEPTION(po::error("'cols_client' must be positive"));
+      }
+    }
+    if (ring_bits != 16 && ring_bits != 32 && ring_bits != 64) {
+      BOOST_THROW_EXCEPTION(po::error("'ring_bits' must be 16, 32 or 64"));
+    }
+    if (num_triples < 1) {
+      BOOST_THROW_EXCEPTION(po::error("'num_triples' must be positive"));
+    }
+    for (const auto& type : triple_type) {
+      if (type != "distributed" && type != "shared") {
+        BOOST_THROW_EXCEPTION(
+            po::error("'triple_type' must be 'distributed' or 'shared'"));
+      }
+    }
+    mpc_config::validate();
+  }
+
+ public:
+  std::vector<int> rows_server;
+  std::vector<int> inner_dim;
+  std::vector<int> cols_client;
+  std::vector<std::string> triple_type;
+  int ring_bits;
+  int num_triples;
+  int max_runs;
+  bool measure_communication;
+
+  DealerConfig() : mpc_config() {
+    namespace po = boost::program_options;
+    add_options()(
+        "rows_server,l", po::value(&rows_server)->composing(),
+        "Number of rows in the server's matrix; can be passed multiple times")(
+        "inner_dim,m", po::value(&inner_dim)->composing(),
+        "Number of columns in A and number of rows in B; can be passed "
+        "multiple times")("cols_client,n", po::value(&cols_client)->composing(),
+                          "Number of columns in the client's matrix; can be "
+                          "passed multiple times")(
+        "max_runs", po::value(&max_runs)->default_value(-1),
+        "Maximum number of runs. Default is unlimited")(
+        "triple_type", po::value(&triple_type)->composing(),
+        "Type of the triples generated ('distributed' or 'shared'). Can be "
+        "passed multiple times.")(
+        "ring_bits", po::value(&ring_bits)->default_value(64),
+        "Bit width of the ring the triples live in: 16 | 32 | 64")(
+        "num_triples", po::value(&num_triples)->default_value(1),
+        "Number of triples requested by each party")(
+        "measure_communication",
+        po::bool_switch(&measure_communication)->default_value(false),
+        "Measure communication");
+  }
+};
+
+// Serves one experiment's requests to `parties`.
+template <typename T, bool is_shared>
+void RunDealer(int l, int m, int n, comm_channel* parties) {
+  using sparse_linear_algebra::matrix_multiplication::offline::TripleDealer;
+  TripleDealer<T, is_shared> dealer(l, m, n, &parties[0], &parties[1]);
+  mpc_utils::Status status = dealer.Run();
+  if (!status.ok()) {
+    BOOST_THROW_EXCEPTION(std::runtime_error(status.ToString()));
+  }
+}
+
+// Requests `num_triples` triples from the dealer and waits until they have
+// been expanded.
+template <typename T, bool is_shared>
+void RequestTriples(int l, int m, int n, int role, comm_channel* dealer,
+                    int num_triples, mpc_utils::Benchmarker* benchmarker) {
+  using sparse_linear_algebra::matrix_multiplication::offline::
+      DealerTripleProvider;
+  DealerTripleProvider<T, is_shared> triples(l, m, n, role, dealer);
+  auto start = benchmarker->StartTimer();
+  triples.Precompute(num_triples);
+  for (int i = 0; i < num_triples; i++) {
+    triples.GetTriple();
+  }
+  double seconds = benchmarker->AddSecondsSinceStart("Triples", start);
+  benchmarker->AddAmount("Amortized Seconds per Triple",
+                         seconds / num_triples);
+}
+
+template <typename T>
+void RunExperiment(int l, int m, int n, int role, comm_channel* channels,
+                   bool shared, int num_triples,
+                   mpc_utils::Benchmarker* benchmarker) {
+  if (role == kDealer) {
+    if (shared) {
+      RunDealer<T, true>(l, m, n, channels);
+    } else {
+      RunDealer<T, false>(l, m, n, channels);
+    }
+  } else {
+    if (shared) {
+      RequestTriples<T, true>(l, m, n, role, &channels[0], num_triples,
+                              benchmarker);
+    } else {
+      RequestTriples<T, false>(l, m, n, role, &channels[0], num_triples,
+                               benchmarker);
+    }
+  }
+}
+
+int main(int argc, const char* argv[]) {
+  // parse config
+  DealerConfig conf;
+  try {
+    conf.parse(argc, argv);
+  } catch (boost::program_options::error& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  int role = conf.party_id;
+  party p(conf);
+  // The dealer talks to both parties; the parties only to the dealer.
+  std::vector<comm_channel> channels;
+  if (role == kDealer) {
+    for (int i = 0; i < kDealer; i++) {
+      channels.push_back(p.connect_to(i, conf.measure_communication));
+    }
+  } else {
+    channels.push_back(p.connect_to(kDealer, conf.measure_communication));
+  }
+
+  int num_experiments =
+      std::max({conf.rows_server.size(), conf.inner_dim.size(),
+                conf.cols_client.size()});
+
+  for (int num_runs = 0; conf.max_runs < 0 || num_runs < conf.max_runs;
+       num_runs++) {
+    for (int experiment = 0; experiment < num_experiments; experiment++) {
+      std::cout << "Run " << num_runs << "\n";
+      int l = get_ceil(conf.rows_server, experiment);
+      int m = get_ceil(conf.inner_dim, experiment);
+      int n = get_ceil(conf.cols_client, experiment);
+      const std::string& triple_type = get_ceil(conf.triple_type, experiment);
+
+      std::cout << "l = " << l << "\nm = " << m << "\nn = " << n
+                << "\ntriple_type = " << triple_type
+                << "\nring_bits = " << conf.ring_bits
+                << "\nnum_triples = " << conf.num_triples << "\n";
+
+      std::vector<size_t> bytes_before;
+      if (conf.measure_communication) {
+        for (auto& channel : channels) {
+          bytes_before.push_back(channel.get_num_bytes_sent());
+        }
+      }
+      mpc_utils::Benchmarker benchmarker;
+      benchmarker.BenchmarkFunction("Triple Generation", [&] {
+        bool shared = triple_type == "shared";
+        int num = conf.num_triples;
+        if (conf.ring_bits == 16) {
+          RunExperiment<uint16_t>(l, m, n, role, channels.data(), shared, num,
+                                  &benchmarker);
+        } else if (conf.ring_bits == 32) {
+          RunExperiment<uint32_t>(l, m, n, role, channels.data(), shared, num,
+                                  &benchmarker);
+        } else {
+          RunExperiment<uint64_t>(l, m, n, role, channels.data(), shared, num,
+                                  &benchmarker);
+        }
+      });
+      if (conf.measure_communication) {
+        for (size_t i = 0; i < channels.size(); i++) {
+          std::string name =
+              role == kDealer ? "Bytes Sent to Party " + std::to_string(i)
+                              : "Bytes Sent to Dealer";
+          benchmarker.AddAmount(
+              name, channels[i].get_num_bytes_sent() - bytes_before[i]);
+        }
+      }
+      for (const auto& pair : benchmarker.GetAll()) {
+        std::cout << pair.first << ": " << pair.second << "\n";
+      }
+    }
+  }
+}
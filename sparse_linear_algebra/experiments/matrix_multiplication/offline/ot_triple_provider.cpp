@@ -38,6 +38,12 @@ class OtTripleProviderConfig : public virtual mpc_config {
         BOOST_THROW_EXCEPTION(po::error("'cols_client' must be positive"));
       }
     }
+    if (ring_bits != 16 && ring_bits != 32 && ring_bits != 64) {
+      BOOST_THROW_EXCEPTION(po::error("'ring_bits' must be 16, 32 or 64"));
+    }
+    if (num_triples < 1) {
+      BOOST_THROW_EXCEPTION(po::error("'num_triples' must be positive"));
+    }
     for (const auto& type : triple_type) {
       if (type != "distributed" && type != "shared") {
         BOOST_THROW_EXCEPTION(
@@ -52,6 +58,8 @@ class OtTripleProviderConfig : public virtual mpc_config {
   std::vector<int> inner_dim;
   std::vector<int> cols_client;
   std::vector<std::string> triple_type;
+  int ring_bits;
+  int num_triples;
   int max_runs;
   bool measure_communication;
 
@@ -70,14 +78,50 @@ class OtTripleProviderConfig : public virtual mpc_config {
         "triple_type", po::value(&triple_type)->composing(),
         "Type of the triples generated ('distributed' or 'shared'). Can be "
         "passed multiple times.")(
+        "ring_bits", po::value(&ring_bits)->default_value(64),
+        "Bit width of the ring the triples live in: 16 | 32 | 64")(
+        "num_triples", po::value(&num_triples)->default_value(1),
+        "Number of triples generated by each provider")(
         "measure_communication",
         po::bool_switch(&measure_communication)->default_value(false),
         "Measure communication");
   }
 };
 
-int main(int argc, const char* argv[]) {
+// Generates `num_triples` (l x m) x (m x n) triples with shares in the ring of
+// integers modulo 2^(8 * sizeof(T)) using a single provider. The first triple
+// includes the base OTs and is timed separately from the remaining ones.
+template <typename T, bool is_shared>
+void GenerateTriples(int l, int m, int n, int role, comm_channel* channel,
+                     int num_triples, mpc_utils::Benchmarker* benchmarker) {
   using sparse_linear_algebra::matrix_multiplication::offline::OTTripleProvider;
+  auto triples = OTTripleProvider<T, is_shared>::Create(l, m, n, role, channel)
+                     .ValueOrDie();
+  benchmarker->BenchmarkFunction("First Triple",
+                                 [&] { triples->Precompute(1); });
+  if (num_triples > 1) {
+    auto start = benchmarker->StartTimer();
+    triples->Precompute(num_triples - 1);
+    benchmarker->AddSecondsSinceStart("Remaining Triples", start);
+    double seconds = benchmarker->GetAll()["Remaining Triples"];
+    benchmarker->AddAmount("Amortized Seconds per Triple",
+                           seconds / (num_triples - 1));
+  }
+}
+
+template <typename T>
+void GenerateTriples(int l, int m, int n, int role, comm_channel* channel,
+                     bool shared, int num_triples,
+                     mpc_utils::Benchmarker* benchmarker) {
+  if (shared) {
+    GenerateTriples<T, true>(l, m, n, role, channel, num_triples, benchmarker);
+  } else {
+    GenerateTriples<T, false>(l, m, n, role, channel, num_triples,
+                              benchmarker);
+  }
+}
+
+int main(int argc, const char* argv[]) {
   // parse config
   OtTripleProviderConfig conf;
   try {
@@ -104,20 +148,23 @@ int main(int argc, const char* argv[]) {
       const std::string& triple_type = get_ceil(conf.triple_type, experiment);
 
       std::cout << "l = " << l << "\nm = " << m << "\nn = " << n
-                << "\ntriple_type = " << triple_type << "\n";
+                << "\ntriple_type = " << triple_type
+                << "\nring_bits = " << conf.ring_bits
+                << "\nnum_triples = " << conf.num_triples << "\n";
 
       mpc_utils::Benchmarker benchmarker;
       benchmarker.BenchmarkFunction("Triple Generation", [&] {
-        if (triple_type == "shared") {
-          auto triples =
-              OTTripleProvider<uint64_t, true>::Create(l, m, n, role, &channel)
-                  .ValueOrDie();
-          triples->Precompute(1);
+        bool shared = triple_type == "shared";
+        int num = conf.num_triples;
+        if (conf.ring_bits == 16) {
+          GenerateTriples<uint16_t>(l, m, n, role, &channel, shared, num,
+                                    &benchmarker);
+        } else if (conf.ring_bits == 32) {
+          GenerateTriples<uint32_t>(l, m, n, role, &channel, shared, num,
+                                    &benchmarker);
         } else {
-          auto triples =
-              OTTripleProvider<uint64_t, false>::Create(l, m, n, role, &channel)
-                  .ValueOrDie();
-          triples->Precompute(1);
+          GenerateTriples<uint64_t>(l, m, n, role, &channel, shared, num,
+                                    &benchmarker);
         }
       });
       for (const auto& pair : benchmarker.GetAll()) {
@@ -8,6 +8,7 @@
 #include "mpc_utils/mpc_config.hpp"
 #include "mpc_utils/party.hpp"
 #include "sparse_linear_algebra/oblivious_map/basic_oblivious_map.hpp"
+#include "sparse_linear_algebra/oblivious_map/cuckoo_oblivious_map.hpp"
 #include "sparse_linear_algebra/oblivious_map/poly_oblivious_map.hpp"
 #include "sparse_linear_algebra/oblivious_map/sorting_oblivious_map.hpp"
 #include "sparse_linear_algebra/util/get_ceil.hpp"
@@ -42,11 +43,15 @@ class test_pir_config : public virtual mpc_config {
             po::error("'num_elements_client' must be positive"));
       }
     }
+    if (num_values <= 0) {
+      BOOST_THROW_EXCEPTION(po::error("'num_values' must be positive"));
+    }
     for (auto &pir_type : pir_types) {
-      if (pir_type != "basic" && pir_type != "poly" && pir_type != "scs") {
+      if (pir_type != "basic" && pir_type != "poly" && pir_type != "scs" &&
+          pir_type != "cuckoo") {
         BOOST_THROW_EXCEPTION(
             po::error("'pir_type' must be either "
-                      "`basic`, `poly` or `scs`"));
+                      "`basic`, `poly`, `scs` or `cuckoo`"));
       }
     }
     mpc_config::validate();
@@ -57,6 +62,7 @@ class test_pir_config : public virtual mpc_config {
   std::vector<ssize_t> num_elements_client;
   std::vector<std::string> pir_types;
   int16_t statistical_security;
+  ssize_t num_values;
   bool measure_communication;
 
   test_pir_config() {
@@ -68,11 +74,14 @@ class test_pir_config : public virtual mpc_config {
         "num_elements_client,n", po::value(&num_elements_client)->composing(),
         "Number of non-zero elements in the client's database; can be passed "
         "multiple times")("pir_type", po::value(&pir_types)->composing(),
-                          "PIR type: basic | poly | scs; can "
+                          "PIR type: basic | poly | scs | cuckoo; can "
                           "be passed multiple times")(
         "statistical_security,s",
         po::value(&statistical_security)->default_value(40),
         "Statistical security parameter")(
+        "num_values", po::value(&num_values)->default_value(1),
+        "Number of values looked up per key; rows wider than an AES block "
+        "span several blocks")(
         "measure_communication",
         po::bool_switch(&measure_communication)->default_value(false),
         "Measure communication");
@@ -116,6 +125,10 @@ int main(int argc, const char **argv) {
           proto = std::unique_ptr<oblivious_map<key_type, value_type>>(
               new poly_oblivious_map<key_type, value_type>(
                   chan, conf.statistical_security));
+        } else if (pir_type == "cuckoo") {
+          proto = std::unique_ptr<oblivious_map<key_type, value_type>>(
+              new cuckoo_oblivious_map<key_type, value_type>(
+                  chan, conf.statistical_security));
         } else {  // if(conf.pir_type == "scs") {
           proto = std::unique_ptr<oblivious_map<key_type, value_type>>(
               new sorting_oblivious_map<key_type, value_type>(chan));
@@ -127,23 +140,29 @@ int main(int argc, const char **argv) {
       std::cout << "PIR type: " << pir_type << "\n";
       std::cout << "num_elements_server: " << num_elements_server << "\n";
       std::cout << "num_elements_client: " << num_elements_client << "\n";
+      std::cout << "num_values: " << conf.num_values << "\n";
       mpc_utils::Benchmarker benchmarker;
       try {
         if (party.get_id() == 0) {
           std::vector<key_type> server_keys_in(num_elements_server);
           std::iota(server_keys_in.begin(), server_keys_in.end(), 0);
-          std::vector<value_type> server_values_in(num_elements_server, 23);
-          std::vector<value_type> server_defaults(num_elements_client, 13);
+          std::vector<value_type> server_values_in(
+              num_elements_server * conf.num_values, 23);
+          std::vector<value_type> server_defaults(
+              num_elements_client * conf.num_values, 13);
           benchmarker.BenchmarkFunction("total_time", [&]() {
-            proto->run_server(server_keys_in, server_values_in, server_defaults,
-                              false, &benchmarker);
+            proto->run_server_multi(server_keys_in, server_values_in,
+                                    server_defaults, conf.num_values, false,
+                                    &benchmarker);
           });
         } else {
           std::vector<key_type> client_in(num_elements_client);
           std::iota(client_in.begin(), client_in.end(), 42);
-          std::vector<value_type> client_out(num_elements_client);
+          std::vector<value_type> client_out(num_elements_client *
+                                             conf.num_values);
           benchmarker.BenchmarkFunction("total_time", [&]() {
-            proto->run_client(client_in, client_out, false, &benchmarker);
+            proto->run_client_multi(client_in, client_out, conf.num_values,
+                                    false, &benchmarker);
           });
         }
       } catch (boost::exception &ex) {
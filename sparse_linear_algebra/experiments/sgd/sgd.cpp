@@ -6,6 +6,7 @@
 #include "sparse_linear_algebra/matrix_multiplication/cols-rows.hpp"
 #include "sparse_linear_algebra/matrix_multiplication/dense.hpp"
 #include "sparse_linear_algebra/matrix_multiplication/offline/fake_triple_provider.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/slicing_triple_provider.hpp"
 #include "sparse_linear_algebra/matrix_multiplication/rows-dense.hpp"
 #include "sparse_linear_algebra/oblivious_map/basic_oblivious_map.hpp"
 #include "sparse_linear_algebra/oblivious_map/oblivious_map.hpp"
@@ -119,10 +120,45 @@ class sgd_config : public virtual mpc_config {
   }
 };
 
+// Fake triples for one of the multiplications in each batch. The active party
+// has role 1 and alternates between batches, so there is a provider for each
+// role. Triples are generated for full batches and sliced to the size of the
+// last batch, so that no provider needs to be created per batch.
+template <typename T, bool is_shared>
+class batch_triples {
+ public:
+  batch_triples(int l, int m, int n, comm_channel* channel) {
+    for (int role = 0; role < 2; role++) {
+      sources_[role].reset(
+          new sparse_linear_algebra::matrix_multiplication::offline::
+              FakeTripleProvider<T, is_shared>(l, m, n, role));
+      sliced_[role].reset(
+          new sparse_linear_algebra::matrix_multiplication::offline::
+              SlicingTripleProvider<T, is_shared>(sources_[role].get(),
+                                                  channel));
+    }
+  }
+
+  // Precomputes the triple for the next batch in which this party has `role`.
+  void precompute(int role) { sources_[role]->Precompute(1); }
+
+  sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
+      T, is_shared>&
+  get(int role) {
+    return *sliced_[role];
+  }
+
+ private:
+  std::unique_ptr<sparse_linear_algebra::matrix_multiplication::offline::
+                      FakeTripleProvider<T, is_shared>>
+      sources_[2];
+  std::unique_ptr<sparse_linear_algebra::matrix_multiplication::offline::
+                      SlicingTripleProvider<T, is_shared>>
+      sliced_[2];
+};
+
 // generates random matrices and multiplies them using multiplication triples
 int main(int argc, const char* argv[]) {
-  using sparse_linear_algebra::matrix_multiplication::offline::
-      FakeTripleProvider;
   using T = uint64_t;
 
   int precision = 10;
@@ -198,6 +234,15 @@ int main(int argc, const char* argv[]) {
       }
       B.setFromTriplets(triplets_B.begin(), triplets_B.end());
 
+      // Each batch asks for triples of its exact size.
+      dense_multiplication_options options;
+      options.exact_shape = true;
+      batch_triples<T, false> forward_dense(batch_size, m, n, &channel);
+      batch_triples<T, true> forward_sparse(batch_size, nonzeros, n, &channel);
+      batch_triples<T, false> backward_dense(m, batch_size, n, &channel);
+      batch_triples<T, false> backward_sparse(nonzeros, batch_size, n,
+                                              &channel);
+
       for (int epoch = 0; epoch < num_epochs; epoch++) {
         int active_party = 0;  // Alternates between batches.
         const Eigen::SparseMatrix<T, Eigen::RowMajor>* input[2] = {&A, &B};
@@ -214,39 +259,39 @@ int main(int argc, const char* argv[]) {
                 input[active_party]->rows() - row_index[active_party];
           }
 
+          int role = active_party == p.get_id();
+
           // Forward pass.
           Eigen::Matrix<T, Eigen::Dynamic, 1> activations(this_batch_size);
           try {
             if (mult_type == "dense") {
-              FakeTripleProvider<T> triples(this_batch_size, m, n,
-                                            active_party == p.get_id());
               channel.sync();
               // TODO: aggregate fake Triple computation times
-              benchmarker.BenchmarkFunction("Fake Triple Generation",
-                                            [&] { triples.Precompute(1); });
+              benchmarker.BenchmarkFunction(
+                  "Fake Triple Generation",
+                  [&] { forward_dense.precompute(role); });
 
               channel.sync();
               benchmarker.BenchmarkFunction("Forward Pass", [&] {
                 activations = matrix_multiplication_dense(
                     input[active_party]->middleRows(row_index[active_party],
                                                     this_batch_size),
-                    model, channel, active_party == p.get_id(), triples,
-                    this_batch_size);
+                    model, channel, role, forward_dense.get(role),
+                    this_batch_size, options);
               });
             } else if (mult_type == "sparse") {
-              FakeTripleProvider<T, true> triples(this_batch_size, nonzeros, n,
-                                                  active_party == p.get_id());
               channel.sync();
-              benchmarker.BenchmarkFunction("Fake Triple Generation",
-                                            [&] { triples.Precompute(1); });
+              benchmarker.BenchmarkFunction(
+                  "Fake Triple Generation",
+                  [&] { forward_sparse.precompute(role); });
 
               channel.sync();
               benchmarker.BenchmarkFunction("Forward Pass", [&] {
                 activations = matrix_multiplication_cols_dense(
                     input[active_party]->middleRows(row_index[active_party],
                                                     this_batch_size),
-                    model, proto, channel, active_party == p.get_id(), triples,
-                    this_batch_size, nonzeros, &benchmarker);
+                    model, proto, channel, role, forward_sparse.get(role),
+                    this_batch_size, nonzeros, &benchmarker, options);
               });
             } else {
               BOOST_THROW_EXCEPTION(
@@ -302,12 +347,11 @@ int main(int argc, const char* argv[]) {
           Eigen::Matrix<T, Eigen::Dynamic, 1> gradient(m);
           try {
             if (mult_type == "dense") {
-              FakeTripleProvider<T> triples(m, this_batch_size, n,
-                                            active_party == p.get_id());
               channel.sync();
               // TODO: aggregate fake Triple computation times
-              benchmarker.BenchmarkFunction("Fake Triple Generation",
-                                            [&] { triples.Precompute(1); });
+              benchmarker.BenchmarkFunction(
+                  "Fake Triple Generation",
+                  [&] { backward_dense.precompute(role); });
 
               channel.sync();
               benchmarker.BenchmarkFunction("Backward Pass", [&] {
@@ -315,15 +359,14 @@ int main(int argc, const char* argv[]) {
                     input[active_party]
                         ->middleRows(row_index[active_party], this_batch_size)
                         .transpose(),
-                    activations, channel, active_party == p.get_id(), triples,
-                    -1);
+                    activations, channel, role, backward_dense.get(role), -1,
+                    options);
               });
             } else if (mult_type == "sparse") {
-              FakeTripleProvider<T> triples(nonzeros, this_batch_size, n,
-                                            active_party == p.get_id());
               channel.sync();
-              benchmarker.BenchmarkFunction("Fake Triple Generation",
-                                            [&] { triples.Precompute(1); });
+              benchmarker.BenchmarkFunction(
+                  "Fake Triple Generation",
+                  [&] { backward_sparse.precompute(role); });
 
               channel.sync();
               benchmarker.BenchmarkFunction("Backward Pass", [&] {
@@ -331,8 +374,8 @@ int main(int argc, const char* argv[]) {
                     input[active_party]
                         ->middleRows(row_index[active_party], this_batch_size)
                         .transpose(),
-                    activations, channel, active_party == p.get_id(), triples,
-                    -1, nonzeros, &benchmarker);
+                    activations, channel, role, backward_sparse.get(role), -1,
+                    nonzeros, &benchmarker, options);
               });
             } else {
               BOOST_THROW_EXCEPTION(
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <unordered_map>
-#include <unordered_set>
 #include "Eigen/Sparse"
 #include "boost/range/algorithm.hpp"
 #include "boost/range/counting_range.hpp"
@@ -13,46 +12,65 @@ extern "C" {
 #include <bcrandom.h>
 }
 
+// Writes this party's share of the product to `result`. A `workspace` reused
+// across calls avoids reallocating the intermediate dense matrices and index
+// lists.
 template <
     typename Derived_A, typename Derived_B, typename K,
     typename T = typename Derived_A::Scalar,
     typename std::enable_if<std::is_same<T, typename Derived_B::Scalar>::value,
                             int>::type = 0>
-Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
-matrix_multiplication_cols_dense(
+void matrix_multiplication_cols_dense(
     const Eigen::SparseMatrixBase<Derived_A>& A_in,
     const Eigen::MatrixBase<Derived_B>& B_in, oblivious_map<K, T>& prot,
     comm_channel& channel, int role,
     sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
         T, true>& triples,
-    ssize_t chunk_size_in = -1,
+    matrix_output<T> result, ssize_t chunk_size_in = -1,
     ssize_t k_A = -1,  // saves a communication round if set
-    mpc_utils::Benchmarker* benchmarker = nullptr) {
+    mpc_utils::Benchmarker* benchmarker = nullptr,
+    const dense_multiplication_options& options =
+        dense_multiplication_options(),
+    multiplication_workspace<T>* workspace = nullptr) {
   try {
-    std::vector<K> inner_indices;
-    Eigen::SparseMatrix<T, Eigen::RowMajor> A;
-    Eigen::Matrix<T, Derived_B::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
-        B;
-    Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
-        ret;
+    if (result.rows() != A_in.rows() || result.cols() != B_in.cols()) {
+      BOOST_THROW_EXCEPTION(
+          std::invalid_argument("Output size does not match matrix sizes"));
+    }
+    multiplication_workspace<T> local_workspace;
+    if (workspace == nullptr) {
+      workspace = &local_workspace;
+    }
+    // k_A is either unset (-1) or a number of columns of A
+    auto check_k_A = [&] {
+      if (k_A < 0 || k_A > A_in.cols()) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+            "k_A must be between 0 and the number of columns of A"));
+      }
+    };
+    if (k_A != -1) {
+      check_k_A();
+    }
+    const auto& A = A_in.derived();
+    const auto& B = B_in.derived();
+    auto& inner_indices = workspace->inner_indices;
+    auto& inner_positions = workspace->inner_positions;
     // compute own indices and exchange k values if not given as arguments
     if (role == 0) {
-      A = A_in.derived();
-      auto inner_indices_copy = compute_inner_indices(A);
-      inner_indices =
-          std::vector<K>(inner_indices_copy.begin(), inner_indices_copy.end());
+      ComputeNonzeroIndices(A, true, &inner_indices, &inner_positions);
       if (k_A == -1) {
         k_A = inner_indices.size();
         channel.send(k_A);
         channel.flush();
+      } else if (inner_indices.size() > static_cast<size_t>(k_A)) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+            "k_A is smaller than the number of nonzero columns of A"));
+      } else {
+        PadNonzeroIndices(k_A, &inner_indices, &inner_positions);
       }
-    } else {
-      B = B_in.derived();
-      if (k_A == -1) {
-        channel.recv(k_A);
-      }
-      A.resize(A_in.rows(), k_A);
-      A.setZero();
+    } else if (k_A == -1) {
+      channel.recv(k_A);
+      check_k_A();
     }
 
     mpc_utils::Benchmarker::time_point start;
@@ -60,31 +78,36 @@ matrix_multiplication_cols_dense(
       start = benchmarker->StartTimer();
     }
 
-    // get additive shares of B at inner_indices
-    // TODO: extend ROOM to multiple values, do whole matrix B at once
+    // get additive shares of B at inner_indices, looking up whole rows of B
+    // in a single ROOM execution
     size_t num_cols_B = B_in.derived().cols();
-    Eigen::Matrix<T, Derived_B::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
-        B_shared(k_A, num_cols_B);
-    B_shared.setZero();
-    for (size_t col = 0; col < num_cols_B; col++) {
-      std::vector<T> result(k_A);
-      if (role == 0) {
-        prot.run_client(inner_indices, result, true, benchmarker);
-      } else {
-        // set our share
-        auto rng = newBCipherRandomGen();
-        randomizeBuffer(rng, (char*)result.data(), result.size() * sizeof(T));
-        releaseBCipherRandomGen(rng);
-        // get current column
-        std::vector<T> values(B.rows());
-        for (size_t row = 0; row < B.rows(); row++) {
-          values[row] = B(row, col);
+    auto& B_shared = workspace->dense_B;
+    B_shared.resize(k_A, num_cols_B);
+    std::vector<T>& shares = workspace->column_out;
+    std::vector<T>& values = workspace->column_in;
+    shares.assign(k_A * num_cols_B, 0);
+    if (role == 0) {
+      // the oblivious map takes its keys as K
+      std::vector<K> keys(inner_indices.begin(), inner_indices.end());
+      prot.run_client_multi(keys, shares, num_cols_B, true, benchmarker);
+    } else {
+      // set our share
+      auto rng = newBCipherRandomGen();
+      randomizeBuffer(rng, (char*)shares.data(), shares.size() * sizeof(T));
+      releaseBCipherRandomGen(rng);
+      // flatten B row by row
+      values.resize(B.rows() * num_cols_B);
+      for (size_t row = 0; row < static_cast<size_t>(B.rows()); row++) {
+        for (size_t col = 0; col < num_cols_B; col++) {
+          values[row * num_cols_B + col] = B(row, col);
         }
-        prot.run_server(boost::counting_range(K(0), K(B.rows())), values,
-                        result, true, benchmarker);
       }
-      for (size_t row = 0; row < k_A; row++) {
-        B_shared(row, col) = result[row];
+      prot.run_server_multi(boost::counting_range(K(0), K(B.rows())), values,
+                            shares, num_cols_B, true, benchmarker);
+    }
+    for (size_t row = 0; row < static_cast<size_t>(k_A); row++) {
+      for (size_t col = 0; col < num_cols_B; col++) {
+        B_shared(row, col) = shares[row * num_cols_B + col];
       }
     }
 
@@ -93,15 +116,14 @@ matrix_multiplication_cols_dense(
       start = benchmarker->StartTimer();
     }
 
-    // extract nonzero rows
-    Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_A::ColsAtCompileTime>
-        A_dense;
+    // extract nonzero columns
+    auto& A_dense = workspace->dense_A;
     if (role == 0) {
-      Eigen::SparseMatrix<T, Eigen::ColMajor> A_cols = A;
-      A_dense.resize(A.rows(), k_A);
-      A_dense.setZero();
-      for (size_t i = 0; i < k_A; i++) {
-        A_dense.col(i) = A_cols.col(inner_indices[i]);
+      A_dense.setZero(A.rows(), k_A);
+      for (Eigen::Index outer = 0; outer < A.outerSize(); outer++) {
+        for (typename Derived_A::InnerIterator it(A, outer); it; ++it) {
+          A_dense(it.row(), inner_positions[it.col()]) = it.value();
+        }
       }
     }
 
@@ -112,11 +134,13 @@ matrix_multiplication_cols_dense(
 
     // dense multiplication
     if (role == 0) {
-      ret = matrix_multiplication_dense(A_dense, B_shared, channel, role,
-                                        triples, chunk_size_in);
+      matrix_multiplication_dense(A_dense, B_shared, channel, role, triples,
+                                  result, chunk_size_in, options, workspace);
     } else {
-      ret = matrix_multiplication_dense(A, B_shared, channel, role, triples,
-                                        chunk_size_in);
+      // our share of A is zero
+      matrix_multiplication_dense(
+          dense_internal::Matrix<T>::Zero(A.rows(), k_A), B_shared, channel,
+          role, triples, result, chunk_size_in, options, workspace);
     }
 
     if (benchmarker != nullptr) {
@@ -124,8 +148,6 @@ matrix_multiplication_cols_dense(
       start = benchmarker->StartTimer();
     }
 
-    return ret;
-
   } catch (boost::exception& e) {
     e << error_a_size1(A_in.rows()) << error_a_size2(A_in.cols())
       << error_b_size1(B_in.rows()) << error_b_size2(B_in.cols());
@@ -133,3 +155,62 @@ matrix_multiplication_cols_dense(
     throw;
   }
 }
+
+template <
+    typename Derived_A, typename Derived_B, typename K,
+    typename T = typename Derived_A::Scalar,
+    typename std::enable_if<std::is_same<T, typename Derived_B::Scalar>::value,
+                            int>::type = 0>
+Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
+matrix_multiplication_cols_dense(
+    const Eigen::SparseMatrixBase<Derived_A>& A_in,
+    const Eigen::MatrixBase<Derived_B>& B_in, oblivious_map<K, T>& prot,
+    comm_channel& channel, int role,
+    sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
+        T, true>& triples,
+    ssize_t chunk_size_in = -1,
+    ssize_t k_A = -1,  // saves a communication round if set
+    mpc_utils::Benchmarker* benchmarker = nullptr,
+    const dense_multiplication_options& options =
+        dense_multiplication_options(),
+    multiplication_workspace<T>* workspace = nullptr) {
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> ret(A_in.rows(),
+                                                       B_in.cols());
+  matrix_multiplication_cols_dense(A_in, B_in, prot, channel, role, triples,
+                                   ret, chunk_size_in, k_A, benchmarker,
+                                   options, workspace);
+  return ret;
+}
+
+// Asynchronous version of matrix_multiplication_cols_dense on its own channel
+// session; see run_on_session(). The inputs are copied; `prot` and `triples`
+// must stay alive until the returned future is ready, and must not be used by
+// anything else meanwhile. `prot` keeps communicating over its own channel.
+template <
+    typename Derived_A, typename Derived_B, typename K,
+    typename T = typename Derived_A::Scalar,
+    typename std::enable_if<std::is_same<T, typename Derived_B::Scalar>::value,
+                            int>::type = 0>
+std::future<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>
+matrix_multiplication_cols_dense_async(
+    const Eigen::SparseMatrixBase<Derived_A>& A_in,
+    const Eigen::MatrixBase<Derived_B>& B_in, oblivious_map<K, T>& prot,
+    comm_channel& channel, int role,
+    sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
+        T, true>& triples,
+    ssize_t chunk_size_in = -1,
+    ssize_t k_A = -1,  // saves a communication round if set
+    const dense_multiplication_options& options =
+        dense_multiplication_options()) {
+  Eigen::SparseMatrix<T, Eigen::RowMajor> A = A_in.derived();
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> B = B_in.derived();
+  return run_on_session(channel, [A, B, &prot, role, &triples, chunk_size_in,
+                                  k_A, options](comm_channel& session) {
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> result(A.rows(),
+                                                            B.cols());
+    matrix_multiplication_cols_dense(A, B, prot, session, role, triples,
+                                     result, chunk_size_in, k_A, nullptr,
+                                     options);
+    return result;
+  });
+}
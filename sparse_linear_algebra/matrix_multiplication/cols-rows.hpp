@@ -39,35 +39,48 @@ std::pair<std::unordered_map<K, K>, std::vector<K>> permute_inner_indices(
                      dense_indices.end()));
 }
 
+// Writes this party's share of the product to `result`. A `workspace` reused
+// across calls avoids reallocating the permuted dense matrices and index
+// lists. See
+// secure_multiply() for choosing this protocol based on the sparsity of A and
+// B.
 template <
     typename Derived_A, typename Derived_B, typename K,
     typename T = typename Derived_A::Scalar,
     typename std::enable_if<std::is_same<T, typename Derived_B::Scalar>::value,
                             int>::type = 0>
-Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
-matrix_multiplication_cols_rows(  // TODO: somehow derive row-/column sparsity
+void matrix_multiplication_cols_rows(
     const Eigen::SparseMatrixBase<Derived_A> &A_in,
     const Eigen::SparseMatrixBase<Derived_B> &B_in, oblivious_map<K, K> &prot,
     comm_channel &channel, int role,
     sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
         T, false> &triples,  // TODO: implement shared variant by pseudorandomly
                              // permuting indexes in another garbled circuit
-    ssize_t chunk_size_in = -1, ssize_t k_A = -1,
+    matrix_output<T> result, ssize_t chunk_size_in = -1, ssize_t k_A = -1,
     ssize_t k_B = -1,  // saves a communication round if set
-    mpc_utils::Benchmarker *benchmarker = nullptr) {
+    mpc_utils::Benchmarker *benchmarker = nullptr,
+    const dense_multiplication_options &options =
+        dense_multiplication_options(),
+    multiplication_workspace<T> *workspace = nullptr) {
   try {
+    if (result.rows() != A_in.rows() || result.cols() != B_in.cols()) {
+      BOOST_THROW_EXCEPTION(
+          std::invalid_argument("Output size does not match matrix sizes"));
+    }
+    multiplication_workspace<T> local_workspace;
+    if (workspace == nullptr) {
+      workspace = &local_workspace;
+    }
     size_t k;
-    std::vector<K> inner_indices;
-    Eigen::SparseMatrix<T, Eigen::RowMajor> A;
-    Eigen::SparseMatrix<T, Eigen::ColMajor> B;
-    Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
-        ret;
+    const auto &A = A_in.derived();
+    const auto &B = B_in.derived();
+    // the columns of A or the rows of B that have nonzeros, and their
+    // positions in the permuted dense matrix
+    auto &inner_indices = workspace->inner_indices;
+    auto &inner_positions = workspace->inner_positions;
     // compute own indices and exchange k values if not given as arguments
     if (role == 0) {
-      A = A_in.derived();
-      auto inner_indices_copy = compute_inner_indices(A);
-      inner_indices =
-          std::vector<K>(inner_indices_copy.begin(), inner_indices_copy.end());
+      ComputeNonzeroIndices(A, true, &inner_indices, &inner_positions);
       if (k_A == -1) {
         k_A = inner_indices.size();
         channel.send(k_A);
@@ -76,10 +89,7 @@ matrix_multiplication_cols_rows(  // TODO: somehow derive row-/column sparsity
         channel.recv(k_B);
       }
     } else {
-      B = B_in.derived();
-      auto inner_indices_copy = compute_inner_indices(B);
-      inner_indices =
-          std::vector<K>(inner_indices_copy.begin(), inner_indices_copy.end());
+      ComputeNonzeroIndices(B, false, &inner_indices, &inner_positions);
       if (k_A == -1) {
         channel.recv(k_A);
       }
@@ -88,9 +98,13 @@ matrix_multiplication_cols_rows(  // TODO: somehow derive row-/column sparsity
         channel.send(k_B);
       }
     }
+    if (inner_indices.size() > static_cast<size_t>(role == 0 ? k_A : k_B)) {
+      BOOST_THROW_EXCEPTION(std::invalid_argument(
+          "k_A or k_B is smaller than the number of nonzero indices"));
+    }
     k = k_A + k_B;
-
-    std::vector<std::pair<K, K>> perm(inner_indices.size());
+    // the oblivious map takes its keys as K
+    std::vector<K> keys(inner_indices.begin(), inner_indices.end());
 
     mpc_utils::Benchmarker::time_point start;
     if (benchmarker != nullptr) {
@@ -105,23 +119,21 @@ matrix_multiplication_cols_rows(  // TODO: somehow derive row-/column sparsity
       randomizeBuffer(gen, (char *)&seed, sizeof(int));
       releaseBCipherRandomGen(gen);
       std::mt19937 prg(seed);
-      auto perm_result = permute_inner_indices(prg, inner_indices, k);
+      auto perm_result = permute_inner_indices(prg, keys, k);
       // run ROOM protocol to give client their permutation
       prot.run_server(perm_result.first, perm_result.second, false,
                       benchmarker);
-      boost::copy(perm_result.first, perm.begin());
+      for (const auto &pair : perm_result.first) {
+        inner_positions[pair.first] = pair.second;
+      }
     } else {
       std::vector<K> perm_values(role == 0 ? k_A : k_B);
-      std::vector<K> inner_indices_copy(
-          perm_values.size(),
-          -1);  // Fill with dummy value by default that is guaranteed not to
-                // match on the other side.
-      std::copy_n(inner_indices.begin(),
-                  std::min(inner_indices.size(), inner_indices_copy.size()),
-                  inner_indices_copy.begin());
-      prot.run_client(inner_indices_copy, perm_values, false, benchmarker);
-      for (size_t i = 0; i < perm.size(); i++) {
-        perm[i] = std::make_pair(inner_indices[i], perm_values[i]);
+      // Fill with dummy value by default that is guaranteed not to match on
+      // the other side.
+      keys.resize(perm_values.size(), -1);
+      prot.run_client(keys, perm_values, false, benchmarker);
+      for (size_t i = 0; i < inner_indices.size(); i++) {
+        inner_positions[inner_indices[i]] = perm_values[i];
       }
     }
 
@@ -132,13 +144,12 @@ matrix_multiplication_cols_rows(  // TODO: somehow derive row-/column sparsity
 
     // apply permutation and multiply
     if (role == 0) {
-      Eigen::Matrix<T, Derived_A::RowsAtCompileTime,
-                    Derived_A::ColsAtCompileTime>
-          A_permuted(A.rows(), k);
-      A_permuted.setZero();
-      Eigen::SparseMatrix<T, Eigen::ColMajor> A_cols = A;
-      for (auto pair : perm) {
-        A_permuted.col(pair.second) = A_cols.col(pair.first);
+      auto &A_permuted = workspace->dense_A;
+      A_permuted.setZero(A.rows(), k);
+      for (Eigen::Index outer = 0; outer < A.outerSize(); outer++) {
+        for (typename Derived_A::InnerIterator it(A, outer); it; ++it) {
+          A_permuted(it.row(), inner_positions[it.col()]) = it.value();
+        }
       }
 
       if (benchmarker != nullptr) {
@@ -146,22 +157,21 @@ matrix_multiplication_cols_rows(  // TODO: somehow derive row-/column sparsity
         start = benchmarker->StartTimer();
       }
 
-      B.resize(k, B_in.cols());
-      ret = matrix_multiplication_dense(A_permuted, B, channel, role, triples,
-                                        chunk_size_in);
+      // only the shape of our (zero) share of B is used
+      matrix_multiplication_dense(
+          A_permuted, dense_internal::Matrix<T>::Zero(k, B.cols()), channel,
+          role, triples, result, chunk_size_in, options, workspace);
 
       if (benchmarker != nullptr) {
         benchmarker->AddSecondsSinceStart("dense_time", start);
       }
     } else {
-      Eigen::Matrix<T, Derived_B::RowsAtCompileTime,
-                    Derived_B::ColsAtCompileTime>
-          B_permuted(k, B.cols());
-      B_permuted.setZero();
-      // copy into row major for faster row access
-      Eigen::SparseMatrix<T, Eigen::RowMajor> B_rows = B;
-      for (auto pair : perm) {
-        B_permuted.row(pair.second) = B_rows.row(pair.first);
+      auto &B_permuted = workspace->dense_B;
+      B_permuted.setZero(k, B.cols());
+      for (Eigen::Index outer = 0; outer < B.outerSize(); outer++) {
+        for (typename Derived_B::InnerIterator it(B, outer); it; ++it) {
+          B_permuted(inner_positions[it.row()], it.col()) = it.value();
+        }
       }
 
       if (benchmarker != nullptr) {
@@ -169,16 +179,16 @@ matrix_multiplication_cols_rows(  // TODO: somehow derive row-/column sparsity
         start = benchmarker->StartTimer();
       }
 
-      A.resize(A_in.rows(), k);
-      ret = matrix_multiplication_dense(A, B_permuted, channel, role, triples,
-                                        chunk_size_in);
+      // only the shape of our (zero) share of A is used
+      matrix_multiplication_dense(
+          dense_internal::Matrix<T>::Zero(A.rows(), k), B_permuted, channel,
+          role, triples, result, chunk_size_in, options, workspace);
 
       if (benchmarker != nullptr) {
         benchmarker->AddSecondsSinceStart("dense_time", start);
         start = benchmarker->StartTimer();
       }
     }
-    return ret;
   } catch (boost::exception &e) {
     e << error_a_size1(A_in.rows()) << error_a_size2(A_in.cols())
       << error_b_size1(B_in.rows()) << error_b_size2(B_in.cols());
@@ -186,3 +196,61 @@ matrix_multiplication_cols_rows(  // TODO: somehow derive row-/column sparsity
     throw;
   }
 }
+
+template <
+    typename Derived_A, typename Derived_B, typename K,
+    typename T = typename Derived_A::Scalar,
+    typename std::enable_if<std::is_same<T, typename Derived_B::Scalar>::value,
+                            int>::type = 0>
+Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
+matrix_multiplication_cols_rows(
+    const Eigen::SparseMatrixBase<Derived_A> &A_in,
+    const Eigen::SparseMatrixBase<Derived_B> &B_in, oblivious_map<K, K> &prot,
+    comm_channel &channel, int role,
+    sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
+        T, false> &triples,
+    ssize_t chunk_size_in = -1, ssize_t k_A = -1,
+    ssize_t k_B = -1,  // saves a communication round if set
+    mpc_utils::Benchmarker *benchmarker = nullptr,
+    const dense_multiplication_options &options =
+        dense_multiplication_options(),
+    multiplication_workspace<T> *workspace = nullptr) {
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> ret(A_in.rows(),
+                                                       B_in.cols());
+  matrix_multiplication_cols_rows(A_in, B_in, prot, channel, role, triples, ret,
+                                  chunk_size_in, k_A, k_B, benchmarker, options,
+                                  workspace);
+  return ret;
+}
+
+// Asynchronous version of matrix_multiplication_cols_rows on its own channel
+// session; see run_on_session(). The inputs are copied; `prot` and `triples`
+// must stay alive until the returned future is ready, and must not be used by
+// anything else meanwhile. `prot` keeps communicating over its own channel.
+template <
+    typename Derived_A, typename Derived_B, typename K,
+    typename T = typename Derived_A::Scalar,
+    typename std::enable_if<std::is_same<T, typename Derived_B::Scalar>::value,
+                            int>::type = 0>
+std::future<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>
+matrix_multiplication_cols_rows_async(
+    const Eigen::SparseMatrixBase<Derived_A> &A_in,
+    const Eigen::SparseMatrixBase<Derived_B> &B_in, oblivious_map<K, K> &prot,
+    comm_channel &channel, int role,
+    sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
+        T, false> &triples,
+    ssize_t chunk_size_in = -1, ssize_t k_A = -1,
+    ssize_t k_B = -1,  // saves a communication round if set
+    const dense_multiplication_options &options =
+        dense_multiplication_options()) {
+  Eigen::SparseMatrix<T, Eigen::RowMajor> A = A_in.derived();
+  Eigen::SparseMatrix<T, Eigen::ColMajor> B = B_in.derived();
+  return run_on_session(channel, [A, B, &prot, role, &triples, chunk_size_in,
+                                  k_A, k_B, options](comm_channel &session) {
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> result(A.rows(),
+                                                            B.cols());
+    matrix_multiplication_cols_rows(A, B, prot, session, role, triples, result,
+                                    chunk_size_in, k_A, k_B, nullptr, options);
+    return result;
+  });
+}
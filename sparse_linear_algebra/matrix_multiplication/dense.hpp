@@ -1,10 +1,21 @@
 #pragma once
 
+#include <sys/types.h>
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <vector>
 #include "Eigen/Dense"
+#include "boost/serialization/utility.hpp"
+#include "boost/serialization/vector.hpp"
 #include "mpc_utils/boost_serialization/eigen.hpp"
 #include "mpc_utils/comm_channel.hpp"
 #include "sparse_linear_algebra/matrix_multiplication/offline/triple_provider.hpp"
 #include "sparse_linear_algebra/oblivious_map/oblivious_map.hpp"
+#include "sparse_linear_algebra/util/ring_gemm.hpp"
+#include "sparse_linear_algebra/util/thread_pool.hpp"
 
 /**
  * error_info structs for reporting input dimension in exceptions
@@ -19,20 +30,235 @@ typedef boost::error_info<struct tag_K_A, size_t> error_k_A;
 typedef boost::error_info<struct tag_K_B, size_t> error_k_B;
 typedef boost::error_info<struct tag_CHUNK_SIZE, size_t> error_chunk_size;
 
+// Options for matrix_multiplication_dense and the sparse multiplications built
+// on top of it.
+struct dense_multiplication_options {
+  // Number of threads computing the local products of different chunks. If
+  // larger than 1, mask exchange for chunk i+1 on the calling thread overlaps
+  // with the local products of chunk i.
+  int num_threads = 1;
+
+  // If set, the masked inputs of all chunks are opened in a single exchange,
+  // so the whole multiplication takes one round instead of one per chunk. This
+  // keeps the masked inputs of all chunks in memory at once. Both parties must
+  // use the same value.
+  bool single_round = false;
+
+  // If set, all chunks use a single triple family from
+  // TripleProvider::GetTripleFamily() that shares V, so B - V is opened only
+  // once instead of once per chunk. Both parties must use the same value.
+  bool shared_v = false;
+
+  // If set, each chunk asks for a triple of exactly its shape via
+  // TripleProvider::GetTripleOfShape(), so a smaller last chunk is not padded
+  // to the chunk size, and the provider's dimensions only need to be supported
+  // rather than equal to the chunk dimensions. Cannot be combined with
+  // shared_v. Both parties must use the same value.
+  bool exact_shape = false;
+};
+
+namespace dense_internal {
+
+template <typename T>
+using Matrix = sparse_linear_algebra::matrix_multiplication::offline::Matrix<T>;
+
+// Masked right-hand side B - V, possibly shared by several chunks. After
+// open_masks(), F holds the opened value, and role 1 has added F to its V.
+template <typename T>
+struct masked_rhs {
+  Matrix<T> V, F;
+  bool opened = false;
+};
+
+// Triple and masked input of a single chunk of a dense multiplication. After
+// open_masks(), E holds the opened value A - U. `rhs` points either to
+// `own_rhs` or to the right-hand side shared by a triple family.
+template <typename T>
+struct masked_chunk {
+  size_t offset, rows;
+  Matrix<T> U, Z, E;
+  masked_rhs<T> own_rhs;
+  masked_rhs<T> *rhs;
+};
+
+// Makes the output parameter below a non-deduced context, so that any
+// column-major block converts to it.
+template <typename T>
+struct output {
+  using type = Eigen::Ref<Matrix<T>, 0, Eigen::OuterStride<>>;
+};
+
+}  // namespace dense_internal
+
+// Caller-provided output of a multiplication. Any column-major dynamic matrix
+// or block of one, e.g. `result.middleRows(offset, rows)`, binds to it.
+template <typename T>
+using matrix_output = typename dense_internal::output<T>::type;
+
+// Buffers that matrix_multiplication_dense and the sparse multiplications
+// reuse across calls. Repeated multiplications with the same dimensions and
+// options then reuse all masked inputs, intermediate dense matrices, index
+// lists and worker threads instead of allocating them anew. What is still
+// allocated per call are the triples, the matrices deserialized from the
+// channel, the futures of the scheduled local products, and the buffers of the
+// oblivious map, zero-sharing and permutation protocols. A workspace must not
+// be used by several multiplications at the same time.
+template <typename T>
+struct multiplication_workspace {
+  using matrix = dense_internal::Matrix<T>;
+
+  // Masked chunks in flight in matrix_multiplication_dense.
+  std::vector<dense_internal::masked_chunk<T>> chunks;
+  // Masked right-hand side shared by all chunks of a triple family.
+  dense_internal::masked_rhs<T> family_rhs;
+  // Masked inputs sent and received when opening masks.
+  std::vector<matrix> sent_E, sent_F;
+  std::pair<std::vector<matrix>, std::vector<matrix>> received;
+  // Worker threads computing local products; recreated only if the number of
+  // threads changes.
+  std::unique_ptr<thread_pool> pool;
+
+  // Intermediate dense operands and results of the sparse multiplications.
+  matrix dense_A, dense_B, dense_result;
+  // Flattened ROOM inputs and outputs of the sparse multiplications.
+  std::vector<T> column_in, column_out;
+  // Inner indices of the sparse operand of the sparse multiplications, and
+  // the position of each index in `inner_indices`, or -1 if it is not there.
+  std::vector<size_t> inner_indices;
+  std::vector<ssize_t> inner_positions;
+};
+
+namespace dense_internal {
+
+// Masks the right-hand side `B` with `V` if this party holds (a share of) it.
+template <typename T, bool is_shared, typename Derived_B>
+void mask_rhs(const Derived_B &B, Matrix<T> V, int role, masked_rhs<T> *rhs) {
+  if (is_shared || role == 1) {
+    rhs->F = B - V;
+  } else {
+    rhs->F.setZero(B.rows(), B.cols());
+  }
+  rhs->V = std::move(V);
+  rhs->opened = false;
+}
+
+// Masks the chunk of `A` starting at row `offset` with `U` if this party holds
+// (a share of) it. Reuses the buffers already held by `chunk`.
+template <typename T, bool is_shared, typename Derived_A>
+void mask_chunk(const Derived_A &A, size_t offset, size_t chunk_size, int role,
+                Matrix<T> U, Matrix<T> Z, masked_rhs<T> *rhs,
+                masked_chunk<T> *chunk) {
+  chunk->offset = offset;
+  chunk->rows = std::min(chunk_size, A.rows() - offset);
+  if (is_shared || role == 0) {
+    chunk->E.resize(chunk_size, A.cols());
+    chunk->E.topRows(chunk->rows) = A.middleRows(offset, chunk->rows);
+    chunk->E.bottomRows(chunk_size - chunk->rows).setZero();
+    chunk->E -= U;
+  } else {
+    chunk->E.setZero(chunk_size, A.cols());
+  }
+  chunk->U = std::move(U);
+  chunk->Z = std::move(Z);
+  chunk->rhs = rhs;
+}
+
+// Opens the masked inputs of `num_chunks` chunks in a single exchange,
+// including each right-hand side that has not been opened before. Role 0 sends
+// its share of E and receives F, and role 1 does the opposite. For shared
+// triples, both parties send shares of both.
+template <typename T, bool is_shared>
+void open_masks(comm_channel &channel, int role, masked_chunk<T> *chunks,
+                size_t num_chunks, multiplication_workspace<T> *workspace) {
+  std::vector<masked_rhs<T> *> rhs;
+  for (size_t i = 0; i < num_chunks; i++) {
+    if (!chunks[i].rhs->opened &&
+        std::find(rhs.begin(), rhs.end(), chunks[i].rhs) == rhs.end()) {
+      rhs.push_back(chunks[i].rhs);
+    }
+  }
+  std::vector<Matrix<T>> &E = workspace->sent_E, &F = workspace->sent_F;
+  std::vector<Matrix<T>> &E_other = workspace->received.first;
+  std::vector<Matrix<T>> &F_other = workspace->received.second;
+  E.clear();
+  F.clear();
+  E_other.clear();
+  F_other.clear();
+  for (size_t i = 0; i < num_chunks; i++) {
+    E.push_back(std::move(chunks[i].E));
+  }
+  for (auto r : rhs) {
+    F.push_back(std::move(r->F));
+  }
+  if (is_shared) {
+    auto own = std::make_pair(std::move(E), std::move(F));
+    channel.send_recv(own, workspace->received);
+    E = std::move(own.first);
+    F = std::move(own.second);
+  } else if (role == 0) {
+    channel.send_recv(E, F_other);
+  } else {
+    channel.send_recv(F, E_other);
+  }
+  if ((is_shared || role == 1) && E_other.size() != E.size()) {
+    BOOST_THROW_EXCEPTION(
+        std::runtime_error("Received wrong number of masked chunks"));
+  }
+  if ((is_shared || role == 0) && F_other.size() != F.size()) {
+    BOOST_THROW_EXCEPTION(
+        std::runtime_error("Received wrong number of masked chunks"));
+  }
+  for (size_t i = 0; i < E.size(); i++) {
+    if (i < E_other.size()) {
+      E[i] += E_other[i];
+    }
+    chunks[i].E = std::move(E[i]);
+  }
+  for (size_t i = 0; i < F.size(); i++) {
+    if (i < F_other.size()) {
+      F[i] += F_other[i];
+    }
+    rhs[i]->F = std::move(F[i]);
+    if (role == 1) {
+      // E * F + E * V = E * (F + V) saves one product per chunk.
+      rhs[i]->V += rhs[i]->F;
+    }
+    rhs[i]->opened = true;
+  }
+}
+
+// Computes this party's share of the product of an opened chunk and writes it
+// to the corresponding rows of `result`.
+template <typename T, typename Result>
+void local_product(const masked_chunk<T> &chunk, Result *result) {
+  const Matrix<T> &V = chunk.rhs->V, &F = chunk.rhs->F;
+  size_t rows = chunk.rows;
+  auto result_rows = result->middleRows(chunk.offset, rows);
+  result_rows = chunk.Z.topRows(rows);
+  ring_gemm(chunk.E.topRows(rows), V, result_rows);
+  ring_gemm(chunk.U.topRows(rows), F, result_rows);
+}
+
+}  // namespace dense_internal
+
+// Multiplies A and B and writes this party's share of the (l x n) product to
+// `result`. A `workspace` reused across calls avoids reallocating buffers.
 template <
     typename Derived_A, typename Derived_B,
     typename T = typename Derived_A::Scalar, bool is_shared,
     typename std::enable_if<std::is_same<T, typename Derived_B::Scalar>::value,
                             int>::type = 0>
-Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
-matrix_multiplication_dense(
+void matrix_multiplication_dense(
     const Eigen::EigenBase<Derived_A> &A_in,
     const Eigen::EigenBase<Derived_B> &B_in, comm_channel &channel, int role,
     sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
         T, is_shared> &triples,
-    ssize_t chunk_size_in = -1) {
-  using matrix_result = Eigen::Matrix<T, Derived_A::RowsAtCompileTime,
-                                      Derived_B::ColsAtCompileTime>;
+    matrix_output<T> result, ssize_t chunk_size_in = -1,
+    const dense_multiplication_options &options =
+        dense_multiplication_options(),
+    multiplication_workspace<T> *workspace = nullptr) {
+  using dense_internal::masked_chunk;
+  using dense_internal::Matrix;
   const Derived_A &A = A_in.derived();
   const Derived_B &B = B_in.derived();
   // A : l x m, B: m x n, C: l x n
@@ -47,66 +273,129 @@ matrix_multiplication_dense(
     if (m != B.rows()) {
       BOOST_THROW_EXCEPTION(std::invalid_argument("Matrix sizes do not match"));
     }
-    if (std::tie(chunk_size, m, n) != triples.dimensions()) {
+    if (static_cast<size_t>(result.rows()) != l ||
+        static_cast<size_t>(result.cols()) != n) {
+      BOOST_THROW_EXCEPTION(
+          std::invalid_argument("Output size does not match matrix sizes"));
+    }
+    size_t num_chunks = l > 0 ? (l + chunk_size - 1) / chunk_size : 0;
+    bool triples_match;
+    if (options.exact_shape) {
+      if (options.shared_v) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+            "exact_shape cannot be combined with shared_v"));
+      }
+      // All chunks but the last have chunk_size rows.
+      size_t last_rows = l - (num_chunks - 1) * chunk_size;
+      triples_match = l == 0 || ((num_chunks == 1 ||
+                                  triples.SupportsShape(chunk_size, m, n)) &&
+                                 triples.SupportsShape(last_rows, m, n));
+    } else {
+      triples_match = std::tie(chunk_size, m, n) == triples.dimensions();
+    }
+    if (!triples_match) {
       BOOST_THROW_EXCEPTION(
           boost::enable_error_info(std::invalid_argument(
               "Triple dimensions do not match matrix dimensions"))
           << error_triple_dimensions(triples.dimensions()));
     }
+    multiplication_workspace<T> local_workspace;
+    if (workspace == nullptr) {
+      workspace = &local_workspace;
+    }
 
-    using matrix_triple =
-        sparse_linear_algebra::matrix_multiplication::offline::Matrix<T>;
-    std::vector<std::function<matrix_triple()>> compute_chunks;
-    for (size_t i = 0; i * chunk_size < l; i++) {
-      compute_chunks.push_back([&triples, &channel, &B, &A, chunk_size, l, m, n,
-                                role, i]() -> matrix_triple {
-        Eigen::Matrix<T, Eigen::Dynamic, Derived_A::ColsAtCompileTime> chunk_A(
-            chunk_size, m);
-        chunk_A.setZero();
-        if ((i + 1) * chunk_size > l) {
-          chunk_A += A.bottomRows(l - i * chunk_size);
-        } else {
-          chunk_A = A.middleRows(i * chunk_size, chunk_size);
-        }
-        // get a multiplication Triple;
-        matrix_triple U, V, Z;
+    // With a triple family, all chunks share V and thus the masked B - V.
+    std::vector<Matrix<T>> family_U, family_Z;
+    if (options.shared_v && num_chunks > 0) {
+      Matrix<T> V;
+      std::tie(family_U, V, family_Z) = triples.GetTripleFamily(num_chunks);
+      if (family_U.size() != num_chunks || family_Z.size() != num_chunks) {
+        BOOST_THROW_EXCEPTION(
+            std::runtime_error("Triple family has the wrong size"));
+      }
+      dense_internal::mask_rhs<T, is_shared>(B, std::move(V), role,
+                                             &workspace->family_rhs);
+    }
+    auto mask_chunk = [&](size_t i, masked_chunk<T> *chunk) {
+      if (options.shared_v) {
+        dense_internal::mask_chunk<T, is_shared>(
+            A, i * chunk_size, chunk_size, role, std::move(family_U[i]),
+            std::move(family_Z[i]), &workspace->family_rhs, chunk);
+        return;
+      }
+      Matrix<T> U, V, Z;
+      size_t rows = chunk_size;
+      if (options.exact_shape) {
+        rows = std::min(chunk_size, l - i * chunk_size);
+        std::tie(U, V, Z) = triples.GetTripleOfShape(rows, m, n);
+      } else {
         std::tie(U, V, Z) = triples.GetTriple();
+      }
+      dense_internal::mask_rhs<T, is_shared>(B, std::move(V), role,
+                                             &chunk->own_rhs);
+      dense_internal::mask_chunk<T, is_shared>(A, i * chunk_size, rows, role,
+                                               std::move(U), std::move(Z),
+                                               &chunk->own_rhs, chunk);
+    };
 
-        // role 0 sends A - U and receives B - V simultaneously
-        // then compute share of the result
-        matrix_triple E = (is_shared || role == 0) * (chunk_A - U),
-                      E2(chunk_size, m);
-        matrix_triple F = (is_shared || role == 1) * (B - V), F2(m, n);
-        if (role == 0) {
-          channel.send_recv(E, F2);
-          if (is_shared) {
-            channel.send_recv(F, E2);
-            E += E2;
-          }
-          F += F2;
-          return (E * V) + (U * F) + Z;
-        } else {
-          channel.send_recv(F, E2);
-          if (is_shared) {
-            channel.send_recv(E, F2);
-            F += F2;
-          }
-          E += E2;
-          return (E * F) + (E * V) + (U * F) + Z;
-        }
-      });
+    // Masks are exchanged on the calling thread, since the channel is not
+    // thread-safe. Local products are handed to the pool and write their rows
+    // of the result directly.
+    size_t num_workers = options.num_threads > 1 ? options.num_threads : 0;
+    if (!workspace->pool || workspace->pool->size() != num_workers) {
+      workspace->pool.reset(new thread_pool(num_workers));
     }
-    matrix_result result = matrix_result::Zero(l, n);
-    // TODO: threading
-    for (size_t i = 0; i * chunk_size < l; i++) {
-      if ((i + 1) * chunk_size > l) {
-        result.bottomRows(l - i * chunk_size) =
-            compute_chunks[i]().topRows(l - i * chunk_size);
+    thread_pool &pool = *workspace->pool;
+    std::vector<masked_chunk<T>> &chunks = workspace->chunks;
+    std::deque<std::future<void>> pending;
+    try {
+      if (options.single_round) {
+        chunks.resize(std::max(chunks.size(), num_chunks));
+        for (size_t i = 0; i < num_chunks; i++) {
+          mask_chunk(i, &chunks[i]);
+        }
+        dense_internal::open_masks<T, is_shared>(channel, role, chunks.data(),
+                                                 num_chunks, workspace);
+        for (size_t i = 0; i < num_chunks; i++) {
+          const masked_chunk<T> *chunk = &chunks[i];
+          pending.push_back(pool.schedule([chunk, &result] {
+            dense_internal::local_product(*chunk, &result);
+          }));
+        }
       } else {
-        result.middleRows(i * chunk_size, chunk_size) = compute_chunks[i]();
+        // Bounds the number of chunks whose masked inputs are held in memory.
+        // Chunk i uses slot i % num_slots, which is free again once the
+        // products of the max_pending preceding chunks have been waited for.
+        const size_t max_pending = 2 * std::max<size_t>(pool.size(), 1);
+        const size_t num_slots = std::min(max_pending + 1, num_chunks);
+        chunks.resize(std::max(chunks.size(), num_slots));
+        for (size_t i = 0; i < num_chunks; i++) {
+          masked_chunk<T> *chunk = &chunks[i % num_slots];
+          mask_chunk(i, chunk);
+          dense_internal::open_masks<T, is_shared>(channel, role, chunk, 1,
+                                                   workspace);
+          pending.push_back(pool.schedule([chunk, &result] {
+            dense_internal::local_product(*chunk, &result);
+          }));
+          while (pending.size() > max_pending) {
+            pending.front().get();
+            pending.pop_front();
+          }
+        }
+      }
+      for (auto &chunk : pending) {
+        chunk.get();
+      }
+    } catch (...) {
+      // Scheduled products write into `result` and read the workspace's
+      // chunks, which both outlive this call, so they must finish first.
+      for (auto &chunk : pending) {
+        if (chunk.valid()) {
+          chunk.wait();
+        }
       }
+      throw;
     }
-    return result;
   } catch (boost::exception &e) {
     e << error_a_size1(A.rows()) << error_a_size2(A.cols())
       << error_b_size1(B.rows()) << error_b_size2(B.cols());
@@ -114,3 +403,67 @@ matrix_multiplication_dense(
     throw;
   }
 }
+
+template <
+    typename Derived_A, typename Derived_B,
+    typename T = typename Derived_A::Scalar, bool is_shared,
+    typename std::enable_if<std::is_same<T, typename Derived_B::Scalar>::value,
+                            int>::type = 0>
+Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
+matrix_multiplication_dense(
+    const Eigen::EigenBase<Derived_A> &A_in,
+    const Eigen::EigenBase<Derived_B> &B_in, comm_channel &channel, int role,
+    sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
+        T, is_shared> &triples,
+    ssize_t chunk_size_in = -1,
+    const dense_multiplication_options &options =
+        dense_multiplication_options(),
+    multiplication_workspace<T> *workspace = nullptr) {
+  dense_internal::Matrix<T> result(A_in.rows(), B_in.cols());
+  matrix_multiplication_dense(A_in, B_in, channel, role, triples, result,
+                              chunk_size_in, options, workspace);
+  return result;
+}
+
+// Runs `f(session)` on a new thread, where `session` is a fresh clone of
+// `channel`, and returns a future for the result. Several multiplications
+// started this way run independently and overlap their network waits. Cloning
+// communicates over `channel`, so both parties must start their asynchronous
+// multiplications in the same order.
+template <typename F>
+std::future<typename std::result_of<F(comm_channel &)>::type> run_on_session(
+    comm_channel &channel, F f) {
+  auto session = std::make_shared<comm_channel>(channel.clone());
+  return std::async(std::launch::async, [session, f]() mutable {
+    auto result = f(*session);
+    session->flush();
+    return result;
+  });
+}
+
+// Asynchronous version of matrix_multiplication_dense on its own channel
+// session. The inputs are copied; `triples` must stay alive until the returned
+// future is ready, and must not be used by any other multiplication meanwhile.
+template <
+    typename Derived_A, typename Derived_B,
+    typename T = typename Derived_A::Scalar, bool is_shared,
+    typename std::enable_if<std::is_same<T, typename Derived_B::Scalar>::value,
+                            int>::type = 0>
+std::future<dense_internal::Matrix<T>> matrix_multiplication_dense_async(
+    const Eigen::EigenBase<Derived_A> &A_in,
+    const Eigen::EigenBase<Derived_B> &B_in, comm_channel &channel, int role,
+    sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
+        T, is_shared> &triples,
+    ssize_t chunk_size_in = -1,
+    const dense_multiplication_options &options =
+        dense_multiplication_options()) {
+  typename Derived_A::PlainObject A = A_in.derived();
+  typename Derived_B::PlainObject B = B_in.derived();
+  return run_on_session(channel, [A, B, role, &triples, chunk_size_in,
+                                  options](comm_channel &session) {
+    dense_internal::Matrix<T> result(A.rows(), B.cols());
+    matrix_multiplication_dense(A, B, session, role, triples, result,
+                                chunk_size_in, options);
+    return result;
+  });
+}
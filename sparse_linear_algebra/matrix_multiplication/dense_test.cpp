@@ -0,0 +1,286 @@
+#include "sparse_linear_algebra/matrix_multiplication/dense.hpp"
+#include <thread>
+#include "gtest/gtest.h"
+#include "mpc_utils/testing/comm_channel_test_helper.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/fake_triple_provider.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/slicing_triple_provider.hpp"
+#include "sparse_linear_algebra/util/randomize_matrix.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace {
+
+// Throws once `limit` triples have been handed out.
+template <typename T>
+class FailingTripleProvider : public offline::FakeTripleProvider<T> {
+ public:
+  FailingTripleProvider(int l, int m, int n, int role, int limit)
+      : offline::TripleProvider<T>(l, m, n, role),
+        offline::FakeTripleProvider<T>(l, m, n, role),
+        limit_(limit) {
+    this->Precompute(limit);
+  }
+
+  offline::Triple<T> GetTriple() override {
+    if (limit_-- <= 0) {
+      BOOST_THROW_EXCEPTION(std::runtime_error("Out of triples"));
+    }
+    return offline::FakeTripleProvider<T>::GetTriple();
+  }
+
+ private:
+  int limit_;
+};
+
+template <typename T>
+class DenseTest : public ::testing::Test {
+ protected:
+  DenseTest() : helper_(false), rng_(12345) {}
+
+  // Multiplies A and B, where party 0 holds A and party 1 holds B if
+  // `is_shared` is false. Otherwise, both parties hold additive shares of A and
+  // B.
+  template <bool is_shared>
+  offline::Matrix<T> Multiply(const offline::Matrix<T>& A,
+                              const offline::Matrix<T>& B, int chunk_size,
+                              const dense_multiplication_options& options) {
+    int l = A.rows(), m = A.cols(), n = B.cols();
+    int num_chunks = (l + chunk_size - 1) / chunk_size;
+    offline::Matrix<T> A_0 = A, B_0 = offline::Matrix<T>::Zero(m, n);
+    offline::Matrix<T> A_1 = offline::Matrix<T>::Zero(l, m), B_1 = B;
+    if (is_shared) {
+      randomize_matrix(rng_, A_1);
+      randomize_matrix(rng_, B_0);
+      A_0 -= A_1;
+      B_1 -= B_0;
+    }
+    offline::Matrix<T> result_0, result_1;
+    mpc_utils::comm_channel* channel_0 = helper_.GetChannel(0);
+    mpc_utils::comm_channel* channel_1 = helper_.GetChannel(1);
+    std::thread thread1([&] {
+      offline::FakeTripleProvider<T, is_shared> triples(chunk_size, m, n, 1);
+      Precompute(&triples, num_chunks, options);
+      result_1 = matrix_multiplication_dense(A_1, B_1, *channel_1, 1, triples,
+                                             chunk_size, options);
+      channel_1->flush();
+    });
+    offline::FakeTripleProvider<T, is_shared> triples(chunk_size, m, n, 0);
+    Precompute(&triples, num_chunks, options);
+    result_0 = matrix_multiplication_dense(A_0, B_0, *channel_0, 0, triples,
+                                           chunk_size, options);
+    thread1.join();
+    return result_0 + result_1;
+  }
+
+  template <bool is_shared>
+  static void Precompute(offline::FakeTripleProvider<T, is_shared>* triples,
+                         int num_chunks,
+                         const dense_multiplication_options& options) {
+    if (options.shared_v) {
+      triples->PrecomputeFamilies(1, num_chunks);
+    } else {
+      triples->Precompute(num_chunks);
+    }
+  }
+
+  offline::Matrix<T> Random(int rows, int cols) {
+    offline::Matrix<T> result(rows, cols);
+    randomize_matrix(rng_, result);
+    return result;
+  }
+
+  mpc_utils::testing::CommChannelTestHelper helper_;
+  std::mt19937 rng_;
+};
+
+using MyTypes = ::testing::Types<uint16_t, uint32_t, uint64_t>;
+TYPED_TEST_SUITE(DenseTest, MyTypes);
+
+TYPED_TEST(DenseTest, TestChunks) {
+  const int l = 10, m = 7, n = 3;
+  auto A = this->Random(l, m);
+  auto B = this->Random(m, n);
+  offline::Matrix<TypeParam> expected = A * B;
+  for (bool shared_v : {false, true}) {
+    for (bool single_round : {false, true}) {
+      for (int num_threads : {1, 4}) {
+        dense_multiplication_options options;
+        options.num_threads = num_threads;
+        options.single_round = single_round;
+        options.shared_v = shared_v;
+        // One chunk, evenly divided chunks, and a smaller last chunk.
+        for (int chunk_size : {10, 5, 3}) {
+          EXPECT_EQ(this->template Multiply<false>(A, B, chunk_size, options),
+                    expected);
+          EXPECT_EQ(this->template Multiply<true>(A, B, chunk_size, options),
+                    expected);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(DenseTest, OutputAndWorkspace) {
+  using Matrix = offline::Matrix<TypeParam>;
+  const int l = 10, m = 7, n = 3, chunk_size = 3, num_runs = 3;
+  for (bool single_round : {false, true}) {
+    dense_multiplication_options options;
+    options.num_threads = 2;
+    options.single_round = single_round;
+    std::vector<Matrix> A, B;
+    for (int i = 0; i < num_runs; i++) {
+      A.push_back(this->Random(l, m));
+      B.push_back(this->Random(m, n));
+    }
+    // Each party writes its shares into rows [2, 2 + l) of a larger matrix
+    // and reuses one workspace across all runs.
+    Matrix result_0 = Matrix::Zero(l + 4, n * num_runs);
+    Matrix result_1 = result_0;
+    auto run = [&](int role, mpc_utils::comm_channel* channel, Matrix* result) {
+      offline::FakeTripleProvider<TypeParam> triples(chunk_size, m, n, role);
+      triples.Precompute(num_runs * ((l + chunk_size - 1) / chunk_size));
+      multiplication_workspace<TypeParam> workspace;
+      Matrix zero_A = Matrix::Zero(l, m);
+      Matrix zero_B = Matrix::Zero(m, n);
+      for (int i = 0; i < num_runs; i++) {
+        matrix_multiplication_dense(
+            role == 0 ? A[i] : zero_A, role == 1 ? B[i] : zero_B, *channel,
+            role, triples, result->block(2, i * n, l, n), chunk_size, options,
+            &workspace);
+      }
+      channel->flush();
+    };
+    std::thread thread1(
+        [&] { run(1, this->helper_.GetChannel(1), &result_1); });
+    run(0, this->helper_.GetChannel(0), &result_0);
+    thread1.join();
+    Matrix sum = result_0 + result_1;
+    for (int i = 0; i < num_runs; i++) {
+      EXPECT_EQ(sum.block(2, i * n, l, n), A[i] * B[i]);
+    }
+    EXPECT_TRUE(sum.topRows(2).isZero());
+    EXPECT_TRUE(sum.bottomRows(2).isZero());
+  }
+}
+
+TYPED_TEST(DenseTest, WorkspaceReusableAfterFailure) {
+  using Matrix = offline::Matrix<TypeParam>;
+  const int l = 30, m = 7, n = 3, chunk_size = 3;
+  auto A = this->Random(l, m);
+  auto B = this->Random(m, n);
+  for (bool single_round : {false, true}) {
+    dense_multiplication_options options;
+    options.num_threads = 4;
+    options.single_round = single_round;
+    // Both parties run out of triples at the same chunk, while the products
+    // of earlier chunks may still be running. The workspace must be usable
+    // again afterwards.
+    auto run = [&](int role, Matrix* result) {
+      mpc_utils::comm_channel* channel = this->helper_.GetChannel(role);
+      Matrix A_in = role == 0 ? A : Matrix::Zero(l, m);
+      Matrix B_in = role == 1 ? B : Matrix::Zero(m, n);
+      multiplication_workspace<TypeParam> workspace;
+      FailingTripleProvider<TypeParam> failing(chunk_size, m, n, role, 6);
+      *result = Matrix::Zero(l, n);
+      EXPECT_THROW(
+          matrix_multiplication_dense(A_in, B_in, *channel, role, failing,
+                                      *result, chunk_size, options,
+                                      &workspace),
+          std::runtime_error);
+      offline::FakeTripleProvider<TypeParam> triples(chunk_size, m, n, role);
+      triples.Precompute(l / chunk_size);
+      matrix_multiplication_dense(A_in, B_in, *channel, role, triples,
+                                  *result, chunk_size, options, &workspace);
+      channel->flush();
+    };
+    Matrix result_0, result_1;
+    std::thread thread1([&] { run(1, &result_1); });
+    run(0, &result_0);
+    thread1.join();
+    EXPECT_EQ(result_0 + result_1, A * B);
+  }
+}
+
+TYPED_TEST(DenseTest, ExactShape) {
+  using Matrix = offline::Matrix<TypeParam>;
+  const int l = 10, m = 7, n = 3, chunk_size = 4;
+  auto A = this->Random(l, m);
+  auto B = this->Random(m, n);
+  for (bool single_round : {false, true}) {
+    dense_multiplication_options options;
+    options.single_round = single_round;
+    options.exact_shape = true;
+    // Triples are sliced from larger ones in all three dimensions, including
+    // a last chunk of only two rows.
+    auto run = [&](int role, Matrix* result) {
+      mpc_utils::comm_channel* channel = this->helper_.GetChannel(role);
+      offline::FakeTripleProvider<TypeParam> source(chunk_size + 1, m + 2,
+                                                    n + 1, role);
+      source.Precompute((l + chunk_size - 1) / chunk_size);
+      offline::SlicingTripleProvider<TypeParam> triples(&source, channel);
+      *result = matrix_multiplication_dense(
+          role == 0 ? A : Matrix::Zero(l, m),
+          role == 1 ? B : Matrix::Zero(m, n), *channel, role, triples,
+          chunk_size, options);
+      channel->flush();
+    };
+    Matrix result_0, result_1;
+    std::thread thread1([&] { run(1, &result_1); });
+    run(0, &result_0);
+    thread1.join();
+    EXPECT_EQ(result_0 + result_1, A * B);
+  }
+}
+
+TYPED_TEST(DenseTest, ExactShapeUnsupported) {
+  using Matrix = offline::Matrix<TypeParam>;
+  dense_multiplication_options options;
+  options.exact_shape = true;
+  // A plain provider only supports its own shape, which doesn't fit the last
+  // chunk.
+  offline::FakeTripleProvider<TypeParam> triples(4, 7, 3, 0);
+  EXPECT_THROW(matrix_multiplication_dense(
+                   Matrix(Matrix::Zero(10, 7)), Matrix(Matrix::Zero(7, 3)),
+                   *this->helper_.GetChannel(0), 0, triples, 4, options),
+               std::invalid_argument);
+}
+
+TYPED_TEST(DenseTest, Async) {
+  using Matrix = offline::Matrix<TypeParam>;
+  const int l = 10, m = 7, n = 3, chunk_size = 5, num_multiplications = 3;
+  std::vector<Matrix> A, B;
+  for (int i = 0; i < num_multiplications; i++) {
+    A.push_back(this->Random(l, m));
+    B.push_back(this->Random(m, n));
+  }
+  // All multiplications are in flight before the first result is needed.
+  auto run = [&](int role, std::vector<Matrix>* results) {
+    mpc_utils::comm_channel* channel = this->helper_.GetChannel(role);
+    std::vector<std::unique_ptr<offline::FakeTripleProvider<TypeParam>>>
+        triples;
+    std::vector<std::future<Matrix>> futures;
+    for (int i = 0; i < num_multiplications; i++) {
+      triples.emplace_back(new offline::FakeTripleProvider<TypeParam>(
+          chunk_size, m, n, role));
+      triples.back()->Precompute(l / chunk_size);
+      futures.push_back(matrix_multiplication_dense_async(
+          role == 0 ? A[i] : Matrix::Zero(l, m),
+          role == 1 ? B[i] : Matrix::Zero(m, n), *channel, role,
+          *triples.back(), chunk_size));
+    }
+    for (auto& future : futures) {
+      results->push_back(future.get());
+    }
+  };
+  std::vector<Matrix> results_0, results_1;
+  std::thread thread1([&] { run(1, &results_1); });
+  run(0, &results_0);
+  thread1.join();
+  for (int i = 0; i < num_multiplications; i++) {
+    EXPECT_EQ(results_0[i] + results_1[i], A[i] * B[i]);
+  }
+}
+
+}  // namespace
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
@@ -0,0 +1,71 @@
+// A DealerTripleProvider obtains multiplication triples from a TripleDealer
+// running on a third machine. Both parties must request the same numbers of
+// triples and families in the same order. See triple_dealer.hpp for how the
+// triples are distributed.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "mpc_utils/comm_channel.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/triple_dealer.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/triple_provider.hpp"
+#include "sparse_linear_algebra/util/ring_queue.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+
+template <typename T, bool is_shared = false>
+class DealerTripleProvider : public virtual TripleProvider<T, is_shared> {
+ public:
+  // Constructs a triple provider for multiplying an (l x m) with an (m x n)
+  // matrix that requests triples from the dealer at the other end of
+  // `dealer`. The `cap` argument allows to use a bounded queue for storing
+  // triples.
+  DealerTripleProvider(int l, int m, int n, int role, comm_channel *dealer,
+                       int cap = -1);
+
+  // Ends the session with the dealer.
+  ~DealerTripleProvider() override;
+
+  // Requests a number of triples from the dealer. Blocks if capacity is
+  // bounded and queue is full. Throws if the dealer rejects the request, e.g.,
+  // because the other party requested something else.
+  void Precompute(int num);
+
+  // Requests a number of triple families, each consisting of `size` triples
+  // that share the same V. Blocks if capacity is bounded and queue is full.
+  void PrecomputeFamilies(int num, int size);
+
+  // Returns a precomputed triple. Can be called concurrently with precompute();
+  // however, only one thread may call get() at the same time.
+  Triple<T> GetTriple() override;
+
+  // Returns a triple family precomputed by PrecomputeFamilies(). `size` must
+  // match the size passed there.
+  TripleFamily<T> GetTripleFamily(int size) override;
+
+ private:
+  // Sends a request for `num` triples or families to the dealer and returns
+  // the key for expanding them.
+  std::vector<uint8_t> Request(int num, int family_size);
+
+  // Precomputed triples to be returned by GetTriple().
+  ring_queue<Triple<T>> triples_;
+
+  // Precomputed triple families to be returned by GetTripleFamily().
+  ring_queue<TripleFamily<T>> families_;
+
+  // Channel to the dealer passed at construction.
+  comm_channel *dealer_;
+
+  // Whether the dealer is still serving requests, i.e., has not rejected one.
+  bool session_open_;
+};
+
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
+
+#include "dealer_triple_provider.tpp"
@@ -0,0 +1,132 @@
+#include <stdexcept>
+#include "boost/serialization/vector.hpp"
+#include "boost/throw_exception.hpp"
+#include "mpc_utils/boost_serialization/eigen.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+
+template <typename T, bool is_shared>
+DealerTripleProvider<T, is_shared>::DealerTripleProvider(int l, int m, int n,
+                                                         int role,
+                                                         comm_channel *dealer,
+                                                         int cap)
+    : TripleProvider<T, is_shared>(l, m, n, role),
+      triples_(cap),
+      families_(cap),
+      dealer_(dealer),
+      session_open_(true) {}
+
+template <typename T, bool is_shared>
+DealerTripleProvider<T, is_shared>::~DealerTripleProvider() {
+  if (!session_open_) {
+    return;
+  }
+  try {
+    Request(0, 0);
+  } catch (...) {
+    // The dealer is gone already; there is nothing left to end.
+  }
+}
+
+template <typename T, bool is_shared>
+std::vector<uint8_t> DealerTripleProvider<T, is_shared>::Request(
+    int num, int family_size) {
+  DealerRequest request;
+  std::tie(request.l, request.m, request.n) = this->dimensions();
+  request.element_size = sizeof(T);
+  request.is_shared = is_shared;
+  request.num = num;
+  request.family_size = family_size;
+  dealer_->send(request);
+  dealer_->flush();
+  bool accepted;
+  dealer_->recv(accepted);
+  if (!accepted) {
+    session_open_ = false;
+    BOOST_THROW_EXCEPTION(std::runtime_error(
+        "The dealer rejected the request for triples; both parties must "
+        "request the same triples"));
+  }
+  std::vector<uint8_t> key;
+  if (num > 0) {
+    dealer_->recv(key);
+    if (key.size() != dealer_internal::kKeySize) {
+      BOOST_THROW_EXCEPTION(
+          std::runtime_error("Received a key of the wrong size"));
+    }
+  }
+  return key;
+}
+
+template <typename T, bool is_shared>
+void DealerTripleProvider<T, is_shared>::Precompute(int num) {
+  if (num < 1) {
+    return;
+  }
+  int l, m, n;
+  std::tie(l, m, n) = this->dimensions();
+  int role = this->role();
+  std::vector<uint8_t> key = Request(num, 0);
+  for (int i = 0; i < num; i++) {
+    Triple<T> triple = dealer_internal::ExpandShares<T, is_shared>(
+        key.data(), i, role, l, m, n);
+    if (role == 1) {
+      dealer_->recv(std::get<2>(triple));
+    }
+    triples_.push(std::move(triple));
+  }
+}
+
+template <typename T, bool is_shared>
+void DealerTripleProvider<T, is_shared>::PrecomputeFamilies(int num,
+                                                            int size) {
+  using dealer_internal::ExpandFamilyMember;
+  if (size < 1) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("Family size must be positive"));
+  }
+  if (num < 1) {
+    return;
+  }
+  int l, m, n;
+  std::tie(l, m, n) = this->dimensions();
+  int role = this->role();
+  std::vector<uint8_t> key = Request(num, size);
+  for (int k = 0; k < num; k++) {
+    uint64_t nonce = static_cast<uint64_t>(k) * (size + 1);
+    Matrix<T> V = dealer_internal::ExpandFamilyV<T, is_shared>(
+        key.data(), nonce, role, m, n);
+    std::vector<Matrix<T>> Us(size), Zs(size);
+    for (int j = 0; j < size; j++) {
+      std::tie(Us[j], Zs[j]) = ExpandFamilyMember<T, is_shared>(
+          key.data(), nonce + 1 + j, role, l, m, n);
+      if (role == 1) {
+        dealer_->recv(Zs[j]);
+      }
+    }
+    families_.push(
+        std::make_tuple(std::move(Us), std::move(V), std::move(Zs)));
+  }
+}
+
+template <typename T, bool is_shared>
+Triple<T> DealerTripleProvider<T, is_shared>::GetTriple() {
+  return triples_.pop();
+}
+
+template <typename T, bool is_shared>
+TripleFamily<T> DealerTripleProvider<T, is_shared>::GetTripleFamily(
+    int size) {
+  TripleFamily<T> family = families_.pop();
+  if (static_cast<int>(std::get<0>(family).size()) != size) {
+    BOOST_THROW_EXCEPTION(std::invalid_argument(
+        "Requested family size does not match precomputed size"));
+  }
+  return family;
+}
+
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
@@ -0,0 +1,127 @@
+#include "sparse_linear_algebra/matrix_multiplication/offline/dealer_triple_provider.hpp"
+#include <functional>
+#include <thread>
+#include "gtest/gtest.h"
+#include "mpc_utils/status_matchers.h"
+#include "mpc_utils/testing/comm_channel_test_helper.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/triple_dealer.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+namespace {
+
+class DealerTripleProviderTest : public ::testing::Test {
+ protected:
+  static constexpr int kL = 3, kM = 4, kN = 2;
+
+  DealerTripleProviderTest() : helper0_(false), helper1_(false) {}
+
+  // Runs a dealer and the two parties in separate threads. `party(role, p)`
+  // is called with each party's provider. Returns the dealer's status.
+  template <typename T, bool is_shared>
+  mpc_utils::Status RunSession(
+      std::function<void(int, DealerTripleProvider<T, is_shared> *)> party) {
+    mpc_utils::Status status;
+    std::thread dealer([&] {
+      TripleDealer<T, is_shared> dealer(kL, kM, kN, helper0_.GetChannel(1),
+                                        helper1_.GetChannel(1));
+      status = dealer.Run();
+    });
+    std::thread party1([&] {
+      DealerTripleProvider<T, is_shared> triples(kL, kM, kN, 1,
+                                                 helper1_.GetChannel(0));
+      party(1, &triples);
+    });
+    {
+      DealerTripleProvider<T, is_shared> triples(kL, kM, kN, 0,
+                                                 helper0_.GetChannel(0));
+      party(0, &triples);
+    }
+    party1.join();
+    dealer.join();
+    return status;
+  }
+
+  mpc_utils::testing::CommChannelTestHelper helper0_;
+  mpc_utils::testing::CommChannelTestHelper helper1_;
+};
+
+TEST_F(DealerTripleProviderTest, DistributedTriples) {
+  const int num = 3;
+  std::vector<Triple<uint64_t>> triples[2];
+  EXPECT_OK((RunSession<uint64_t, false>(
+      [&](int role, DealerTripleProvider<uint64_t, false> *provider) {
+        provider->Precompute(num - 1);
+        provider->Precompute(1);
+        for (int i = 0; i < num; i++) {
+          triples[role].push_back(provider->GetTriple());
+        }
+      })));
+  for (int i = 0; i < num; i++) {
+    Matrix<uint64_t> u, v, w0, w1;
+    std::tie(u, std::ignore, w0) = triples[0][i];
+    std::tie(std::ignore, v, w1) = triples[1][i];
+    EXPECT_EQ(u.rows(), kL);
+    EXPECT_EQ(u.cols(), kM);
+    EXPECT_EQ(v.rows(), kM);
+    EXPECT_EQ(v.cols(), kN);
+    EXPECT_EQ(u * v, w0 + w1);
+    // Party 1 holds no share of U, and party 0 none of V.
+    EXPECT_TRUE(std::get<0>(triples[1][i]).isZero());
+    EXPECT_TRUE(std::get<1>(triples[0][i]).isZero());
+  }
+  // Triples of different batches use different keys.
+  EXPECT_NE(std::get<0>(triples[0][0]), std::get<0>(triples[0][num - 1]));
+}
+
+TEST_F(DealerTripleProviderTest, SharedTriples) {
+  const int num = 2;
+  std::vector<Triple<uint32_t>> triples[2];
+  EXPECT_OK((RunSession<uint32_t, true>(
+      [&](int role, DealerTripleProvider<uint32_t, true> *provider) {
+        provider->Precompute(num);
+        for (int i = 0; i < num; i++) {
+          triples[role].push_back(provider->GetTriple());
+        }
+      })));
+  for (int i = 0; i < num; i++) {
+    Matrix<uint32_t> u0, u1, v0, v1, w0, w1;
+    std::tie(u0, v0, w0) = triples[0][i];
+    std::tie(u1, v1, w1) = triples[1][i];
+    EXPECT_EQ((u0 + u1) * (v0 + v1), w0 + w1);
+  }
+}
+
+TEST_F(DealerTripleProviderTest, SharedTripleFamilies) {
+  const int size = 3;
+  TripleFamily<uint64_t> families[2];
+  EXPECT_OK((RunSession<uint64_t, true>(
+      [&](int role, DealerTripleProvider<uint64_t, true> *provider) {
+        provider->PrecomputeFamilies(2, size);
+        provider->GetTripleFamily(size);
+        families[role] = provider->GetTripleFamily(size);
+      })));
+  std::vector<Matrix<uint64_t>> u0, u1, w0, w1;
+  Matrix<uint64_t> v0, v1;
+  std::tie(u0, v0, w0) = families[0];
+  std::tie(u1, v1, w1) = families[1];
+  ASSERT_EQ(u0.size(), size);
+  ASSERT_EQ(w1.size(), size);
+  for (int j = 0; j < size; j++) {
+    EXPECT_EQ((u0[j] + u1[j]) * (v0 + v1), w0[j] + w1[j]);
+  }
+}
+
+TEST_F(DealerTripleProviderTest, MismatchingRequests) {
+  mpc_utils::Status status = RunSession<uint64_t, false>(
+      [&](int role, DealerTripleProvider<uint64_t, false> *provider) {
+        EXPECT_THROW(provider->Precompute(role + 1), std::runtime_error);
+      });
+  EXPECT_FALSE(status.ok());
+}
+
+}  // namespace
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
@@ -7,7 +7,7 @@
 
 #include <random>
 #include "sparse_linear_algebra/matrix_multiplication/offline/triple_provider.hpp"
-#include "sparse_linear_algebra/util/blocking_queue.hpp"
+#include "sparse_linear_algebra/util/ring_queue.hpp"
 
 namespace sparse_linear_algebra {
 namespace matrix_multiplication {
@@ -25,13 +25,24 @@ class FakeTripleProvider : public virtual TripleProvider<T, is_shared> {
   // full.
   void Precompute(int num);
 
+  // Precomputes a number of triple families, each consisting of `size` triples
+  // that share the same V. Blocks if capacity is bounded and queue is full.
+  void PrecomputeFamilies(int num, int size);
+
   // Returns a precomputed triple. Can be called concurrently with precompute();
   // however, only one thread may call get() at the same time.
   Triple<T> GetTriple() override;
 
+  // Returns a triple family precomputed by PrecomputeFamilies(). `size` must
+  // match the size passed there.
+  TripleFamily<T> GetTripleFamily(int size) override;
+
  private:
   // Precomputed triples to be returned by GetTriple().
-  blocking_queue<Triple<T>> triples_;
+  ring_queue<Triple<T>> triples_;
+
+  // Precomputed triple families to be returned by GetTripleFamily().
+  ring_queue<TripleFamily<T>> families_;
 
   // Random number generator used for creating triples.
   std::mt19937 rng_;
@@ -1,4 +1,7 @@
+#include <vector>
+#include "boost/throw_exception.hpp"
 #include "sparse_linear_algebra/util/randomize_matrix.hpp"
+#include "sparse_linear_algebra/util/ring_gemm.hpp"
 
 namespace sparse_linear_algebra {
 namespace matrix_multiplication {
@@ -9,6 +12,7 @@ FakeTripleProvider<T, is_shared>::FakeTripleProvider(int l, int m, int n,
                                                      int role, int cap)
     : TripleProvider<T, is_shared>(l, m, n, role),
       triples_(cap),
+      families_(cap),
       rng_(12345){};  // We seed the random number generator
                       // deterministically, which doesn't matter since we're
                       // generating insecure triples anyway.
@@ -33,9 +37,55 @@ void FakeTripleProvider<T, is_shared>::Precompute(int num) {
     }
 
     if (role == 0) {
-      triples_.push(std::make_tuple(U - U_mask, V_mask, Z_mask));
+      triples_.push(
+          std::make_tuple(U - U_mask, std::move(V_mask), std::move(Z_mask)));
     } else {
-      triples_.push(std::make_tuple(U_mask, V - V_mask, U * V - Z_mask));
+      triples_.push(std::make_tuple(std::move(U_mask), V - V_mask,
+                                    ring_product(U, V) - Z_mask));
+    }
+  }
+}
+
+template <typename T, bool is_shared>
+void FakeTripleProvider<T, is_shared>::PrecomputeFamilies(int num, int size) {
+  if (size < 1) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("Family size must be positive"));
+  }
+  for (int i = 0; i < num; i++) {
+    int l, m, n;
+    std::tie(l, m, n) = this->dimensions();
+    int role = this->role();
+
+    Matrix<T> V(m, n), V_mask = Matrix<T>::Zero(m, n);
+    randomize_matrix(rng_, V);
+    if (is_shared) {
+      randomize_matrix(rng_, V_mask);
+    }
+    std::vector<Matrix<T>> Us(size), Zs(size);
+    for (int j = 0; j < size; j++) {
+      Matrix<T> U(l, m), U_mask = Matrix<T>::Zero(l, m);
+      Matrix<T> Z_mask(l, n);
+      randomize_matrix(rng_, U);
+      randomize_matrix(rng_, Z_mask);
+      if (is_shared) {
+        randomize_matrix(rng_, U_mask);
+      }
+      if (role == 0) {
+        Us[j] = U - U_mask;
+        Zs[j] = std::move(Z_mask);
+      } else {
+        Us[j] = std::move(U_mask);
+        Zs[j] = ring_product(U, V) - Z_mask;
+      }
+    }
+
+    if (role == 0) {
+      families_.push(
+          std::make_tuple(std::move(Us), std::move(V_mask), std::move(Zs)));
+    } else {
+      families_.push(
+          std::make_tuple(std::move(Us), V - V_mask, std::move(Zs)));
     }
   }
 }
@@ -45,6 +95,16 @@ Triple<T> FakeTripleProvider<T, is_shared>::GetTriple() {
   return triples_.pop();
 }
 
+template <typename T, bool is_shared>
+TripleFamily<T> FakeTripleProvider<T, is_shared>::GetTripleFamily(int size) {
+  TripleFamily<T> family = families_.pop();
+  if (static_cast<int>(std::get<0>(family).size()) != size) {
+    BOOST_THROW_EXCEPTION(std::invalid_argument(
+        "Requested family size does not match precomputed size"));
+  }
+  return family;
+}
+
 }  // namespace offline
 }  // namespace matrix_multiplication
 }  // namespace sparse_linear_algebra
\ No newline at end of file
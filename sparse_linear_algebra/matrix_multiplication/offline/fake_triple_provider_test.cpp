@@ -50,6 +50,37 @@ TEST(FakeTripleProvider, SharedTriple) {
   EXPECT_EQ((u1 + u2) * (v1 + v2), w1 + w2);
 }
 
+TEST(FakeTripleProvider, SharedTripleFamily) {
+  int l = 2, m = 3, n = 4, size = 3;
+  FakeTripleProvider<uint64_t, true> triples1(l, m, n, 0);
+  FakeTripleProvider<uint64_t, true> triples2(l, m, n, 1);
+  triples1.PrecomputeFamilies(1, size);
+  triples2.PrecomputeFamilies(1, size);
+  std::vector<Matrix<uint64_t>> u1, u2, w1, w2;
+  Matrix<uint64_t> v1, v2;
+  std::tie(u1, v1, w1) = triples1.GetTripleFamily(size);
+  std::tie(u2, v2, w2) = triples2.GetTripleFamily(size);
+  ASSERT_EQ(u1.size(), size);
+  ASSERT_EQ(u2.size(), size);
+  ASSERT_EQ(w1.size(), size);
+  ASSERT_EQ(w2.size(), size);
+  EXPECT_EQ(v1.rows(), m);
+  EXPECT_EQ(v1.cols(), n);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(u1[i].rows(), l);
+    EXPECT_EQ(u1[i].cols(), m);
+    EXPECT_EQ(w1[i].rows(), l);
+    EXPECT_EQ(w1[i].cols(), n);
+    EXPECT_EQ((u1[i] + u2[i]) * (v1 + v2), w1[i] + w2[i]);
+  }
+}
+
+TEST(FakeTripleProvider, TripleFamilySizeMismatch) {
+  FakeTripleProvider<uint64_t, false> triples(2, 3, 4, 0);
+  triples.PrecomputeFamilies(1, 3);
+  EXPECT_THROW(triples.GetTripleFamily(2), std::invalid_argument);
+}
+
 }  // namespace
 }  // namespace offline
 }  // namespace matrix_multiplication
@@ -0,0 +1,153 @@
+// Kernels for building the correlated OT inputs of a Gilboa multiplication
+// and for folding the OT outputs into shares. A packed multiplication of two
+// values a1, a2 with b uses bit_width COTs, whose 128-bit messages hold one
+// 64-bit lane per value. Rings of at most 32 bits use four 32-bit lanes
+// instead, see Correction32(). All kernels work on contiguous arrays and only
+// need SSE2.
+
+#pragma once
+
+#include <emmintrin.h>
+#include <cstdint>
+#include <utility>
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+namespace gilboa_internal {
+
+static_assert(sizeof(std::pair<uint64_t, uint64_t>) == sizeof(__m128i),
+              "COT deltas must be layout-compatible with 128-bit blocks");
+
+// Writes the correlations (a1 << k, a2 << k) for all k < bit_width to
+// `deltas`. The shifts are computed by doubling both lanes at once.
+inline void BuildDeltas(uint64_t a1, uint64_t a2, int bit_width,
+                        std::pair<uint64_t, uint64_t> *deltas) {
+  __m128i delta = _mm_set_epi64x(a2, a1);
+  __m128i *out = reinterpret_cast<__m128i *>(deltas);
+  for (int k = 0; k < bit_width; k++) {
+    _mm_storeu_si128(out + k, delta);
+    delta = _mm_add_epi64(delta, delta);
+  }
+}
+
+// Writes the bits of b, least significant first, to `choices`.
+inline void BuildChoices(uint64_t b, int bit_width, bool *choices) {
+  for (int k = 0; k < bit_width; k++) {
+    choices[k] = (b >> k) & 1;
+  }
+}
+
+// Returns the lane-wise sum of `count` blocks, modulo 2^64.
+inline __m128i SumBlocks(const __m128i *blocks, int64_t count) {
+  // Independent accumulators hide the latency of the adds.
+  __m128i sum0 = _mm_setzero_si128(), sum1 = _mm_setzero_si128();
+  __m128i sum2 = _mm_setzero_si128(), sum3 = _mm_setzero_si128();
+  int64_t k = 0;
+  for (; k + 4 <= count; k += 4) {
+    sum0 = _mm_add_epi64(sum0, _mm_loadu_si128(blocks + k));
+    sum1 = _mm_add_epi64(sum1, _mm_loadu_si128(blocks + k + 1));
+    sum2 = _mm_add_epi64(sum2, _mm_loadu_si128(blocks + k + 2));
+    sum3 = _mm_add_epi64(sum3, _mm_loadu_si128(blocks + k + 3));
+  }
+  for (; k < count; k++) {
+    sum0 = _mm_add_epi64(sum0, _mm_loadu_si128(blocks + k));
+  }
+  return _mm_add_epi64(_mm_add_epi64(sum0, sum1), _mm_add_epi64(sum2, sum3));
+}
+
+inline uint64_t LowLane(__m128i block) {
+  return static_cast<uint64_t>(_mm_cvtsi128_si64(block));
+}
+
+inline uint64_t HighLane(__m128i block) {
+  return static_cast<uint64_t>(
+      _mm_cvtsi128_si64(_mm_unpackhi_epi64(block, block)));
+}
+
+// EMP adds COT deltas with 64-bit carries, which would let the carry of one
+// 32-bit lane corrupt the next. Four-lane multiplications thus use COTs with
+// random deltas, i.e., random messages x0 and x1 = x0 + delta, and the sender
+// sends its own correction C = x0 - x1 + a per 32-bit lane. The receiver with
+// choice b then holds x_b + b * C = x0 + b * a in each lane.
+
+// Returns the lane-wise correction x0 - x1 + a for the messages x0 and
+// x1 = x0 + delta of a random COT.
+inline __m128i Correction32(__m128i x0,
+                            const std::pair<uint64_t, uint64_t> &delta,
+                            __m128i a) {
+  __m128i x1 = _mm_add_epi64(
+      x0, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&delta)));
+  return _mm_add_epi32(_mm_sub_epi32(x0, x1), a);
+}
+
+// Returns the receiver's lanes x_b + b * C for the message x_b of choice b.
+inline __m128i Corrected32(__m128i message, bool b, __m128i correction) {
+  __m128i mask = _mm_set1_epi32(-static_cast<int>(b));
+  return _mm_add_epi32(message, _mm_and_si128(correction, mask));
+}
+
+// Returns the lane-wise sum of `sum` and `block` << k, modulo 2^32.
+inline __m128i AddShifted32(__m128i sum, __m128i block, int k) {
+  return _mm_add_epi32(sum, _mm_sll_epi32(block, _mm_cvtsi32_si128(k)));
+}
+
+// Returns the number of correction bits of a four-lane multiplication, where
+// the correction of bit k is truncated to bit_width - k bits per lane.
+inline int64_t CorrectionBits32(int bit_width) {
+  return 2 * int64_t{bit_width} * (bit_width + 1);
+}
+
+// Returns the offset of the correction of bit k within those of a four-lane
+// multiplication.
+inline int64_t CorrectionOffset32(int bit_width, int k) {
+  return 4 * (int64_t{k} * bit_width - int64_t{k} * (k - 1) / 2);
+}
+
+// Returns the number of 64-bit words needed by PackBits() for `count` values
+// of `width` bits starting at bit 0.
+inline int64_t PackedWords(int64_t count, int width) {
+  return (count * width + 63) / 64;
+}
+
+// Writes the low `width` bits of each of the `count` values to `out`,
+// starting at bit `first_bit`. The bits written to must be zero before. Used
+// for truncated Gilboa corrections, where bit k of the multiplier only affects
+// the high bit_width - k bits of the product.
+template <typename T>
+void PackBits(const T *values, int64_t count, int width, uint64_t *out,
+              int64_t first_bit = 0) {
+  const uint64_t mask =
+      width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+  for (int64_t i = 0; i < count; i++) {
+    uint64_t value = static_cast<uint64_t>(values[i]) & mask;
+    int64_t bit = first_bit + i * width;
+    int shift = bit % 64;
+    out[bit / 64] |= value << shift;
+    if (shift + width > 64) {
+      out[bit / 64 + 1] |= value >> (64 - shift);
+    }
+  }
+}
+
+// Inverse of PackBits(). The bits of `values` above `width` are zero.
+template <typename T>
+void UnpackBits(const uint64_t *in, int64_t count, int width, T *values,
+                int64_t first_bit = 0) {
+  const uint64_t mask =
+      width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+  for (int64_t i = 0; i < count; i++) {
+    int64_t bit = first_bit + i * width;
+    int shift = bit % 64;
+    uint64_t value = in[bit / 64] >> shift;
+    if (shift + width > 64) {
+      value |= in[bit / 64 + 1] << (64 - shift);
+    }
+    values[i] = static_cast<T>(value & mask);
+  }
+}
+
+}  // namespace gilboa_internal
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
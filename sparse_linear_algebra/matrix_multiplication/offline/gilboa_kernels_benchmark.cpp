@@ -0,0 +1,84 @@
+// Compares the Gilboa kernels used by OTTripleProvider against the scalar
+// loops they replaced, on the local work of a single GilboaProduct tile.
+
+#include <random>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "sparse_linear_algebra/matrix_multiplication/offline/gilboa_kernels.hpp"
+
+namespace {
+
+using namespace sparse_linear_algebra::matrix_multiplication::offline;
+
+constexpr int kBitWidth = 64;
+
+std::vector<uint64_t> RandomValues(int64_t size) {
+  std::mt19937_64 rng(12345);
+  std::vector<uint64_t> values(size);
+  for (auto &value : values) {
+    value = rng();
+  }
+  return values;
+}
+
+template <bool use_kernel>
+void BM_BuildDeltas(benchmark::State &state) {
+  const int64_t units = state.range(0);
+  std::vector<uint64_t> a = RandomValues(2 * units);
+  std::vector<std::pair<uint64_t, uint64_t>> deltas(units * kBitWidth);
+  for (auto _ : state) {
+    for (int64_t u = 0; u < units; u++) {
+      if (use_kernel) {
+        gilboa_internal::BuildDeltas(a[2 * u], a[2 * u + 1], kBitWidth,
+                                     &deltas[u * kBitWidth]);
+      } else {
+        for (int k = 0; k < kBitWidth; k++) {
+          deltas[u * kBitWidth + k] =
+              std::make_pair(a[2 * u] << k, a[2 * u + 1] << k);
+        }
+      }
+    }
+    benchmark::DoNotOptimize(deltas.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * units * kBitWidth);
+}
+
+template <bool use_kernel>
+void BM_SumBlocks(benchmark::State &state) {
+  const int64_t units = state.range(0), m = state.range(1);
+  std::vector<uint64_t> values = RandomValues(2 * units * kBitWidth);
+  const __m128i *blocks = reinterpret_cast<const __m128i *>(values.data());
+  std::vector<uint64_t> R(2 * units / m);
+  for (auto _ : state) {
+    // One result entry per run of m units, as in GilboaProduct.
+    for (int64_t u = 0; u < units; u += m) {
+      const __m128i *first = blocks + u * kBitWidth;
+      if (use_kernel) {
+        __m128i sum = gilboa_internal::SumBlocks(first, m * kBitWidth);
+        R[2 * (u / m)] -= gilboa_internal::LowLane(sum);
+        R[2 * (u / m) + 1] -= gilboa_internal::HighLane(sum);
+      } else {
+        for (int64_t k = 0; k < m * kBitWidth; k++) {
+          R[2 * (u / m)] -= first[k][0];
+          R[2 * (u / m) + 1] -= first[k][1];
+        }
+      }
+    }
+    benchmark::DoNotOptimize(R.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * units * kBitWidth);
+}
+
+BENCHMARK_TEMPLATE(BM_BuildDeltas, false)->Arg(1 << 14);
+BENCHMARK_TEMPLATE(BM_BuildDeltas, true)->Arg(1 << 14);
+// KNN chunk triples (n = 1) have long runs; square products short ones.
+BENCHMARK_TEMPLATE(BM_SumBlocks, false)
+    ->Args({1 << 14, 4096})
+    ->Args({1 << 14, 16});
+BENCHMARK_TEMPLATE(BM_SumBlocks, true)
+    ->Args({1 << 14, 4096})
+    ->Args({1 << 14, 16});
+
+}  // namespace
@@ -5,7 +5,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <exception>
 #include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "absl/memory/memory.h"
 #include "emp-ot/emp-ot.h"
 #include "emp-tool/emp-tool.h"
 #include "mpc_utils/comm_channel.hpp"
@@ -13,7 +19,7 @@
 #include "mpc_utils/openssl_uniform_bit_generator.hpp"
 #include "mpc_utils/statusor.h"
 #include "sparse_linear_algebra/matrix_multiplication/offline/triple_provider.hpp"
-#include "sparse_linear_algebra/util/blocking_queue.hpp"
+#include "sparse_linear_algebra/util/ring_queue.hpp"
 
 namespace sparse_linear_algebra {
 namespace matrix_multiplication {
@@ -21,44 +27,165 @@ namespace offline {
 
 template <typename T, bool is_shared = false>
 class OTTripleProvider : public virtual TripleProvider<T, is_shared> {
-  static_assert(sizeof(T) == 8,
-                "OtTripleProvider only supports 64-bit integers at the moment");
+  static_assert(std::is_unsigned<T>::value && sizeof(T) <= 8,
+                "OTTripleProvider only supports unsigned integers of at most "
+                "64 bits");
 
  public:
+  // Default for the `memory_budget` argument of Create().
+  static constexpr int64_t kDefaultMemoryBudget = int64_t{1} << 28;
+
   // Constructs a triple provider for multiplying an (l x m) with an (m x n)
   // matrix. The `cap` argument allows to use a bounded queue for storing
-  // triples.
+  // triples. `memory_budget` bounds the bytes used for OT inputs and outputs
+  // while generating a triple; both parties must pass the same value.
   static mpc_utils::StatusOr<std::unique_ptr<OTTripleProvider<T, is_shared>>>
-  Create(int l, int m, int n, int role, comm_channel *channel, int cap = -1);
+  Create(int l, int m, int n, int role, comm_channel *channel, int cap = -1,
+         int64_t memory_budget = kDefaultMemoryBudget);
+
+  ~OTTripleProvider() override;
 
   // Precomputes a number of triples. Blocks if capacity is bounded and queue is
   // full.
   void Precompute(int num);
 
+  // Precomputes a number of triple families, each consisting of `size` triples
+  // that share the same V. Blocks if capacity is bounded and queue is full.
+  void PrecomputeFamilies(int num, int size);
+
   // Returns a precomputed triple. Can be called concurrently with precompute();
   // however, only one thread may call get() at the same time.
   Triple<T> GetTriple() override;
 
+  // Returns a triple family precomputed by PrecomputeFamilies(). `size` must
+  // match the size passed there.
+  TripleFamily<T> GetTripleFamily(int size) override;
+
+  // Starts `num_workers` threads that generate triples in the background until
+  // StopBackground() is called. Each worker runs its own OT extension over a
+  // clone of the channel passed to Create(). If `family_size` is positive, the
+  // workers generate triple families of that size instead. Both parties must
+  // call this at the same point of their communication with the same
+  // arguments. Triples left over from a previous background run are discarded.
+  //
+  // While workers are running, GetTriple() (or GetTripleFamily()) takes from
+  // them in round-robin order, so that both parties get matching triples. If
+  // capacity is bounded, the cap is split among the workers, so that together
+  // they hold at most `cap` triples that have not been consumed yet; it must
+  // then be at least `num_workers`. Once all workers have exited, GetTriple()
+  // and GetTripleFamily() fall back to precomputed triples and throw if there
+  // are none.
+  mpc_utils::Status StartBackground(int num_workers, int family_size = 0);
+
+  // Stops the background workers once they have finished their current
+  // triple, which stays available. Both parties must call this. Party 0
+  // decides when the workers of both parties stop, so party 1 blocks until
+  // party 0 has called StopBackground() as well.
+  void StopBackground();
+
+  // Returns the number of precomputed triples and families that have not been
+  // consumed yet, i.e., how far production is ahead of the consumer.
+  int NumAvailable();
+
  private:
+  using OTExtension = emp::SHOTExtension<mpc_utils::CommChannelEMPAdapter>;
+
+  // A channel adapter with one long-lived OT extension per direction. Reusing
+  // the extensions across products means base OTs only run once per session.
+  struct OTSession {
+    explicit OTSession(
+        std::unique_ptr<mpc_utils::CommChannelEMPAdapter> adapter)
+        : channel_adapter(std::move(adapter)),
+          ot{absl::make_unique<OTExtension>(channel_adapter.get()),
+             absl::make_unique<OTExtension>(channel_adapter.get())} {}
+    std::unique_ptr<mpc_utils::CommChannelEMPAdapter> channel_adapter;
+    // Indexed by the role of the OT sender, i.e., the party providing U.
+    std::unique_ptr<OTExtension> ot[2];
+  };
+
+  // State of a background worker. Workers with the same index are paired
+  // across the two parties.
+  struct Worker {
+    explicit Worker(int cap) : triples(cap), families(cap) {}
+    std::unique_ptr<comm_channel> channel;
+    std::unique_ptr<OTSession> session;
+    mpc_utils::OpenSSLUniformBitGenerator rng;
+    // Closed by the worker when it exits.
+    ring_queue<Triple<T>> triples;
+    ring_queue<TripleFamily<T>> families;
+    std::exception_ptr error;
+    std::thread thread;
+  };
+
   // Private constructor, called by Create.
   OTTripleProvider(
-      int l, int m, int n, int role,
+      int l, int m, int n, int role, comm_channel *channel,
       std::unique_ptr<mpc_utils::CommChannelEMPAdapter> channel_adapter,
-      int cap);
+      int cap, int64_t memory_budget);
 
   // Returns an additive share of UV, where
   // input_assign is 0 iff party 0 provides U and party 1 provides V
-  Matrix<T> GilboaProduct(Matrix<T> U, Matrix<T> V, bool input_assign);
+  Matrix<T> GilboaProduct(Matrix<T> U, Matrix<T> V, bool input_assign,
+                          OTSession *session,
+                          mpc_utils::OpenSSLUniformBitGenerator &rng);
+
+  // GilboaProduct() for rings of at most 32 bits, packing four products per
+  // COT. `rng` seeds the random COT deltas.
+  Matrix<T> GilboaProduct32(Matrix<T> U, const Matrix<T> &V,
+                            bool input_assign, OTSession *session,
+                            mpc_utils::OpenSSLUniformBitGenerator &rng);
+
+  // Generates a single triple where U has `l` rows.
+  Triple<T> GenerateTriple(int l, OTSession *session,
+                           mpc_utils::OpenSSLUniformBitGenerator &rng);
+
+  // Generates a family of `size` triples sharing the same V.
+  TripleFamily<T> GenerateTripleFamily(
+      int size, OTSession *session,
+      mpc_utils::OpenSSLUniformBitGenerator &rng);
+
+  // Main loop of a background worker.
+  void RunWorker(Worker *worker, int family_size);
+
+  // Pops the next value from the workers' `queue`s in round-robin order,
+  // skipping workers that have exited and have nothing left. Returns false if
+  // all workers are exhausted.
+  template <typename Value>
+  bool PopFromWorkers(ring_queue<Value> Worker::*queue, Value *value);
+
+  // Pops a precomputed value from `queue`. If `from_workers` is true and
+  // workers were started, they have all exited, so this throws instead of
+  // blocking if `queue` is empty.
+  template <typename Value>
+  Value PopPrecomputed(ring_queue<Value> *queue, bool from_workers);
 
   // Precomputed triples to be returned by GetTriple().
-  blocking_queue<Triple<T>> triples_;
+  ring_queue<Triple<T>> triples_;
+
+  // Precomputed triple families to be returned by GetTripleFamily().
+  ring_queue<TripleFamily<T>> families_;
 
-  // Wrapper around the communication channel passed at construction.
-  // Used for oblivious transfers during triple generation.
-  std::unique_ptr<mpc_utils::CommChannelEMPAdapter> channel_adapter_;
+  // OT session over the communication channel passed at construction. Used
+  // for oblivious transfers by Precompute() and PrecomputeFamilies().
+  OTSession session_;
 
   // Random number generator for creating triples.
   mpc_utils::OpenSSLUniformBitGenerator rng_;
+
+  // Channel passed at construction, cloned for each background worker.
+  comm_channel *channel_;
+  int cap_;
+
+  // Bytes available for the OT inputs and outputs of a GilboaProduct() tile.
+  int64_t memory_budget_;
+
+  // Background workers of the current or last run, and the next one to take a
+  // triple from.
+  std::vector<std::unique_ptr<Worker>> workers_;
+  size_t next_worker_ = 0;
+  int background_family_size_ = 0;
+  bool background_running_ = false;
+  std::atomic<bool> stop_requested_{false};
 };
 
 }  // namespace offline
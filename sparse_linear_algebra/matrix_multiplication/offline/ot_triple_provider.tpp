@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <vector>
 #include "absl/memory/memory.h"
@@ -8,7 +10,10 @@
 #include "mpc_utils/canonical_errors.h"
 #include "mpc_utils/comm_channel_emp_adapter.hpp"
 #include "mpc_utils/status_macros.h"
+#include "sparse_linear_algebra/matrix_multiplication/offline/gilboa_kernels.hpp"
+#include "sparse_linear_algebra/util/aes_prg.hpp"
 #include "sparse_linear_algebra/util/randomize_matrix.hpp"
+#include "sparse_linear_algebra/util/ring_gemm.hpp"
 
 namespace sparse_linear_algebra {
 namespace matrix_multiplication {
@@ -17,10 +22,14 @@ namespace offline {
 template <typename T, bool is_shared>
 mpc_utils::StatusOr<std::unique_ptr<OTTripleProvider<T, is_shared>>>
 OTTripleProvider<T, is_shared>::Create(int l, int m, int n, int role,
-                                       comm_channel *channel, int cap) {
+                                       comm_channel *channel, int cap,
+                                       int64_t memory_budget) {
   if (l < 1 || m < 1 || n < 1) {
     return mpc_utils::InvalidArgumentError("l, m and n must be positive");
   }
+  if (memory_budget < 1) {
+    return mpc_utils::InvalidArgumentError("memory_budget must be positive");
+  }
   if (role != 0 && role != 1) {
     return mpc_utils::InvalidArgumentError("role must be 0 or 1");
   }
@@ -29,21 +38,32 @@ OTTripleProvider<T, is_shared>::Create(int l, int m, int n, int role,
   ASSIGN_OR_RETURN(auto adapter, mpc_utils::CommChannelEMPAdapter::Create(
                                      channel, !channel->is_measured()));
   return absl::WrapUnique(
-      new OTTripleProvider(l, m, n, role, std::move(adapter), cap));
+      new OTTripleProvider(l, m, n, role, channel, std::move(adapter), cap,
+                           memory_budget));
 }
 
 template <typename T, bool is_shared>
 OTTripleProvider<T, is_shared>::OTTripleProvider(
-    int l, int m, int n, int role,
-    std::unique_ptr<mpc_utils::CommChannelEMPAdapter> channel_adapter, int cap)
+    int l, int m, int n, int role, comm_channel *channel,
+    std::unique_ptr<mpc_utils::CommChannelEMPAdapter> channel_adapter, int cap,
+    int64_t memory_budget)
     : TripleProvider<T, is_shared>(l, m, n, role),
       triples_(cap),
-      channel_adapter_(std::move(channel_adapter)) {}
+      families_(cap),
+      session_(std::move(channel_adapter)),
+      channel_(channel),
+      cap_(cap),
+      memory_budget_(memory_budget) {}
+
+template <typename T, bool is_shared>
+OTTripleProvider<T, is_shared>::~OTTripleProvider() {
+  StopBackground();
+}
 
 template <typename T, bool is_shared>
-Matrix<T> OTTripleProvider<T, is_shared>::GilboaProduct(Matrix<T> U,
-                                                        Matrix<T> V,
-                                                        bool input_assign) {
+Matrix<T> OTTripleProvider<T, is_shared>::GilboaProduct(
+    Matrix<T> U, Matrix<T> V, bool input_assign, OTSession *session,
+    mpc_utils::OpenSSLUniformBitGenerator &rng) {
   // input_assign is 0 iff party 0 provides U and party 1 provides V
   int64_t l = U.rows();
   int64_t m = U.cols();
@@ -52,139 +72,477 @@ Matrix<T> OTTripleProvider<T, is_shared>::GilboaProduct(Matrix<T> U,
     BOOST_THROW_EXCEPTION(
         std::runtime_error("Error: matrix dimensions don't agree"));
   }
+  if (sizeof(T) <= 4) {
+    return GilboaProduct32(std::move(U), V, input_assign, session, rng);
+  }
 
-  Matrix<uint64_t> R = Matrix<uint64_t>::Zero(l, n);
-  int64_t bit_width = sizeof(uint64_t) * 8;  // bitwidth of the shares.
-  // We run a single instance of N-COT_M, where N = n * ceil(l/2) * m *
-  // bit_width. bit_width is the number of OTs needed for a single Gilboa
-  // multiplications, and for multiplying U and V we needs l * n * m
-  // multiplications with a naive algorithm. The ceil(l/2) above comes from the
-  // fact that we exploit packing, as M in EMP is 128 bits. This optimization
-  // halves computation and communication, and assumes that sizeof(T) = 64.
+  int64_t bit_width = sizeof(T) * 8;  // bitwidth of the shares.
+  // We run N-COT_M, where N = n * ceil(l/2) * m * bit_width. bit_width is the
+  // number of OTs needed for a single Gilboa multiplications, and for
+  // multiplying U and V we needs l * n * m multiplications with a naive
+  // algorithm. The ceil(l/2) above comes from the fact that we exploit
+  // packing, as M in EMP is 128 bits. This optimization halves computation and
+  // communication. Smaller rings use GilboaProduct32() instead.
 
   // We use cot_add_delta fro EMP. This is a particular case of N-COT where the
   // sender defines cot_deltas as a list of N pairs of uint64_t. The receiver
   // gets a block (128 bits) that is the component-wise sum of cot_deltas[i] and
   // m_0 (seen as a pair of uint64_t) if its choose bit is 1, and m_0 otherwise.
-  int64_t N = n * ((l + 1) / 2) * m * bit_width;
+  //
+  // The N COTs are grouped into stride * n * m units of bit_width COTs, one
+  // unit per packed Gilboa multiplication. Units are processed in tiles that
+  // fit into memory_budget_, so that peak memory does not depend on l, m and n.
+  // The tile size only depends on the budget and T, so both parties run the
+  // same sequence of COT batches.
+  auto stride = (l + 1) / 2;
+  int64_t num_units = stride * n * m;
+  int64_t bytes_per_unit =
+      bit_width * (sizeof(emp::block) + sizeof(std::pair<uint64_t, uint64_t>));
+  int64_t units_per_tile = std::min(
+      num_units, std::max<int64_t>(1, memory_budget_ / bytes_per_unit));
+  int64_t tile_cots = units_per_tile * bit_width;
 
-  std::vector<emp::block> opt0(N);
-  std::vector<emp::block> ot_result(N);
-  // std::vector<bool> is implemented as a bitstring, ans thus does not use a
-  // bool * internally, which EMP requires.
-  boost::container::vector<bool> choices(N);
-  std::vector<std::pair<uint64_t, uint64_t>> cot_deltas(N);
+  // Pad U and R with a zero row if l is odd, so that every unit has two rows.
+  U.conservativeResizeLike(Matrix<T>::Zero(2 * stride, m));
+  Matrix<T> R = Matrix<T>::Zero(2 * stride, n);
 
   // Party holding U acts as sender
   int sender = (input_assign ? 0 : 1);
   int role = this->role();
-  auto stride = (l + 1) / 2;
-  // Construct list of deltas and choices for the N COTs to compute an l x n x
-  // m matrix multiplication between matrices U and V. These are in principle
-  // l*n*m multiplications between every pair of values a, b in U and V, each
-  // requiring bit_width COTs with correlation function f(x) = 2^i * a + x and
-  // choice but b[i] (ith bit of the binary encoding of b). However, we can pack
-  // several multiplications with the same value, such as (a1 * b), (a2 * b), in
-  // a single OT, to reduce from l*n*m to stride*n*m Gilboa multiplications The
-  // correlation function operates on a1 and a2 simultaneouly, resulting in f(x)
-  // = 2^i * a1 + x[0:63] || 2^i * a1 + x[64:128], as x is an emp::block (AES
-  // block) of length 128).
-  for (int64_t i = 0; i < stride; ++i) {
-    for (int64_t j = 0; j < n; j++) {
-      for (int64_t z = 0; z < m; z++) {
-        for (int k = 0; k < bit_width; k++) {
-          if (role == sender) {
-            cot_deltas[i * n * m * bit_width + j * m * bit_width +
-                       z * bit_width + k] =
-                std::make_pair(
-                    (((uint64_t)1) << k) * U(i, z),
-                    (i + stride < l) ? (((T)1) << k) * U(i + stride, z) : 0);
-          } else {
-            choices[i * n * m * bit_width + j * m * bit_width + z * bit_width +
-                    k] = ((V(z, j) >> k) & 0x1);
-          }
+  // The sender needs opt0 and cot_deltas, the receiver ot_result and choices.
+  std::vector<emp::block> opt0(role == sender ? tile_cots : 0);
+  std::vector<std::pair<uint64_t, uint64_t>> cot_deltas(
+      role == sender ? tile_cots : 0);
+  std::vector<emp::block> ot_result(role == sender ? 0 : tile_cots);
+  // std::vector<bool> is implemented as a bitstring, ans thus does not use a
+  // bool * internally, which EMP requires.
+  boost::container::vector<bool> choices(role == sender ? 0 : tile_cots);
+  // The sender subtracts its OT messages, the receiver adds them.
+  const emp::block *messages = role == sender ? opt0.data() : ot_result.data();
+  const uint64_t sign = role == sender ? ~uint64_t{0} : 1;
+  // The extension for this direction runs its base OTs on first use only.
+  OTExtension &ot = *session->ot[sender];
+
+  for (int64_t tile_begin = 0; tile_begin < num_units;
+       tile_begin += units_per_tile) {
+    int64_t tile_end = std::min(num_units, tile_begin + units_per_tile);
+    // Construct list of deltas and choices for the COTs of this tile to
+    // compute an l x n x m matrix multiplication between matrices U and V.
+    // These are in principle l*n*m multiplications between every pair of
+    // values a, b in U and V, each requiring bit_width COTs with correlation
+    // function f(x) = 2^i * a + x and choice but b[i] (ith bit of the binary
+    // encoding of b). However, we can pack several multiplications with the
+    // same value, such as (a1 * b), (a2 * b), in a single OT, to reduce from
+    // l*n*m to stride*n*m Gilboa multiplications The correlation function
+    // operates on a1 and a2 simultaneouly, resulting in f(x) = 2^i * a1 +
+    // x[0:63] || 2^i * a1 + x[64:128], as x is an emp::block (AES block) of
+    // length 128). Unit u corresponds to the multiplication (i, j, z) with
+    // u = (i * n + j) * m + z, so the units of each (i, j) are contiguous.
+    for (int64_t u = tile_begin; u < tile_end;) {
+      int64_t i = u / (n * m), j = (u / m) % n, z = u % m;
+      int64_t segment_end = std::min(tile_end, u - z + m);
+      int64_t offset = (u - tile_begin) * bit_width;
+      if (role == sender) {
+        for (; u < segment_end; u++, z++, offset += bit_width) {
+          gilboa_internal::BuildDeltas(U(i, z), U(i + stride, z), bit_width,
+                                       &cot_deltas[offset]);
+        }
+      } else {
+        for (; u < segment_end; u++, z++, offset += bit_width) {
+          gilboa_internal::BuildChoices(V(z, j), bit_width,
+                                        choices.data() + offset);
         }
       }
     }
+
+    // Run OT Extension (Party holding U as sender)
+    int64_t num_cots = (tile_end - tile_begin) * bit_width;
+    if (role == sender) {
+      ot.send_cot_add_delta(opt0.data(), cot_deltas.data(), num_cots);
+    } else {
+      ot.recv_cot(ot_result.data(), choices.data(), num_cots);
+    }
+    session->channel_adapter->flush();
+
+    // Parties aggregate OT messages into their share of the result, one
+    // (i, j) at a time.
+    for (int64_t u = tile_begin; u < tile_end;) {
+      int64_t i = u / (n * m), j = (u / m) % n;
+      int64_t segment_end = std::min(tile_end, u - u % m + m);
+      emp::block sum = gilboa_internal::SumBlocks(
+          messages + (u - tile_begin) * bit_width,
+          (segment_end - u) * bit_width);
+      R(i, j) += static_cast<T>(sign * gilboa_internal::LowLane(sum));
+      R(i + stride, j) += static_cast<T>(sign * gilboa_internal::HighLane(sum));
+      u = segment_end;
+    }
   }
+  R.conservativeResize(l, n);
+  return R;
+}
+
+template <typename T, bool is_shared>
+Matrix<T> OTTripleProvider<T, is_shared>::GilboaProduct32(
+    Matrix<T> U, const Matrix<T> &V, bool input_assign, OTSession *session,
+    mpc_utils::OpenSSLUniformBitGenerator &rng) {
+  int64_t l = U.rows();
+  int64_t m = U.cols();
+  int64_t n = V.cols();
+  const int bit_width = sizeof(T) * 8;
 
-  // Run OT Extension (Party holding U as sender)
-  emp::SHOTExtension<mpc_utils::CommChannelEMPAdapter> ot(
-      channel_adapter_.get());
+  // As in GilboaProduct(), but each COT packs four products, of rows i,
+  // i + stride, i + 2 * stride and i + 3 * stride of U, in 32-bit lanes. This
+  // halves the number of COTs again. The COTs have random deltas, and the
+  // sender corrects them with gilboa_internal::Correction32(). Since 2^k
+  // cancels the high k bits of each lane, only bit_width - k bits per lane
+  // are sent for bit k.
+  //
+  // Units are numbered and tiled as in GilboaProduct(). The corrections of a
+  // tile are packed back to back into a single message.
+  auto stride = (l + 3) / 4;
+  int64_t num_units = stride * n * m;
+  const int64_t unit_bits = gilboa_internal::CorrectionBits32(bit_width);
+  int64_t bytes_per_unit =
+      bit_width * (sizeof(emp::block) + sizeof(std::pair<uint64_t, uint64_t>)) +
+      (unit_bits + 7) / 8;
+  int64_t units_per_tile = std::min(
+      num_units, std::max<int64_t>(1, memory_budget_ / bytes_per_unit));
+  int64_t tile_cots = units_per_tile * bit_width;
+
+  // Pad U and R with zero rows, so that every unit has four rows.
+  U.conservativeResizeLike(Matrix<T>::Zero(4 * stride, m));
+  Matrix<T> R = Matrix<T>::Zero(4 * stride, n);
+
+  // Party holding U acts as sender
+  int sender = (input_assign ? 0 : 1);
+  int role = this->role();
+  std::vector<emp::block> messages(tile_cots);
+  std::vector<std::pair<uint64_t, uint64_t>> cot_deltas(
+      role == sender ? tile_cots : 0);
+  boost::container::vector<bool> choices(role == sender ? 0 : tile_cots);
+  std::vector<uint64_t> corrections(
+      gilboa_internal::PackedWords(units_per_tile, unit_bits));
+  // The deltas are the keystream under a fresh key.
+  std::unique_ptr<aes_prg> delta_prg;
   if (role == sender) {
-    ot.send_cot_add_delta(opt0.data(), cot_deltas.data(), N);
-  } else {
-    ot.recv_cot(ot_result.data(), choices.data(), N);
-  }
-  channel_adapter_->flush();
-  // Parties aggregate OT messages into their share of the result
-  for (int64_t i = 0; i < stride; i++) {
-    for (int64_t j = 0; j < n; j++) {
-      for (int64_t z = 0; z < m; z++) {
-        for (int k = 0; k < bit_width; k++) {
-          if (role == sender) {
-            R(i, j) -=
-                (uint64_t)(opt0[i * n * m * bit_width + j * m * bit_width +
-                                z * bit_width + k][0]);
-            if (i + stride < l) {
-              R(i + stride, j) -=
-                  (uint64_t)(opt0[i * n * m * bit_width + j * m * bit_width +
-                                  z * bit_width + k][1]);
-            }
-          } else {
-            R(i, j) +=
-                (uint64_t)(ot_result[i * n * m * bit_width + j * m * bit_width +
-                                     z * bit_width + k][0]);
-            if (i + stride < l) {
-              R(i + stride, j) += (uint64_t)(
-                  ot_result[i * n * m * bit_width + j * m * bit_width +
-                            z * bit_width + k][1]);
-            }
+    std::uniform_int_distribution<uint64_t> dist;
+    uint64_t key_words[2] = {dist(rng), dist(rng)};
+    uint8_t key[aes_prg::block_size];
+    std::memcpy(key, key_words, sizeof(key));
+    delta_prg = absl::make_unique<aes_prg>(key);
+  }
+  OTExtension &ot = *session->ot[sender];
+
+  for (int64_t tile_begin = 0; tile_begin < num_units;
+       tile_begin += units_per_tile) {
+    int64_t tile_end = std::min(num_units, tile_begin + units_per_tile);
+    int64_t num_cots = (tile_end - tile_begin) * bit_width;
+    int64_t num_words =
+        gilboa_internal::PackedWords(tile_end - tile_begin, unit_bits);
+    std::fill_n(corrections.begin(), num_words, 0);
+    if (role == sender) {
+      delta_prg->random_data(cot_deltas.data(),
+                             num_cots * sizeof(cot_deltas[0]));
+      ot.send_cot_add_delta(messages.data(), cot_deltas.data(), num_cots);
+    } else {
+      for (int64_t u = tile_begin; u < tile_end; u++) {
+        int64_t j = (u / m) % n, z = u % m;
+        gilboa_internal::BuildChoices(
+            V(z, j), bit_width,
+            choices.data() + (u - tile_begin) * bit_width);
+      }
+      ot.recv_cot(messages.data(), choices.data(), num_cots);
+      session->channel_adapter->recv_data(corrections.data(),
+                                          num_words * sizeof(uint64_t));
+    }
+
+    // The sender computes and packs the corrections, and subtracts x0 from
+    // its share. The receiver adds the corrected messages to its share. Both
+    // accumulate the lanes of one (i, j) at a time.
+    for (int64_t u = tile_begin; u < tile_end;) {
+      int64_t i = u / (n * m), j = (u / m) % n, z = u % m;
+      int64_t segment_end = std::min(tile_end, u - z + m);
+      __m128i sum = _mm_setzero_si128();
+      for (; u < segment_end; u++, z++) {
+        int64_t t = (u - tile_begin) * bit_width;
+        int64_t bit = (u - tile_begin) * unit_bits;
+        uint32_t lanes[4];
+        if (role == sender) {
+          __m128i a = _mm_set_epi32(U(i + 3 * stride, z),
+                                    U(i + 2 * stride, z), U(i + stride, z),
+                                    U(i, z));
+          for (int k = 0; k < bit_width; k++, t++) {
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(lanes),
+                gilboa_internal::Correction32(messages[t], cot_deltas[t], a));
+            gilboa_internal::PackBits(
+                lanes, 4, bit_width - k, corrections.data(),
+                bit + gilboa_internal::CorrectionOffset32(bit_width, k));
+            sum = gilboa_internal::AddShifted32(sum, messages[t], k);
+          }
+        } else {
+          for (int k = 0; k < bit_width; k++, t++) {
+            gilboa_internal::UnpackBits(
+                corrections.data(), 4, bit_width - k, lanes,
+                bit + gilboa_internal::CorrectionOffset32(bit_width, k));
+            __m128i y = gilboa_internal::Corrected32(
+                messages[t], choices[t],
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes)));
+            sum = gilboa_internal::AddShifted32(sum, y, k);
           }
         }
       }
+      uint32_t lanes[4];
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), sum);
+      for (int q = 0; q < 4; q++) {
+        T lane = static_cast<T>(lanes[q]);
+        R(i + q * stride, j) += role == sender ? static_cast<T>(-lane) : lane;
+      }
     }
+    if (role == sender) {
+      session->channel_adapter->send_data(corrections.data(),
+                                          num_words * sizeof(uint64_t));
+    }
+    session->channel_adapter->flush();
   }
+  R.conservativeResize(l, n);
   return R;
 }
 
 template <typename T, bool is_shared>
-void OTTripleProvider<T, is_shared>::Precompute(int num) {
-  for (auto i = 0; i < num; i++) {
-    int l, m, n;
-    std::tie(l, m, n) = this->dimensions();
-    int role = this->role();
-    // Role 0 generates a random l x m matrix U0, and Role 1 generates a random
-    // m x n matrix V1. We then run an OT-based matrix multiplication protocol
-    // to produce a share of U0 * V1. If is_shared is true then we repeat the
-    // above with reversed roles and inputs V0, U1 and construct the final
-    // triple as a share of (U0+U1)(V0+V1) = U0V0 + U0V1 + U1V0 + U1V1 using
-    // some additional local computations.
-    Matrix<T> U = Matrix<T>::Zero(l, m);
-    Matrix<T> V = Matrix<T>::Zero(m, n);
+Triple<T> OTTripleProvider<T, is_shared>::GenerateTriple(
+    int l, OTSession *session, mpc_utils::OpenSSLUniformBitGenerator &rng) {
+  int m, n;
+  std::tie(std::ignore, m, n) = this->dimensions();
+  int role = this->role();
+  // Role 0 generates a random l x m matrix U0, and Role 1 generates a random
+  // m x n matrix V1. We then run an OT-based matrix multiplication protocol
+  // to produce a share of U0 * V1. If is_shared is true then we repeat the
+  // above with reversed roles and inputs V0, U1 and construct the final
+  // triple as a share of (U0+U1)(V0+V1) = U0V0 + U0V1 + U1V0 + U1V1 using
+  // some additional local computations.
+  Matrix<T> U = Matrix<T>::Zero(l, m);
+  Matrix<T> V = Matrix<T>::Zero(m, n);
+  if (role == 0) {
+    randomize_matrix(rng, U);
+  } else {
+    randomize_matrix(rng, V);
+  }
+  // Compute share of U0 * V1 above.
+  Matrix<T> R = GilboaProduct(U, V, true, session, rng);
+
+  // Repeat the above if we want a shared triple.
+  if (is_shared) {
     if (role == 0) {
-      randomize_matrix(rng_, U);
+      randomize_matrix(rng, V);
     } else {
-      randomize_matrix(rng_, V);
+      randomize_matrix(rng, U);
+    }
+    ring_gemm(U, V, R);
+    R += GilboaProduct(U, V, false, session, rng);
+  }
+  return std::make_tuple(std::move(U), std::move(V), std::move(R));
+}
+
+template <typename T, bool is_shared>
+TripleFamily<T> OTTripleProvider<T, is_shared>::GenerateTripleFamily(
+    int size, OTSession *session,
+    mpc_utils::OpenSSLUniformBitGenerator &rng) {
+  int l = std::get<0>(this->dimensions());
+  // A family is a single triple with `size` stacked copies of U, so
+  // (U_1; ...; U_size) * V = (Z_1; ...; Z_size) can be split row-wise.
+  Matrix<T> U, V, Z;
+  std::tie(U, V, Z) = GenerateTriple(l * size, session, rng);
+  std::vector<Matrix<T>> Us(size), Zs(size);
+  for (int j = 0; j < size; j++) {
+    Us[j] = U.middleRows(j * l, l);
+    Zs[j] = Z.middleRows(j * l, l);
+  }
+  return std::make_tuple(std::move(Us), std::move(V), std::move(Zs));
+}
+
+template <typename T, bool is_shared>
+void OTTripleProvider<T, is_shared>::Precompute(int num) {
+  int l = std::get<0>(this->dimensions());
+  for (auto i = 0; i < num; i++) {
+    triples_.push(GenerateTriple(l, &session_, rng_));
+  }
+}
+
+template <typename T, bool is_shared>
+void OTTripleProvider<T, is_shared>::PrecomputeFamilies(int num, int size) {
+  if (size < 1) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("Family size must be positive"));
+  }
+  for (auto i = 0; i < num; i++) {
+    families_.push(GenerateTripleFamily(size, &session_, rng_));
+  }
+}
+
+template <typename T, bool is_shared>
+mpc_utils::Status OTTripleProvider<T, is_shared>::StartBackground(
+    int num_workers, int family_size) {
+  if (num_workers < 1) {
+    return mpc_utils::InvalidArgumentError("num_workers must be positive");
+  }
+  if (family_size < 0) {
+    return mpc_utils::InvalidArgumentError("family_size must not be negative");
+  }
+  if (cap_ != -1 && cap_ < num_workers) {
+    return mpc_utils::InvalidArgumentError("cap must be at least num_workers");
+  }
+  if (background_running_) {
+    return mpc_utils::FailedPreconditionError(
+        "Background generation is already running");
+  }
+  workers_.clear();
+  next_worker_ = 0;
+  background_family_size_ = family_size;
+  stop_requested_ = false;
+  // Clone channels sequentially, so that both parties pair workers by index.
+  for (int i = 0; i < num_workers; i++) {
+    // Split the cap exactly, giving the remainder to the first workers.
+    int worker_cap = -1;
+    if (cap_ != -1) {
+      worker_cap = cap_ / num_workers + (i < cap_ % num_workers ? 1 : 0);
     }
-    Matrix<T> R = GilboaProduct(U, V, true);  // Compute share of U0 * V1 above.
+    auto worker = absl::make_unique<Worker>(worker_cap);
+    worker->channel = absl::make_unique<comm_channel>(channel_->clone());
+    worker->channel->sync();
+    ASSIGN_OR_RETURN(auto adapter, mpc_utils::CommChannelEMPAdapter::Create(
+                                       worker->channel.get(),
+                                       !worker->channel->is_measured()));
+    worker->session = absl::make_unique<OTSession>(std::move(adapter));
+    workers_.push_back(std::move(worker));
+  }
+  for (auto &worker : workers_) {
+    worker->thread = std::thread(&OTTripleProvider::RunWorker, this,
+                                 worker.get(), family_size);
+  }
+  background_running_ = true;
+  return mpc_utils::OkStatus();
+}
 
-    // Repeat the above if we want a shared triple.
-    if (is_shared) {
-      if (role == 0) {
-        randomize_matrix(rng_, V);
+template <typename T, bool is_shared>
+void OTTripleProvider<T, is_shared>::RunWorker(Worker *worker,
+                                               int family_size) {
+  int l = std::get<0>(this->dimensions());
+  auto *channel_adapter = worker->session->channel_adapter.get();
+  try {
+    while (true) {
+      // Party 0 decides whether to generate another triple, so that paired
+      // workers always generate the same number of triples.
+      bool proceed = !stop_requested_;
+      if (this->role() == 0) {
+        channel_adapter->send_data(&proceed, sizeof(proceed));
+        channel_adapter->flush();
+      } else {
+        channel_adapter->recv_data(&proceed, sizeof(proceed));
+      }
+      if (!proceed) {
+        break;
+      }
+      if (family_size > 0) {
+        worker->families.push(GenerateTripleFamily(
+            family_size, worker->session.get(), worker->rng));
       } else {
-        randomize_matrix(rng_, U);
+        worker->triples.push(
+            GenerateTriple(l, worker->session.get(), worker->rng));
       }
-      R += U * V + GilboaProduct(U, V, false);
     }
-    triples_.push(std::make_tuple(U, V, R));
+  } catch (...) {
+    worker->error = std::current_exception();
   }
+  worker->triples.close();
+  worker->families.close();
+}
+
+template <typename T, bool is_shared>
+void OTTripleProvider<T, is_shared>::StopBackground() {
+  if (!background_running_) {
+    return;
+  }
+  stop_requested_ = true;
+  for (auto &worker : workers_) {
+    // Don't let workers wait for consumers while stopping.
+    worker->triples.set_capacity(-1);
+    worker->families.set_capacity(-1);
+  }
+  for (auto &worker : workers_) {
+    worker->thread.join();
+  }
+  background_running_ = false;
+}
+
+template <typename T, bool is_shared>
+int OTTripleProvider<T, is_shared>::NumAvailable() {
+  size_t num = triples_.size() + families_.size();
+  for (auto &worker : workers_) {
+    num += worker->triples.size() + worker->families.size();
+  }
+  return num;
+}
+
+template <typename T, bool is_shared>
+template <typename Value>
+bool OTTripleProvider<T, is_shared>::PopFromWorkers(
+    ring_queue<Value> Worker::*queue, Value *value) {
+  // A worker's queue is only empty and closed once it has exited, and paired
+  // workers generate the same number of triples, so both parties skip the
+  // same workers.
+  for (size_t i = 0; i < workers_.size(); i++) {
+    Worker &worker = *workers_[next_worker_];
+    next_worker_ = (next_worker_ + 1) % workers_.size();
+    if ((worker.*queue).pop(value)) {
+      return true;
+    }
+    if (worker.error) {
+      std::rethrow_exception(worker.error);
+    }
+  }
+  return false;
+}
+
+template <typename T, bool is_shared>
+template <typename Value>
+Value OTTripleProvider<T, is_shared>::PopPrecomputed(ring_queue<Value> *queue,
+                                                     bool from_workers) {
+  Value value;
+  // Without workers, Precompute() may still be running concurrently. Once
+  // workers have exited, waiting for more triples would block forever.
+  if (!from_workers || workers_.empty()) {
+    return queue->pop();
+  }
+  if (!queue->try_pop(&value)) {
+    BOOST_THROW_EXCEPTION(std::runtime_error(
+        "Background workers have exited and no triples are precomputed"));
+  }
+  return value;
 }
 
 template <typename T, bool is_shared>
 Triple<T> OTTripleProvider<T, is_shared>::GetTriple() {
-  return triples_.pop();
+  Triple<T> triple;
+  bool from_workers = background_family_size_ == 0;
+  if (from_workers && PopFromWorkers(&Worker::triples, &triple)) {
+    return triple;
+  }
+  return PopPrecomputed(&triples_, from_workers);
+}
+
+template <typename T, bool is_shared>
+TripleFamily<T> OTTripleProvider<T, is_shared>::GetTripleFamily(int size) {
+  TripleFamily<T> family;
+  bool from_workers = background_family_size_ > 0;
+  if (!from_workers || !PopFromWorkers(&Worker::families, &family)) {
+    family = PopPrecomputed(&families_, from_workers);
+  }
+  if (static_cast<int>(std::get<0>(family).size()) != size) {
+    BOOST_THROW_EXCEPTION(std::invalid_argument(
+        "Requested family size does not match precomputed size"));
+  }
+  return family;
 }
 
 }  // namespace offline
@@ -1,106 +1,104 @@
 #include "sparse_linear_algebra/matrix_multiplication/offline/ot_triple_provider.hpp"
 #include <thread>
-#include "absl/memory/memory.h"
-#include "emp-ot/emp-ot.h"
-#include "emp-tool/emp-tool.h"
 #include "gtest/gtest.h"
-#include "mpc_utils/boost_serialization/eigen.hpp"
-#include "mpc_utils/comm_channel.hpp"
 #include "mpc_utils/status_matchers.h"
-#include "mpc_utils/testing/comm_channel_test_helper.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/triple_provider_test_suite.hpp"
 
 namespace sparse_linear_algebra {
 namespace matrix_multiplication {
 namespace offline {
 namespace {
 
-class OTTripleProviderTest : public ::testing::Test {
- protected:
-  OTTripleProviderTest() : helper_(false) {}
-  void SetUp(int l, int m, int n) {
-    using DistributedTripleProvider = OTTripleProvider<uint64_t, false>;
-    using SharedTripleProvider = OTTripleProvider<uint64_t, true>;
-    comm_channel *chan0 = helper_.GetChannel(0);
-    comm_channel *chan1 = helper_.GetChannel(1);
-    std::thread thread1([this, chan1, l, m, n] {
-      ASSERT_OK_AND_ASSIGN(
-          distributed_triples_1_,
-          DistributedTripleProvider::Create(l, m, n, 1, chan1));
-      ASSERT_OK_AND_ASSIGN(shared_triples_1_,
-                           SharedTripleProvider::Create(l, m, n, 1, chan1));
-    });
-    ASSERT_OK_AND_ASSIGN(distributed_triples_0_,
-                         DistributedTripleProvider::Create(l, m, n, 0, chan0));
-    ASSERT_OK_AND_ASSIGN(shared_triples_0_,
-                         SharedTripleProvider::Create(l, m, n, 0, chan0));
-    thread1.join();
-  }
-
-  mpc_utils::testing::CommChannelTestHelper helper_;
-  std::unique_ptr<OTTripleProvider<uint64_t, false>> distributed_triples_0_;
-  std::unique_ptr<OTTripleProvider<uint64_t, true>> shared_triples_0_;
-  std::unique_ptr<OTTripleProvider<uint64_t, false>> distributed_triples_1_;
-  std::unique_ptr<OTTripleProvider<uint64_t, true>> shared_triples_1_;
-};
-
-TEST_F(OTTripleProviderTest, DistributedTriples) {
-  Matrix<uint64_t> u, v, w0, w1;
-  for (int l = 1; l < 5; l++) {
-    for (int m = 1; m < 5; m++) {
-      for (int n = 1; n < 5; n++) {
-        SetUp(l, m, n);
-        std::thread thread1([this, &v, &w1] {
-          distributed_triples_1_->Precompute(1);
-          std::tie(std::ignore, v, w1) = distributed_triples_1_->GetTriple();
-        });
-        distributed_triples_0_->Precompute(1);
-        std::tie(u, std::ignore, w0) = distributed_triples_0_->GetTriple();
-        thread1.join();
+using MyTypes = ::testing::Types<ProviderAndRing<OTTripleProvider, uint16_t>,
+                                 ProviderAndRing<OTTripleProvider, uint32_t>,
+                                 ProviderAndRing<OTTripleProvider, uint64_t>>;
+INSTANTIATE_TYPED_TEST_SUITE_P(OT, TripleProviderTest, MyTypes);
 
-        EXPECT_EQ(u.rows(), l);
-        EXPECT_EQ(u.cols(), m);
-        EXPECT_EQ(v.rows(), m);
-        EXPECT_EQ(v.cols(), n);
-        EXPECT_EQ(w0.rows(), l);
-        EXPECT_EQ(w1.rows(), l);
+// Tests for background generation, which only OTTripleProvider supports.
+template <typename Param>
+class OTTripleProviderTest : public TripleProviderTest<Param> {};
+TYPED_TEST_SUITE(OTTripleProviderTest, MyTypes);
 
-        EXPECT_EQ(w0.cols(), n);
-        EXPECT_EQ(w1.cols(), n);
-        EXPECT_EQ(u * v, w0 + w1);
-      }
+TYPED_TEST(OTTripleProviderTest, BackgroundTriples) {
+  using T = typename TestFixture::T;
+  int l = 3, m = 2, n = 4, num_workers = 3, num_triples = 10;
+  this->SetUp(l, m, n, 4);
+  std::vector<Triple<T>> triples0, triples1;
+  std::thread thread1([this, &triples1, num_workers, num_triples] {
+    ASSERT_OK(this->shared_triples_1_->StartBackground(num_workers));
+    for (int i = 0; i < num_triples; i++) {
+      triples1.push_back(this->shared_triples_1_->GetTriple());
     }
+    this->shared_triples_1_->StopBackground();
+  });
+  ASSERT_OK(this->shared_triples_0_->StartBackground(num_workers));
+  for (int i = 0; i < num_triples; i++) {
+    triples0.push_back(this->shared_triples_0_->GetTriple());
+  }
+  // The workers' caps of 2, 1 and 1 add up to the cap of 4.
+  EXPECT_LE(this->shared_triples_0_->NumAvailable(), 4);
+  this->shared_triples_0_->StopBackground();
+  thread1.join();
+
+  for (int i = 0; i < num_triples; i++) {
+    Matrix<T> u0, u1, v0, v1, w0, w1;
+    std::tie(u0, v0, w0) = triples0[i];
+    std::tie(u1, v1, w1) = triples1[i];
+    EXPECT_EQ((u0 + u1) * (v0 + v1), w0 + w1);
+  }
+  // Triples generated before stopping remain available to both parties.
+  int available = this->shared_triples_0_->NumAvailable();
+  EXPECT_EQ(this->shared_triples_1_->NumAvailable(), available);
+  for (int i = 0; i < available; i++) {
+    Matrix<T> u0, u1, v0, v1, w0, w1;
+    std::tie(u0, v0, w0) = this->shared_triples_0_->GetTriple();
+    std::tie(u1, v1, w1) = this->shared_triples_1_->GetTriple();
+    EXPECT_EQ((u0 + u1) * (v0 + v1), w0 + w1);
   }
 }
 
-TEST_F(OTTripleProviderTest, SharedTriples) {
-  Matrix<uint64_t> u0, u1, v0, v1, w0, w1;
-  for (int l = 1; l < 5; l++) {
-    for (int m = 1; m < 5; m++) {
-      for (int n = 1; n < 5; n++) {
-        SetUp(l, m, n);
-        std::thread thread1([this, &u1, &v1, &w1] {
-          shared_triples_1_->Precompute(1);
-          std::tie(u1, v1, w1) = shared_triples_1_->GetTriple();
-        });
-        shared_triples_0_->Precompute(1);
-        std::tie(u0, v0, w0) = shared_triples_0_->GetTriple();
-        thread1.join();
+TYPED_TEST(OTTripleProviderTest, BackgroundCapTooSmall) {
+  this->SetUp(3, 2, 4, 2);
+  EXPECT_FALSE(this->shared_triples_0_->StartBackground(3).ok());
+}
 
-        EXPECT_EQ(u0.rows(), l);
-        EXPECT_EQ(u0.cols(), m);
-        EXPECT_EQ(v0.rows(), m);
-        EXPECT_EQ(v0.cols(), n);
-        EXPECT_EQ(u1.rows(), l);
-        EXPECT_EQ(u1.cols(), m);
-        EXPECT_EQ(v1.rows(), m);
-        EXPECT_EQ(v1.cols(), n);
-        EXPECT_EQ(w0.rows(), l);
-        EXPECT_EQ(w1.rows(), l);
-        EXPECT_EQ(w0.cols(), n);
-        EXPECT_EQ(w1.cols(), n);
-        EXPECT_EQ((u0 + u1) * (v0 + v1), w0 + w1);
-      }
+TYPED_TEST(OTTripleProviderTest, BackgroundExhausted) {
+  using T = typename TestFixture::T;
+  int l = 3, m = 2, n = 4;
+  this->SetUp(l, m, n);
+  auto run = [](OTTripleProvider<T, true> *triples) {
+    ASSERT_OK(triples->StartBackground(2));
+    triples->StopBackground();
+    for (int i = triples->NumAvailable(); i > 0; i--) {
+      triples->GetTriple();
     }
+    // All workers have exited, so there is nothing to wait for.
+    EXPECT_THROW(triples->GetTriple(), std::runtime_error);
+  };
+  std::thread thread1([this, &run] { run(this->shared_triples_1_.get()); });
+  run(this->shared_triples_0_.get());
+  thread1.join();
+}
+
+TYPED_TEST(OTTripleProviderTest, BackgroundTripleFamilies) {
+  using T = typename TestFixture::T;
+  int l = 3, m = 2, n = 4, size = 3;
+  this->SetUp(l, m, n);
+  TripleFamily<T> family0, family1;
+  std::thread thread1([this, &family1, size] {
+    ASSERT_OK(this->shared_triples_1_->StartBackground(2, size));
+    family1 = this->shared_triples_1_->GetTripleFamily(size);
+    this->shared_triples_1_->StopBackground();
+  });
+  ASSERT_OK(this->shared_triples_0_->StartBackground(2, size));
+  family0 = this->shared_triples_0_->GetTripleFamily(size);
+  this->shared_triples_0_->StopBackground();
+  thread1.join();
+
+  Matrix<T> v = std::get<1>(family0) + std::get<1>(family1);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ((std::get<0>(family0)[i] + std::get<0>(family1)[i]) * v,
+              std::get<2>(family0)[i] + std::get<2>(family1)[i]);
   }
 }
 
@@ -0,0 +1,89 @@
+// A SeededFakeTripleProvider generates the same kind of insecure triples as a
+// FakeTripleProvider, but only queues a seed per triple and expands it with an
+// AES-based PRG when the triple is requested. Expansion runs on a thread pool
+// that works a few triples ahead of the consumer, so memory stays constant per
+// queued triple and generation scales with the number of cores. Like
+// FakeTripleProvider, it should only be used for measuring the online running
+// time of protocols.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <thread>
+#include <utility>
+#include "sparse_linear_algebra/matrix_multiplication/offline/triple_provider.hpp"
+#include "sparse_linear_algebra/util/ring_queue.hpp"
+#include "sparse_linear_algebra/util/thread_pool.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+
+template <typename T, bool is_shared = false>
+class SeededFakeTripleProvider : public virtual TripleProvider<T, is_shared> {
+ public:
+  // Constructs a triple provider for multiplying an (l x m) with an (m x n)
+  // matrix. The `cap` argument allows to use a bounded queue for storing
+  // seeds. Triples are expanded on `num_threads` threads, or synchronously in
+  // GetTriple() if `num_threads` is zero.
+  SeededFakeTripleProvider(
+      int l, int m, int n, int role, int cap = -1,
+      int num_threads = std::thread::hardware_concurrency());
+
+  // Queues seeds for a number of triples. Blocks if capacity is bounded and
+  // queue is full. Both parties must call Precompute() and
+  // PrecomputeFamilies() in the same order.
+  void Precompute(int num);
+
+  // Queues seeds for a number of triple families, each consisting of `size`
+  // triples that share the same V. Blocks if capacity is bounded and queue is
+  // full.
+  void PrecomputeFamilies(int num, int size);
+
+  // Expands and returns a queued triple. Can be called concurrently with
+  // Precompute(); however, only one thread may call GetTriple() at the same
+  // time.
+  Triple<T> GetTriple() override;
+
+  // Expands and returns a triple family queued by PrecomputeFamilies(). The
+  // triples of the family are expanded in parallel. `size` must match the size
+  // passed there.
+  TripleFamily<T> GetTripleFamily(int size) override;
+
+ private:
+  // Expands the triple with the given seed.
+  Triple<T> ExpandTriple(uint64_t seed);
+
+  // Schedules expansions of queued triples until `lookahead_` are in flight or
+  // no seeds are left. Does not block.
+  void ScheduleExpansions();
+
+  // Seeds of the queued triples.
+  ring_queue<uint64_t> triple_seeds_;
+
+  // First seeds and sizes of the queued families. A family of size s uses the
+  // s + 1 seeds starting at its first seed.
+  ring_queue<std::pair<uint64_t, int>> family_seeds_;
+
+  // Next unused seed. Triples and families draw from the same sequence, so
+  // their streams never overlap.
+  uint64_t next_seed_;
+
+  // Number of triples that are expanded ahead of GetTriple().
+  size_t lookahead_;
+
+  // Triples being expanded, in the order of their seeds.
+  std::deque<std::future<Triple<T>>> pending_;
+
+  // Declared last so that running expansions finish before the other members
+  // are destroyed.
+  thread_pool pool_;
+};
+
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
+
+#include "seeded_fake_triple_provider.tpp"
@@ -0,0 +1,168 @@
+#include <vector>
+#include "boost/throw_exception.hpp"
+#include "sparse_linear_algebra/util/aes_prg.hpp"
+#include "sparse_linear_algebra/util/ring_gemm.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+
+namespace seeded_fake_internal {
+
+// The PRG key is fixed, which doesn't matter since we're generating insecure
+// triples anyway. Seeds are used as nonces.
+constexpr uint64_t kKey = 12345;
+
+// Fills `matrix` with the next elements of the stream of `prg`.
+template <typename T>
+void Randomize(aes_prg *prg, Matrix<T> *matrix) {
+  prg->random_data(matrix->data(), matrix->size() * sizeof(T));
+}
+
+}  // namespace seeded_fake_internal
+
+template <typename T, bool is_shared>
+SeededFakeTripleProvider<T, is_shared>::SeededFakeTripleProvider(
+    int l, int m, int n, int role, int cap, int num_threads)
+    : TripleProvider<T, is_shared>(l, m, n, role),
+      triple_seeds_(cap),
+      family_seeds_(cap),
+      next_seed_(0),
+      lookahead_(num_threads),
+      pool_(num_threads) {}
+
+template <typename T, bool is_shared>
+void SeededFakeTripleProvider<T, is_shared>::Precompute(int num) {
+  for (int i = 0; i < num; i++) {
+    triple_seeds_.push(next_seed_++);
+  }
+}
+
+template <typename T, bool is_shared>
+void SeededFakeTripleProvider<T, is_shared>::PrecomputeFamilies(int num,
+                                                                int size) {
+  if (size < 1) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("Family size must be positive"));
+  }
+  for (int i = 0; i < num; i++) {
+    family_seeds_.push(std::make_pair(next_seed_, size));
+    next_seed_ += size + 1;
+  }
+}
+
+template <typename T, bool is_shared>
+Triple<T> SeededFakeTripleProvider<T, is_shared>::ExpandTriple(
+    uint64_t seed) {
+  using seeded_fake_internal::Randomize;
+  int l, m, n;
+  std::tie(l, m, n) = this->dimensions();
+  int role = this->role();
+  aes_prg prg(seeded_fake_internal::kKey, seed);
+
+  // Both parties expand the same matrices; see FakeTripleProvider.
+  Matrix<T> U(l, m), U_mask = Matrix<T>::Zero(l, m);
+  Matrix<T> V(m, n), V_mask = Matrix<T>::Zero(m, n);
+  Matrix<T> Z_mask(l, n);
+  Randomize(&prg, &U);
+  Randomize(&prg, &V);
+  Randomize(&prg, &Z_mask);
+  if (is_shared) {
+    Randomize(&prg, &U_mask);
+    Randomize(&prg, &V_mask);
+  }
+
+  if (role == 0) {
+    return std::make_tuple(U - U_mask, std::move(V_mask), std::move(Z_mask));
+  } else {
+    return std::make_tuple(std::move(U_mask), V - V_mask,
+                           ring_product(U, V) - Z_mask);
+  }
+}
+
+template <typename T, bool is_shared>
+void SeededFakeTripleProvider<T, is_shared>::ScheduleExpansions() {
+  uint64_t seed;
+  while (pending_.size() < lookahead_ && triple_seeds_.try_pop(&seed)) {
+    pending_.push_back(
+        pool_.schedule([this, seed] { return ExpandTriple(seed); }));
+  }
+}
+
+template <typename T, bool is_shared>
+Triple<T> SeededFakeTripleProvider<T, is_shared>::GetTriple() {
+  ScheduleExpansions();
+  if (pending_.empty()) {
+    // Wait for a seed, or expand synchronously if there are no threads.
+    uint64_t seed = triple_seeds_.pop();
+    pending_.push_back(
+        pool_.schedule([this, seed] { return ExpandTriple(seed); }));
+  }
+  std::future<Triple<T>> triple = std::move(pending_.front());
+  pending_.pop_front();
+  // Keep the workers busy while the caller uses this triple.
+  ScheduleExpansions();
+  return triple.get();
+}
+
+template <typename T, bool is_shared>
+TripleFamily<T> SeededFakeTripleProvider<T, is_shared>::GetTripleFamily(
+    int size) {
+  using seeded_fake_internal::Randomize;
+  uint64_t seed;
+  int family_size;
+  std::tie(seed, family_size) = family_seeds_.pop();
+  if (family_size != size) {
+    BOOST_THROW_EXCEPTION(std::invalid_argument(
+        "Requested family size does not match precomputed size"));
+  }
+  int l, m, n;
+  std::tie(l, m, n) = this->dimensions();
+  int role = this->role();
+
+  aes_prg prg(seeded_fake_internal::kKey, seed);
+  Matrix<T> V(m, n), V_mask = Matrix<T>::Zero(m, n);
+  Randomize(&prg, &V);
+  if (is_shared) {
+    Randomize(&prg, &V_mask);
+  }
+
+  // Expand the triples of the family in parallel, each from its own seed.
+  std::vector<std::future<std::pair<Matrix<T>, Matrix<T>>>> members;
+  for (int j = 0; j < size; j++) {
+    members.push_back(pool_.schedule([&, j] {
+      aes_prg prg(seeded_fake_internal::kKey, seed + 1 + j);
+      Matrix<T> U(l, m), U_mask = Matrix<T>::Zero(l, m);
+      Matrix<T> Z_mask(l, n);
+      Randomize(&prg, &U);
+      Randomize(&prg, &Z_mask);
+      if (is_shared) {
+        Randomize(&prg, &U_mask);
+      }
+      if (role == 0) {
+        return std::make_pair(Matrix<T>(U - U_mask), std::move(Z_mask));
+      } else {
+        return std::make_pair(std::move(U_mask),
+                              Matrix<T>(ring_product(U, V) - Z_mask));
+      }
+    }));
+  }
+  // The members refer to V, so wait for all of them before anything can throw.
+  for (auto &member : members) {
+    member.wait();
+  }
+  std::vector<Matrix<T>> Us(size), Zs(size);
+  for (int j = 0; j < size; j++) {
+    std::tie(Us[j], Zs[j]) = members[j].get();
+  }
+
+  if (role == 0) {
+    return std::make_tuple(std::move(Us), std::move(V_mask), std::move(Zs));
+  } else {
+    return std::make_tuple(std::move(Us), V - V_mask, std::move(Zs));
+  }
+}
+
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
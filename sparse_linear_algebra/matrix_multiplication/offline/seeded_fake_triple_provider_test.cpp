@@ -0,0 +1,91 @@
+#include "sparse_linear_algebra/matrix_multiplication/offline/seeded_fake_triple_provider.hpp"
+#include "gtest/gtest.h"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+namespace {
+
+class SeededFakeTripleProviderTest
+    : public ::testing::TestWithParam<int /* num_threads */> {};
+
+TEST_P(SeededFakeTripleProviderTest, DistributedTriples) {
+  int l = 2, m = 3, n = 4, num = 5;
+  SeededFakeTripleProvider<uint64_t, false> triples1(l, m, n, 0, -1,
+                                                     GetParam());
+  SeededFakeTripleProvider<uint64_t, false> triples2(l, m, n, 1, -1,
+                                                     GetParam());
+  triples1.Precompute(num);
+  triples2.Precompute(num);
+  Matrix<uint64_t> previous_u = Matrix<uint64_t>::Zero(l, m);
+  for (int i = 0; i < num; i++) {
+    Matrix<uint64_t> u, v, w1, w2;
+    std::tie(u, std::ignore, w1) = triples1.GetTriple();
+    std::tie(std::ignore, v, w2) = triples2.GetTriple();
+    EXPECT_EQ(u.rows(), l);
+    EXPECT_EQ(u.cols(), m);
+    EXPECT_EQ(v.rows(), m);
+    EXPECT_EQ(v.cols(), n);
+    EXPECT_EQ(u * v, w1 + w2);
+    EXPECT_NE(u, previous_u);
+    previous_u = u;
+  }
+}
+
+TEST_P(SeededFakeTripleProviderTest, SharedTriples) {
+  int l = 2, m = 3, n = 4, num = 5;
+  SeededFakeTripleProvider<uint32_t, true> triples1(l, m, n, 0, -1, GetParam());
+  SeededFakeTripleProvider<uint32_t, true> triples2(l, m, n, 1, -1, GetParam());
+  triples1.Precompute(num);
+  triples2.Precompute(num);
+  for (int i = 0; i < num; i++) {
+    Matrix<uint32_t> u1, u2, v1, v2, w1, w2;
+    std::tie(u1, v1, w1) = triples1.GetTriple();
+    std::tie(u2, v2, w2) = triples2.GetTriple();
+    EXPECT_EQ((u1 + u2) * (v1 + v2), w1 + w2);
+  }
+}
+
+TEST_P(SeededFakeTripleProviderTest, SharedTripleFamilyAfterTriples) {
+  int l = 2, m = 3, n = 4, size = 3;
+  SeededFakeTripleProvider<uint64_t, true> triples1(l, m, n, 0, -1, GetParam());
+  SeededFakeTripleProvider<uint64_t, true> triples2(l, m, n, 1, -1, GetParam());
+  triples1.Precompute(2);
+  triples2.Precompute(2);
+  triples1.PrecomputeFamilies(1, size);
+  triples2.PrecomputeFamilies(1, size);
+  std::vector<Matrix<uint64_t>> u1, u2, w1, w2;
+  Matrix<uint64_t> v1, v2;
+  std::tie(u1, v1, w1) = triples1.GetTripleFamily(size);
+  std::tie(u2, v2, w2) = triples2.GetTripleFamily(size);
+  ASSERT_EQ(u1.size(), size);
+  ASSERT_EQ(w2.size(), size);
+  EXPECT_EQ(v1.rows(), m);
+  EXPECT_EQ(v1.cols(), n);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(u1[i].rows(), l);
+    EXPECT_EQ(w1[i].cols(), n);
+    EXPECT_EQ((u1[i] + u2[i]) * (v1 + v2), w1[i] + w2[i]);
+  }
+  // The queued triples are still consistent.
+  for (int i = 0; i < 2; i++) {
+    Matrix<uint64_t> u1, u2, v1, v2, w1, w2;
+    std::tie(u1, v1, w1) = triples1.GetTriple();
+    std::tie(u2, v2, w2) = triples2.GetTriple();
+    EXPECT_EQ((u1 + u2) * (v1 + v2), w1 + w2);
+  }
+}
+
+TEST_P(SeededFakeTripleProviderTest, TripleFamilySizeMismatch) {
+  SeededFakeTripleProvider<uint64_t, false> triples(2, 3, 4, 0, -1, GetParam());
+  triples.PrecomputeFamilies(1, 3);
+  EXPECT_THROW(triples.GetTripleFamily(2), std::invalid_argument);
+}
+
+INSTANTIATE_TEST_SUITE_P(NumThreads, SeededFakeTripleProviderTest,
+                         ::testing::Values(0, 1, 4));
+
+}  // namespace
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
@@ -0,0 +1,64 @@
+// A SlicingTripleProvider takes large triples from another TripleProvider and
+// serves triples of any smaller shape, so that a single provider can be used
+// for multiplications of varying sizes, e.g., the ragged last batch of a
+// training epoch.
+//
+// Fewer rows of U and columns of V are served by slicing alone, since
+// U[:l, :] * V[:, :n] = Z[:l, :n]. A smaller inner dimension m needs
+// communication: splitting U = (U1 U2) and V = (V1; V2) after m columns,
+// U1 * V1 = Z - U2 * V2, so the parties open the discarded U2 and V2, which
+// never mask any input, and subtract their product from Z.
+
+#pragma once
+
+#include <memory>
+#include "mpc_utils/comm_channel.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/triple_provider.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+
+template <typename T, bool is_shared = false>
+class SlicingTripleProvider : public virtual TripleProvider<T, is_shared> {
+ public:
+  // Serves triples sliced from those of `source`, whose dimensions and role
+  // this provider takes. `source` must outlive this provider, and triples
+  // still need to be precomputed there. `channel` is only used for reducing
+  // the inner dimension; if it is null, only the inner dimension of `source`
+  // is supported.
+  explicit SlicingTripleProvider(TripleProvider<T, is_shared> *source,
+                                 comm_channel *channel = nullptr);
+
+  // Like above, but takes ownership of `source`, whose triples must already be
+  // precomputed.
+  explicit SlicingTripleProvider(
+      std::unique_ptr<TripleProvider<T, is_shared>> source,
+      comm_channel *channel = nullptr);
+
+  // Returns a triple of the full dimensions of `source`.
+  Triple<T> GetTriple() override;
+
+  // Passes families of the full dimensions through from `source`.
+  TripleFamily<T> GetTripleFamily(int size) override;
+
+  // Supports all shapes up to the dimensions of `source`.
+  bool SupportsShape(int l, int m, int n) override;
+
+  // Slices a triple of `source` to the given shape. Both parties must request
+  // the same shapes in the same order.
+  Triple<T> GetTripleOfShape(int l, int m, int n) override;
+
+ private:
+  TripleProvider<T, is_shared> *source_;
+  comm_channel *channel_;
+
+  // Set if this provider owns `source_`.
+  std::unique_ptr<TripleProvider<T, is_shared>> owned_source_;
+};
+
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
+
+#include "slicing_triple_provider.tpp"
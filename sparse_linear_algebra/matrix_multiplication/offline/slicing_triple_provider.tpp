@@ -0,0 +1,85 @@
+#include <utility>
+#include "boost/serialization/utility.hpp"
+#include "boost/throw_exception.hpp"
+#include "mpc_utils/boost_serialization/eigen.hpp"
+#include "sparse_linear_algebra/util/ring_gemm.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+
+template <typename T, bool is_shared>
+SlicingTripleProvider<T, is_shared>::SlicingTripleProvider(
+    TripleProvider<T, is_shared> *source, comm_channel *channel)
+    : TripleProvider<T, is_shared>(std::get<0>(source->dimensions()),
+                                   std::get<1>(source->dimensions()),
+                                   std::get<2>(source->dimensions()),
+                                   source->role()),
+      source_(source),
+      channel_(channel) {}
+
+template <typename T, bool is_shared>
+SlicingTripleProvider<T, is_shared>::SlicingTripleProvider(
+    std::unique_ptr<TripleProvider<T, is_shared>> source, comm_channel *channel)
+    : SlicingTripleProvider(source.get(), channel) {
+  owned_source_ = std::move(source);
+}
+
+template <typename T, bool is_shared>
+Triple<T> SlicingTripleProvider<T, is_shared>::GetTriple() {
+  return source_->GetTriple();
+}
+
+template <typename T, bool is_shared>
+TripleFamily<T> SlicingTripleProvider<T, is_shared>::GetTripleFamily(
+    int size) {
+  return source_->GetTripleFamily(size);
+}
+
+template <typename T, bool is_shared>
+bool SlicingTripleProvider<T, is_shared>::SupportsShape(int l, int m, int n) {
+  int max_l, max_m, max_n;
+  std::tie(max_l, max_m, max_n) = this->dimensions();
+  return l >= 1 && l <= max_l && n >= 1 && n <= max_n && m >= 1 &&
+         (m == max_m || (m < max_m && channel_ != nullptr));
+}
+
+template <typename T, bool is_shared>
+Triple<T> SlicingTripleProvider<T, is_shared>::GetTripleOfShape(int l, int m,
+                                                                 int n) {
+  if (!SupportsShape(l, m, n)) {
+    BOOST_THROW_EXCEPTION(std::invalid_argument(
+        "Requested shape exceeds the dimensions of the source triples"));
+  }
+  int max_m = std::get<1>(this->dimensions());
+  Matrix<T> U, V, Z;
+  std::tie(U, V, Z) = source_->GetTriple();
+  Matrix<T> Z_slice = Z.topLeftCorner(l, n);
+  if (m < max_m) {
+    // Open U2 and V2. For distributed triples, party 0 holds U and party 1
+    // holds V, so only U2 needs to be sent.
+    Matrix<T> U2 = U.block(0, m, l, max_m - m);
+    Matrix<T> V2 = V.block(m, 0, max_m - m, n);
+    int role = this->role();
+    if (is_shared) {
+      std::pair<Matrix<T>, Matrix<T>> own(U2, V2), other;
+      channel_->send_recv(own, other);
+      U2 += other.first;
+      V2 += other.second;
+    } else if (role == 0) {
+      channel_->send(U2);
+    } else {
+      channel_->recv(U2);
+    }
+    if ((is_shared && role == 0) || (!is_shared && role == 1)) {
+      Z_slice -= ring_product(U2, V2);
+    }
+  }
+  return std::make_tuple(Matrix<T>(U.topLeftCorner(l, m)),
+                         Matrix<T>(V.topLeftCorner(m, n)),
+                         std::move(Z_slice));
+}
+
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
@@ -0,0 +1,103 @@
+#include "sparse_linear_algebra/matrix_multiplication/offline/slicing_triple_provider.hpp"
+#include <thread>
+#include "gtest/gtest.h"
+#include "mpc_utils/testing/comm_channel_test_helper.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/fake_triple_provider.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+namespace {
+
+class SlicingTripleProviderTest : public ::testing::Test {
+ protected:
+  static constexpr int kL = 5, kM = 4, kN = 3;
+
+  SlicingTripleProviderTest() : helper_(false) {}
+
+  // Gets a triple of the given shape for both parties and returns the shares
+  // of party 0 followed by those of party 1.
+  template <bool is_shared>
+  std::pair<Triple<uint64_t>, Triple<uint64_t>> GetTriples(int l, int m,
+                                                           int n) {
+    std::pair<Triple<uint64_t>, Triple<uint64_t>> triples;
+    std::thread thread1([&] {
+      FakeTripleProvider<uint64_t, is_shared> source(kL, kM, kN, 1);
+      source.Precompute(1);
+      SlicingTripleProvider<uint64_t, is_shared> sliced(&source,
+                                                        helper_.GetChannel(1));
+      triples.second = sliced.GetTripleOfShape(l, m, n);
+    });
+    FakeTripleProvider<uint64_t, is_shared> source(kL, kM, kN, 0);
+    source.Precompute(1);
+    SlicingTripleProvider<uint64_t, is_shared> sliced(&source,
+                                                      helper_.GetChannel(0));
+    triples.first = sliced.GetTripleOfShape(l, m, n);
+    thread1.join();
+    return triples;
+  }
+
+  template <bool is_shared>
+  void CheckAllShapes() {
+    for (int l = 1; l <= kL; l++) {
+      for (int m = 1; m <= kM; m++) {
+        for (int n = 1; n <= kN; n++) {
+          Matrix<uint64_t> u0, u1, v0, v1, w0, w1;
+          auto triples = GetTriples<is_shared>(l, m, n);
+          std::tie(u0, v0, w0) = triples.first;
+          std::tie(u1, v1, w1) = triples.second;
+          ASSERT_EQ(u0.rows(), l);
+          ASSERT_EQ(u0.cols(), m);
+          ASSERT_EQ(v1.rows(), m);
+          ASSERT_EQ(v1.cols(), n);
+          ASSERT_EQ(w0.rows(), l);
+          ASSERT_EQ(w1.cols(), n);
+          EXPECT_EQ((u0 + u1) * (v0 + v1), w0 + w1)
+              << "l = " << l << ", m = " << m << ", n = " << n;
+        }
+      }
+    }
+  }
+
+  mpc_utils::testing::CommChannelTestHelper helper_;
+};
+
+TEST_F(SlicingTripleProviderTest, DistributedTriples) {
+  CheckAllShapes<false>();
+}
+
+TEST_F(SlicingTripleProviderTest, SharedTriples) { CheckAllShapes<true>(); }
+
+TEST_F(SlicingTripleProviderTest, SupportedShapes) {
+  FakeTripleProvider<uint64_t, false> source(kL, kM, kN, 0);
+  SlicingTripleProvider<uint64_t, false> sliced(&source);
+  EXPECT_EQ(sliced.dimensions(), source.dimensions());
+  EXPECT_TRUE(sliced.SupportsShape(kL, kM, kN));
+  EXPECT_TRUE(sliced.SupportsShape(1, kM, 1));
+  EXPECT_FALSE(sliced.SupportsShape(kL + 1, kM, kN));
+  EXPECT_FALSE(sliced.SupportsShape(kL, kM, kN + 1));
+  EXPECT_FALSE(sliced.SupportsShape(0, kM, kN));
+  // Without a channel, the inner dimension can't be reduced.
+  EXPECT_FALSE(sliced.SupportsShape(kL, kM - 1, kN));
+  EXPECT_THROW(sliced.GetTripleOfShape(kL, kM - 1, kN),
+               std::invalid_argument);
+  // Plain providers only support their own shape.
+  EXPECT_TRUE(source.SupportsShape(kL, kM, kN));
+  EXPECT_FALSE(source.SupportsShape(kL - 1, kM, kN));
+}
+
+TEST_F(SlicingTripleProviderTest, OwnsSource) {
+  std::unique_ptr<FakeTripleProvider<uint64_t, false>> source(
+      new FakeTripleProvider<uint64_t, false>(kL, kM, kN, 0));
+  source->Precompute(1);
+  SlicingTripleProvider<uint64_t, false> sliced(std::move(source));
+  Matrix<uint64_t> u;
+  std::tie(u, std::ignore, std::ignore) = sliced.GetTripleOfShape(2, kM, 1);
+  EXPECT_EQ(u.rows(), 2);
+  EXPECT_EQ(u.cols(), kM);
+}
+
+}  // namespace
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
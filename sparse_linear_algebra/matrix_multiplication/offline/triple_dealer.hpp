@@ -0,0 +1,112 @@
+// A TripleDealer is a semi-trusted third party that generates multiplication
+// triples for two parties, which receive them through DealerTripleProvider.
+// The dealer learns all triples, so it must not collude with either party.
+//
+// To save bandwidth, the shares of party 0 and the random parts of the shares
+// of party 1 are expanded from fresh AES keys that the dealer sends along with
+// each batch of triples. Besides its key, party 1 only receives the correction
+// Z_1 = UV - Z_0 for each triple, i.e., an (l x n) matrix instead of the three
+// matrices of a full triple.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "mpc_utils/comm_channel.hpp"
+#include "mpc_utils/openssl_uniform_bit_generator.hpp"
+#include "mpc_utils/statusor.h"
+#include "sparse_linear_algebra/matrix_multiplication/offline/triple_provider.hpp"
+#include "sparse_linear_algebra/util/aes_prg.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+
+// Sent by each party to the dealer to request triples. The dealer only serves
+// a request if both parties send the same one, and it matches the dealer's
+// configuration.
+struct DealerRequest {
+  int l, m, n;
+  int element_size;
+  bool is_shared;
+  // Number of triples, or of families if `family_size` is positive. A request
+  // for zero triples ends the session.
+  int num;
+  int family_size;
+
+  bool operator==(const DealerRequest &other) const {
+    return l == other.l && m == other.m && n == other.n &&
+           element_size == other.element_size &&
+           is_shared == other.is_shared && num == other.num &&
+           family_size == other.family_size;
+  }
+
+  template <class Archive>
+  void serialize(Archive &ar, const unsigned int version) {
+    ar &l &m &n &element_size &is_shared &num &family_size;
+  }
+};
+
+template <typename T, bool is_shared = false>
+class TripleDealer {
+ public:
+  // Creates a dealer for multiplying an (l x m) with an (m x n) matrix that
+  // talks to party 0 and 1 over the respective channels.
+  TripleDealer(int l, int m, int n, comm_channel *party0,
+               comm_channel *party1);
+
+  // Serves requests until both parties end the session. Returns an error if
+  // the parties send different requests, or ones that do not match this
+  // dealer.
+  mpc_utils::Status Run();
+
+ private:
+  // Generates and sends the triples or families for `request`.
+  void Serve(const DealerRequest &request);
+
+  int l_, m_, n_;
+  comm_channel *parties_[2];
+
+  // Random number generator for the keys sent to the parties.
+  mpc_utils::OpenSSLUniformBitGenerator rng_;
+};
+
+namespace dealer_internal {
+
+// Size in bytes of the AES keys sent by the dealer.
+constexpr int kKeySize = aes_prg::block_size;
+
+// Fills `matrix` with the next elements of the stream of `prg`.
+template <typename T>
+void Randomize(aes_prg *prg, Matrix<T> *matrix) {
+  prg->random_data(matrix->data(), matrix->size() * sizeof(T));
+}
+
+// The parts of a party's shares that are expanded from its key. For party 0,
+// these are U, V and Z, where V is zero for distributed triples. For party 1,
+// these are U and V, where U is zero for distributed triples, and Z is left
+// empty for the dealer's correction.
+//
+// The i-th triple of a batch uses nonce i. The k-th family of size s uses
+// nonce k * (s + 1) for its V, and the following s nonces for its members.
+template <typename T, bool is_shared>
+Triple<T> ExpandShares(const uint8_t *key, uint64_t nonce, int role, int l,
+                       int m, int n);
+
+template <typename T, bool is_shared>
+Matrix<T> ExpandFamilyV(const uint8_t *key, uint64_t nonce, int role, int m,
+                        int n);
+
+// Returns U and (for party 0) Z of a family member.
+template <typename T, bool is_shared>
+std::pair<Matrix<T>, Matrix<T>> ExpandFamilyMember(const uint8_t *key,
+                                                   uint64_t nonce, int role,
+                                                   int l, int m, int n);
+
+}  // namespace dealer_internal
+
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
+
+#include "triple_dealer.tpp"
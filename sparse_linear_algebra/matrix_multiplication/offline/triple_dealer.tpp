@@ -0,0 +1,147 @@
+#include <cstring>
+#include "boost/serialization/vector.hpp"
+#include "mpc_utils/boost_serialization/eigen.hpp"
+#include "mpc_utils/canonical_errors.h"
+#include "sparse_linear_algebra/util/ring_gemm.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+
+namespace dealer_internal {
+
+template <typename T, bool is_shared>
+Triple<T> ExpandShares(const uint8_t *key, uint64_t nonce, int role, int l,
+                       int m, int n) {
+  aes_prg prg(key, nonce);
+  Matrix<T> U = Matrix<T>::Zero(l, m), V = Matrix<T>::Zero(m, n), Z;
+  if (role == 0 || is_shared) {
+    Randomize(&prg, &U);
+  }
+  if (role == 1 || is_shared) {
+    Randomize(&prg, &V);
+  }
+  if (role == 0) {
+    Z.resize(l, n);
+    Randomize(&prg, &Z);
+  }
+  return std::make_tuple(std::move(U), std::move(V), std::move(Z));
+}
+
+template <typename T, bool is_shared>
+Matrix<T> ExpandFamilyV(const uint8_t *key, uint64_t nonce, int role, int m,
+                        int n) {
+  Matrix<T> V = Matrix<T>::Zero(m, n);
+  if (role == 1 || is_shared) {
+    aes_prg prg(key, nonce);
+    Randomize(&prg, &V);
+  }
+  return V;
+}
+
+template <typename T, bool is_shared>
+std::pair<Matrix<T>, Matrix<T>> ExpandFamilyMember(const uint8_t *key,
+                                                   uint64_t nonce, int role,
+                                                   int l, int m, int n) {
+  aes_prg prg(key, nonce);
+  Matrix<T> U = Matrix<T>::Zero(l, m), Z;
+  if (role == 0 || is_shared) {
+    Randomize(&prg, &U);
+  }
+  if (role == 0) {
+    Z.resize(l, n);
+    Randomize(&prg, &Z);
+  }
+  return std::make_pair(std::move(U), std::move(Z));
+}
+
+}  // namespace dealer_internal
+
+template <typename T, bool is_shared>
+TripleDealer<T, is_shared>::TripleDealer(int l, int m, int n,
+                                         comm_channel *party0,
+                                         comm_channel *party1)
+    : l_(l), m_(m), n_(n), parties_{party0, party1} {}
+
+template <typename T, bool is_shared>
+mpc_utils::Status TripleDealer<T, is_shared>::Run() {
+  while (true) {
+    DealerRequest requests[2];
+    parties_[0]->recv(requests[0]);
+    parties_[1]->recv(requests[1]);
+    const DealerRequest &request = requests[0];
+    bool accepted = request == requests[1] && request.l == l_ &&
+                    request.m == m_ && request.n == n_ &&
+                    request.element_size == sizeof(T) &&
+                    request.is_shared == is_shared && request.num >= 0 &&
+                    request.family_size >= 0;
+    for (comm_channel *party : parties_) {
+      party->send(accepted);
+      party->flush();
+    }
+    if (!accepted) {
+      return mpc_utils::InvalidArgumentError(
+          "The parties' triple requests differ or do not match the dealer");
+    }
+    if (request.num == 0) {
+      return mpc_utils::OkStatus();
+    }
+    Serve(request);
+  }
+}
+
+template <typename T, bool is_shared>
+void TripleDealer<T, is_shared>::Serve(const DealerRequest &request) {
+  using dealer_internal::ExpandFamilyMember;
+  using dealer_internal::ExpandFamilyV;
+  using dealer_internal::ExpandShares;
+  using dealer_internal::kKeySize;
+  std::vector<uint8_t> keys[2];
+  for (int role = 0; role < 2; role++) {
+    keys[role].resize(kKeySize);
+    for (int i = 0; i < kKeySize; i += sizeof(uint64_t)) {
+      uint64_t random = rng_();
+      std::memcpy(&keys[role][i], &random, sizeof(random));
+    }
+    parties_[role]->send(keys[role]);
+  }
+  parties_[0]->flush();
+
+  // Only party 1 needs anything besides its key.
+  comm_channel *party1 = parties_[1];
+  if (request.family_size == 0) {
+    for (int i = 0; i < request.num; i++) {
+      Triple<T> shares[2];
+      for (int role = 0; role < 2; role++) {
+        shares[role] = ExpandShares<T, is_shared>(keys[role].data(), i, role,
+                                                  l_, m_, n_);
+      }
+      Matrix<T> U = std::get<0>(shares[0]) + std::get<0>(shares[1]);
+      Matrix<T> V = std::get<1>(shares[0]) + std::get<1>(shares[1]);
+      Matrix<T> Z1 = ring_product(U, V) - std::get<2>(shares[0]);
+      party1->send(Z1);
+    }
+  } else {
+    int size = request.family_size;
+    for (int k = 0; k < request.num; k++) {
+      uint64_t nonce = static_cast<uint64_t>(k) * (size + 1);
+      Matrix<T> V =
+          ExpandFamilyV<T, is_shared>(keys[0].data(), nonce, 0, m_, n_) +
+          ExpandFamilyV<T, is_shared>(keys[1].data(), nonce, 1, m_, n_);
+      for (int j = 0; j < size; j++) {
+        Matrix<T> U0, Z0, U1;
+        std::tie(U0, Z0) = ExpandFamilyMember<T, is_shared>(
+            keys[0].data(), nonce + 1 + j, 0, l_, m_, n_);
+        std::tie(U1, std::ignore) = ExpandFamilyMember<T, is_shared>(
+            keys[1].data(), nonce + 1 + j, 1, l_, m_, n_);
+        Matrix<T> Z1 = ring_product(Matrix<T>(U0 + U1), V) - Z0;
+        party1->send(Z1);
+      }
+    }
+  }
+  party1->flush();
+}
+
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
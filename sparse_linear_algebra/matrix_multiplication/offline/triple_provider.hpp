@@ -6,7 +6,10 @@
 
 #pragma once
 
+#include <stdexcept>
+#include <vector>
 #include "Eigen/Dense"
+#include "boost/throw_exception.hpp"
 
 namespace sparse_linear_algebra {
 namespace matrix_multiplication {
@@ -18,6 +21,13 @@ using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
 template <typename T>
 using Triple = std::tuple<Matrix<T>, Matrix<T>, Matrix<T>>;
 
+// A family of triples (U_i, V, Z_i) that share the same V. Used for
+// multiplying all chunks of a matrix with the same right-hand side, where
+// B - V only needs to be opened once.
+template <typename T>
+using TripleFamily =
+    std::tuple<std::vector<Matrix<T>>, Matrix<T>, std::vector<Matrix<T>>>;
+
 template <typename T, bool is_shared = false>
 class TripleProvider {
  public:
@@ -27,6 +37,8 @@ class TripleProvider {
   TripleProvider(int l, int m, int n, int role)
       : dimensions_(l, m, n), role_(role){};
 
+  virtual ~TripleProvider() = default;
+
   // Returns (l, m, n) passed at construction as a tuple.
   std::tuple<int, int, int> dimensions() { return dimensions_; }
 
@@ -36,6 +48,31 @@ class TripleProvider {
   // Returns a single triple.
   virtual Triple<T> GetTriple() = 0;
 
+  // Returns whether GetTripleOfShape() can return triples for multiplying an
+  // (l x m) with an (m x n) matrix. By default, only the dimensions passed at
+  // construction are supported.
+  virtual bool SupportsShape(int l, int m, int n) {
+    return std::make_tuple(l, m, n) == dimensions_;
+  }
+
+  // Returns a single triple for multiplying an (l x m) with an (m x n) matrix.
+  // Throws if the shape is not supported. By default, this is GetTriple().
+  virtual Triple<T> GetTripleOfShape(int l, int m, int n) {
+    if (!SupportsShape(l, m, n)) {
+      BOOST_THROW_EXCEPTION(std::invalid_argument(
+          "This TripleProvider does not support the requested shape"));
+    }
+    return GetTriple();
+  }
+
+  // Returns a family of `size` triples sharing the same V. V must only ever be
+  // used to mask a single right-hand side. Providers that do not support
+  // families throw.
+  virtual TripleFamily<T> GetTripleFamily(int /*size*/) {
+    BOOST_THROW_EXCEPTION(std::logic_error(
+        "This TripleProvider does not support triple families"));
+  }
+
  private:
   // The matrix dimensions passed at construction.
   std::tuple<int, int, int> dimensions_;
@@ -0,0 +1,223 @@
+// Typed tests for OT-based triple providers such as OTTripleProvider. Test
+// files instantiate TripleProviderTest with ProviderAndRing types, e.g.:
+//
+//   INSTANTIATE_TYPED_TEST_SUITE_P(
+//       OT, TripleProviderTest,
+//       ::testing::Types<ProviderAndRing<OTTripleProvider, uint64_t>>);
+
+#pragma once
+
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "mpc_utils/comm_channel.hpp"
+#include "mpc_utils/status_matchers.h"
+#include "mpc_utils/testing/comm_channel_test_helper.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/triple_provider.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+
+// Type parameter of TripleProviderTest: a provider template, which must have
+// the same Create() function as OTTripleProvider, and the ring to test it on.
+template <template <typename, bool> class ProviderTemplate, typename Ring>
+struct ProviderAndRing {
+  template <bool is_shared>
+  using Provider = ProviderTemplate<Ring, is_shared>;
+  using T = Ring;
+};
+
+template <typename Param>
+class TripleProviderTest : public ::testing::Test {
+ protected:
+  using T = typename Param::T;
+  using DistributedProvider = typename Param::template Provider<false>;
+  using SharedProvider = typename Param::template Provider<true>;
+
+  TripleProviderTest() : helper_(false) {}
+  void SetUp(int l, int m, int n, int cap = -1,
+             int64_t memory_budget = SharedProvider::kDefaultMemoryBudget) {
+    comm_channel *chan0 = helper_.GetChannel(0);
+    comm_channel *chan1 = helper_.GetChannel(1);
+    std::thread thread1([this, chan1, l, m, n, cap, memory_budget] {
+      ASSERT_OK_AND_ASSIGN(distributed_triples_1_,
+                           DistributedProvider::Create(l, m, n, 1, chan1, cap,
+                                                       memory_budget));
+      ASSERT_OK_AND_ASSIGN(
+          shared_triples_1_,
+          SharedProvider::Create(l, m, n, 1, chan1, cap, memory_budget));
+    });
+    ASSERT_OK_AND_ASSIGN(
+        distributed_triples_0_,
+        DistributedProvider::Create(l, m, n, 0, chan0, cap, memory_budget));
+    ASSERT_OK_AND_ASSIGN(
+        shared_triples_0_,
+        SharedProvider::Create(l, m, n, 0, chan0, cap, memory_budget));
+    thread1.join();
+  }
+
+  mpc_utils::testing::CommChannelTestHelper helper_;
+  std::unique_ptr<DistributedProvider> distributed_triples_0_;
+  std::unique_ptr<SharedProvider> shared_triples_0_;
+  std::unique_ptr<DistributedProvider> distributed_triples_1_;
+  std::unique_ptr<SharedProvider> shared_triples_1_;
+};
+
+TYPED_TEST_SUITE_P(TripleProviderTest);
+
+TYPED_TEST_P(TripleProviderTest, DistributedTriples) {
+  using T = typename TestFixture::T;
+  Matrix<T> u, v, w0, w1;
+  for (int l = 1; l < 5; l++) {
+    for (int m = 1; m < 5; m++) {
+      for (int n = 1; n < 5; n++) {
+        this->SetUp(l, m, n);
+        std::thread thread1([this, &v, &w1] {
+          this->distributed_triples_1_->Precompute(1);
+          std::tie(std::ignore, v, w1) =
+              this->distributed_triples_1_->GetTriple();
+        });
+        this->distributed_triples_0_->Precompute(1);
+        std::tie(u, std::ignore, w0) =
+            this->distributed_triples_0_->GetTriple();
+        thread1.join();
+
+        EXPECT_EQ(u.rows(), l);
+        EXPECT_EQ(u.cols(), m);
+        EXPECT_EQ(v.rows(), m);
+        EXPECT_EQ(v.cols(), n);
+        EXPECT_EQ(w0.rows(), l);
+        EXPECT_EQ(w1.rows(), l);
+
+        EXPECT_EQ(w0.cols(), n);
+        EXPECT_EQ(w1.cols(), n);
+        EXPECT_EQ(u * v, w0 + w1);
+      }
+    }
+  }
+}
+
+TYPED_TEST_P(TripleProviderTest, SharedTriples) {
+  using T = typename TestFixture::T;
+  Matrix<T> u0, u1, v0, v1, w0, w1;
+  for (int l = 1; l < 5; l++) {
+    for (int m = 1; m < 5; m++) {
+      for (int n = 1; n < 5; n++) {
+        this->SetUp(l, m, n);
+        std::thread thread1([this, &u1, &v1, &w1] {
+          this->shared_triples_1_->Precompute(1);
+          std::tie(u1, v1, w1) = this->shared_triples_1_->GetTriple();
+        });
+        this->shared_triples_0_->Precompute(1);
+        std::tie(u0, v0, w0) = this->shared_triples_0_->GetTriple();
+        thread1.join();
+
+        EXPECT_EQ(u0.rows(), l);
+        EXPECT_EQ(u0.cols(), m);
+        EXPECT_EQ(v0.rows(), m);
+        EXPECT_EQ(v0.cols(), n);
+        EXPECT_EQ(u1.rows(), l);
+        EXPECT_EQ(u1.cols(), m);
+        EXPECT_EQ(v1.rows(), m);
+        EXPECT_EQ(v1.cols(), n);
+        EXPECT_EQ(w0.rows(), l);
+        EXPECT_EQ(w1.rows(), l);
+        EXPECT_EQ(w0.cols(), n);
+        EXPECT_EQ(w1.cols(), n);
+        EXPECT_EQ((u0 + u1) * (v0 + v1), w0 + w1);
+      }
+    }
+  }
+}
+
+TYPED_TEST_P(TripleProviderTest, SmallMemoryBudget) {
+  using T = typename TestFixture::T;
+  int l = 5, m = 3, n = 2;
+  // Too small for any unit of COTs, so each tile holds a single one; and
+  // enough for a few units per tile, so a product runs in several tiles. The
+  // largest budget fits several packed multiplications of OTTripleProvider per
+  // tile, for both 64-bit and 32-bit lanes, and leaves the last tile partial.
+  for (int64_t memory_budget :
+       {int64_t{1}, int64_t{2 * 8 * sizeof(T) * 32},
+        int64_t{10 * 8 * sizeof(T) * 32}}) {
+    Matrix<T> u0, u1, v0, v1, w0, w1;
+    this->SetUp(l, m, n, -1, memory_budget);
+    std::thread thread1([this, &u1, &v1, &w1] {
+      this->shared_triples_1_->Precompute(1);
+      std::tie(u1, v1, w1) = this->shared_triples_1_->GetTriple();
+    });
+    this->shared_triples_0_->Precompute(1);
+    std::tie(u0, v0, w0) = this->shared_triples_0_->GetTriple();
+    thread1.join();
+    EXPECT_EQ((u0 + u1) * (v0 + v1), w0 + w1);
+  }
+}
+
+TYPED_TEST_P(TripleProviderTest, RepeatedPrecompute) {
+  using T = typename TestFixture::T;
+  int l = 3, m = 2, n = 1;
+  this->SetUp(l, m, n);
+  std::vector<Triple<T>> triples0, triples1;
+  // Later calls reuse the OT extensions set up by the first one.
+  auto run = [](typename TestFixture::SharedProvider *provider,
+                std::vector<Triple<T>> *triples) {
+    for (int num : {1, 3, 2}) {
+      provider->Precompute(num);
+      for (int i = 0; i < num; i++) {
+        triples->push_back(provider->GetTriple());
+      }
+    }
+  };
+  std::thread thread1([this, &triples1, run] {
+    run(this->shared_triples_1_.get(), &triples1);
+  });
+  run(this->shared_triples_0_.get(), &triples0);
+  thread1.join();
+
+  ASSERT_EQ(triples0.size(), 6);
+  ASSERT_EQ(triples1.size(), 6);
+  for (int i = 0; i < 6; i++) {
+    Matrix<T> u0, u1, v0, v1, w0, w1;
+    std::tie(u0, v0, w0) = triples0[i];
+    std::tie(u1, v1, w1) = triples1[i];
+    EXPECT_EQ((u0 + u1) * (v0 + v1), w0 + w1);
+  }
+}
+
+TYPED_TEST_P(TripleProviderTest, SharedTripleFamilies) {
+  using T = typename TestFixture::T;
+  int l = 3, m = 2, n = 4, size = 3;
+  this->SetUp(l, m, n);
+  std::vector<Matrix<T>> u0, u1, w0, w1;
+  Matrix<T> v0, v1;
+  std::thread thread1([this, &u1, &v1, &w1, size] {
+    this->shared_triples_1_->PrecomputeFamilies(1, size);
+    std::tie(u1, v1, w1) = this->shared_triples_1_->GetTripleFamily(size);
+  });
+  this->shared_triples_0_->PrecomputeFamilies(1, size);
+  std::tie(u0, v0, w0) = this->shared_triples_0_->GetTripleFamily(size);
+  thread1.join();
+
+  ASSERT_EQ(u0.size(), size);
+  ASSERT_EQ(u1.size(), size);
+  ASSERT_EQ(w0.size(), size);
+  ASSERT_EQ(w1.size(), size);
+  EXPECT_EQ(v0.rows(), m);
+  EXPECT_EQ(v0.cols(), n);
+  for (int i = 0; i < size; i++) {
+    EXPECT_EQ(u0[i].rows(), l);
+    EXPECT_EQ(u0[i].cols(), m);
+    EXPECT_EQ(w0[i].rows(), l);
+    EXPECT_EQ(w0[i].cols(), n);
+    EXPECT_EQ((u0[i] + u1[i]) * (v0 + v1), w0[i] + w1[i]);
+  }
+}
+
+REGISTER_TYPED_TEST_SUITE_P(TripleProviderTest, DistributedTriples,
+                            SharedTriples, SmallMemoryBudget,
+                            RepeatedPrecompute, SharedTripleFamilies);
+
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
@@ -0,0 +1,127 @@
+// A file-based store for multiplication triples, which allows generating
+// triples offline (e.g., overnight) with any TripleProvider and consuming them
+// in a later process. Each store file holds the triples of one party for one
+// shape (l, m, n), ring and triple type, and is read through a memory mapping.
+//
+// File format (version 2, native byte order): an 80-byte TripleStoreHeader,
+// followed by the triples. Each triple consists of U (l x m), V (m x n) and
+// W (l x n), stored column-major as in Matrix<T>. The header records how many
+// triples have been written and how many have been consumed; consumed triples
+// are never returned again, even after reopening the store. It also records
+// the random id and first index of the last batch of appended triples, which
+// both parties compare before using their stores, so that a party never pairs
+// its triples with those of a different or diverged store.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include "Eigen/Dense"
+#include "mpc_utils/comm_channel.hpp"
+#include "mpc_utils/statusor.h"
+#include "sparse_linear_algebra/matrix_multiplication/offline/triple_provider.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+
+struct TripleStoreHeader {
+  static constexpr char kMagic[8] = {'R', 'O', 'O', 'M', 'T', 'R', 'P', 'L'};
+  static constexpr uint32_t kVersion = 2;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t element_size;
+  int64_t l, m, n;
+  uint8_t is_shared;
+  uint8_t role;
+  uint8_t padding[6];
+  // Random id of the last append, shared by the stores of both parties.
+  uint64_t batch_id;
+  // Index of the first triple written by the last append.
+  int64_t batch_start;
+  // Number of complete triples in the file.
+  int64_t num_triples;
+  // Number of triples handed out so far. Updated before a triple is returned.
+  int64_t num_consumed;
+};
+static_assert(sizeof(TripleStoreHeader) == 80,
+              "TripleStoreHeader must keep its on-disk size");
+
+// Returns the path of the store in `directory` for this party's triples of the
+// given shape and type. Stores are indexed by all of these, so that a party
+// never consumes triples generated for a different multiplication.
+std::string TripleStorePath(const std::string &directory, int element_size,
+                            int l, int m, int n, bool is_shared, int role);
+
+// Takes `num` triples from `producer` and appends them to the matching store
+// in `directory`, creating it if necessary. `producer` can be any provider,
+// e.g., a FakeTripleProvider or an OTTripleProvider, and must be able to
+// return `num` triples (e.g., after Precompute(num)). Both parties must call
+// this with the same `num`; they agree on a batch id over `channel` and fail
+// if their stores hold different numbers of triples. Also fails if another
+// process is using the store.
+template <typename T, bool is_shared>
+mpc_utils::Status AppendToTripleStore(const std::string &directory,
+                                      TripleProvider<T, is_shared> *producer,
+                                      comm_channel *channel, int num);
+
+// A TripleProvider serving triples from a store written by
+// AppendToTripleStore(). The store stays locked while the provider exists. On
+// first use, both parties check over `channel` that their stores belong to the
+// same batch and are at the same position.
+template <typename T, bool is_shared = false>
+class MappedTripleProvider : public virtual TripleProvider<T, is_shared> {
+ public:
+  // A triple as read-only views into the mapped file.
+  using TripleView =
+      std::tuple<Eigen::Map<const Matrix<T>>, Eigen::Map<const Matrix<T>>,
+                 Eigen::Map<const Matrix<T>>>;
+
+  // Opens the store in `directory` for multiplying an (l x m) with an
+  // (m x n) matrix as party `role`. `channel` connects to the other party.
+  static mpc_utils::StatusOr<
+      std::unique_ptr<MappedTripleProvider<T, is_shared>>>
+  Open(const std::string &directory, int l, int m, int n, int role,
+       comm_channel *channel);
+
+  ~MappedTripleProvider();
+
+  // Returns the next unconsumed triple, copied from the file. Throws if the
+  // store is exhausted, or on first use if the stores of the two parties do
+  // not match.
+  Triple<T> GetTriple() override;
+
+  // Like GetTriple(), but without copying. The views stay valid while this
+  // provider exists.
+  TripleView GetTripleView();
+
+  // Returns the number of triples that have not been consumed yet.
+  int64_t NumRemaining() const;
+
+ private:
+  MappedTripleProvider(int l, int m, int n, int role, comm_channel *channel,
+                       int fd, void *mapping, size_t mapping_size);
+
+  // Compares the batch and position of both parties' stores.
+  void CheckPaired();
+
+  // Marks the next triple as consumed and returns a pointer to it.
+  const T *ConsumeNext();
+
+  comm_channel *channel_;
+  // Whether CheckPaired() has succeeded.
+  bool paired_;
+  int fd_;
+  void *mapping_;
+  size_t mapping_size_;
+  TripleStoreHeader *header_;
+};
+
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
+
+#include "triple_store.tpp"
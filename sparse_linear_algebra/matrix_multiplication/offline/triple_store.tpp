@@ -0,0 +1,301 @@
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <vector>
+#include "absl/memory/memory.h"
+#include "boost/serialization/vector.hpp"
+#include "boost/throw_exception.hpp"
+#include "mpc_utils/canonical_errors.h"
+#include "mpc_utils/openssl_uniform_bit_generator.hpp"
+#include "mpc_utils/status_macros.h"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+
+inline std::string TripleStorePath(const std::string &directory,
+                                   int element_size, int l, int m, int n,
+                                   bool is_shared, int role) {
+  std::stringstream ss;
+  ss << directory << "/triples_u" << 8 * element_size << "_" << l << "x" << m
+     << "x" << n << (is_shared ? "_shared" : "_distributed") << "_role"
+     << role << ".bin";
+  return ss.str();
+}
+
+namespace triple_store_internal {
+
+inline mpc_utils::Status ErrnoError(const std::string &what,
+                                    const std::string &path) {
+  return mpc_utils::InternalError(what + " " + path + ": " +
+                                  std::strerror(errno));
+}
+
+// Opens `path` and locks it exclusively, so that a store is only used by one
+// process at a time. Returns the file descriptor.
+inline mpc_utils::StatusOr<int> OpenLocked(const std::string &path,
+                                           int flags) {
+  int fd = open(path.c_str(), flags, 0600);
+  if (fd == -1) {
+    return ErrnoError("Failed to open", path);
+  }
+  if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+    close(fd);
+    return mpc_utils::FailedPreconditionError("Triple store " + path +
+                                              " is in use");
+  }
+  return fd;
+}
+
+// Checks that `header` describes a store for the given triples.
+inline mpc_utils::Status CheckHeader(const TripleStoreHeader &header,
+                                     uint32_t element_size, int l, int m,
+                                     int n, bool is_shared, int role) {
+  if (std::memcmp(header.magic, TripleStoreHeader::kMagic,
+                  sizeof(header.magic)) != 0) {
+    return mpc_utils::InvalidArgumentError("Not a triple store");
+  }
+  if (header.version != TripleStoreHeader::kVersion) {
+    return mpc_utils::UnimplementedError("Unsupported triple store version " +
+                                         std::to_string(header.version));
+  }
+  if (header.element_size != element_size || header.l != l ||
+      header.m != m || header.n != n || header.is_shared != is_shared ||
+      header.role != role) {
+    return mpc_utils::InvalidArgumentError(
+        "Triple store holds triples of a different type");
+  }
+  if (header.num_consumed < 0 || header.num_consumed > header.num_triples) {
+    return mpc_utils::DataLossError("Corrupted triple store header");
+  }
+  return mpc_utils::OkStatus();
+}
+
+// Number of elements of a single (l x m) x (m x n) triple.
+inline int64_t TripleElements(int64_t l, int64_t m, int64_t n) {
+  return l * m + m * n + l * n;
+}
+
+}  // namespace triple_store_internal
+
+template <typename T, bool is_shared>
+mpc_utils::Status AppendToTripleStore(const std::string &directory,
+                                      TripleProvider<T, is_shared> *producer,
+                                      comm_channel *channel, int num) {
+  namespace internal = triple_store_internal;
+  int l, m, n;
+  std::tie(l, m, n) = producer->dimensions();
+  int role = producer->role();
+  std::string path =
+      TripleStorePath(directory, sizeof(T), l, m, n, is_shared, role);
+  ASSIGN_OR_RETURN(int fd, internal::OpenLocked(path, O_RDWR | O_CREAT));
+  // Closes the file, also on errors.
+  std::unique_ptr<int, void (*)(int *)> closer(&fd,
+                                               [](int *fd) { close(*fd); });
+
+  TripleStoreHeader header;
+  ssize_t read_bytes = pread(fd, &header, sizeof(header), 0);
+  if (read_bytes == 0) {
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, TripleStoreHeader::kMagic, sizeof(header.magic));
+    header.version = TripleStoreHeader::kVersion;
+    header.element_size = sizeof(T);
+    header.l = l;
+    header.m = m;
+    header.n = n;
+    header.is_shared = is_shared;
+    header.role = role;
+  } else if (read_bytes != sizeof(header)) {
+    return mpc_utils::DataLossError("Truncated triple store header");
+  }
+  RETURN_IF_ERROR(
+      internal::CheckHeader(header, sizeof(T), l, m, n, is_shared, role));
+
+  // Party 0 draws the id of the new batch. Both stores must hold the same
+  // number of triples, so that the new ones are paired as well.
+  uint64_t batch_id;
+  if (role == 0) {
+    mpc_utils::OpenSSLUniformBitGenerator rng;
+    batch_id = std::uniform_int_distribution<uint64_t>()(rng);
+    channel->send(batch_id);
+  } else {
+    channel->recv(batch_id);
+  }
+  int64_t other_num_triples;
+  channel->send_recv(header.num_triples, other_num_triples);
+  if (other_num_triples != header.num_triples) {
+    return mpc_utils::FailedPreconditionError(
+        "Triple stores of the two parties hold different numbers of triples");
+  }
+
+  // Write the triples after the existing ones, then publish them by updating
+  // the header, so that an interrupted append leaves the store intact.
+  const int64_t triple_bytes = internal::TripleElements(l, m, n) * sizeof(T);
+  off_t offset = sizeof(header) + header.num_triples * triple_bytes;
+  std::vector<T> buffer(internal::TripleElements(l, m, n));
+  for (int i = 0; i < num; i++) {
+    Matrix<T> U, V, W;
+    std::tie(U, V, W) = producer->GetTriple();
+    std::copy_n(U.data(), U.size(), buffer.begin());
+    std::copy_n(V.data(), V.size(), buffer.begin() + U.size());
+    std::copy_n(W.data(), W.size(), buffer.begin() + U.size() + V.size());
+    const char *data = reinterpret_cast<const char *>(buffer.data());
+    for (int64_t written = 0; written < triple_bytes;) {
+      ssize_t ret = pwrite(fd, data + written, triple_bytes - written,
+                           offset + written);
+      if (ret == -1) {
+        return internal::ErrnoError("Failed to write", path);
+      }
+      written += ret;
+    }
+    offset += triple_bytes;
+  }
+  if (fsync(fd) == -1) {
+    return internal::ErrnoError("Failed to sync", path);
+  }
+  header.batch_id = batch_id;
+  header.batch_start = header.num_triples;
+  header.num_triples += num;
+  if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header) ||
+      fsync(fd) == -1) {
+    return internal::ErrnoError("Failed to update header of", path);
+  }
+  return mpc_utils::OkStatus();
+}
+
+template <typename T, bool is_shared>
+mpc_utils::StatusOr<std::unique_ptr<MappedTripleProvider<T, is_shared>>>
+MappedTripleProvider<T, is_shared>::Open(const std::string &directory, int l,
+                                         int m, int n, int role,
+                                         comm_channel *channel) {
+  namespace internal = triple_store_internal;
+  if (l < 1 || m < 1 || n < 1) {
+    return mpc_utils::InvalidArgumentError("l, m and n must be positive");
+  }
+  if (role != 0 && role != 1) {
+    return mpc_utils::InvalidArgumentError("role must be 0 or 1");
+  }
+  std::string path =
+      TripleStorePath(directory, sizeof(T), l, m, n, is_shared, role);
+  ASSIGN_OR_RETURN(int fd, internal::OpenLocked(path, O_RDWR));
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return internal::ErrnoError("Failed to stat", path);
+  }
+  size_t size = st.st_size;
+  if (size < sizeof(TripleStoreHeader)) {
+    close(fd);
+    return mpc_utils::DataLossError("Truncated triple store header");
+  }
+  void *mapping =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    close(fd);
+    return internal::ErrnoError("Failed to map", path);
+  }
+  // Takes ownership of fd and mapping.
+  auto provider = absl::WrapUnique(
+      new MappedTripleProvider(l, m, n, role, channel, fd, mapping, size));
+  const TripleStoreHeader &header = *provider->header_;
+  RETURN_IF_ERROR(
+      internal::CheckHeader(header, sizeof(T), l, m, n, is_shared, role));
+  if (sizeof(header) + header.num_triples *
+                           internal::TripleElements(l, m, n) * sizeof(T) >
+      size) {
+    return mpc_utils::DataLossError("Triple store is shorter than its header");
+  }
+  return std::move(provider);
+}
+
+template <typename T, bool is_shared>
+MappedTripleProvider<T, is_shared>::MappedTripleProvider(
+    int l, int m, int n, int role, comm_channel *channel, int fd,
+    void *mapping, size_t mapping_size)
+    : TripleProvider<T, is_shared>(l, m, n, role),
+      channel_(channel),
+      paired_(false),
+      fd_(fd),
+      mapping_(mapping),
+      mapping_size_(mapping_size),
+      header_(static_cast<TripleStoreHeader *>(mapping)) {}
+
+template <typename T, bool is_shared>
+MappedTripleProvider<T, is_shared>::~MappedTripleProvider() {
+  munmap(mapping_, mapping_size_);
+  close(fd_);  // Also releases the lock.
+}
+
+template <typename T, bool is_shared>
+void MappedTripleProvider<T, is_shared>::CheckPaired() {
+  std::vector<int64_t> own = {static_cast<int64_t>(header_->batch_id),
+                              header_->batch_start, header_->num_triples,
+                              header_->num_consumed};
+  std::vector<int64_t> other;
+  channel_->send_recv(own, other);
+  if (other != own) {
+    BOOST_THROW_EXCEPTION(std::runtime_error(
+        "Triple stores of the two parties are from different batches or at "
+        "different positions"));
+  }
+  paired_ = true;
+}
+
+template <typename T, bool is_shared>
+const T *MappedTripleProvider<T, is_shared>::ConsumeNext() {
+  if (!paired_) {
+    CheckPaired();
+  }
+  if (header_->num_consumed >= header_->num_triples) {
+    BOOST_THROW_EXCEPTION(std::out_of_range("Triple store is exhausted"));
+  }
+  int64_t index = header_->num_consumed++;
+  // Persist the consumption before handing out the triple, so that it is not
+  // reused even if this process crashes.
+  if (msync(mapping_, sizeof(TripleStoreHeader), MS_SYNC) == -1) {
+    BOOST_THROW_EXCEPTION(std::runtime_error(
+        std::string("Failed to sync triple store header: ") +
+        std::strerror(errno)));
+  }
+  int l, m, n;
+  std::tie(l, m, n) = this->dimensions();
+  const char *data = static_cast<const char *>(mapping_) +
+                     sizeof(TripleStoreHeader) +
+                     index * triple_store_internal::TripleElements(l, m, n) *
+                         sizeof(T);
+  return reinterpret_cast<const T *>(data);
+}
+
+template <typename T, bool is_shared>
+typename MappedTripleProvider<T, is_shared>::TripleView
+MappedTripleProvider<T, is_shared>::GetTripleView() {
+  int l, m, n;
+  std::tie(l, m, n) = this->dimensions();
+  const T *data = ConsumeNext();
+  return TripleView(Eigen::Map<const Matrix<T>>(data, l, m),
+                    Eigen::Map<const Matrix<T>>(data + l * m, m, n),
+                    Eigen::Map<const Matrix<T>>(data + l * m + m * n, l, n));
+}
+
+template <typename T, bool is_shared>
+Triple<T> MappedTripleProvider<T, is_shared>::GetTriple() {
+  TripleView view = GetTripleView();
+  return std::make_tuple(Matrix<T>(std::get<0>(view)),
+                         Matrix<T>(std::get<1>(view)),
+                         Matrix<T>(std::get<2>(view)));
+}
+
+template <typename T, bool is_shared>
+int64_t MappedTripleProvider<T, is_shared>::NumRemaining() const {
+  return header_->num_triples - header_->num_consumed;
+}
+
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
@@ -0,0 +1,155 @@
+#include "sparse_linear_algebra/matrix_multiplication/offline/triple_store.hpp"
+#include <cstdio>
+#include <thread>
+#include "gtest/gtest.h"
+#include "mpc_utils/status_matchers.h"
+#include "mpc_utils/testing/comm_channel_test_helper.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/fake_triple_provider.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace offline {
+namespace {
+
+using Provider = MappedTripleProvider<uint64_t, true>;
+
+class TripleStoreTest : public ::testing::Test {
+ protected:
+  static constexpr int l = 3, m = 4, n = 2;
+
+  TripleStoreTest() : helper_(false) {}
+
+  void SetUp() override {
+    directory_ = ::testing::TempDir();
+    for (int role = 0; role < 2; role++) {
+      std::remove(Path(role).c_str());
+    }
+  }
+
+  std::string Path(int role) {
+    return TripleStorePath(directory_, sizeof(uint64_t), l, m, n, true, role);
+  }
+
+  // Runs `f(role, channel)` for both parties concurrently.
+  template <typename F>
+  void RunBoth(F f) {
+    std::thread thread1([this, &f] { f(1, helper_.GetChannel(1)); });
+    f(0, helper_.GetChannel(0));
+    thread1.join();
+  }
+
+  // Generates `num` shared triples for both parties and stores them. Each
+  // producer skips its first `skip` triples, so that triples stored by
+  // different calls differ.
+  void Produce(int num, int skip = 0) {
+    RunBoth([this, num, skip](int role, comm_channel *channel) {
+      FakeTripleProvider<uint64_t, true> producer(l, m, n, role);
+      producer.Precompute(skip + num);
+      for (int i = 0; i < skip; i++) {
+        producer.GetTriple();
+      }
+      ASSERT_OK(AppendToTripleStore(directory_, &producer, channel, num));
+    });
+  }
+
+  mpc_utils::testing::CommChannelTestHelper helper_;
+  std::string directory_;
+};
+
+TEST_F(TripleStoreTest, ServesStoredTriples) {
+  Produce(2);
+  std::vector<Triple<uint64_t>> triples[2];
+  RunBoth([this, &triples](int role, comm_channel *channel) {
+    ASSERT_OK_AND_ASSIGN(auto provider,
+                         Provider::Open(directory_, l, m, n, role, channel));
+    EXPECT_EQ(provider->NumRemaining(), 2);
+    for (int i = 0; i < 2; i++) {
+      triples[role].push_back(provider->GetTriple());
+    }
+    EXPECT_THROW(provider->GetTriple(), std::out_of_range);
+  });
+  for (int i = 0; i < 2; i++) {
+    Matrix<uint64_t> u0, u1, v0, v1, w0, w1;
+    std::tie(u0, v0, w0) = triples[0][i];
+    std::tie(u1, v1, w1) = triples[1][i];
+    EXPECT_EQ(u0.rows(), l);
+    EXPECT_EQ(u0.cols(), m);
+    EXPECT_EQ(v0.rows(), m);
+    EXPECT_EQ(v0.cols(), n);
+    EXPECT_EQ((u0 + u1) * (v0 + v1), w0 + w1);
+  }
+}
+
+TEST_F(TripleStoreTest, ConsumedTriplesAreNotReused) {
+  Produce(1);
+  Matrix<uint64_t> u0, v0, w0;
+  RunBoth([&](int role, comm_channel *channel) {
+    ASSERT_OK_AND_ASSIGN(auto provider,
+                         Provider::Open(directory_, l, m, n, role, channel));
+    Triple<uint64_t> triple = provider->GetTriple();
+    if (role == 0) {
+      std::tie(u0, v0, w0) = triple;
+    }
+  });
+  // The second batch holds a different triple.
+  Produce(1, 1);
+  RunBoth([&](int role, comm_channel *channel) {
+    ASSERT_OK_AND_ASSIGN(auto provider,
+                         Provider::Open(directory_, l, m, n, role, channel));
+    EXPECT_EQ(provider->NumRemaining(), 1);
+    auto view = provider->GetTripleView();
+    if (role == 0) {
+      EXPECT_EQ(std::get<0>(view).rows(), l);
+      EXPECT_NE(std::get<0>(view), u0);
+      EXPECT_NE(std::get<1>(view), v0);
+      EXPECT_NE(std::get<2>(view), w0);
+    }
+    EXPECT_EQ(provider->NumRemaining(), 0);
+  });
+}
+
+TEST_F(TripleStoreTest, RejectsStoresOfDifferentBatches) {
+  // Party 0 keeps its store of the first batch, party 1 only has the second.
+  Produce(1);
+  std::string saved = Path(0) + ".saved";
+  ASSERT_EQ(std::rename(Path(0).c_str(), saved.c_str()), 0);
+  std::remove(Path(1).c_str());
+  Produce(1);
+  ASSERT_EQ(std::rename(saved.c_str(), Path(0).c_str()), 0);
+  RunBoth([this](int role, comm_channel *channel) {
+    ASSERT_OK_AND_ASSIGN(auto provider,
+                         Provider::Open(directory_, l, m, n, role, channel));
+    EXPECT_THROW(provider->GetTriple(), std::runtime_error);
+  });
+}
+
+TEST_F(TripleStoreTest, RejectsAppendToDivergedStores) {
+  Produce(1);
+  std::remove(Path(1).c_str());
+  RunBoth([this](int role, comm_channel *channel) {
+    FakeTripleProvider<uint64_t, true> producer(l, m, n, role);
+    producer.Precompute(1);
+    EXPECT_FALSE(AppendToTripleStore(directory_, &producer, channel, 1).ok());
+  });
+}
+
+TEST_F(TripleStoreTest, StoreIsLockedWhileOpen) {
+  Produce(1);
+  comm_channel *channel = helper_.GetChannel(0);
+  ASSERT_OK_AND_ASSIGN(auto triples,
+                       Provider::Open(directory_, l, m, n, 0, channel));
+  EXPECT_FALSE(Provider::Open(directory_, l, m, n, 0, channel).ok());
+  FakeTripleProvider<uint64_t, true> producer(l, m, n, 0);
+  producer.Precompute(1);
+  EXPECT_FALSE(AppendToTripleStore(directory_, &producer, channel, 1).ok());
+}
+
+TEST_F(TripleStoreTest, RejectsMissingStore) {
+  EXPECT_FALSE(
+      Provider::Open(directory_, l, m, n, 0, helper_.GetChannel(0)).ok());
+}
+
+}  // namespace
+}  // namespace offline
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
@@ -0,0 +1,404 @@
+#pragma once
+
+#include <sys/types.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Eigen/Dense"
+#include "boost/throw_exception.hpp"
+#include "sparse_linear_algebra/util/ring_gemm.hpp"
+
+// The protocols for multiplying a matrix A of party 0 with a matrix B of party
+// 1, see dense.hpp, rows-dense.hpp, cols-dense.hpp and cols-rows.hpp.
+enum class multiplication_protocol { dense, rows_dense, cols_dense, cols_rows };
+
+// The oblivious maps used by cols_dense and cols_rows.
+enum class oblivious_map_type { basic, poly, scs, cuckoo };
+
+inline const char* to_string(multiplication_protocol protocol) {
+  switch (protocol) {
+    case multiplication_protocol::dense:
+      return "dense";
+    case multiplication_protocol::rows_dense:
+      return "rows_dense";
+    case multiplication_protocol::cols_dense:
+      return "cols_dense";
+    case multiplication_protocol::cols_rows:
+      return "cols_rows";
+  }
+  return "unknown";
+}
+
+inline const char* to_string(oblivious_map_type map) {
+  switch (map) {
+    case oblivious_map_type::basic:
+      return "basic";
+    case oblivious_map_type::poly:
+      return "poly";
+    case oblivious_map_type::scs:
+      return "scs";
+    case oblivious_map_type::cuckoo:
+      return "cuckoo";
+  }
+  return "unknown";
+}
+
+// Shapes of A (l x m) and B (m x n), and the number of rows and columns that
+// contain nonzeros. Counts of -1 are unknown.
+struct sparsity_statistics {
+  ssize_t l = -1;
+  ssize_t m = -1;
+  ssize_t n = -1;
+  ssize_t nonzero_rows_A = -1;
+  ssize_t nonzero_cols_A = -1;
+  ssize_t nonzero_rows_B = -1;
+};
+
+// Parameters of the connection between the parties.
+struct network_parameters {
+  // Bytes per second in each direction.
+  double bandwidth = 1.25e8;
+  // Seconds per communication round.
+  double latency = 5e-4;
+};
+
+// Costs of the primitives the protocols are built from. The defaults are
+// rough figures for a single core of a current x86 machine; use
+// calibrate_cost_model() to measure the local ones.
+struct cost_model {
+  // Local ring multiply-add in a dense product.
+  double seconds_per_multiply_add = 1e-9;
+  // Garbling or evaluating a single AND gate in Obliv-C.
+  double seconds_per_and_gate = 4e-8;
+  // Garbled AND gates are sent as two ciphertexts (half gates).
+  double bytes_per_and_gate = 32;
+  // AND gates of one AES-128 block in Obliv-C's circuit.
+  double and_gates_per_aes_block = 6800;
+  // Multiplication in the 128-bit prime field of the polynomial protocols.
+  double seconds_per_field_operation = 1e-7;
+  // Computation per extended oblivious transfer.
+  double seconds_per_ot = 2e-7;
+  // Communication per extended oblivious transfer, on top of the messages.
+  double bytes_per_ot = 32;
+};
+
+struct planner_options {
+  // Size of the ring elements and of the keys of the oblivious maps.
+  size_t element_size = 8;
+  size_t key_size = 8;
+  // Statistical security of the poly and cuckoo maps.
+  int statistical_security = 40;
+  // Bytes available for the triple and masked inputs of a single chunk.
+  size_t memory_budget = size_t(1) << 30;
+  // See dense_multiplication_options.
+  bool single_round = false;
+  bool shared_v = false;
+  // Candidates to choose from, e.g. only the protocols for which triples are
+  // available.
+  std::vector<multiplication_protocol> protocols = {
+      multiplication_protocol::dense, multiplication_protocol::rows_dense,
+      multiplication_protocol::cols_dense, multiplication_protocol::cols_rows};
+  std::vector<oblivious_map_type> maps = {
+      oblivious_map_type::basic, oblivious_map_type::poly,
+      oblivious_map_type::scs, oblivious_map_type::cuckoo};
+};
+
+// The protocol, oblivious map and chunk size chosen by plan_multiplication().
+struct multiplication_plan {
+  multiplication_protocol protocol = multiplication_protocol::dense;
+  // Only meaningful for cols_dense and cols_rows.
+  oblivious_map_type map = oblivious_map_type::basic;
+  // The dense multiplication inside the protocol multiplies a (dense_rows x
+  // dense_inner) matrix with a (dense_inner x n) matrix in `num_chunks` chunks
+  // of `chunk_size` rows. Triples have dimensions (chunk_size, dense_inner, n).
+  ssize_t dense_rows = 0;
+  ssize_t dense_inner = 0;
+  ssize_t n = 0;
+  ssize_t chunk_size = 1;
+  ssize_t num_chunks = 0;
+  // Estimated running time and bytes sent by each party.
+  double seconds = 0;
+  double bytes = 0;
+
+  bool uses_map() const {
+    return protocol == multiplication_protocol::cols_dense ||
+           protocol == multiplication_protocol::cols_rows;
+  }
+
+  std::string to_string() const {
+    std::ostringstream ss;
+    ss << ::to_string(protocol);
+    if (uses_map()) {
+      ss << " with " << ::to_string(map) << " map";
+    }
+    ss << ", " << num_chunks << " chunk(s) of " << chunk_size << " x "
+       << dense_inner << " (estimated " << seconds << " s, " << bytes
+       << " bytes)";
+    return ss.str();
+  }
+
+  template <class Archive>
+  void serialize(Archive& ar, const unsigned int version) {
+    ar& protocol& map& dense_rows& dense_inner& n& chunk_size& num_chunks&
+        seconds& bytes;
+  }
+};
+
+namespace planner_internal {
+
+// log2(x), but at least 1, for the depth of sorting networks and subproduct
+// trees.
+inline double log2_at_least_1(double x) {
+  return std::max(1.0, std::log2(std::max(x, 1.0)));
+}
+
+inline double ceil_div(double a, double b) { return std::ceil(a / b); }
+
+// Costs of a protocol step, combined into seconds by total_seconds().
+struct cost {
+  double compute = 0;
+  double bytes = 0;
+  double rounds = 0;
+
+  cost& operator+=(const cost& other) {
+    compute += other.compute;
+    bytes += other.bytes;
+    rounds += other.rounds;
+    return *this;
+  }
+};
+
+inline double total_seconds(const cost& c, const network_parameters& network) {
+  return c.compute + c.bytes / network.bandwidth + c.rounds * network.latency;
+}
+
+// A garbled circuit with the given number of AND gates.
+inline cost circuit_cost(double and_gates, const cost_model& model) {
+  return {and_gates * model.seconds_per_and_gate,
+          and_gates * model.bytes_per_and_gate, 2};
+}
+
+// Largest chunk size whose triple and masked inputs fit into the memory
+// budget, balanced so that all chunks have about the same size.
+inline ssize_t choose_chunk_size(ssize_t rows, ssize_t inner, ssize_t n,
+                                 const planner_options& options) {
+  if (rows <= 0) {
+    return 1;
+  }
+  // U, E (chunk x inner) and Z (chunk x n) per chunk, V and F once
+  double budget = double(options.memory_budget) / options.element_size -
+                  2.0 * inner * n;
+  ssize_t max_chunk = std::max<double>(1, budget / (2.0 * inner + n));
+  ssize_t num_chunks = ceil_div(rows, std::min(max_chunk, rows));
+  return ceil_div(rows, num_chunks);
+}
+
+inline cost dense_cost(ssize_t rows, ssize_t inner, ssize_t n, ssize_t chunk,
+                       const cost_model& model,
+                       const planner_options& options) {
+  if (rows <= 0) {
+    return {};
+  }
+  double num_chunks = ceil_div(rows, chunk);
+  double padded_rows = num_chunks * chunk;
+  // E for every chunk, F once per triple or once per family
+  double num_F = options.shared_v ? 1 : num_chunks;
+  return {2 * padded_rows * inner * n * model.seconds_per_multiply_add,
+          options.element_size * (padded_rows * inner + num_F * inner * n),
+          options.single_round ? 1 : num_chunks};
+}
+
+// Looking up `queries` keys among `entries` key-value pairs with keys in [0,
+// domain), returning `value_size` bytes per key.
+inline cost room_cost(oblivious_map_type map, double queries, double entries,
+                      double domain, double value_size,
+                      const cost_model& model,
+                      const planner_options& options) {
+  const double block_size = 16;
+  cost c;
+  switch (map) {
+    case oblivious_map_type::basic: {
+      // the server encrypts and sends the whole domain; the client decrypts
+      // its rows in a circuit
+      double blocks = ceil_div(value_size + 1, block_size);
+      c.bytes = domain * (value_size + 1);
+      c.rounds = 1;
+      c += circuit_cost(queries * blocks * model.and_gates_per_aes_block,
+                        model);
+      break;
+    }
+    case oblivious_map_type::poly: {
+      // one polynomial of degree `entries` per block of the row, which starts
+      // with the zero bytes checked on decryption
+      double polys = ceil_div(
+          options.statistical_security / 8 + value_size, block_size);
+      double depth = log2_at_least_1(std::max(entries, queries));
+      c.compute = polys * (entries + queries) * depth * depth *
+                  model.seconds_per_field_operation;
+      c.bytes = polys * entries * block_size;
+      c.rounds = 1;
+      c += circuit_cost(queries * polys * model.and_gates_per_aes_block,
+                        model);
+      break;
+    }
+    case oblivious_map_type::scs: {
+      // merge, compare neighbours, shuffle
+      double size = entries + queries;
+      double depth = log2_at_least_1(size);
+      double key_bits = 8 * options.key_size;
+      double pair_bits = key_bits + 8 * value_size + 1;
+      double gates = size / 2 * depth * (key_bits + pair_bits) +
+                     size * (key_bits + 8 * value_size) +
+                     size * depth * pair_bits;
+      c += circuit_cost(gates, model);
+      // the valid flags are revealed separately
+      c.rounds += 2;
+      break;
+    }
+    case oblivious_map_type::cuckoo: {
+      // with the default 3 hash functions and a stash of 4 rows, the server
+      // sends 1.27 * entries + 4 rows; the circuit computes one keystream per
+      // query and checks the tags of its 7 candidate rows
+      double candidates = 3 + 4;
+      double tag = ceil_div(options.statistical_security + 3, 8);
+      double row = value_size + tag;
+      c.bytes = (1.27 * entries + 4) * row;
+      c.rounds = 1;
+      c += circuit_cost(
+          queries * (ceil_div(row, block_size) * model.and_gates_per_aes_block +
+                     candidates * 8 * row),
+          model);
+      break;
+    }
+  }
+  return c;
+}
+
+// Expanding `rows` rows of `row_size` bytes to `l` rows.
+inline cost zero_sharing_cost(double rows, double l, double row_size,
+                              const cost_model& model) {
+  if (rows <= 0) {
+    return {};
+  }
+  const double block_size = 16;
+  double depth = log2_at_least_1(l);
+  cost c;
+  c.compute = l * model.seconds_per_ot +
+              (rows + l) * depth * depth * model.seconds_per_field_operation;
+  c.bytes = l * (row_size + block_size + model.bytes_per_ot);
+  c.rounds = 2;
+  double gates = rows * (ceil_div(row_size, block_size) *
+                             model.and_gates_per_aes_block +
+                         2 * 8 * row_size);
+  c += circuit_cost(gates, model);
+  return c;
+}
+
+}  // namespace planner_internal
+
+// Estimates the cost of every candidate protocol and oblivious map for the
+// given statistics, and returns the cheapest. Unknown nonzero counts are
+// treated as fully dense. Chunk sizes are as large as the memory budget
+// allows.
+inline multiplication_plan plan_multiplication(
+    const sparsity_statistics& stats,
+    const network_parameters& network = network_parameters(),
+    const cost_model& model = cost_model(),
+    const planner_options& options = planner_options()) {
+  using namespace planner_internal;
+  if (stats.l < 0 || stats.m < 0 || stats.n < 0) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("Matrix dimensions must be known"));
+  }
+  if (options.protocols.empty()) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("At least one protocol must be allowed"));
+  }
+  const ssize_t l = stats.l, m = stats.m, n = stats.n;
+  const ssize_t rows_A = stats.nonzero_rows_A < 0 ? l : stats.nonzero_rows_A;
+  const ssize_t cols_A = stats.nonzero_cols_A < 0 ? m : stats.nonzero_cols_A;
+  const ssize_t rows_B = stats.nonzero_rows_B < 0 ? m : stats.nonzero_rows_B;
+  const double w = options.element_size;
+
+  multiplication_plan best;
+  best.seconds = std::numeric_limits<double>::infinity();
+  auto consider = [&](multiplication_protocol protocol, oblivious_map_type map,
+                      ssize_t dense_rows, ssize_t dense_inner,
+                      const cost& other) {
+    ssize_t chunk = choose_chunk_size(dense_rows, dense_inner, n, options);
+    cost c = dense_cost(dense_rows, dense_inner, n, chunk, model, options);
+    c += other;
+    double seconds = total_seconds(c, network);
+    if (seconds < best.seconds) {
+      best.protocol = protocol;
+      best.map = map;
+      best.dense_rows = dense_rows;
+      best.dense_inner = dense_inner;
+      best.n = n;
+      best.chunk_size = chunk;
+      best.num_chunks = dense_rows > 0 ? ceil_div(dense_rows, chunk) : 0;
+      best.seconds = seconds;
+      best.bytes = c.bytes;
+    }
+  };
+  for (auto protocol : options.protocols) {
+    switch (protocol) {
+      case multiplication_protocol::dense:
+        consider(protocol, oblivious_map_type::basic, l, m, {});
+        break;
+      case multiplication_protocol::rows_dense:
+        consider(protocol, oblivious_map_type::basic, rows_A, m,
+                 zero_sharing_cost(rows_A, l, n * w, model));
+        break;
+      case multiplication_protocol::cols_dense:
+        for (auto map : options.maps) {
+          consider(protocol, map, l, cols_A,
+                   room_cost(map, cols_A, m, m, n * w, model, options));
+        }
+        break;
+      case multiplication_protocol::cols_rows:
+        for (auto map : options.maps) {
+          double queries = std::min(cols_A, rows_B);
+          double entries = std::max(cols_A, rows_B);
+          // the keys are the inner indices in [0, m), see cols-rows.hpp
+          consider(protocol, map, l, cols_A + rows_B,
+                   room_cost(map, queries, entries, m, options.key_size,
+                             model, options));
+        }
+        break;
+    }
+  }
+  if (best.seconds == std::numeric_limits<double>::infinity()) {
+    BOOST_THROW_EXCEPTION(std::invalid_argument(
+        "No oblivious map allowed for the sparse protocols"));
+  }
+  return best;
+}
+
+// Measures the local costs of `model` on this machine, using products of ring
+// elements of type T. The costs of garbled circuits, OT and field operations
+// are kept.
+template <typename T = uint64_t>
+cost_model calibrate_cost_model(cost_model model = cost_model(),
+                                int size = 256) {
+  using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+  Matrix A = Matrix::Constant(size, size, 3);
+  Matrix B = Matrix::Constant(size, size, 5);
+  Matrix C = Matrix::Zero(size, size);
+  ring_gemm(A, B, C);  // warm up
+  auto start = std::chrono::steady_clock::now();
+  const int repetitions = 3;
+  for (int i = 0; i < repetitions; i++) {
+    ring_gemm(A, B, C);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  model.seconds_per_multiply_add =
+      elapsed.count() / (double(repetitions) * size * size * size);
+  return model;
+}
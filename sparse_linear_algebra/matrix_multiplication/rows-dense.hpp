@@ -8,55 +8,71 @@
 #include "sparse_linear_algebra/util/time.h"
 #include "sparse_linear_algebra/zero_sharing/zero_sharing.hpp"
 
+// Writes this party's share of the product to `result`. A `workspace` reused
+// across calls avoids reallocating the intermediate dense matrices and index
+// lists.
 template <typename Derived_A, typename Derived_B,
           typename T = typename Derived_A::Scalar>
-Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
-matrix_multiplication_rows_dense(
+void matrix_multiplication_rows_dense(
     const Eigen::SparseMatrixBase<Derived_A>& A_in,
     const Eigen::MatrixBase<Derived_B>& B_in, comm_channel& channel, int role,
     sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
         T, false>& triples,
-    ssize_t chunk_size_in = -1,
+    matrix_output<T> result, ssize_t chunk_size_in = -1,
     ssize_t k_A = -1,  // saves a communication round if set
-    mpc_utils::Benchmarker* benchmarker = nullptr) {
+    mpc_utils::Benchmarker* benchmarker = nullptr,
+    const dense_multiplication_options& options =
+        dense_multiplication_options(),
+    multiplication_workspace<T>* workspace = nullptr) {
   static_assert(std::is_same<typename Derived_A::Scalar, T>::value &&
                     std::is_same<typename Derived_B::Scalar, T>::value,
                 "Both matrix arguments must have the same scalar type");
   try {
-    std::vector<size_t> inner_indices;
-    Eigen::SparseMatrix<T, Eigen::ColMajor> A;
-    auto& B = B_in.derived();
-    Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
-        ret, ret_dense;
+    if (result.rows() != A_in.rows() || result.cols() != B_in.cols()) {
+      BOOST_THROW_EXCEPTION(
+          std::invalid_argument("Output size does not match matrix sizes"));
+    }
+    multiplication_workspace<T> local_workspace;
+    if (workspace == nullptr) {
+      workspace = &local_workspace;
+    }
+    // k_A is either unset (-1) or a number of rows of A
+    auto check_k_A = [&] {
+      if (k_A < 0 || k_A > A_in.rows()) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+            "k_A must be between 0 and the number of rows of A"));
+      }
+    };
+    if (k_A != -1) {
+      check_k_A();
+    }
+    const auto& A = A_in.derived();
+    const auto& B = B_in.derived();
+    auto& inner_indices = workspace->inner_indices;
+    auto& inner_positions = workspace->inner_positions;
+    auto& ret_dense = workspace->dense_result;
     // compute own indices and exchange k values if not given as arguments
     if (role == 0) {
-      A = A_in.derived();
-      auto inner_indices_set = ComputeInnerIndices(&A);
+      ComputeNonzeroIndices(A, false, &inner_indices, &inner_positions);
       if (k_A == -1) {
-        k_A = inner_indices_set.size();
+        k_A = inner_indices.size();
         channel.send(k_A);
         channel.flush();
+      } else if (inner_indices.size() > static_cast<size_t>(k_A)) {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+            "k_A is smaller than the number of nonzero rows of A"));
       } else {
-        // Extend inner_indices_set to contain exactly k_A elements.
-        for (int i = 0; static_cast<int>(inner_indices_set.size()) < k_A; i++) {
-          inner_indices_set.insert(i);
-        }
-      }
-      inner_indices.resize(k_A);
-      std::copy_n(inner_indices_set.begin(), k_A, inner_indices.begin());
-    } else {
-      if (k_A == -1) {
-        channel.recv(k_A);
+        PadNonzeroIndices(k_A, &inner_indices, &inner_positions);
       }
-      A.resize(k_A, A_in.cols());
-      A.setZero();
+    } else if (k_A == -1) {
+      channel.recv(k_A);
+      check_k_A();
     }
 
     // No nonzeros? Return early.
     if (k_A == 0) {
-      return Eigen::Matrix<T, Derived_A::RowsAtCompileTime,
-                           Derived_B::ColsAtCompileTime>::Zero(A_in.rows(),
-                                                               B_in.cols());
+      result.setZero();
+      return;
     }
 
     mpc_utils::Benchmarker::time_point start;
@@ -65,14 +81,13 @@ matrix_multiplication_rows_dense(
     }
 
     // extract nonzero rows
-    Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_A::ColsAtCompileTime>
-        A_dense;
+    auto& A_dense = workspace->dense_A;
     if (role == 0) {
-      Eigen::SparseMatrix<T, Eigen::RowMajor> A_rows = A;
-      A_dense.resize(k_A, A.cols());
-      A_dense.setZero();
-      for (size_t i = 0; i < k_A; i++) {
-        A_dense.row(i) = A_rows.row(inner_indices[i]);
+      A_dense.setZero(k_A, A.cols());
+      for (Eigen::Index outer = 0; outer < A.outerSize(); outer++) {
+        for (typename Derived_A::InnerIterator it(A, outer); it; ++it) {
+          A_dense(inner_positions[it.row()], it.col()) = it.value();
+        }
       }
     }
 
@@ -82,12 +97,15 @@ matrix_multiplication_rows_dense(
     }
 
     // dense multiplication
+    ret_dense.resize(k_A, B.cols());
     if (role == 0) {
-      ret_dense = matrix_multiplication_dense(A_dense, B, channel, role,
-                                              triples, chunk_size_in);
+      matrix_multiplication_dense(A_dense, B, channel, role, triples,
+                                  ret_dense, chunk_size_in, options, workspace);
     } else {
-      ret_dense = matrix_multiplication_dense(A, B, channel, role, triples,
-                                              chunk_size_in);
+      // only the shape of our (zero) share of A is used
+      matrix_multiplication_dense(
+          dense_internal::Matrix<T>::Zero(k_A, A.cols()), B, channel, role,
+          triples, ret_dense, chunk_size_in, options, workspace);
     }
 
     if (benchmarker != nullptr) {
@@ -95,25 +113,14 @@ matrix_multiplication_rows_dense(
       start = benchmarker->StartTimer();
     }
 
-    // use zero-sharing protocol to share the result back to dimension A.rows()
-    ret.resize(A_in.rows(), B_in.cols());
-    ret.setZero();
-    for (size_t col = 0; col < B_in.cols(); col++) {
-      std::vector<T> current_col_dense(ret_dense.rows());
-      std::vector<T> current_col;
-      for (size_t row = 0; row < ret_dense.rows(); row++) {
-        current_col_dense[row] = ret_dense(row, col);
-      }
-      if (role == 0) {
-        current_col = zero_sharing_server(current_col_dense, inner_indices,
-                                          A_in.rows(), channel, benchmarker);
-      } else {
-        current_col = zero_sharing_client(current_col_dense, A_in.rows(),
-                                          channel, benchmarker);
-      }
-      for (size_t row = 0; row < ret.rows(); row++) {
-        ret(row, col) = current_col[row];
-      }
+    // use zero-sharing protocol to share the result back to dimension
+    // A.rows(); all columns are expanded at once
+    if (role == 0) {
+      zero_sharing_server(ret_dense, inner_indices, A_in.rows(), channel,
+                          result, benchmarker);
+    } else {
+      zero_sharing_client(ret_dense, A_in.rows(), channel, result,
+                          benchmarker);
     }
 
     if (benchmarker != nullptr) {
@@ -121,8 +128,6 @@ matrix_multiplication_rows_dense(
       start = benchmarker->StartTimer();
     }
 
-    return ret;
-
   } catch (boost::exception& e) {
     e << error_a_size1(A_in.rows()) << error_a_size2(A_in.cols())
       << error_b_size1(B_in.rows()) << error_b_size2(B_in.cols());
@@ -130,3 +135,53 @@ matrix_multiplication_rows_dense(
     throw;
   }
 }
+
+template <typename Derived_A, typename Derived_B,
+          typename T = typename Derived_A::Scalar>
+Eigen::Matrix<T, Derived_A::RowsAtCompileTime, Derived_B::ColsAtCompileTime>
+matrix_multiplication_rows_dense(
+    const Eigen::SparseMatrixBase<Derived_A>& A_in,
+    const Eigen::MatrixBase<Derived_B>& B_in, comm_channel& channel, int role,
+    sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
+        T, false>& triples,
+    ssize_t chunk_size_in = -1,
+    ssize_t k_A = -1,  // saves a communication round if set
+    mpc_utils::Benchmarker* benchmarker = nullptr,
+    const dense_multiplication_options& options =
+        dense_multiplication_options(),
+    multiplication_workspace<T>* workspace = nullptr) {
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> ret(A_in.rows(),
+                                                       B_in.cols());
+  matrix_multiplication_rows_dense(A_in, B_in, channel, role, triples, ret,
+                                   chunk_size_in, k_A, benchmarker, options,
+                                   workspace);
+  return ret;
+}
+
+// Asynchronous version of matrix_multiplication_rows_dense on its own channel
+// session; see run_on_session(). The inputs are copied; `triples` must stay
+// alive until the returned future is ready, and must not be used by any other
+// multiplication meanwhile.
+template <typename Derived_A, typename Derived_B,
+          typename T = typename Derived_A::Scalar>
+std::future<Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>
+matrix_multiplication_rows_dense_async(
+    const Eigen::SparseMatrixBase<Derived_A>& A_in,
+    const Eigen::MatrixBase<Derived_B>& B_in, comm_channel& channel, int role,
+    sparse_linear_algebra::matrix_multiplication::offline::TripleProvider<
+        T, false>& triples,
+    ssize_t chunk_size_in = -1,
+    ssize_t k_A = -1,  // saves a communication round if set
+    const dense_multiplication_options& options =
+        dense_multiplication_options()) {
+  Eigen::SparseMatrix<T, Eigen::ColMajor> A = A_in.derived();
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> B = B_in.derived();
+  return run_on_session(channel, [A, B, role, &triples, chunk_size_in, k_A,
+                                  options](comm_channel& session) {
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> result(A.rows(),
+                                                            B.cols());
+    matrix_multiplication_rows_dense(A, B, session, role, triples, result,
+                                     chunk_size_in, k_A, nullptr, options);
+    return result;
+  });
+}
@@ -81,6 +81,80 @@ TYPED_TEST(RowsDenseTest, TestZero) {
   EXPECT_EQ(this->Multiply(A, B), result);
 }
 
+TYPED_TEST(RowsDenseTest, TestMultipleColumns) {
+  const int l = 5, m = 3, n = 3;
+  Eigen::SparseMatrix<TypeParam> A(l, m);
+  Eigen::Matrix<TypeParam, m, n> B;
+  Eigen::Matrix<TypeParam, l, n> result;
+  A.insert(1, 0) = 2;
+  A.insert(3, 2) = 3;
+  A.insert(4, 1) = 1;
+  B << 1, 2, 3,  //
+      4, 5, 6,   //
+      7, 8, 9;
+  result << 0, 0, 0,  //
+      2, 4, 6,        //
+      0, 0, 0,        //
+      21, 24, 27,     //
+      4, 5, 6;
+  EXPECT_EQ(this->Multiply(A, B), result);
+}
+
+TYPED_TEST(RowsDenseTest, ReusesWorkspace) {
+  using Matrix = Eigen::Matrix<TypeParam, Eigen::Dynamic, Eigen::Dynamic>;
+  const int l = 6, m = 4, n = 2, k_A = 3, num_runs = 3;
+  Matrix B(m, n);
+  B << 1, 2,  //
+      3, 4,   //
+      5, 6,   //
+      7, 8;
+  // Different nonzero rows in each run, but always k_A of them.
+  std::vector<Eigen::SparseMatrix<TypeParam>> A;
+  for (int i = 0; i < num_runs; i++) {
+    A.emplace_back(l, m);
+    A[i].insert(i, 0) = 1;
+    A[i].insert(i + 1, 1) = 2;
+    A[i].insert(i + 3, i) = 3;
+  }
+  // Each party checks that the workspace buffers it uses keep their storage
+  // after the first run.
+  auto run = [&](int role, std::vector<Matrix>* results) {
+    mpc_utils::comm_channel* channel = this->helper_.GetChannel(role);
+    offline::FakeTripleProvider<TypeParam, false> triples(k_A, m, n, role);
+    triples.Precompute(num_runs);
+    multiplication_workspace<TypeParam> workspace;
+    Eigen::SparseMatrix<TypeParam> A_zero(l, m);
+    std::vector<const void*> buffers;
+    for (int i = 0; i < num_runs; i++) {
+      Matrix result(l, n);
+      matrix_multiplication_rows_dense(
+          role == 0 ? A[i] : A_zero, role == 1 ? B : Matrix::Zero(m, n),
+          *channel, role, triples, result, -1, k_A, nullptr,
+          dense_multiplication_options(), &workspace);
+      results->push_back(result);
+      std::vector<const void*> current = {workspace.dense_result.data()};
+      if (role == 0) {
+        current.push_back(workspace.dense_A.data());
+        current.push_back(workspace.inner_indices.data());
+        current.push_back(workspace.inner_positions.data());
+      }
+      if (i == 0) {
+        buffers = current;
+      } else {
+        EXPECT_EQ(current, buffers) << "role " << role << ", run " << i;
+      }
+    }
+    channel->flush();
+  };
+  std::vector<Matrix> results_0, results_1;
+  std::thread thread1([&] { run(1, &results_1); });
+  run(0, &results_0);
+  thread1.join();
+  for (int i = 0; i < num_runs; i++) {
+    EXPECT_EQ(results_0[i] + results_1[i], Matrix(A[i]) * B);
+  }
+}
+
 }  // namespace
 }  // namespace matrix_multiplication
 }  // namespace sparse_linear_algebra
\ No newline at end of file
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include "Eigen/Sparse"
+#include "sparse_common.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/cols-dense.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/cols-rows.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/dense.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/planner.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/rows-dense.hpp"
+#include "sparse_linear_algebra/oblivious_map/basic_oblivious_map.hpp"
+#include "sparse_linear_algebra/oblivious_map/cuckoo_oblivious_map.hpp"
+#include "sparse_linear_algebra/oblivious_map/poly_oblivious_map.hpp"
+#include "sparse_linear_algebra/oblivious_map/sorting_oblivious_map.hpp"
+
+struct secure_multiply_options {
+  // Public bounds on the nonzero rows and columns of A and B. Counts left at
+  // -1 are computed by their owner and sent to the other party in the clear,
+  // which reveals them in addition to what the chosen protocol reveals. Both
+  // parties must pass the same bounds.
+  sparsity_statistics bounds;
+  // Used by party 0 for choosing the plan, which is then sent to party 1.
+  network_parameters network;
+  cost_model model;
+  planner_options planner;
+  // Passed to the dense multiplication. single_round and shared_v override the
+  // ones in `planner`.
+  dense_multiplication_options dense;
+};
+
+// Creates an oblivious map of the given type.
+template <typename K, typename V>
+std::unique_ptr<oblivious_map<K, V>> make_oblivious_map(
+    oblivious_map_type type, comm_channel& channel,
+    int statistical_security = 40) {
+  switch (type) {
+    case oblivious_map_type::basic:
+      return std::unique_ptr<oblivious_map<K, V>>(
+          new basic_oblivious_map<K, V>(channel));
+    case oblivious_map_type::poly:
+      return std::unique_ptr<oblivious_map<K, V>>(
+          new poly_oblivious_map<K, V>(channel, statistical_security));
+    case oblivious_map_type::scs:
+      return std::unique_ptr<oblivious_map<K, V>>(
+          new sorting_oblivious_map<K, V>(channel));
+    case oblivious_map_type::cuckoo:
+      return std::unique_ptr<oblivious_map<K, V>>(
+          new cuckoo_oblivious_map<K, V>(channel, statistical_security));
+  }
+  BOOST_THROW_EXCEPTION(std::invalid_argument("Unknown oblivious map type"));
+}
+
+// Fills in the dimensions of A and B and the nonzero counts missing from
+// `bounds`. Party 0 counts the nonzero rows and columns of A, party 1 the
+// nonzero rows of B, and each sends the counts the other party is missing.
+template <typename Derived_A, typename Derived_B>
+sparsity_statistics exchange_sparsity_statistics(
+    const Eigen::SparseMatrixBase<Derived_A>& A_in,
+    const Eigen::SparseMatrixBase<Derived_B>& B_in, comm_channel& channel,
+    int role, sparsity_statistics bounds = sparsity_statistics()) {
+  using T = typename Derived_A::Scalar;
+  sparsity_statistics stats = bounds;
+  stats.l = A_in.rows();
+  stats.m = A_in.cols();
+  stats.n = B_in.cols();
+  auto check_bound = [](ssize_t bound, size_t count, ssize_t dimension) {
+    if (bound != -1 &&
+        (static_cast<size_t>(bound) < count || bound > dimension)) {
+      BOOST_THROW_EXCEPTION(std::invalid_argument(
+          "Bounds must be between the nonzero count and the dimension"));
+    }
+  };
+  if (role == 0) {
+    Eigen::SparseMatrix<T, Eigen::RowMajor> A_rows = A_in.derived();
+    Eigen::SparseMatrix<T, Eigen::ColMajor> A_cols = A_in.derived();
+    size_t rows = ComputeInnerIndices(&A_cols).size();
+    size_t cols = ComputeInnerIndices(&A_rows).size();
+    check_bound(bounds.nonzero_rows_A, rows, stats.l);
+    check_bound(bounds.nonzero_cols_A, cols, stats.m);
+    if (bounds.nonzero_rows_A == -1) {
+      stats.nonzero_rows_A = rows;
+      channel.send(stats.nonzero_rows_A);
+    }
+    if (bounds.nonzero_cols_A == -1) {
+      stats.nonzero_cols_A = cols;
+      channel.send(stats.nonzero_cols_A);
+    }
+    channel.flush();
+    if (bounds.nonzero_rows_B == -1) {
+      channel.recv(stats.nonzero_rows_B);
+    }
+  } else {
+    if (bounds.nonzero_rows_A == -1) {
+      channel.recv(stats.nonzero_rows_A);
+    }
+    if (bounds.nonzero_cols_A == -1) {
+      channel.recv(stats.nonzero_cols_A);
+    }
+    Eigen::SparseMatrix<T, Eigen::ColMajor> B = B_in.derived();
+    size_t rows = ComputeInnerIndices(&B).size();
+    check_bound(bounds.nonzero_rows_B, rows, stats.m);
+    if (bounds.nonzero_rows_B == -1) {
+      stats.nonzero_rows_B = rows;
+      channel.send(stats.nonzero_rows_B);
+      channel.flush();
+    }
+  }
+  return stats;
+}
+
+// Multiplies A (held by party 0) with B (held by party 1) using whichever of
+// the dense and sparse protocols and oblivious maps is estimated to be the
+// cheapest, and writes this party's share of the product to `result`. Returns
+// the plan that was executed.
+//
+// Triples are created once the plan is known by calling
+//   make_triples(plan, std::integral_constant<bool, is_shared>())
+// which must return a std::unique_ptr<TripleProvider<T, is_shared>> for
+// dimensions (plan.chunk_size, plan.dense_inner, plan.n) that holds
+// plan.num_chunks triples, or a single family of that size if
+// options.dense.shared_v is set. cols_dense uses shared triples, all other
+// protocols use non-shared ones. Keys of the oblivious maps have type K.
+template <
+    typename K = size_t, typename Derived_A, typename Derived_B,
+    typename TripleFactory, typename T = typename Derived_A::Scalar,
+    typename std::enable_if<std::is_same<T, typename Derived_B::Scalar>::value,
+                            int>::type = 0>
+multiplication_plan secure_multiply(
+    const Eigen::SparseMatrixBase<Derived_A>& A_in,
+    const Eigen::SparseMatrixBase<Derived_B>& B_in, comm_channel& channel,
+    int role, TripleFactory&& make_triples, matrix_output<T> result,
+    const secure_multiply_options& options = secure_multiply_options(),
+    mpc_utils::Benchmarker* benchmarker = nullptr,
+    multiplication_workspace<T>* workspace = nullptr) {
+  using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+  sparsity_statistics stats =
+      exchange_sparsity_statistics(A_in, B_in, channel, role, options.bounds);
+
+  // party 0 plans, so that both parties agree even if their cost models differ
+  multiplication_plan plan;
+  if (role == 0) {
+    planner_options planner = options.planner;
+    planner.element_size = sizeof(T);
+    planner.key_size = sizeof(K);
+    planner.single_round = options.dense.single_round;
+    planner.shared_v = options.dense.shared_v;
+    plan = plan_multiplication(stats, options.network, options.model, planner);
+    channel.send(plan);
+    channel.flush();
+  } else {
+    channel.recv(plan);
+  }
+
+  const int statistical_security = options.planner.statistical_security;
+  switch (plan.protocol) {
+    case multiplication_protocol::dense: {
+      auto triples = make_triples(plan, std::false_type());
+      matrix_multiplication_dense(
+          Matrix(A_in.derived()), Matrix(B_in.derived()), channel, role,
+          *triples, result, plan.chunk_size, options.dense, workspace);
+      break;
+    }
+    case multiplication_protocol::rows_dense: {
+      auto triples = make_triples(plan, std::false_type());
+      matrix_multiplication_rows_dense(
+          A_in, Matrix(B_in.derived()), channel, role, *triples, result,
+          plan.chunk_size, stats.nonzero_rows_A, benchmarker, options.dense,
+          workspace);
+      break;
+    }
+    case multiplication_protocol::cols_dense: {
+      auto triples = make_triples(plan, std::true_type());
+      auto map =
+          make_oblivious_map<K, T>(plan.map, channel, statistical_security);
+      matrix_multiplication_cols_dense(
+          A_in, Matrix(B_in.derived()), *map, channel, role, *triples, result,
+          plan.chunk_size, stats.nonzero_cols_A, benchmarker, options.dense,
+          workspace);
+      break;
+    }
+    case multiplication_protocol::cols_rows: {
+      auto triples = make_triples(plan, std::false_type());
+      auto map =
+          make_oblivious_map<K, K>(plan.map, channel, statistical_security);
+      matrix_multiplication_cols_rows(
+          A_in, B_in, *map, channel, role, *triples, result, plan.chunk_size,
+          stats.nonzero_cols_A, stats.nonzero_rows_B, benchmarker,
+          options.dense, workspace);
+      break;
+    }
+  }
+  return plan;
+}
+
+template <
+    typename K = size_t, typename Derived_A, typename Derived_B,
+    typename TripleFactory, typename T = typename Derived_A::Scalar,
+    typename std::enable_if<std::is_same<T, typename Derived_B::Scalar>::value,
+                            int>::type = 0>
+Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> secure_multiply(
+    const Eigen::SparseMatrixBase<Derived_A>& A_in,
+    const Eigen::SparseMatrixBase<Derived_B>& B_in, comm_channel& channel,
+    int role, TripleFactory&& make_triples,
+    const secure_multiply_options& options = secure_multiply_options(),
+    mpc_utils::Benchmarker* benchmarker = nullptr,
+    multiplication_plan* plan = nullptr) {
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> ret(A_in.rows(),
+                                                       B_in.cols());
+  multiplication_plan executed =
+      secure_multiply<K>(A_in, B_in, channel, role,
+                         std::forward<TripleFactory>(make_triples), ret,
+                         options, benchmarker);
+  if (plan != nullptr) {
+    *plan = executed;
+  }
+  return ret;
+}
@@ -0,0 +1,199 @@
+#include "sparse_linear_algebra/matrix_multiplication/secure_multiply.hpp"
+#include <thread>
+#include "gtest/gtest.h"
+#include "mpc_utils/testing/comm_channel_test_helper.hpp"
+#include "sparse_linear_algebra/matrix_multiplication/offline/fake_triple_provider.hpp"
+#include "sparse_linear_algebra/util/randomize_matrix.hpp"
+
+namespace sparse_linear_algebra {
+namespace matrix_multiplication {
+namespace {
+
+TEST(PlannerTest, DenseMatricesUseDenseProtocol) {
+  sparsity_statistics stats;
+  stats.l = 100;
+  stats.m = 100;
+  stats.n = 10;
+  multiplication_plan plan = plan_multiplication(stats);
+  EXPECT_EQ(plan.protocol, multiplication_protocol::dense);
+  EXPECT_EQ(plan.dense_rows, 100);
+  EXPECT_EQ(plan.dense_inner, 100);
+  EXPECT_EQ(plan.num_chunks, 1);
+}
+
+TEST(PlannerTest, FewNonzeroColumnsUseSparseProtocol) {
+  sparsity_statistics stats;
+  stats.l = 1000;
+  stats.m = 150000;
+  stats.n = 1;
+  stats.nonzero_rows_A = 1000;
+  stats.nonzero_cols_A = 100;
+  stats.nonzero_rows_B = 50;
+  multiplication_plan plan = plan_multiplication(stats);
+  EXPECT_TRUE(plan.uses_map());
+  EXPECT_LE(plan.dense_inner, 150);
+}
+
+TEST(PlannerTest, FewNonzeroRowsUseRowsDense) {
+  sparsity_statistics stats;
+  stats.l = 100000;
+  stats.m = 1000;
+  stats.n = 1;
+  stats.nonzero_rows_A = 10;
+  multiplication_plan plan = plan_multiplication(stats);
+  EXPECT_EQ(plan.protocol, multiplication_protocol::rows_dense);
+  EXPECT_EQ(plan.dense_rows, 10);
+}
+
+TEST(PlannerTest, ColsRowsAccountsForWholeKeyDomain) {
+  // The basic map sends a row for every inner index of the m columns, not just
+  // for the k_A + k_B nonzero ones.
+  sparsity_statistics stats;
+  stats.l = 1000;
+  stats.n = 1;
+  stats.nonzero_rows_A = 1000;
+  stats.nonzero_cols_A = 6990;
+  stats.nonzero_rows_B = 10;
+  planner_options options;
+  options.protocols = {multiplication_protocol::cols_rows};
+  stats.m = 7000;
+  multiplication_plan plan = plan_multiplication(stats, network_parameters(),
+                                                 cost_model(), options);
+  EXPECT_EQ(plan.map, oblivious_map_type::basic);
+  stats.m = 1067089;
+  plan = plan_multiplication(stats, network_parameters(), cost_model(),
+                             options);
+  EXPECT_NE(plan.map, oblivious_map_type::basic);
+}
+
+TEST(PlannerTest, ChunksFitMemoryBudget) {
+  sparsity_statistics stats;
+  stats.l = 1000;
+  stats.m = 100;
+  stats.n = 1;
+  planner_options options;
+  options.protocols = {multiplication_protocol::dense};
+  options.memory_budget = 8 * (2 * 100 * 1 + 250 * (2 * 100 + 1));
+  multiplication_plan plan = plan_multiplication(
+      stats, network_parameters(), cost_model(), options);
+  EXPECT_EQ(plan.chunk_size, 250);
+  EXPECT_EQ(plan.num_chunks, 4);
+}
+
+TEST(PlannerTest, NoCandidatesThrows) {
+  sparsity_statistics stats;
+  stats.l = stats.m = stats.n = 1;
+  planner_options options;
+  options.protocols = {multiplication_protocol::cols_dense};
+  options.maps.clear();
+  EXPECT_THROW(plan_multiplication(stats, network_parameters(), cost_model(),
+                                   options),
+               std::invalid_argument);
+}
+
+TEST(SecureMultiplyTest, DenseProtocol) {
+  using T = uint64_t;
+  using Matrix = offline::Matrix<T>;
+  mpc_utils::testing::CommChannelTestHelper helper(false);
+  std::mt19937 rng(12345);
+  const int l = 10, m = 7, n = 3;
+  Matrix A(l, m), B(m, n);
+  randomize_matrix(rng, A);
+  randomize_matrix(rng, B);
+  Eigen::SparseMatrix<T> A_sparse = A.sparseView(), B_sparse = B.sparseView();
+  Eigen::SparseMatrix<T> A_empty(l, m), B_empty(m, n);
+  secure_multiply_options options;
+  options.planner.protocols = {multiplication_protocol::dense};
+  options.planner.memory_budget = 8 * (2 * m * n + 4 * (2 * m + n));
+
+  auto run = [&](int role, const Eigen::SparseMatrix<T>& A_in,
+                 const Eigen::SparseMatrix<T>& B_in,
+                 multiplication_plan* plan) {
+    auto make_triples = [role](const multiplication_plan& plan,
+                               auto is_shared) {
+      using Provider =
+          offline::FakeTripleProvider<T, decltype(is_shared)::value>;
+      std::unique_ptr<Provider> triples(
+          new Provider(plan.chunk_size, plan.dense_inner, plan.n, role));
+      triples->Precompute(plan.num_chunks);
+      return triples;
+    };
+    return secure_multiply(A_in, B_in, *helper.GetChannel(role), role,
+                           make_triples, options, nullptr, plan);
+  };
+  Matrix result_0, result_1;
+  multiplication_plan plan_0, plan_1;
+  std::thread thread1([&] {
+    result_1 = run(1, A_empty, B_sparse, &plan_1);
+    helper.GetChannel(1)->flush();
+  });
+  result_0 = run(0, A_sparse, B_empty, &plan_0);
+  thread1.join();
+
+  EXPECT_EQ(plan_0.protocol, multiplication_protocol::dense);
+  EXPECT_EQ(plan_0.chunk_size, 4);
+  EXPECT_EQ(plan_1.chunk_size, plan_0.chunk_size);
+  EXPECT_EQ(plan_1.num_chunks, 3);
+  EXPECT_EQ(result_0 + result_1, A * B);
+}
+
+class SecureMultiplySparseTest
+    : public ::testing::TestWithParam<multiplication_protocol> {};
+
+TEST_P(SecureMultiplySparseTest, MatchesPlainProduct) {
+  using T = uint64_t;
+  using Matrix = offline::Matrix<T>;
+  mpc_utils::testing::CommChannelTestHelper helper(false);
+  std::mt19937 rng(12345);
+  const int l = 20, m = 30, n = 2;
+  // A has few nonzero rows and columns
+  Eigen::SparseMatrix<T> A(l, m);
+  A.insert(2, 3) = 5;
+  A.insert(2, 17) = 7;
+  A.insert(11, 3) = 1;
+  A.insert(15, 29) = 9;
+  Matrix B(m, n);
+  randomize_matrix(rng, B);
+  Eigen::SparseMatrix<T> B_sparse = B.sparseView();
+  Eigen::SparseMatrix<T> A_empty(l, m), B_empty(m, n);
+  secure_multiply_options options;
+  options.planner.protocols = {GetParam()};
+  options.planner.maps = {oblivious_map_type::basic};
+
+  auto run = [&](int role, const Eigen::SparseMatrix<T>& A_in,
+                 const Eigen::SparseMatrix<T>& B_in,
+                 multiplication_plan* plan) {
+    auto make_triples = [role](const multiplication_plan& plan,
+                               auto is_shared) {
+      using Provider =
+          offline::FakeTripleProvider<T, decltype(is_shared)::value>;
+      std::unique_ptr<Provider> triples(
+          new Provider(plan.chunk_size, plan.dense_inner, plan.n, role));
+      triples->Precompute(plan.num_chunks);
+      return triples;
+    };
+    return secure_multiply(A_in, B_in, *helper.GetChannel(role), role,
+                           make_triples, options, nullptr, plan);
+  };
+  Matrix result_0, result_1;
+  multiplication_plan plan_0, plan_1;
+  std::thread thread1([&] {
+    result_1 = run(1, A_empty, B_sparse, &plan_1);
+    helper.GetChannel(1)->flush();
+  });
+  result_0 = run(0, A, B_empty, &plan_0);
+  thread1.join();
+
+  EXPECT_EQ(plan_0.protocol, GetParam());
+  EXPECT_EQ(plan_1.protocol, GetParam());
+  EXPECT_EQ(result_0 + result_1, Matrix(A) * B);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Protocols, SecureMultiplySparseTest,
+    ::testing::Values(multiplication_protocol::rows_dense,
+                      multiplication_protocol::cols_dense));
+
+}  // namespace
+}  // namespace matrix_multiplication
+}  // namespace sparse_linear_algebra
@@ -1,7 +1,10 @@
 #ifndef SPARSE_LINEAR_ALGEBRA_MATRIX_MULTIPLICATION_SPARSE_COMMON_HPP_
 #define SPARSE_LINEAR_ALGEBRA_MATRIX_MULTIPLICATION_SPARSE_COMMON_HPP_
 
+#include <sys/types.h>
 #include <unordered_set>
+#include <vector>
+#include "Eigen/Sparse"
 #include "absl/container/flat_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "mpc_utils/canonical_errors.h"
@@ -29,4 +32,43 @@ absl::flat_hash_set<StorageIndex> ComputeInnerIndices(
   return indices;
 }
 
+// Writes the sorted row indices of m where m has non-zero values to
+// `indices`, or the column indices if `cols` is set. `positions` gets the
+// position of each row (column) in `indices`, or -1. Unlike the functions
+// above, this neither modifies m nor allocates if the vectors are large
+// enough already.
+template <typename Derived>
+void ComputeNonzeroIndices(const Eigen::SparseMatrixBase<Derived>& m,
+                           bool cols, std::vector<size_t>* indices,
+                           std::vector<ssize_t>* positions) {
+  const Derived& mat = m.derived();
+  size_t size = cols ? mat.cols() : mat.rows();
+  positions->assign(size, -1);
+  for (Eigen::Index outer = 0; outer < mat.outerSize(); outer++) {
+    for (typename Derived::InnerIterator it(mat, outer); it; ++it) {
+      (*positions)[cols ? it.col() : it.row()] = 0;
+    }
+  }
+  indices->clear();
+  for (size_t i = 0; i < size; i++) {
+    if ((*positions)[i] == 0) {
+      (*positions)[i] = indices->size();
+      indices->push_back(i);
+    }
+  }
+}
+
+// Appends the smallest indices missing from `indices` until it has `k`
+// elements, and updates `positions` accordingly. `k` must be at most
+// positions->size().
+inline void PadNonzeroIndices(size_t k, std::vector<size_t>* indices,
+                              std::vector<ssize_t>* positions) {
+  for (size_t i = 0; indices->size() < k; i++) {
+    if ((*positions)[i] < 0) {
+      (*positions)[i] = indices->size();
+      indices->push_back(i);
+    }
+  }
+}
+
 #endif  // SPARSE_LINEAR_ALGEBRA_MATRIX_MULTIPLICATION_SPARSE_COMMON_HPP_
\ No newline at end of file
@@ -3,7 +3,8 @@
 
 typedef struct {
   size_t index_size;
-  size_t element_size;
+  size_t element_size;  // bytes per row, without the valid flag
+  size_t value_size;    // bytes per value; rows consist of several values
   size_t num_ciphertexts;
   uint8_t *indexes_client;
   uint8_t *ciphertexts_client;
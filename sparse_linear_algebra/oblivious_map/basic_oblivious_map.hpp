@@ -17,24 +17,31 @@ class basic_oblivious_map : public virtual oblivious_map<K, V> {
  private:
   const int cipher;
   const size_t block_size;
+  // approximate number of bytes of the encrypted table sent at once
+  const size_t chunk_size;
   std::vector<uint8_t> key;
   comm_channel& chan;
 
  public:
-  basic_oblivious_map(comm_channel& chan)
+  // The server streams the encrypted table to the client in chunks of about
+  // `chunk_size` bytes, which bounds the memory used by both parties.
+  basic_oblivious_map(comm_channel& chan, size_t chunk_size = 1 << 20)
       : oblivious_map<K, V>(),
         cipher(GCRY_CIPHER_AES128),
         block_size(16),
+        chunk_size(chunk_size),
         chan(chan) {
     // initialize libgcrypt via obliv-c
     gcryDefaultLibInit();
-    // check if sizes fit into ciphertexts
-    // TODO: implement encryption of multiple blocks for really large value
-    // types?
-    if (block_size < sizeof(V) + 1 || block_size < sizeof(K) + 1) {
+    // check if keys fit into counters; values may span several blocks
+    if (block_size < sizeof(K) + 1) {
       BOOST_THROW_EXCEPTION(
           std::invalid_argument("Block size too small for given types"));
     }
+    if (chunk_size == 0) {
+      BOOST_THROW_EXCEPTION(
+          std::invalid_argument("chunk_size must be positive"));
+    }
   }
   ~basic_oblivious_map() {}
 
@@ -47,6 +54,24 @@ class basic_oblivious_map : public virtual oblivious_map<K, V> {
                   mpc_utils::Benchmarker* benchmarker = nullptr);
   void run_client(const key_range input, value_range output, bool shared_output,
                   mpc_utils::Benchmarker* benchmarker = nullptr);
+  void run_server_multi(const key_range input_keys,
+                        const value_range input_values,
+                        const value_range defaults, size_t num_values,
+                        bool shared_output,
+                        mpc_utils::Benchmarker* benchmarker = nullptr);
+  void run_client_multi(const key_range input, value_range output,
+                        size_t num_values, bool shared_output,
+                        mpc_utils::Benchmarker* benchmarker = nullptr);
+
+ private:
+  // Protocol for rows of `num_values` values each, stored back to back in
+  // `values`, `defaults` and the client's result.
+  void run_server_rows(const std::vector<K>& keys, const std::vector<V>& values,
+                       const std::vector<V>& defaults, size_t num_values,
+                       bool shared_output, mpc_utils::Benchmarker* benchmarker);
+  std::vector<V> run_client_rows(const std::vector<K>& keys, size_t num_values,
+                                 bool shared_output,
+                                 mpc_utils::Benchmarker* benchmarker);
 };
 
 #include "basic_oblivious_map.tpp"
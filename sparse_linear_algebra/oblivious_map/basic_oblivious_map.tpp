@@ -1,8 +1,13 @@
 #include <algorithm>
+#include <exception>
+#include <numeric>
+#include <thread>
 #include "absl/strings/str_cat.h"
 #include "boost/range.hpp"
 #include "boost/range/algorithm.hpp"
 #include "mpc_utils/comm_channel_oblivc_adapter.hpp"
+#include "sparse_linear_algebra/util/aes_ctr.hpp"
+#include "sparse_linear_algebra/util/ring_queue.hpp"
 #include "sparse_linear_algebra/util/serialize_le.hpp"
 #include "sparse_linear_algebra/util/time.h"
 extern "C" {
@@ -15,56 +20,147 @@ void basic_oblivious_map<K, V>::run_server(
     const basic_oblivious_map<K, V>::pair_range input,
     const basic_oblivious_map<K, V>::value_range defaults, bool shared_output,
     mpc_utils::Benchmarker* benchmarker) {
+  std::vector<K> keys;
+  std::vector<V> values;
+  for (auto pair : input) {
+    keys.push_back(pair.first);
+    values.push_back(pair.second);
+  }
+  run_server_rows(keys, values,
+                  std::vector<V>(boost::begin(defaults), boost::end(defaults)),
+                  1, shared_output, benchmarker);
+}
+
+template <typename K, typename V>
+void basic_oblivious_map<K, V>::run_client(
+    const basic_oblivious_map<K, V>::key_range input,
+    const basic_oblivious_map<K, V>::value_range output, bool shared_output,
+    mpc_utils::Benchmarker* benchmarker) {
+  std::vector<V> result =
+      run_client_rows(std::vector<K>(boost::begin(input), boost::end(input)), 1,
+                      shared_output, benchmarker);
+  boost::copy(result, boost::begin(output));
+}
+
+template <typename K, typename V>
+void basic_oblivious_map<K, V>::run_server_multi(
+    const basic_oblivious_map<K, V>::key_range input_keys,
+    const basic_oblivious_map<K, V>::value_range input_values,
+    const basic_oblivious_map<K, V>::value_range defaults, size_t num_values,
+    bool shared_output, mpc_utils::Benchmarker* benchmarker) {
+  std::vector<K> keys(boost::begin(input_keys), boost::end(input_keys));
+  std::vector<V> values(boost::begin(input_values), boost::end(input_values));
+  if (num_values == 0 || values.size() != keys.size() * num_values) {
+    BOOST_THROW_EXCEPTION(std::invalid_argument(
+        "Values must consist of one row of num_values values per key"));
+  }
+  run_server_rows(keys, values,
+                  std::vector<V>(boost::begin(defaults), boost::end(defaults)),
+                  num_values, shared_output, benchmarker);
+}
+
+template <typename K, typename V>
+void basic_oblivious_map<K, V>::run_client_multi(
+    const basic_oblivious_map<K, V>::key_range input,
+    basic_oblivious_map<K, V>::value_range output, size_t num_values,
+    bool shared_output, mpc_utils::Benchmarker* benchmarker) {
+  if (num_values == 0) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("num_values must be positive"));
+  }
+  std::vector<V> result =
+      run_client_rows(std::vector<K>(boost::begin(input), boost::end(input)),
+                      num_values, shared_output, benchmarker);
+  boost::copy(result, boost::begin(output));
+}
+
+template <typename K, typename V>
+void basic_oblivious_map<K, V>::run_server_rows(
+    const std::vector<K>& keys, const std::vector<V>& values,
+    const std::vector<V>& defaults, size_t num_values, bool shared_output,
+    mpc_utils::Benchmarker* benchmarker) {
   mpc_utils::Benchmarker::time_point start;
   if (benchmarker != nullptr) {
     start = benchmarker->StartTimer();
   }
-  size_t input_length = boost::size(input);
-  size_t default_length = boost::size(defaults);
-  // write values into a dense vector
-  std::vector<uint8_t> input_bytes, defaults_bytes(default_length * sizeof(V));
-  serialize_le(defaults_bytes.data(), std::begin(defaults), default_length);
-  input_bytes.reserve(256);
-  size_t max_key = 0;
-  auto it = boost::begin(input);
-  for (size_t i = 0; i < input_length; i++, it++) {
-    K current_key = it->first;
-    while (input_bytes.capacity() <= current_key * (sizeof(V) + 1)) {
-      input_bytes.reserve(2 * input_bytes.capacity());
-    }
-    if (current_key > max_key) {
-      max_key = current_key;
-      input_bytes.resize((current_key + 1) * (sizeof(V) + 1), 0);
-    }
-    serialize_le(&input_bytes[current_key * (sizeof(V) + 1)], &(it->second), 1);
-    // one extra byte per element to distinguish missing values from zeros
-    input_bytes[current_key * (sizeof(V) + 1) + sizeof(V)] = 1;
+  // one extra byte per row to distinguish missing values from zeros
+  const size_t row_size = num_values * sizeof(V) + 1;
+  if (row_size > block_size && sizeof(K) > sizeof(uint64_t)) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("Keys too large for rows of several blocks"));
   }
+  size_t default_length = defaults.size() / num_values;
+  std::vector<uint8_t> defaults_bytes(defaults.size() * sizeof(V));
+  serialize_le(defaults_bytes.data(), defaults.data(), defaults.size());
+
+  // sort the keys, so that each chunk of the dense table can be filled in a
+  // single pass; later values for the same key overwrite earlier ones
+  std::vector<size_t> order(keys.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return static_cast<size_t>(keys[a]) < static_cast<size_t>(keys[b]);
+  });
+  size_t num_rows =
+      keys.empty() ? 0 : static_cast<size_t>(keys[order.back()]) + 1;
+  chan.send(num_rows);
 
   // setup encryption
   if (key.size() == 0) {
     key.resize(block_size);
     gcry_randomize(key.data(), block_size, GCRY_STRONG_RANDOM);
   }
-  gcry_cipher_hd_t handle;
-  gcry_cipher_open(&handle, cipher, GCRY_CIPHER_MODE_CTR, 0);
-  gcry_cipher_setkey(handle, key.data(), block_size);
-
-  // encrypt
-  for (size_t i = 0; i < max_key + 1; i++) {
-    uint8_t buf[block_size] = {0};
-    uint8_t ctr[block_size] = {0};
-    serialize_le(&ctr[0], &i, 1);
-    gcry_cipher_setctr(handle, ctr, block_size);
-    gcry_cipher_encrypt(handle, buf, block_size, nullptr, 0);
-    for (size_t j = 0; j < sizeof(V) + 1; j++) {
-      input_bytes[i * (sizeof(V) + 1) + j] ^= buf[j];
+  aes_ctr aes(key.data());
+
+  // write values into chunks of the dense table and encrypt them; row i uses
+  // the keystream for counter i. Chunk i + 1 is encrypted while chunk i is
+  // sent, and at most two chunks wait in the queue.
+  const size_t chunk_rows = std::max<size_t>(chunk_size / row_size, 1);
+  // Errors of the encryption thread are rethrown once it has been joined.
+  ring_queue<std::vector<uint8_t>> chunks(2);
+  std::exception_ptr encrypt_error;
+  std::thread encrypt([&] {
+    try {
+      int num_threads = std::thread::hardware_concurrency();
+      size_t next = 0;
+      for (size_t begin = 0; begin < num_rows; begin += chunk_rows) {
+        size_t rows = std::min(chunk_rows, num_rows - begin);
+        std::vector<uint8_t> chunk(rows * row_size, 0);
+        for (; next < order.size() &&
+               static_cast<size_t>(keys[order[next]]) < begin + rows;
+             next++) {
+          size_t i = order[next];
+          size_t offset = (static_cast<size_t>(keys[i]) - begin) * row_size;
+          uint8_t* row = &chunk[offset];
+          serialize_le(row, &values[i * num_values], num_values);
+          row[row_size - 1] = 1;
+        }
+        aes.crypt_rows(chunk.data(), row_size, rows, begin, num_threads);
+        chunks.push(std::move(chunk));
+      }
+    } catch (...) {
+      encrypt_error = std::current_exception();
     }
-  }
-  gcry_cipher_close(handle);
+    chunks.close();
+  });
 
-  // send encrypted vector to client for selection
-  chan.send(input_bytes);
+  // send encrypted chunks to client for selection
+  std::vector<uint8_t> chunk;
+  try {
+    while (chunks.pop(&chunk)) {
+      chan.send(chunk);
+      chan.flush();
+    }
+  } catch (...) {
+    // let the encryption thread finish before giving up
+    while (chunks.pop(&chunk)) {
+    }
+    encrypt.join();
+    throw;
+  }
+  encrypt.join();
+  if (encrypt_error) {
+    std::rethrow_exception(encrypt_error);
+  }
 
   if (benchmarker != nullptr) {
     benchmarker->AddSecondsSinceStart("local_time", start);
@@ -73,7 +169,8 @@ void basic_oblivious_map<K, V>::run_server(
 
   // setup obliv-c inputs
   pir_basic_oblivc_args args = {.index_size = sizeof(K),
-                                .element_size = sizeof(V),
+                                .element_size = num_values * sizeof(V),
+                                .value_size = sizeof(V),
                                 .num_ciphertexts = default_length,
                                 .indexes_client = nullptr,
                                 .ciphertexts_client = nullptr,
@@ -105,31 +202,56 @@ void basic_oblivious_map<K, V>::run_server(
 }
 
 template <typename K, typename V>
-void basic_oblivious_map<K, V>::run_client(
-    const basic_oblivious_map<K, V>::key_range input,
-    const basic_oblivious_map<K, V>::value_range output, bool shared_output,
+std::vector<V> basic_oblivious_map<K, V>::run_client_rows(
+    const std::vector<K>& keys, size_t num_values, bool shared_output,
     mpc_utils::Benchmarker* benchmarker) {
   mpc_utils::Benchmarker::time_point start;
   if (benchmarker != nullptr) {
     start = benchmarker->StartTimer();
   }
-  size_t length = boost::size(input);
-  std::vector<uint8_t> all_ciphertexts;
-  chan.recv(all_ciphertexts);
-  size_t num_all_ciphertexts = all_ciphertexts.size() / (sizeof(V) + 1);
-  std::vector<uint8_t> selected_ciphertexts(length * (sizeof(V) + 1), 0);
+  const size_t row_size = num_values * sizeof(V) + 1;
+  if (row_size > block_size && sizeof(K) > sizeof(uint64_t)) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("Keys too large for rows of several blocks"));
+  }
+  size_t length = keys.size();
+  size_t num_all_ciphertexts;
+  chan.recv(num_all_ciphertexts);
+
+  // select our rows from each chunk of the server's table as it arrives,
+  // visiting the keys in sorted order
+  std::vector<size_t> order(length);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return static_cast<size_t>(keys[a]) < static_cast<size_t>(keys[b]);
+  });
+  std::vector<uint8_t> selected_ciphertexts(length * row_size, 0);
+  std::vector<uint8_t> chunk;
+  size_t next = 0;
+  for (size_t begin = 0; begin < num_all_ciphertexts;) {
+    chan.recv(chunk);
+    size_t rows = chunk.size() / row_size;
+    if (rows == 0 || rows > num_all_ciphertexts - begin) {
+      BOOST_THROW_EXCEPTION(
+          std::runtime_error("run_client: received a malformed chunk"));
+    }
+    for (; next < length &&
+           static_cast<size_t>(keys[order[next]]) < begin + rows;
+         next++) {
+      size_t i = order[next];
+      std::copy_n(&chunk[(static_cast<size_t>(keys[i]) - begin) * row_size],
+                  row_size, &selected_ciphertexts[i * row_size]);
+    }
+    begin += rows;
+  }
+
   std::vector<uint8_t> indexes_bytes(length * (sizeof(K) + 1), 0);
-  auto it = boost::begin(input);
-  for (size_t i = 0; i < length; i++, it++) {
-    K cur_index = *it;
+  for (size_t i = 0; i < length; i++) {
+    K cur_index = keys[i];
     serialize_le(&indexes_bytes[i * (sizeof(K) + 1)], &cur_index, 1);
-    if (cur_index < num_all_ciphertexts) {
-      std::copy_n(&all_ciphertexts[cur_index * (sizeof(V) + 1)], sizeof(V) + 1,
-                  &selected_ciphertexts[i * (sizeof(V) + 1)]);
-      indexes_bytes[i * (sizeof(K) + 1) + sizeof(K)] = 1;
-    } else {  // index outside of range from the server -> unset valid flag
-      indexes_bytes[i * (sizeof(K) + 1) + sizeof(K)] = 0;
-    }
+    // indexes outside of the server's range have their valid flag unset
+    indexes_bytes[i * (sizeof(K) + 1) + sizeof(K)] =
+        static_cast<size_t>(cur_index) < num_all_ciphertexts;
   }
 
   if (benchmarker != nullptr) {
@@ -138,10 +260,11 @@ void basic_oblivious_map<K, V>::run_client(
   }
 
   // setup obliv-c arguments
-  std::vector<uint8_t> result_bytes(sizeof(V) * length);
+  std::vector<uint8_t> result_bytes(length * num_values * sizeof(V));
   pir_basic_oblivc_args args = {
       .index_size = sizeof(K),
-      .element_size = sizeof(V),
+      .element_size = num_values * sizeof(V),
+      .value_size = sizeof(V),
       .num_ciphertexts = length,
       .indexes_client = indexes_bytes.data(),
       .ciphertexts_client = selected_ciphertexts.data(),
@@ -172,9 +295,11 @@ void basic_oblivious_map<K, V>::run_client(
     start = benchmarker->StartTimer();
   }
 
-  deserialize_le(output.begin(), result_bytes.data(), length);
+  std::vector<V> result(length * num_values);
+  deserialize_le(result.begin(), result_bytes.data(), result.size());
 
   if (benchmarker != nullptr) {
     benchmarker->AddSecondsSinceStart("local_time", start);
   }
+  return result;
 }
@@ -0,0 +1,53 @@
+#include "sparse_linear_algebra/oblivious_map/basic_oblivious_map.hpp"
+#include <thread>
+#include "gtest/gtest.h"
+#include "mpc_utils/testing/comm_channel_test_helper.hpp"
+
+namespace {
+
+// Parameterized by the chunk size, so that small values exercise streaming
+// the encrypted table in many chunks.
+class BasicObliviousMapTest : public ::testing::TestWithParam<size_t> {};
+
+TEST_P(BasicObliviousMapTest, LooksUpRows) {
+  const uint32_t default_value = 7;
+  for (size_t num_values : {1, 5}) {
+    mpc_utils::testing::CommChannelTestHelper helper(false);
+    // Key 5 appears twice; the later value wins.
+    std::vector<uint64_t> keys = {5, 0, 17, 5, 9};
+    std::vector<uint32_t> rows = {50, 1, 170, 55, 90};
+    std::vector<uint64_t> queries = {9, 5, 100, 0, 17, 3};
+    // Rows of queries that are not in `keys`, i.e., 100 and 3, are 0.
+    std::vector<uint32_t> expected_rows = {90, 55, 0, 1, 170, 0};
+
+    std::vector<uint32_t> values, expected;
+    for (uint32_t row : rows) {
+      for (size_t j = 0; j < num_values; j++) {
+        values.push_back(row + j);
+      }
+    }
+    for (uint32_t row : expected_rows) {
+      for (size_t j = 0; j < num_values; j++) {
+        expected.push_back(row ? row + j : default_value);
+      }
+    }
+    std::vector<uint32_t> defaults(queries.size() * num_values, default_value);
+    std::vector<uint32_t> result(queries.size() * num_values);
+
+    std::thread server([&] {
+      basic_oblivious_map<uint64_t, uint32_t> map(*helper.GetChannel(0),
+                                                  GetParam());
+      map.run_server_multi(keys, values, defaults, num_values, false);
+    });
+    basic_oblivious_map<uint64_t, uint32_t> map(*helper.GetChannel(1),
+                                                GetParam());
+    map.run_client_multi(queries, result, num_values, false);
+    server.join();
+    EXPECT_EQ(result, expected) << "num_values = " << num_values;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(ChunkSizes, BasicObliviousMapTest,
+                         ::testing::Values(size_t{1} << 20, 40, 1));
+
+}  // namespace
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+
+typedef struct {
+  size_t index_size;
+  size_t element_size;    // bytes per row, without the tag
+  size_t value_size;      // bytes per value; rows consist of several values
+  size_t tag_size;        // zero bytes after each row, to recognize matches
+  size_t num_candidates;  // rows the client selects for each index
+  size_t num_indexes;
+  uint8_t *indexes_client;
+  uint8_t *ciphertexts_client;
+  uint8_t *defaults_server;
+  uint8_t *key_server;
+  uint8_t *result;
+  bool shared_output;
+} pir_cuckoo_oblivc_args;
+
+void pir_cuckoo_oblivc(void *args);
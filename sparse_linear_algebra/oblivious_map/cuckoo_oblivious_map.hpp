@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "gcrypt.h"
+#include "mpc_utils/comm_channel.hpp"
+#include "sparse_linear_algebra/oblivious_map/cuckoo_table.hpp"
+#include "sparse_linear_algebra/oblivious_map/oblivious_map.hpp"
+
+extern "C" {
+void gcryDefaultLibInit();  // defined in Obliv-C, but not in obliv.h
+}
+
+// Like basic_oblivious_map, but the encrypted table has O(N) rows for N server
+// keys instead of one row per key in the domain. The server places its keys in
+// a cuckoo hash table with `num_hashes` hash functions and a stash of
+// `stash_size` rows. Each row holds a value followed by a tag of zeros, and is
+// encrypted with the keystream for its key. The client selects the rows of all
+// candidate slots of each of its keys and the whole stash, and the circuit
+// decrypts them with the keystream for the client's key; only the row of that
+// key has a zero tag. Both parties must pass the same parameters, except for
+// `expansion`, which only the server uses: the table has `expansion` rows per
+// key, or a default for `num_hashes` if it is 0.
+template <typename K, typename V>
+class cuckoo_oblivious_map : public virtual oblivious_map<K, V> {
+ private:
+  const uint16_t statistical_security;
+  const size_t num_hashes;
+  const size_t stash_size;
+  const double expansion;
+  const size_t block_size;
+  comm_channel& chan;
+
+ public:
+  cuckoo_oblivious_map(comm_channel& chan, uint16_t statistical_security,
+                       size_t num_hashes = 3, size_t stash_size = 4,
+                       double expansion = 0)
+      : oblivious_map<K, V>(),
+        statistical_security(statistical_security),
+        num_hashes(num_hashes),
+        stash_size(stash_size),
+        expansion(expansion),
+        block_size(16),
+        chan(chan) {
+    // initialize libgcrypt via obliv-c
+    gcryDefaultLibInit();
+    // keys are used as the lower half of the counters
+    if (sizeof(K) > sizeof(uint64_t)) {
+      BOOST_THROW_EXCEPTION(
+          std::invalid_argument("Keys too large for the counters"));
+    }
+    if (num_hashes < 2) {
+      BOOST_THROW_EXCEPTION(
+          std::invalid_argument("At least two hash functions are needed"));
+    }
+    if (expansion < 0) {
+      BOOST_THROW_EXCEPTION(
+          std::invalid_argument("expansion must not be negative"));
+    }
+  }
+  ~cuckoo_oblivious_map() {}
+
+  using pair_range = typename oblivious_map<K, V>::pair_range;
+  using key_range = typename oblivious_map<K, V>::key_range;
+  using value_range = typename oblivious_map<K, V>::value_range;
+
+  void run_server(const pair_range input, const value_range defaults,
+                  bool shared_output,
+                  mpc_utils::Benchmarker* benchmarker = nullptr);
+  void run_client(const key_range input, value_range output, bool shared_output,
+                  mpc_utils::Benchmarker* benchmarker = nullptr);
+  void run_server_multi(const key_range input_keys,
+                        const value_range input_values,
+                        const value_range defaults, size_t num_values,
+                        bool shared_output,
+                        mpc_utils::Benchmarker* benchmarker = nullptr);
+  void run_client_multi(const key_range input, value_range output,
+                        size_t num_values, bool shared_output,
+                        mpc_utils::Benchmarker* benchmarker = nullptr);
+
+ private:
+  // Evictions before an insertion gives up and uses the stash.
+  static constexpr int max_evictions = 500;
+  // Tables built with fresh hash functions before giving up.
+  static constexpr int max_attempts = 16;
+
+  // Protocol for rows of `num_values` values each, stored back to back in
+  // `values`, `defaults` and the client's result.
+  void run_server_rows(const std::vector<K>& keys, const std::vector<V>& values,
+                       const std::vector<V>& defaults, size_t num_values,
+                       bool shared_output, mpc_utils::Benchmarker* benchmarker);
+  std::vector<V> run_client_rows(const std::vector<K>& keys, size_t num_values,
+                                 bool shared_output,
+                                 mpc_utils::Benchmarker* benchmarker);
+
+  // Number of zero bytes after each row, such that a row of another key
+  // passes as a match with probability at most 2^-statistical_security.
+  size_t tag_size() const {
+    size_t bits = statistical_security;
+    for (size_t candidates = 1; candidates < num_hashes + stash_size;
+         candidates *= 2) {
+      bits++;
+    }
+    return (bits + 7) / 8;
+  }
+
+  // The counter index of `key`, i.e., its little-endian bytes.
+  static uint64_t to_index(K key) {
+    return static_cast<typename std::make_unsigned<K>::type>(key);
+  }
+};
+
+#include "cuckoo_oblivious_map.tpp"
@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+#include "absl/strings/str_cat.h"
+#include "boost/range.hpp"
+#include "boost/range/algorithm.hpp"
+#include "mpc_utils/comm_channel_oblivc_adapter.hpp"
+#include "sparse_linear_algebra/util/aes_ctr.hpp"
+#include "sparse_linear_algebra/util/aes_prg.hpp"
+#include "sparse_linear_algebra/util/serialize_le.hpp"
+extern "C" {
+#include "cuckoo_oblivious_map.h"
+#include "obliv.h"
+}
+
+template <typename K, typename V>
+void cuckoo_oblivious_map<K, V>::run_server(
+    const cuckoo_oblivious_map<K, V>::pair_range input,
+    const cuckoo_oblivious_map<K, V>::value_range defaults, bool shared_output,
+    mpc_utils::Benchmarker* benchmarker) {
+  std::vector<K> keys;
+  std::vector<V> values;
+  for (auto pair : input) {
+    keys.push_back(pair.first);
+    values.push_back(pair.second);
+  }
+  run_server_rows(keys, values,
+                  std::vector<V>(boost::begin(defaults), boost::end(defaults)),
+                  1, shared_output, benchmarker);
+}
+
+template <typename K, typename V>
+void cuckoo_oblivious_map<K, V>::run_client(
+    const cuckoo_oblivious_map<K, V>::key_range input,
+    const cuckoo_oblivious_map<K, V>::value_range output, bool shared_output,
+    mpc_utils::Benchmarker* benchmarker) {
+  std::vector<V> result =
+      run_client_rows(std::vector<K>(boost::begin(input), boost::end(input)), 1,
+                      shared_output, benchmarker);
+  boost::copy(result, boost::begin(output));
+}
+
+template <typename K, typename V>
+void cuckoo_oblivious_map<K, V>::run_server_multi(
+    const cuckoo_oblivious_map<K, V>::key_range input_keys,
+    const cuckoo_oblivious_map<K, V>::value_range input_values,
+    const cuckoo_oblivious_map<K, V>::value_range defaults, size_t num_values,
+    bool shared_output, mpc_utils::Benchmarker* benchmarker) {
+  std::vector<K> keys(boost::begin(input_keys), boost::end(input_keys));
+  std::vector<V> values(boost::begin(input_values), boost::end(input_values));
+  if (num_values == 0 || values.size() != keys.size() * num_values) {
+    BOOST_THROW_EXCEPTION(std::invalid_argument(
+        "Values must consist of one row of num_values values per key"));
+  }
+  run_server_rows(keys, values,
+                  std::vector<V>(boost::begin(defaults), boost::end(defaults)),
+                  num_values, shared_output, benchmarker);
+}
+
+template <typename K, typename V>
+void cuckoo_oblivious_map<K, V>::run_client_multi(
+    const cuckoo_oblivious_map<K, V>::key_range input,
+    cuckoo_oblivious_map<K, V>::value_range output, size_t num_values,
+    bool shared_output, mpc_utils::Benchmarker* benchmarker) {
+  if (num_values == 0) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("num_values must be positive"));
+  }
+  std::vector<V> result =
+      run_client_rows(std::vector<K>(boost::begin(input), boost::end(input)),
+                      num_values, shared_output, benchmarker);
+  boost::copy(result, boost::begin(output));
+}
+
+template <typename K, typename V>
+void cuckoo_oblivious_map<K, V>::run_server_rows(
+    const std::vector<K>& keys, const std::vector<V>& values,
+    const std::vector<V>& defaults, size_t num_values, bool shared_output,
+    mpc_utils::Benchmarker* benchmarker) {
+  mpc_utils::Benchmarker::time_point start;
+  if (benchmarker != nullptr) {
+    start = benchmarker->StartTimer();
+  }
+  const size_t element_size = num_values * sizeof(V);
+  const size_t row_size = element_size + tag_size();
+  const int num_threads = std::thread::hardware_concurrency();
+  size_t default_length = defaults.size() / num_values;
+  std::vector<uint8_t> defaults_bytes(defaults.size() * sizeof(V));
+  serialize_le(defaults_bytes.data(), defaults.data(), defaults.size());
+
+  // later values for the same key overwrite earlier ones
+  std::unordered_map<uint64_t, size_t> last;
+  for (size_t i = 0; i < keys.size(); i++) {
+    last[to_index(keys[i])] = i;
+  }
+  std::vector<size_t> entries;
+  std::vector<uint64_t> indexes;
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (last.at(to_index(keys[i])) == i) {
+      entries.push_back(i);
+      indexes.push_back(to_index(keys[i]));
+    }
+  }
+
+  // place the keys into a cuckoo table, with fresh hash functions if the
+  // stash overflows
+  size_t table_size =
+      cuckoo_internal::table_size(entries.size(), num_hashes, expansion);
+  std::vector<uint64_t> seeds(num_hashes);
+  std::vector<ssize_t> slots;
+  for (int attempt = 0; slots.empty(); attempt++) {
+    if (attempt == max_attempts) {
+      BOOST_THROW_EXCEPTION(
+          std::runtime_error("run_server: failed to build the cuckoo table"));
+    }
+    gcry_randomize(seeds.data(), seeds.size() * sizeof(uint64_t),
+                   GCRY_STRONG_RANDOM);
+    slots = cuckoo_internal::build_table(indexes, seeds, table_size,
+                                         stash_size, max_evictions);
+  }
+
+  // unused rows are random, so that they decrypt to random tags
+  std::vector<uint8_t> table(slots.size() * row_size);
+  std::vector<uint8_t> padding_key(block_size);
+  gcry_randomize(padding_key.data(), block_size, GCRY_STRONG_RANDOM);
+  aes_prg(padding_key.data()).random_data(table.data(), table.size(),
+                                          num_threads);
+
+  // used rows hold a value and a zero tag, encrypted with the keystream for
+  // their key
+  std::vector<uint8_t> rows, key(block_size);
+  std::vector<uint64_t> row_indexes;
+  std::vector<size_t> row_slots;
+  for (size_t slot = 0; slot < slots.size(); slot++) {
+    if (slots[slot] < 0) {
+      continue;
+    }
+    size_t entry = slots[slot];
+    rows.resize(rows.size() + row_size, 0);
+    uint8_t* row = &rows[rows.size() - row_size];
+    serialize_le(row, &values[entries[entry] * num_values], num_values);
+    row_indexes.push_back(indexes[entry]);
+    row_slots.push_back(slot);
+  }
+  gcry_randomize(key.data(), block_size, GCRY_STRONG_RANDOM);
+  aes_ctr(key.data()).crypt_indexed_rows(rows.data(), row_size,
+                                         row_indexes.data(), row_slots.size(),
+                                         num_threads);
+  for (size_t i = 0; i < row_slots.size(); i++) {
+    std::copy_n(&rows[i * row_size], row_size,
+                &table[row_slots[i] * row_size]);
+  }
+
+  // send hash functions and encrypted table to client for selection
+  chan.send(seeds);
+  chan.send(table);
+  chan.flush();
+
+  if (benchmarker != nullptr) {
+    benchmarker->AddSecondsSinceStart("local_time", start);
+    start = benchmarker->StartTimer();
+  }
+
+  // setup obliv-c inputs
+  pir_cuckoo_oblivc_args args = {.index_size = sizeof(K),
+                                 .element_size = element_size,
+                                 .value_size = sizeof(V),
+                                 .tag_size = tag_size(),
+                                 .num_candidates = num_hashes + stash_size,
+                                 .num_indexes = default_length,
+                                 .indexes_client = nullptr,
+                                 .ciphertexts_client = nullptr,
+                                 .defaults_server = defaults_bytes.data(),
+                                 .key_server = key.data(),
+                                 .result = nullptr,
+                                 .shared_output = shared_output};
+  // run yao's protocol using Obliv-C
+  auto status =
+      mpc_utils::CommChannelOblivCAdapter::Connect(chan, /*sleep_time=*/10);
+  if (!status.ok()) {
+    std::string error = absl::StrCat("run_server: connection failed: ",
+                                     status.status().message());
+    BOOST_THROW_EXCEPTION(std::runtime_error(error));
+  }
+  ProtocolDesc pd = status.ValueOrDie();
+  setCurrentParty(&pd, 1);
+  execYaoProtocol(&pd, pir_cuckoo_oblivc, &args);
+
+  if (benchmarker != nullptr && chan.is_measured()) {
+    benchmarker->AddAmount("Bytes Sent (Obliv-C)", tcp2PBytesSent(&pd));
+  }
+
+  cleanupProtocol(&pd);
+
+  if (benchmarker != nullptr) {
+    benchmarker->AddSecondsSinceStart("mpc_time", start);
+  }
+}
+
+template <typename K, typename V>
+std::vector<V> cuckoo_oblivious_map<K, V>::run_client_rows(
+    const std::vector<K>& keys, size_t num_values, bool shared_output,
+    mpc_utils::Benchmarker* benchmarker) {
+  mpc_utils::Benchmarker::time_point start;
+  if (benchmarker != nullptr) {
+    start = benchmarker->StartTimer();
+  }
+  const size_t element_size = num_values * sizeof(V);
+  const size_t row_size = element_size + tag_size();
+  const size_t num_candidates = num_hashes + stash_size;
+  size_t length = keys.size();
+  std::vector<uint64_t> seeds;
+  std::vector<uint8_t> table;
+  chan.recv(seeds);
+  chan.recv(table);
+  size_t num_rows = table.size() / row_size;
+  if (seeds.size() != num_hashes || table.size() % row_size != 0 ||
+      num_rows <= stash_size) {
+    BOOST_THROW_EXCEPTION(std::runtime_error(
+        "run_client: the server's table does not match our parameters"));
+  }
+  size_t table_size = num_rows - stash_size;
+
+  // select the candidate slots of each key and the whole stash
+  std::vector<uint8_t> selected_ciphertexts(length * num_candidates *
+                                            row_size);
+  std::vector<uint8_t> indexes_bytes(length * sizeof(K));
+  for (size_t i = 0; i < length; i++) {
+    K cur_index = keys[i];
+    serialize_le(&indexes_bytes[i * sizeof(K)], &cur_index, 1);
+    uint8_t* dest = &selected_ciphertexts[i * num_candidates * row_size];
+    for (uint64_t seed : seeds) {
+      size_t slot =
+          cuckoo_internal::hash(seed, to_index(cur_index), table_size);
+      dest = std::copy_n(&table[slot * row_size], row_size, dest);
+    }
+    std::copy_n(&table[table_size * row_size], stash_size * row_size, dest);
+  }
+
+  if (benchmarker != nullptr) {
+    benchmarker->AddSecondsSinceStart("local_time", start);
+    start = benchmarker->StartTimer();
+  }
+
+  // setup obliv-c arguments
+  std::vector<uint8_t> result_bytes(length * element_size);
+  pir_cuckoo_oblivc_args args = {
+      .index_size = sizeof(K),
+      .element_size = element_size,
+      .value_size = sizeof(V),
+      .tag_size = tag_size(),
+      .num_candidates = num_candidates,
+      .num_indexes = length,
+      .indexes_client = indexes_bytes.data(),
+      .ciphertexts_client = selected_ciphertexts.data(),
+      .defaults_server = nullptr,
+      .key_server = nullptr,
+      .result = result_bytes.data(),
+      .shared_output = shared_output};
+  // run yao's protocol using Obliv-C
+  auto status =
+      mpc_utils::CommChannelOblivCAdapter::Connect(chan, /*sleep_time=*/10);
+  if (!status.ok()) {
+    std::string error = absl::StrCat("run_client: connection failed: ",
+                                     status.status().message());
+    BOOST_THROW_EXCEPTION(std::runtime_error(error));
+  }
+  ProtocolDesc pd = status.ValueOrDie();
+  setCurrentParty(&pd, 2);
+  execYaoProtocol(&pd, pir_cuckoo_oblivc, &args);
+
+  if (benchmarker != nullptr && chan.is_measured()) {
+    benchmarker->AddAmount("Bytes Sent (Obliv-C)", tcp2PBytesSent(&pd));
+  }
+
+  cleanupProtocol(&pd);
+
+  if (benchmarker != nullptr) {
+    benchmarker->AddSecondsSinceStart("mpc_time", start);
+    start = benchmarker->StartTimer();
+  }
+
+  std::vector<V> result(length * num_values);
+  deserialize_le(result.begin(), result_bytes.data(), result.size());
+
+  if (benchmarker != nullptr) {
+    benchmarker->AddSecondsSinceStart("local_time", start);
+  }
+  return result;
+}
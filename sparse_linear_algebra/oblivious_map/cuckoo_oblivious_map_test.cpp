@@ -0,0 +1,83 @@
+#include "sparse_linear_algebra/oblivious_map/cuckoo_oblivious_map.hpp"
+#include <thread>
+#include "gtest/gtest.h"
+#include "mpc_utils/testing/comm_channel_test_helper.hpp"
+
+namespace {
+
+const uint16_t statistical_security = 40;
+const uint32_t default_value = 7;
+
+// Key 5 appears twice; the later value wins. Keys do not fit into a single
+// byte, so that all bytes of the counters matter.
+const std::vector<uint64_t> keys = {5, 0, 1 << 20, 5, 9, 300};
+const std::vector<uint32_t> rows = {50, 1, 170, 55, 90, 3000};
+const std::vector<uint64_t> queries = {9, 5, 100, 0, 1 << 20, 3, 300};
+// Rows of queries that are not in `keys`, i.e., 100 and 3, are 0.
+const std::vector<uint32_t> expected_rows = {90, 55, 0, 1, 170, 0, 3000};
+
+// Parameterized by the number of values per row and whether the output is
+// shared. Rows of 5 values and their tag span two AES blocks.
+class CuckooObliviousMapTest
+    : public ::testing::TestWithParam<std::tuple<size_t, bool>> {
+ protected:
+  size_t num_values() const { return std::get<0>(GetParam()); }
+  bool shared_output() const { return std::get<1>(GetParam()); }
+
+  // Looks up `queries` among `keys` and `rows` with the given map parameters,
+  // and checks the client's result.
+  void LookUp(size_t num_hashes, size_t stash_size, double expansion) {
+    mpc_utils::testing::CommChannelTestHelper helper(false);
+    std::vector<uint32_t> values, expected;
+    for (uint32_t row : rows) {
+      for (size_t j = 0; j < num_values(); j++) {
+        values.push_back(row + j);
+      }
+    }
+    for (uint32_t row : expected_rows) {
+      for (size_t j = 0; j < num_values(); j++) {
+        expected.push_back(row ? row + j
+                               : shared_output() ? 0 : default_value);
+      }
+    }
+    // With shared output, the defaults are the server's shares.
+    std::vector<uint32_t> defaults(queries.size() * num_values());
+    for (size_t i = 0; i < defaults.size(); i++) {
+      defaults[i] = shared_output() ? 1000 * i + 1 : default_value;
+    }
+    std::vector<uint32_t> result(queries.size() * num_values());
+
+    std::thread server([&] {
+      cuckoo_oblivious_map<uint64_t, uint32_t> map(
+          *helper.GetChannel(0), statistical_security, num_hashes, stash_size,
+          expansion);
+      map.run_server_multi(keys, values, defaults, num_values(),
+                           shared_output());
+    });
+    cuckoo_oblivious_map<uint64_t, uint32_t> map(
+        *helper.GetChannel(1), statistical_security, num_hashes, stash_size,
+        expansion);
+    map.run_client_multi(queries, result, num_values(), shared_output());
+    server.join();
+    if (shared_output()) {
+      for (size_t i = 0; i < result.size(); i++) {
+        result[i] += defaults[i];
+      }
+    }
+    EXPECT_EQ(result, expected);
+  }
+};
+
+TEST_P(CuckooObliviousMapTest, LooksUpRows) { LookUp(3, 4, 0); }
+
+TEST_P(CuckooObliviousMapTest, LooksUpRowsInStash) {
+  // With 5 distinct keys and a table of 3 rows, at least 2 keys end up in the
+  // stash.
+  LookUp(2, 4, 0.6);
+}
+
+INSTANTIATE_TEST_SUITE_P(NumValuesAndSharing, CuckooObliviousMapTest,
+                         ::testing::Combine(::testing::Values(size_t{1}, 5),
+                                            ::testing::Bool()));
+
+}  // namespace
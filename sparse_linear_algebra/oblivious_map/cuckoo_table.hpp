@@ -0,0 +1,84 @@
+#pragma once
+
+#include <sys/types.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Cuckoo hashing with a stash, as used by cuckoo_oblivious_map to place the
+// server's keys into a table of O(N) rows.
+namespace cuckoo_internal {
+
+// The candidate slot of `index` under the hash function given by `seed`.
+inline size_t hash(uint64_t seed, uint64_t index, size_t table_size) {
+  // finalizer of SplitMix64
+  uint64_t z = index ^ seed;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return (z ^ (z >> 31)) % table_size;
+}
+
+// Number of slots for `num_keys` keys and `num_hashes` hash functions, with
+// `expansion` slots per key. If `expansion` is 0, it is chosen such that
+// insertion rarely needs the stash. With two hash functions, insertion only
+// succeeds reliably below a load of 1/2.
+inline size_t table_size(size_t num_keys, size_t num_hashes,
+                         double expansion = 0) {
+  if (expansion == 0) {
+    expansion = num_hashes == 2 ? 2.4 : 1.27;
+  }
+  return std::max<size_t>(std::ceil(expansion * num_keys), num_hashes);
+}
+
+// Places `indexes` into `table_size` slots using the hash functions given by
+// `seeds`, evicting at most `max_evictions` times per index before putting it
+// into the stash of `stash_size` rows. Returns the entries of the slots (-1 if
+// empty) followed by the stash, or an empty vector if the stash overflows.
+inline std::vector<ssize_t> build_table(const std::vector<uint64_t>& indexes,
+                                        const std::vector<uint64_t>& seeds,
+                                        size_t table_size, size_t stash_size,
+                                        int max_evictions) {
+  std::vector<ssize_t> slots(table_size + stash_size, -1);
+  size_t stash_used = 0;
+  std::mt19937_64 rng(seeds[0]);
+  for (size_t i = 0; i < indexes.size(); i++) {
+    ssize_t entry = i;
+    size_t previous = table_size;  // the slot `entry` was evicted from
+    for (int eviction = 0; entry >= 0 && eviction <= max_evictions;
+         eviction++) {
+      // use a free candidate slot if there is one
+      size_t slot = table_size;
+      for (uint64_t seed : seeds) {
+        size_t candidate = hash(seed, indexes[entry], table_size);
+        if (slots[candidate] < 0) {
+          slot = candidate;
+          break;
+        }
+      }
+      // otherwise evict the entry of a random candidate slot, avoiding the
+      // one we just came from
+      if (slot == table_size) {
+        size_t h = rng() % seeds.size();
+        slot = hash(seeds[h], indexes[entry], table_size);
+        if (slot == previous) {
+          slot = hash(seeds[(h + 1) % seeds.size()], indexes[entry],
+                      table_size);
+        }
+      }
+      std::swap(entry, slots[slot]);
+      previous = slot;
+    }
+    if (entry >= 0) {
+      if (stash_used == stash_size) {
+        return {};
+      }
+      slots[table_size + stash_used++] = entry;
+    }
+  }
+  return slots;
+}
+
+}  // namespace cuckoo_internal
@@ -0,0 +1,58 @@
+#include "sparse_linear_algebra/oblivious_map/cuckoo_table.hpp"
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include "gtest/gtest.h"
+
+namespace {
+
+using cuckoo_internal::build_table;
+using cuckoo_internal::hash;
+
+TEST(CuckooTableTest, KeysAreInCandidateSlotsOrStash) {
+  const size_t stash_size = 4;
+  std::mt19937_64 rng(12345);
+  for (size_t num_hashes : {2, 3}) {
+    for (size_t num_keys : {1, 10, 1000}) {
+      std::vector<uint64_t> indexes(num_keys);
+      std::iota(indexes.begin(), indexes.end(), 1000);
+      size_t table_size = cuckoo_internal::table_size(num_keys, num_hashes);
+      std::vector<uint64_t> seeds(num_hashes);
+      std::vector<ssize_t> slots;
+      for (int attempt = 0; slots.empty() && attempt < 16; attempt++) {
+        for (auto& seed : seeds) {
+          seed = rng();
+        }
+        slots = build_table(indexes, seeds, table_size, stash_size, 500);
+      }
+      ASSERT_EQ(slots.size(), table_size + stash_size);
+      std::vector<int> count(num_keys, 0);
+      for (size_t slot = 0; slot < slots.size(); slot++) {
+        if (slots[slot] < 0) {
+          continue;
+        }
+        ASSERT_LT(slots[slot], num_keys);
+        count[slots[slot]]++;
+        if (slot < table_size) {
+          bool is_candidate = false;
+          for (uint64_t seed : seeds) {
+            is_candidate |=
+                hash(seed, indexes[slots[slot]], table_size) == slot;
+          }
+          EXPECT_TRUE(is_candidate) << "slot " << slot;
+        }
+      }
+      // every key is placed exactly once
+      EXPECT_EQ(count, std::vector<int>(num_keys, 1));
+    }
+  }
+}
+
+TEST(CuckooTableTest, StashOverflowReturnsEmpty) {
+  // 2 slots and a stash of 1 can't hold 4 keys
+  std::vector<uint64_t> indexes = {1, 2, 3, 4};
+  std::vector<uint64_t> seeds = {12345, 54321};
+  EXPECT_TRUE(build_table(indexes, seeds, 2, 1, 10).empty());
+}
+
+}  // namespace
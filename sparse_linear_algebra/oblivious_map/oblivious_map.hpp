@@ -46,6 +46,19 @@ class oblivious_map {
                           bool shared_output = false,
                           mpc_utils::Benchmarker* benchmarker = nullptr);
 
+  // Vector-valued lookups, where each key maps to a row of `num_values`
+  // values. `input_values`, `defaults` and `output` hold these rows back to
+  // back. The default implementations run one lookup per column; subclasses
+  // override them to look up whole rows in a single execution.
+  virtual void run_server_multi(const key_range input_keys,
+                                const value_range input_values,
+                                const value_range defaults, size_t num_values,
+                                bool shared_output = false,
+                                mpc_utils::Benchmarker* benchmarker = nullptr);
+  virtual void run_client_multi(const key_range input, value_range output,
+                                size_t num_values, bool shared_output = false,
+                                mpc_utils::Benchmarker* benchmarker = nullptr);
+
   // adapter for converting an any_range of pairs to a pair_range
   void run_server(
       boost::any_range<std::pair<const K, V>, boost::single_pass_traversal_tag,
@@ -1,5 +1,8 @@
+#include <stdexcept>
+#include "boost/exception/all.hpp"
 #include "boost/fusion/adapted/std_pair.hpp"
 #include "boost/iterator/zip_iterator.hpp"
+#include "boost/range/algorithm/copy.hpp"
 #include "sparse_linear_algebra/util/combine_pair.hpp"
 
 // implicit conversion to pair_range since any_range doesn't work as expected
@@ -27,3 +30,47 @@ void oblivious_map<K, V>::run_server(
   run_server(boost::make_iterator_range_n(it, boost::size(input_keys)),
              defaults, shared_output, benchmarker);
 }
+
+template <typename K, typename V>
+void oblivious_map<K, V>::run_server_multi(
+    const oblivious_map<K, V>::key_range input_keys,
+    const oblivious_map<K, V>::value_range input_values,
+    const oblivious_map<K, V>::value_range defaults, size_t num_values,
+    bool shared_output, mpc_utils::Benchmarker* benchmarker) {
+  std::vector<K> keys(boost::begin(input_keys), boost::end(input_keys));
+  std::vector<V> values(boost::begin(input_values), boost::end(input_values));
+  std::vector<V> default_values(boost::begin(defaults), boost::end(defaults));
+  if (num_values == 0 || values.size() != keys.size() * num_values ||
+      default_values.size() % num_values != 0) {
+    BOOST_THROW_EXCEPTION(std::invalid_argument(
+        "Values and defaults must consist of rows of num_values values"));
+  }
+  std::vector<V> column_values(keys.size());
+  std::vector<V> column_defaults(default_values.size() / num_values);
+  for (size_t j = 0; j < num_values; j++) {
+    for (size_t i = 0; i < column_values.size(); i++) {
+      column_values[i] = values[i * num_values + j];
+    }
+    for (size_t i = 0; i < column_defaults.size(); i++) {
+      column_defaults[i] = default_values[i * num_values + j];
+    }
+    run_server(keys, column_values, column_defaults, shared_output,
+               benchmarker);
+  }
+}
+
+template <typename K, typename V>
+void oblivious_map<K, V>::run_client_multi(
+    const oblivious_map<K, V>::key_range input,
+    oblivious_map<K, V>::value_range output, size_t num_values,
+    bool shared_output, mpc_utils::Benchmarker* benchmarker) {
+  std::vector<K> keys(boost::begin(input), boost::end(input));
+  std::vector<V> column(keys.size()), result(keys.size() * num_values);
+  for (size_t j = 0; j < num_values; j++) {
+    run_client(keys, column, shared_output, benchmarker);
+    for (size_t i = 0; i < column.size(); i++) {
+      result[i * num_values + j] = column[i];
+    }
+  }
+  boost::copy(result, boost::begin(output));
+}
@@ -4,6 +4,7 @@
 typedef struct {
   size_t statistical_security;
   size_t value_type_size;
+  size_t num_values;  // values per key, spread over consecutive ciphertexts
   size_t input_size;
   const uint8_t *input;  // either encrypted elements or the key
   const uint8_t *defaults;
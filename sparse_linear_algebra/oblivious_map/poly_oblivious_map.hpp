@@ -39,14 +39,13 @@ class poly_oblivious_map : public virtual oblivious_map<K, V> {
         print_times(print_times) {
     // initialize libgcrypt via obliv-c
     gcryDefaultLibInit();
-    // check if sizes fit into ciphertexts
-    // TODO: implement encryption of multiple blocks for really large value
-    // types?
+    // check if sizes fit into ciphertexts; rows larger than a block are
+    // spread over several polynomials
     if (statistical_security % 8) {
       BOOST_THROW_EXCEPTION(
           std::invalid_argument("statistical_security must be divisible by 8"));
     }
-    if (8 * block_size < 8 * sizeof(V) + statistical_security ||
+    if (8 * block_size <= statistical_security ||
         block_size < sizeof(nonce) + sizeof(K)) {
       BOOST_THROW_EXCEPTION(std::invalid_argument(
           "Block size too small for given types and statistical security"));
@@ -63,6 +62,30 @@ class poly_oblivious_map : public virtual oblivious_map<K, V> {
                   mpc_utils::Benchmarker* benchmarker = nullptr);
   void run_client(const key_range input, value_range output, bool shared_output,
                   mpc_utils::Benchmarker* benchmarker = nullptr);
+  void run_server_multi(const key_range input_keys,
+                        const value_range input_values,
+                        const value_range defaults, size_t num_values,
+                        bool shared_output,
+                        mpc_utils::Benchmarker* benchmarker = nullptr);
+  void run_client_multi(const key_range input, value_range output,
+                        size_t num_values, bool shared_output,
+                        mpc_utils::Benchmarker* benchmarker = nullptr);
+
+ private:
+  // Protocol for rows of `num_values` values each, stored back to back in
+  // `values`, `defaults` and the client's result. Rows that do not fit into a
+  // single ciphertext together with the zero bytes checked on decryption are
+  // split over several polynomials, which use consecutive nonces.
+  void run_server_rows(const std::vector<K>& keys, const std::vector<V>& values,
+                       const std::vector<V>& defaults, size_t num_values,
+                       bool shared_output, mpc_utils::Benchmarker* benchmarker);
+  std::vector<V> run_client_rows(const std::vector<K>& keys, size_t num_values,
+                                 bool shared_output,
+                                 mpc_utils::Benchmarker* benchmarker);
+  size_t num_polynomials(size_t num_values) const {
+    size_t row_size = statistical_security / 8 + num_values * sizeof(V);
+    return (row_size + block_size - 1) / block_size;
+  }
 };
 
 #include "poly_oblivious_map.tpp"
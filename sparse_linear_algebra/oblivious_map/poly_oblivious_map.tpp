@@ -1,11 +1,13 @@
 #include <algorithm>
+#include <thread>
 #include "absl/strings/str_cat.h"
 #include "boost/range.hpp"
 #include "boost/range/algorithm.hpp"
-#include "fastpoly/recursive.h"
 #include "mpc_utils/boost_serialization/ntl.hpp"
 #include "mpc_utils/comm_channel_oblivc_adapter.hpp"
+#include "sparse_linear_algebra/util/aes_ctr.hpp"
 #include "sparse_linear_algebra/util/serialize_le.hpp"
+#include "sparse_linear_algebra/util/subproduct_tree.hpp"
 #include "sparse_linear_algebra/util/time.h"
 extern "C" {
 #include "obliv.h"
@@ -17,6 +19,65 @@ void poly_oblivious_map<K, V>::run_server(
     const poly_oblivious_map<K, V>::pair_range input,
     const poly_oblivious_map<K, V>::value_range defaults, bool shared_output,
     mpc_utils::Benchmarker* benchmarker) {
+  std::vector<K> keys;
+  std::vector<V> values;
+  for (auto pair : input) {
+    keys.push_back(pair.first);
+    values.push_back(pair.second);
+  }
+  run_server_rows(keys, values,
+                  std::vector<V>(boost::begin(defaults), boost::end(defaults)),
+                  1, shared_output, benchmarker);
+}
+
+template <typename K, typename V>
+void poly_oblivious_map<K, V>::run_client(
+    const poly_oblivious_map<K, V>::key_range input,
+    const poly_oblivious_map<K, V>::value_range output, bool shared_output,
+    mpc_utils::Benchmarker* benchmarker) {
+  std::vector<V> result =
+      run_client_rows(std::vector<K>(boost::begin(input), boost::end(input)), 1,
+                      shared_output, benchmarker);
+  boost::copy(result, boost::begin(output));
+}
+
+template <typename K, typename V>
+void poly_oblivious_map<K, V>::run_server_multi(
+    const poly_oblivious_map<K, V>::key_range input_keys,
+    const poly_oblivious_map<K, V>::value_range input_values,
+    const poly_oblivious_map<K, V>::value_range defaults, size_t num_values,
+    bool shared_output, mpc_utils::Benchmarker* benchmarker) {
+  std::vector<K> keys(boost::begin(input_keys), boost::end(input_keys));
+  std::vector<V> values(boost::begin(input_values), boost::end(input_values));
+  if (num_values == 0 || values.size() != keys.size() * num_values) {
+    BOOST_THROW_EXCEPTION(std::invalid_argument(
+        "Values must consist of one row of num_values values per key"));
+  }
+  run_server_rows(keys, values,
+                  std::vector<V>(boost::begin(defaults), boost::end(defaults)),
+                  num_values, shared_output, benchmarker);
+}
+
+template <typename K, typename V>
+void poly_oblivious_map<K, V>::run_client_multi(
+    const poly_oblivious_map<K, V>::key_range input,
+    poly_oblivious_map<K, V>::value_range output, size_t num_values,
+    bool shared_output, mpc_utils::Benchmarker* benchmarker) {
+  if (num_values == 0) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("num_values must be positive"));
+  }
+  std::vector<V> result =
+      run_client_rows(std::vector<K>(boost::begin(input), boost::end(input)),
+                      num_values, shared_output, benchmarker);
+  boost::copy(result, boost::begin(output));
+}
+
+template <typename K, typename V>
+void poly_oblivious_map<K, V>::run_server_rows(
+    const std::vector<K>& keys, const std::vector<V>& values,
+    const std::vector<V>& defaults, size_t num_values, bool shared_output,
+    mpc_utils::Benchmarker* benchmarker) {
   try {
     mpc_utils::Benchmarker::time_point start;
     if (benchmarker != nullptr) {
@@ -24,68 +85,75 @@ void poly_oblivious_map<K, V>::run_server(
     }
 
     NTL::ZZ_pPush push(modulus);
-    nonce++;
-    NTL::ZZ_pX poly_server;
-    size_t input_length = boost::size(input);
-    size_t default_length = boost::size(defaults);
+    // one nonce per polynomial
+    const size_t num_polys = num_polynomials(num_values);
+    const uint64_t first_nonce = nonce + 1;
+    nonce += num_polys;
+    const size_t offset = statistical_security / 8;
+    const size_t row_size = num_values * sizeof(V);
+    size_t input_length = keys.size();
 
     // convert server inputs
     NTL::Vec<NTL::ZZ_p> elements_server;
-    NTL::Vec<NTL::ZZ_p> values_server;
-    elements_server.SetMaxLength(input_length);
-    values_server.SetMaxLength(input_length);
-    for (auto pair : input) {
-      elements_server.append(NTL::conv<NTL::ZZ_p>(pair.first));
-      values_server.append(NTL::conv<NTL::ZZ_p>(pair.second));
+    elements_server.SetLength(input_length);
+    for (size_t i = 0; i < input_length; i++) {
+      elements_server[i] = NTL::conv<NTL::ZZ_p>(keys[i]);
     }
+    std::vector<uint8_t> values_bytes(values.size() * sizeof(V));
+    serialize_le(values_bytes.data(), values.data(), values.size());
 
     // setup encryption
     if (key.size() == 0) {
       key.resize(block_size);
       gcry_randomize(key.data(), block_size, GCRY_STRONG_RANDOM);
     }
-    gcry_cipher_hd_t handle;
-    gcry_cipher_open(&handle, cipher, GCRY_CIPHER_MODE_CTR, 0);
-    gcry_cipher_setkey(handle, key.data(), block_size);
+    aes_ctr aes(key.data());
+    std::vector<uint8_t> blocks(input_length * block_size);
+    // all polynomials go through the same points
+    thread_pool pool;
+    subproduct_tree tree(elements_server.data(), input_length, pool);
 
-    // encrypt server values
-    for (size_t i = 0; i < input_length; i++) {
-      NTL::ZZ val;
-      NTL::conv(val, values_server[i]);
-      val <<= statistical_security;
-      // use AES counter mode with the element as the counter
-      unsigned char buf[block_size] = {0};
-      unsigned char ctr[block_size] = {0};
-      NTL::BytesFromZZ(
-          ctr,
-          (NTL::conv<NTL::ZZ>(elements_server[i]) << 8 * (sizeof(nonce))) +
-              nonce,
-          block_size);
-      gcry_cipher_setctr(handle, ctr, block_size);
-      if (NTL::NumBytes(val) > block_size) {
-        BOOST_THROW_EXCEPTION(
-            std::runtime_error("Server value does not fit in plaintext space"));
+    for (size_t p = 0; p < num_polys; p++) {
+      // use AES counter mode with the element as the counter; all counter
+      // blocks are encrypted in one batch
+      for (size_t i = 0; i < input_length; i++) {
+        NTL::BytesFromZZ(
+            &blocks[i * block_size],
+            (NTL::conv<NTL::ZZ>(elements_server[i]) << 8 * (sizeof(nonce))) +
+                (first_nonce + p),
+            block_size);
       }
-      NTL::BytesFromZZ(buf, val, block_size);
-      gcry_cipher_encrypt(handle, buf, block_size, nullptr, 0);
-      NTL::conv(values_server[i], NTL::ZZFromBytes(buf, block_size));
-    }
-    gcry_cipher_close(handle);
-
-    // interpolate polynomial over the values
-    // interpolate_recursive(poly_server, elements_server,values_server);
-    poly_interpolate_zp_recursive(values_server.length() - 1,
-                                  elements_server.data(), values_server.data(),
-                                  poly_server);
-    chan.send(poly_server);
+      aes.encrypt_blocks(blocks.data(), blocks.data(), input_length,
+                         std::thread::hardware_concurrency());
+
+      // encrypt the p-th block of each row, which is preceded by `offset` zero
+      // bytes
+      size_t part_begin = std::max(p * block_size, offset);
+      size_t part_end = std::min((p + 1) * block_size, offset + row_size);
+      NTL::Vec<NTL::ZZ_p> values_server;
+      values_server.SetLength(input_length);
+      for (size_t i = 0; i < input_length; i++) {
+        unsigned char* buf = &blocks[i * block_size];
+        const uint8_t* row = &values_bytes[i * row_size];
+        for (size_t j = part_begin; j < part_end; j++) {
+          buf[j - p * block_size] ^= row[j - offset];
+        }
+        NTL::conv(values_server[i], NTL::ZZFromBytes(buf, block_size));
+      }
+
+      // interpolate polynomial over the values
+      NTL::ZZ_pX poly_server;
+      tree.interpolate(values_server.data(), poly_server);
+      chan.send(poly_server);
+    }
     chan.flush();
 
     // set up inputs for obliv-c
-    std::vector<uint8_t> defaults_bytes(default_length * sizeof(V), 0);
-    serialize_le(defaults_bytes.begin(), boost::begin(defaults),
-                 default_length);
+    std::vector<uint8_t> defaults_bytes(defaults.size() * sizeof(V), 0);
+    serialize_le(defaults_bytes.begin(), defaults.begin(), defaults.size());
     pir_poly_oblivc_args args = {.statistical_security = statistical_security,
                                  .value_type_size = sizeof(V),
+                                 .num_values = num_values,
                                  .input_size = key.size(),
                                  .input = key.data(),
                                  .defaults = defaults_bytes.data(),
@@ -125,9 +193,8 @@ void poly_oblivious_map<K, V>::run_server(
 }
 
 template <typename K, typename V>
-void poly_oblivious_map<K, V>::run_client(
-    const poly_oblivious_map<K, V>::key_range input,
-    const poly_oblivious_map<K, V>::value_range output, bool shared_output,
+std::vector<V> poly_oblivious_map<K, V>::run_client_rows(
+    const std::vector<K>& keys, size_t num_values, bool shared_output,
     mpc_utils::Benchmarker* benchmarker) {
   try {
     mpc_utils::Benchmarker::time_point start;
@@ -136,43 +203,55 @@ void poly_oblivious_map<K, V>::run_client(
     }
 
     NTL::ZZ_pPush push(modulus);
-    nonce++;
-    size_t length = boost::size(input);
-
-    // receive polynomial from server and send number of inputs
-    NTL::ZZ_pX poly_server;
-    chan.recv(poly_server);
+    const size_t num_polys = num_polynomials(num_values);
+    const uint64_t first_nonce = nonce + 1;
+    nonce += num_polys;
+    size_t length = keys.size();
 
     // convert client inputs to NTL vectors
     NTL::Vec<NTL::ZZ_p> elements_client;
-    NTL::Vec<NTL::ZZ_p> values_client;
     elements_client.SetLength(length);
-    values_client.SetLength(length);
-    boost::copy(input, elements_client.begin());
-    // evaluate polynomial using fastpoly
-    poly_evaluate_zp_recursive(elements_client.length() - 1, poly_server,
-                               elements_client.data(), values_client.data());
+    for (size_t i = 0; i < length; i++) {
+      elements_client[i] = NTL::conv<NTL::ZZ_p>(keys[i]);
+    }
+
+    // receive polynomials from server and evaluate them at our keys
+    thread_pool pool;
+    subproduct_tree tree(elements_client.data(), length, pool);
+    std::vector<NTL::Vec<NTL::ZZ_p>> values_client(num_polys);
+    for (size_t p = 0; p < num_polys; p++) {
+      NTL::ZZ_pX poly_server;
+      chan.recv(poly_server);
+      values_client[p].SetLength(length);
+      tree.evaluate(poly_server, values_client[p].data());
+    }
 
-    std::vector<uint8_t> result(values_client.length() * sizeof(V));
+    std::vector<uint8_t> result(length * num_values * sizeof(V));
     // set up inputs for obliv-c
-    std::vector<uint8_t> ciphertexts_client(values_client.length() * 2 *
+    std::vector<uint8_t> ciphertexts_client(length * num_polys * 2 *
                                             block_size);
     pir_poly_oblivc_args args = {.statistical_security = statistical_security,
                                  .value_type_size = sizeof(V),
+                                 .num_values = num_values,
                                  .input_size = ciphertexts_client.size(),
                                  .input = ciphertexts_client.data(),
                                  .defaults = nullptr,
                                  .result = result.data(),
                                  .shared_output = shared_output};
-    // serialize ciphertexts and elements (used as ctr in decryption)
-    for (size_t i = 0; i < values_client.length(); i++) {
-      NTL::BytesFromZZ(ciphertexts_client.data() + i * 2 * block_size,
-                       NTL::conv<NTL::ZZ>(values_client[i]), block_size);
-      NTL::BytesFromZZ(
-          ciphertexts_client.data() + (i * 2 + 1) * block_size,
-          (NTL::conv<NTL::ZZ>(elements_client[i]) << 8 * (sizeof(nonce))) +
-              nonce,
-          block_size);
+    // serialize ciphertexts and elements (used as ctr in decryption), with the
+    // parts of each row next to each other
+    for (size_t i = 0; i < length; i++) {
+      for (size_t p = 0; p < num_polys; p++) {
+        uint8_t* pair = ciphertexts_client.data() +
+                        (i * num_polys + p) * 2 * block_size;
+        NTL::BytesFromZZ(pair, NTL::conv<NTL::ZZ>(values_client[p][i]),
+                         block_size);
+        NTL::BytesFromZZ(
+            pair + block_size,
+            (NTL::conv<NTL::ZZ>(elements_client[i]) << 8 * (sizeof(nonce))) +
+                (first_nonce + p),
+            block_size);
+      }
     }
     chan.flush();
 
@@ -204,11 +283,13 @@ void poly_oblivious_map<K, V>::run_client(
       start = benchmarker->StartTimer();
     }
 
-    deserialize_le(boost::begin(output), result.data(), length);
+    std::vector<V> output(length * num_values);
+    deserialize_le(output.begin(), result.data(), output.size());
 
     if (benchmarker != nullptr) {
       benchmarker->AddSecondsSinceStart("local_time", start);
     }
+    return output;
   } catch (NTL::ErrorObject& ex) {
     BOOST_THROW_EXCEPTION(ex);
   }
@@ -4,6 +4,7 @@
 typedef struct {
   size_t key_type_size;
   size_t value_type_size;
+  size_t num_values;  // values per key, stored back to back
   size_t num_elements;
   const uint8_t *input_keys;
   const uint8_t *input_values;
@@ -23,6 +23,24 @@ class sorting_oblivious_map : public virtual oblivious_map<K, V> {
                   mpc_utils::Benchmarker* benchmarker = nullptr);
   void run_client(const key_range input, value_range output, bool shared_output,
                   mpc_utils::Benchmarker* benchmarker = nullptr);
+  void run_server_multi(const key_range input_keys,
+                        const value_range input_values,
+                        const value_range defaults, size_t num_values,
+                        bool shared_output,
+                        mpc_utils::Benchmarker* benchmarker = nullptr);
+  void run_client_multi(const key_range input, value_range output,
+                        size_t num_values, bool shared_output,
+                        mpc_utils::Benchmarker* benchmarker = nullptr);
+
+ private:
+  // Protocol for rows of `num_values` values each, stored back to back in
+  // `values`, `defaults` and the client's result.
+  void run_server_rows(const std::vector<K>& keys, const std::vector<V>& values,
+                       const std::vector<V>& defaults, size_t num_values,
+                       bool shared_output, mpc_utils::Benchmarker* benchmarker);
+  std::vector<V> run_client_rows(const std::vector<K>& keys, size_t num_values,
+                                 bool shared_output,
+                                 mpc_utils::Benchmarker* benchmarker);
 };
 
 #include "sorting_oblivious_map.tpp"
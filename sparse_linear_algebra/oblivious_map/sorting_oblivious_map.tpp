@@ -1,3 +1,4 @@
+#include <numeric>
 #include "absl/strings/str_cat.h"
 #include "boost/range/adaptor/map.hpp"
 #include "boost/range/combine.hpp"
@@ -15,33 +16,95 @@ void sorting_oblivious_map<K, V>::run_server(
     const sorting_oblivious_map<K, V>::pair_range input,
     const sorting_oblivious_map<K, V>::value_range defaults, bool shared_output,
     mpc_utils::Benchmarker* benchmarker) {
+  std::vector<K> keys;
+  std::vector<V> values;
+  for (auto pair : input) {
+    keys.push_back(pair.first);
+    values.push_back(pair.second);
+  }
+  run_server_rows(keys, values,
+                  std::vector<V>(boost::begin(defaults), boost::end(defaults)),
+                  1, shared_output, benchmarker);
+}
+
+template <typename K, typename V>
+void sorting_oblivious_map<K, V>::run_client(
+    const sorting_oblivious_map<K, V>::key_range input,
+    sorting_oblivious_map<K, V>::value_range output, bool shared_output,
+    mpc_utils::Benchmarker* benchmarker) {
+  std::vector<V> result =
+      run_client_rows(std::vector<K>(boost::begin(input), boost::end(input)), 1,
+                      shared_output, benchmarker);
+  boost::copy(result, boost::begin(output));
+}
+
+template <typename K, typename V>
+void sorting_oblivious_map<K, V>::run_server_multi(
+    const sorting_oblivious_map<K, V>::key_range input_keys,
+    const sorting_oblivious_map<K, V>::value_range input_values,
+    const sorting_oblivious_map<K, V>::value_range defaults, size_t num_values,
+    bool shared_output, mpc_utils::Benchmarker* benchmarker) {
+  std::vector<K> keys(boost::begin(input_keys), boost::end(input_keys));
+  std::vector<V> values(boost::begin(input_values), boost::end(input_values));
+  if (num_values == 0 || values.size() != keys.size() * num_values) {
+    BOOST_THROW_EXCEPTION(std::invalid_argument(
+        "Values must consist of one row of num_values values per key"));
+  }
+  run_server_rows(keys, values,
+                  std::vector<V>(boost::begin(defaults), boost::end(defaults)),
+                  num_values, shared_output, benchmarker);
+}
+
+template <typename K, typename V>
+void sorting_oblivious_map<K, V>::run_client_multi(
+    const sorting_oblivious_map<K, V>::key_range input,
+    sorting_oblivious_map<K, V>::value_range output, size_t num_values,
+    bool shared_output, mpc_utils::Benchmarker* benchmarker) {
+  if (num_values == 0) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("num_values must be positive"));
+  }
+  std::vector<V> result =
+      run_client_rows(std::vector<K>(boost::begin(input), boost::end(input)),
+                      num_values, shared_output, benchmarker);
+  boost::copy(result, boost::begin(output));
+}
+
+template <typename K, typename V>
+void sorting_oblivious_map<K, V>::run_server_rows(
+    const std::vector<K>& keys, const std::vector<V>& values,
+    const std::vector<V>& defaults, size_t num_values, bool shared_output,
+    mpc_utils::Benchmarker* benchmarker) {
   mpc_utils::Benchmarker::time_point start;
   if (benchmarker != nullptr) {
     start = benchmarker->StartTimer();
   }
 
-  size_t input_size = boost::size(input);
-  // sort inputs
-  std::vector<std::pair<K, V>> input_vec;
+  size_t input_size = keys.size();
+  const size_t row_size = num_values * sizeof(V);
+  // sort inputs by key
+  std::vector<size_t> order(input_size);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&keys](size_t i, size_t j) { return keys[i] < keys[j]; });
   std::vector<uint8_t> input_keys_bytes(input_size * sizeof(K));
-  std::vector<uint8_t> input_values_bytes(input_size * sizeof(V));
-  std::vector<uint8_t> input_defaults_bytes(boost::size(defaults) * sizeof(V));
+  std::vector<uint8_t> input_values_bytes(input_size * row_size);
+  std::vector<uint8_t> input_defaults_bytes(defaults.size() * sizeof(V));
 
-  input_vec =
-      std::vector<std::pair<K, V>>(boost::begin(input), boost::end(input));
-  boost::sort(input_vec);
   // serialize for obliv-c
-  serialize_le(input_keys_bytes.begin(),
-               boost::begin(boost::adaptors::keys(input_vec)), input_size);
-  serialize_le(input_values_bytes.begin(),
-               boost::begin(boost::adaptors::values(input_vec)), input_size);
-  serialize_le(input_defaults_bytes.begin(), boost::begin(defaults),
-               boost::size(defaults));
+  for (size_t i = 0; i < input_size; i++) {
+    serialize_le(&input_keys_bytes[i * sizeof(K)], &keys[order[i]], 1);
+    serialize_le(&input_values_bytes[i * row_size],
+                 &values[order[i] * num_values], num_values);
+  }
+  serialize_le(input_defaults_bytes.begin(), defaults.begin(),
+               defaults.size());
   chan.flush();
 
   pir_scs_oblivc_args args = {.key_type_size = sizeof(K),
                               .value_type_size = sizeof(V),
-                              .num_elements = input_vec.size(),
+                              .num_values = num_values,
+                              .num_elements = input_size,
                               .input_keys = input_keys_bytes.data(),
                               .input_values = input_values_bytes.data(),
                               .input_defaults = input_defaults_bytes.data(),
@@ -79,30 +142,30 @@ void sorting_oblivious_map<K, V>::run_server(
 }
 
 template <typename K, typename V>
-void sorting_oblivious_map<K, V>::run_client(
-    const sorting_oblivious_map<K, V>::key_range input,
-    sorting_oblivious_map<K, V>::value_range output, bool shared_output,
+std::vector<V> sorting_oblivious_map<K, V>::run_client_rows(
+    const std::vector<K>& keys, size_t num_values, bool shared_output,
     mpc_utils::Benchmarker* benchmarker) {
   mpc_utils::Benchmarker::time_point start;
   if (benchmarker != nullptr) {
     start = benchmarker->StartTimer();
   }
 
-  size_t input_size = boost::size(input);
+  size_t input_size = keys.size();
+  const size_t row_size = num_values * sizeof(V);
   std::map<K, size_t> input_map;
   std::vector<uint8_t> input_bytes(input_size * sizeof(K));
-  std::vector<uint8_t> output_keys_bytes(boost::size(output) * sizeof(K));
-  std::vector<uint8_t> output_values_bytes(boost::size(output) * sizeof(V));
+  std::vector<uint8_t> output_keys_bytes(input_size * sizeof(K));
+  std::vector<uint8_t> output_values_bytes(input_size * row_size);
 
-  auto it = boost::begin(input);
   for (size_t i = 0; i < input_size; i++) {
-    input_map.emplace(*(it++), i);
+    input_map.emplace(keys[i], i);
   }
   serialize_le(input_bytes.begin(),
                boost::begin(boost::adaptors::keys(input_map)), input_size);
 
   pir_scs_oblivc_args args = {.key_type_size = sizeof(K),
                               .value_type_size = sizeof(V),
+                              .num_values = num_values,
                               .num_elements = input_size,
                               .input_keys = input_bytes.data(),
                               .input_values = nullptr,
@@ -140,17 +203,16 @@ void sorting_oblivious_map<K, V>::run_client(
   }
 
   // reorder outputs to match original order of the inputs
-  std::vector<V> output_values(input_size);
+  std::vector<V> output_values(input_size * num_values);
   for (size_t i = 0; i < input_size; i++) {
     K key;
-    V value;
     deserialize_le(&key, &output_keys_bytes[i * sizeof(K)], 1);
-    deserialize_le(&value, &output_values_bytes[i * sizeof(V)], 1);
-    output_values[input_map[key]] = value;
+    deserialize_le(&output_values[input_map[key] * num_values],
+                   &output_values_bytes[i * row_size], num_values);
   }
-  boost::copy(output_values, boost::begin(output));
 
   if (benchmarker != nullptr) {
     benchmarker->AddSecondsSinceStart("local_time", start);
   }
+  return output_values;
 }
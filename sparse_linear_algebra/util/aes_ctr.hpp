@@ -0,0 +1,204 @@
+#pragma once
+
+#include <stdint.h>
+#include <wmmintrin.h>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// The AES-NI code is compiled for the target explicitly, so that including this
+// header does not require -maes.
+#define AES_CTR_TARGET __attribute__((target("aes,sse2")))
+
+// AES-128 with AES-NI for computing many counter-mode keystreams at once.
+// Blocks are encrypted several at a time to hide the latency of AESENC, also
+// across short rows, and large batches can be split across threads.
+//
+// The keystream for index i consists of the encrypted counter blocks that hold
+// i in their low 8 bytes (little-endian) and the block number in their high 8
+// bytes (big-endian). This is the layout used by ctr_keystream() and by the
+// Obliv-C circuits that recompute the keystream.
+class aes_ctr {
+ public:
+  static constexpr size_t block_size = 16;
+
+  AES_CTR_TARGET explicit aes_ctr(const uint8_t key[block_size]) {
+    expand_key(_mm_loadu_si128(reinterpret_cast<const __m128i *>(key)));
+  }
+
+  // Encrypts `num_blocks` arbitrary blocks from `in` to `out`, e.g., counter
+  // blocks that do not follow the layout above. `in` and `out` may be equal.
+  void encrypt_blocks(const uint8_t *in, uint8_t *out, size_t num_blocks,
+                      int max_threads = 1) const {
+    parallel_for(num_blocks, block_size, max_threads,
+                 [&](size_t begin, size_t end) {
+                   encrypt(
+                       [&](size_t i) {
+                         return _mm_loadu_si128(
+                             reinterpret_cast<const __m128i *>(in) + i);
+                       },
+                       [&](size_t i, __m128i block) {
+                         _mm_storeu_si128(reinterpret_cast<__m128i *>(out) + i,
+                                          block);
+                       },
+                       begin, end);
+                 });
+  }
+
+  // Writes blocks `first_block` to `first_block + num_blocks - 1` of the
+  // keystream for `index` to `out`.
+  void keystream_blocks(uint64_t index, uint64_t first_block, uint8_t *out,
+                        size_t num_blocks, int max_threads = 1) const {
+    parallel_for(num_blocks, block_size, max_threads,
+                 [&](size_t begin, size_t end) {
+                   encrypt(
+                       [&](size_t i) {
+                         return counter_block(index, first_block + i);
+                       },
+                       [&](size_t i, __m128i block) {
+                         _mm_storeu_si128(reinterpret_cast<__m128i *>(out) + i,
+                                          block);
+                       },
+                       begin, end);
+                 });
+  }
+
+  // XORs the first `row_size` bytes of the keystream for `first_index + i`
+  // into the i-th of the `num_rows` consecutive rows at `data`.
+  void crypt_rows(uint8_t *data, size_t row_size, size_t num_rows,
+                  uint64_t first_index = 0, int max_threads = 1) const {
+    crypt_rows_with(data, row_size, num_rows,
+                    [&](size_t row) { return first_index + row; },
+                    max_threads);
+  }
+
+  // Like crypt_rows(), but uses the keystream for `indexes[i]` for the i-th
+  // row.
+  void crypt_indexed_rows(uint8_t *data, size_t row_size,
+                          const uint64_t *indexes, size_t num_rows,
+                          int max_threads = 1) const {
+    crypt_rows_with(data, row_size, num_rows,
+                    [&](size_t row) { return indexes[row]; }, max_threads);
+  }
+
+  // Like crypt_rows(), but overwrites the rows with the keystream.
+  void keystream_rows(uint8_t *out, size_t row_size, size_t num_rows,
+                      uint64_t first_index = 0, int max_threads = 1) const {
+    std::fill_n(out, row_size * num_rows, 0);
+    crypt_rows(out, row_size, num_rows, first_index, max_threads);
+  }
+
+ private:
+  // Number of blocks encrypted in parallel, to hide the latency of AESENC.
+  static constexpr int pipeline_blocks = 8;
+
+  // Threads only pay off for large batches.
+  static constexpr size_t min_bytes_per_thread = size_t{1} << 18;
+
+  template <int rcon>
+  AES_CTR_TARGET static __m128i expand_round(__m128i key) {
+    __m128i assist = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(key, rcon),
+                                       _MM_SHUFFLE(3, 3, 3, 3));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+  }
+
+  AES_CTR_TARGET void expand_key(__m128i key) {
+    round_keys_[0] = key;
+    round_keys_[1] = expand_round<0x01>(round_keys_[0]);
+    round_keys_[2] = expand_round<0x02>(round_keys_[1]);
+    round_keys_[3] = expand_round<0x04>(round_keys_[2]);
+    round_keys_[4] = expand_round<0x08>(round_keys_[3]);
+    round_keys_[5] = expand_round<0x10>(round_keys_[4]);
+    round_keys_[6] = expand_round<0x20>(round_keys_[5]);
+    round_keys_[7] = expand_round<0x40>(round_keys_[6]);
+    round_keys_[8] = expand_round<0x80>(round_keys_[7]);
+    round_keys_[9] = expand_round<0x1b>(round_keys_[8]);
+    round_keys_[10] = expand_round<0x36>(round_keys_[9]);
+  }
+
+  static __m128i counter_block(uint64_t index, uint64_t block) {
+    return _mm_set_epi64x(static_cast<int64_t>(__builtin_bswap64(block)),
+                          static_cast<int64_t>(index));
+  }
+
+  // Encrypts the blocks `input(i)` for i in [begin, end) and passes the
+  // results to `output(i, block)`.
+  template <typename Input, typename Output>
+  AES_CTR_TARGET void encrypt(Input input, Output output, size_t begin,
+                              size_t end) const {
+    __m128i blocks[pipeline_blocks];
+    for (size_t i = begin; i < end; i += pipeline_blocks) {
+      int count = std::min<size_t>(pipeline_blocks, end - i);
+      for (int j = 0; j < count; j++) {
+        blocks[j] = _mm_xor_si128(input(i + j), round_keys_[0]);
+      }
+      for (int round = 1; round < 10; round++) {
+        for (int j = 0; j < count; j++) {
+          blocks[j] = _mm_aesenc_si128(blocks[j], round_keys_[round]);
+        }
+      }
+      for (int j = 0; j < count; j++) {
+        output(i + j, _mm_aesenclast_si128(blocks[j], round_keys_[10]));
+      }
+    }
+  }
+
+  // Implements crypt_rows() for the index `index_of(i)` of row i.
+  template <typename IndexOf>
+  void crypt_rows_with(uint8_t *data, size_t row_size, size_t num_rows,
+                       IndexOf index_of, int max_threads) const {
+    const size_t blocks_per_row = (row_size + block_size - 1) / block_size;
+    parallel_for(
+        num_rows, row_size, max_threads, [&](size_t begin, size_t end) {
+          encrypt(
+              [&](size_t i) {
+                return counter_block(index_of(i / blocks_per_row),
+                                     i % blocks_per_row);
+              },
+              [&](size_t i, __m128i block) {
+                size_t row = i / blocks_per_row;
+                size_t offset = (i % blocks_per_row) * block_size;
+                uint8_t *dest = data + row * row_size + offset;
+                size_t length = std::min(block_size, row_size - offset);
+                uint8_t keystream[block_size];
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(keystream),
+                                 block);
+                for (size_t j = 0; j < length; j++) {
+                  dest[j] ^= keystream[j];
+                }
+              },
+              begin * blocks_per_row, end * blocks_per_row);
+        });
+  }
+
+  // Calls `f(begin, end)` on contiguous ranges covering [0, num_items), using
+  // up to `max_threads` threads.
+  template <typename F>
+  static void parallel_for(size_t num_items, size_t bytes_per_item,
+                           int max_threads, F f) {
+    size_t num_threads = std::min<size_t>(
+        std::max(max_threads, 1),
+        std::max<size_t>(num_items * bytes_per_item / min_bytes_per_thread, 1));
+    if (num_threads == 1) {
+      f(0, num_items);
+      return;
+    }
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++) {
+      threads.emplace_back(f, num_items * t / num_threads,
+                           num_items * (t + 1) / num_threads);
+    }
+    f(0, num_items / num_threads);
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+  __m128i round_keys_[11];
+};
+
+#undef AES_CTR_TARGET
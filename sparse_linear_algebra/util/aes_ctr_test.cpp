@@ -0,0 +1,104 @@
+#include "sparse_linear_algebra/util/aes_ctr.hpp"
+#include <vector>
+#include "gtest/gtest.h"
+#include "sparse_linear_algebra/util/ctr_keystream.hpp"
+
+namespace {
+
+class AesCtrTest : public ::testing::Test {
+ protected:
+  AesCtrTest() {
+    for (int i = 0; i < 16; i++) {
+      key_[i] = 3 * i + 1;
+    }
+    gcry_cipher_open(&handle_, GCRY_CIPHER_AES128, GCRY_CIPHER_MODE_CTR, 0);
+    gcry_cipher_setkey(handle_, key_, sizeof(key_));
+  }
+
+  ~AesCtrTest() override { gcry_cipher_close(handle_); }
+
+  uint8_t key_[16];
+  gcry_cipher_hd_t handle_;
+};
+
+TEST_F(AesCtrTest, RowsMatchCtrKeystream) {
+  aes_ctr cipher(key_);
+  const uint64_t first_index = 7;
+  const size_t num_rows = 21;
+  // Rows shorter than a block, spanning a partial block, and a full block.
+  for (size_t row_size : {5, 16, 37}) {
+    std::vector<uint8_t> expected(row_size * num_rows);
+    std::vector<uint8_t> actual(expected.size());
+    for (size_t i = 0; i < num_rows; i++) {
+      ctr_keystream(handle_, first_index + i, &expected[i * row_size],
+                    row_size);
+    }
+    cipher.keystream_rows(actual.data(), row_size, num_rows, first_index);
+    EXPECT_EQ(actual, expected) << "row_size = " << row_size;
+    // Encrypting twice decrypts.
+    cipher.crypt_rows(actual.data(), row_size, num_rows, first_index);
+    EXPECT_EQ(actual, std::vector<uint8_t>(actual.size(), 0));
+  }
+}
+
+TEST_F(AesCtrTest, IndexedRowsMatchCtrKeystream) {
+  aes_ctr cipher(key_);
+  const std::vector<uint64_t> indexes = {9, 3, ~uint64_t{0}, 3, 1000};
+  const size_t row_size = 21;
+  std::vector<uint8_t> expected(row_size * indexes.size());
+  std::vector<uint8_t> actual(expected.size());
+  for (size_t i = 0; i < indexes.size(); i++) {
+    ctr_keystream(handle_, indexes[i], &expected[i * row_size], row_size);
+  }
+  cipher.crypt_indexed_rows(actual.data(), row_size, indexes.data(),
+                            indexes.size());
+  EXPECT_EQ(actual, expected);
+}
+
+TEST_F(AesCtrTest, KeystreamBlocksMatchCtrKeystream) {
+  aes_ctr cipher(key_);
+  const size_t num_blocks = 13;
+  std::vector<uint8_t> expected(16 * (num_blocks + 3));
+  ctr_keystream(handle_, 42, expected.data(), expected.size());
+  std::vector<uint8_t> actual(16 * num_blocks);
+  cipher.keystream_blocks(42, 3, actual.data(), num_blocks);
+  EXPECT_TRUE(std::equal(actual.begin(), actual.end(), expected.begin() + 48));
+}
+
+TEST_F(AesCtrTest, EncryptBlocksMatchesGcrypt) {
+  aes_ctr cipher(key_);
+  const size_t num_blocks = 11;
+  std::vector<uint8_t> in(16 * num_blocks), expected(in.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = i * 7;
+  }
+  gcry_cipher_hd_t ecb;
+  gcry_cipher_open(&ecb, GCRY_CIPHER_AES128, GCRY_CIPHER_MODE_ECB, 0);
+  gcry_cipher_setkey(ecb, key_, sizeof(key_));
+  gcry_cipher_encrypt(ecb, expected.data(), expected.size(), in.data(),
+                      in.size());
+  gcry_cipher_close(ecb);
+  std::vector<uint8_t> actual(in.size());
+  cipher.encrypt_blocks(in.data(), actual.data(), num_blocks);
+  EXPECT_EQ(actual, expected);
+  // In place.
+  cipher.encrypt_blocks(in.data(), in.data(), num_blocks);
+  EXPECT_EQ(in, expected);
+}
+
+TEST_F(AesCtrTest, ThreadsDoNotChangeOutput) {
+  aes_ctr cipher(key_);
+  // Large enough to be split across threads.
+  const size_t row_size = 24, num_rows = 100000;
+  std::vector<uint8_t> single(row_size * num_rows), multi(single.size());
+  cipher.keystream_rows(single.data(), row_size, num_rows, 5, 1);
+  cipher.keystream_rows(multi.data(), row_size, num_rows, 5, 4);
+  EXPECT_EQ(single, multi);
+  std::vector<uint8_t> blocks_single(16 * num_rows);
+  std::vector<uint8_t> blocks_multi(blocks_single.size());
+  cipher.encrypt_blocks(single.data(), blocks_single.data(), num_rows, 1);
+  cipher.encrypt_blocks(single.data(), blocks_multi.data(), num_rows, 4);
+  EXPECT_EQ(blocks_single, blocks_multi);
+}
+
+}  // namespace
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <cstring>
+#include <limits>
+#include "sparse_linear_algebra/util/aes_ctr.hpp"
+
+// A pseudorandom generator that outputs the AES-128 keystream in counter mode,
+// computed with aes_ctr. The counter block of the i-th output block holds
+// `nonce` in its low 8 bytes (little-endian) and i in its high 8 bytes
+// (big-endian), which is the layout used by ctr_keystream(). Generators with
+// the same key and different nonces thus produce independent streams.
+//
+// Satisfies the UniformRandomBitGenerator concept, but random_data() is much
+// faster for filling buffers.
+class aes_prg {
+ public:
+  using result_type = uint64_t;
+  static constexpr size_t block_size = aes_ctr::block_size;
+
+  aes_prg(const uint8_t key[block_size], uint64_t nonce = 0)
+      : cipher_(key), nonce_(nonce), counter_(0), buffered_(0) {}
+
+  // Uses `seed` in both halves of the key.
+  explicit aes_prg(uint64_t seed, uint64_t nonce = 0)
+      : cipher_(seed_key(seed).data()),
+        nonce_(nonce),
+        counter_(0),
+        buffered_(0) {}
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  result_type operator()() {
+    if (buffered_ == 0) {
+      fill_blocks(buffer_, buffer_blocks);
+      buffered_ = buffer_blocks * block_size / sizeof(result_type);
+    }
+    result_type ret;
+    std::memcpy(&ret, buffer_ + sizeof(buffer_) - buffered_ * sizeof(ret),
+                sizeof(ret));
+    buffered_--;
+    return ret;
+  }
+
+  // Writes the next `num_bytes` bytes of the stream to `out`, using up to
+  // `max_threads` threads for large outputs. Output always starts at a block
+  // boundary; the rest of a partially used block is discarded.
+  void random_data(void *out, size_t num_bytes, int max_threads = 1) {
+    uint8_t *bytes = static_cast<uint8_t *>(out);
+    size_t num_blocks = num_bytes / block_size;
+    fill_blocks(bytes, num_blocks, max_threads);
+    if (num_bytes % block_size) {
+      uint8_t last[block_size];
+      fill_blocks(last, 1);
+      std::memcpy(bytes + num_blocks * block_size, last,
+                  num_bytes % block_size);
+    }
+  }
+
+ private:
+  static constexpr int buffer_blocks = 8;
+
+  static std::array<uint8_t, block_size> seed_key(uint64_t seed) {
+    std::array<uint8_t, block_size> key;
+    std::memcpy(key.data(), &seed, sizeof(seed));
+    std::memcpy(key.data() + sizeof(seed), &seed, sizeof(seed));
+    return key;
+  }
+
+  // Writes the next `num_blocks` blocks of the stream to `out`.
+  void fill_blocks(uint8_t *out, size_t num_blocks, int max_threads = 1) {
+    cipher_.keystream_blocks(nonce_, counter_, out, num_blocks, max_threads);
+    counter_ += num_blocks;
+  }
+
+  aes_ctr cipher_;
+  uint64_t nonce_;
+  uint64_t counter_;
+  // Output of operator(), consumed from the front.
+  uint8_t buffer_[buffer_blocks * block_size];
+  int buffered_;
+};
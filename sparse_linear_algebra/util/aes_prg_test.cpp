@@ -0,0 +1,49 @@
+#include "sparse_linear_algebra/util/aes_prg.hpp"
+#include <vector>
+#include "gtest/gtest.h"
+#include "sparse_linear_algebra/util/ctr_keystream.hpp"
+
+namespace {
+
+TEST(AesPrgTest, MatchesKnownAnswer) {
+  // AES-128 of the zero block under the zero key.
+  const uint8_t expected[16] = {0x66, 0xe9, 0x4b, 0xd4, 0xef, 0x8a,
+                                0x2c, 0x3b, 0x88, 0x4c, 0xfa, 0x59,
+                                0xca, 0x34, 0x2b, 0x2e};
+  const uint8_t key[16] = {0};
+  aes_prg prg(key);
+  uint8_t out[16];
+  prg.random_data(out, sizeof(out));
+  EXPECT_TRUE(std::equal(out, out + 16, expected));
+}
+
+TEST(AesPrgTest, MatchesCtrKeystream) {
+  uint8_t key[16];
+  for (int i = 0; i < 16; i++) {
+    key[i] = i;
+  }
+  gcry_cipher_hd_t handle;
+  gcry_cipher_open(&handle, GCRY_CIPHER_AES128, GCRY_CIPHER_MODE_CTR, 0);
+  gcry_cipher_setkey(handle, key, sizeof(key));
+  // Not a multiple of the block size or the pipeline width.
+  const size_t num_bytes = 16 * 19 + 5;
+  for (uint64_t index : {uint64_t{0}, uint64_t{42}, ~uint64_t{0}}) {
+    std::vector<uint8_t> expected(num_bytes), actual(num_bytes);
+    ctr_keystream(handle, index, expected.data(), num_bytes);
+    aes_prg prg(key, index);
+    prg.random_data(actual.data(), num_bytes);
+    EXPECT_EQ(actual, expected) << "index = " << index;
+  }
+  gcry_cipher_close(handle);
+}
+
+TEST(AesPrgTest, StreamsDependOnNonce) {
+  aes_prg prg0(12345, 0), prg1(12345, 1), prg0_again(12345, 0);
+  uint64_t a = prg0(), b = prg1();
+  EXPECT_NE(a, b);
+  EXPECT_EQ(a, prg0_again());
+  // operator() continues the stream.
+  EXPECT_NE(prg0(), a);
+}
+
+}  // namespace
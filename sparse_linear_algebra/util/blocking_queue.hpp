@@ -1,6 +1,8 @@
 // StackOverflow answer by Dietmar Kühl, licensed under cc by-sa 3.0
 // https://stackoverflow.com/a/12805690
 // Adapted to support capacity.
+#pragma once
+
 #include <condition_variable>
 #include <deque>
 #include <mutex>
@@ -13,6 +15,7 @@ class blocking_queue {
   std::condition_variable d_condition_not_full;
   std::deque<T> d_queue;
   int d_capacity;
+  bool d_closed = false;
 
   bool empty() const { return d_queue.empty(); }
   bool full() const {
@@ -40,4 +43,40 @@ class blocking_queue {
     this->d_condition_not_full.notify_one();
     return rc;
   }
+  // Like pop(), but returns false instead of blocking if the queue is empty
+  // and has been closed.
+  bool pop(T* value) {
+    {
+      std::unique_lock<std::mutex> lock(this->d_mutex);
+      this->d_condition_not_empty.wait(lock,
+                                       [=] { return !empty() || d_closed; });
+      if (empty()) {
+        return false;
+      }
+      *value = std::move(this->d_queue.back());
+      this->d_queue.pop_back();
+    }
+    this->d_condition_not_full.notify_one();
+    return true;
+  }
+  // Signals that no more elements will be pushed.
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(this->d_mutex);
+      d_closed = true;
+    }
+    this->d_condition_not_empty.notify_all();
+  }
+  // Changes the capacity, waking up producers if there is room now.
+  void set_capacity(ssize_t cap) {
+    {
+      std::lock_guard<std::mutex> lock(this->d_mutex);
+      d_capacity = cap;
+    }
+    this->d_condition_not_full.notify_all();
+  }
+  size_t size() {
+    std::lock_guard<std::mutex> lock(this->d_mutex);
+    return d_queue.size();
+  }
 };
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include "gcrypt.h"
+#include "sparse_linear_algebra/util/serialize_le.hpp"
+
+// XORs `num_bytes` bytes of AES-CTR keystream for `index` into `data`, using
+// the key set on `handle`, which must be in CTR mode. The first counter block
+// holds `index` in its low 8 bytes (little-endian), and CTR mode counts the
+// following blocks in its high 8 bytes (big-endian). Obliv-C circuits that
+// recompute the keystream must build the same counter blocks.
+inline void ctr_crypt(gcry_cipher_hd_t handle, uint64_t index, uint8_t *data,
+                      size_t num_bytes) {
+  const size_t block_size = 16;
+  uint8_t ctr[block_size] = {0};
+  serialize_le(&ctr[0], &index, 1);
+  gcry_cipher_setctr(handle, ctr, block_size);
+  gcry_cipher_encrypt(handle, data, num_bytes, nullptr, 0);
+}
+
+// Writes `num_bytes` bytes of AES-CTR keystream for `index` to `out`; see
+// ctr_crypt().
+inline void ctr_keystream(gcry_cipher_hd_t handle, uint64_t index,
+                          uint8_t *out, size_t num_bytes) {
+  std::fill_n(out, num_bytes, 0);
+  ctr_crypt(handle, index, out, num_bytes);
+}
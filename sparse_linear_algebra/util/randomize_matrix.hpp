@@ -1,16 +1,31 @@
 #pragma once
 #include <Eigen/Dense>
+#include <cstring>
 #include <random>
+#include <type_traits>
+#include "sparse_linear_algebra/util/aes_prg.hpp"
 
-// fills matrix with pseudorandomly generated elements
+// fills matrix with pseudorandomly generated elements. Only a fresh AES key is
+// drawn from `r`; the elements are the keystream under that key, computed in
+// bulk with up to `max_threads` threads. `m` must be a matrix with integral
+// scalars or a block of one.
 template <class Matrix, class Generator>
-void randomize_matrix(Generator&& r, Matrix&& m) {
-  std::uniform_int_distribution<
-      typename std::remove_reference<Matrix>::type::Scalar>
-      dist;
-  for (Eigen::Index i = 0; i < m.rows(); i++) {
-    for (Eigen::Index j = 0; j < m.cols(); j++) {
-      m(i, j) = dist(r);
-    }
+void randomize_matrix(Generator&& r, Matrix&& m, int max_threads = 1) {
+  using Scalar = typename std::remove_reference<Matrix>::type::Scalar;
+  static_assert(std::is_integral<Scalar>::value,
+                "randomize_matrix requires integral scalars");
+  std::uniform_int_distribution<uint64_t> dist;
+  uint64_t key_words[2] = {dist(r), dist(r)};
+  uint8_t key[aes_prg::block_size];
+  std::memcpy(key, key_words, sizeof(key));
+  aes_prg prg(key);
+  size_t num_bytes = m.size() * sizeof(Scalar);
+  if (m.innerStride() == 1 && m.outerStride() == m.innerSize()) {
+    prg.random_data(m.data(), num_bytes, max_threads);
+  } else {
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> buffer(m.rows(),
+                                                                 m.cols());
+    prg.random_data(buffer.data(), num_bytes, max_threads);
+    m = buffer;
   }
 }
@@ -0,0 +1,313 @@
+// Matrix products over the ring of integers modulo 2^(8 * sizeof(T)), as used
+// for the local share products in the multiplication protocols. Eigen's
+// integer products are not vectorized like its floating point ones, so for
+// uint32_t and uint64_t we use a cache-blocked kernel with AVX2 / AVX-512
+// inner loops whenever the compiler targets those instruction sets (e.g., via
+// `bazel build --config=native`). Everything else falls back to Eigen.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "Eigen/Dense"
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace ring_gemm_internal {
+
+using Eigen::Index;
+
+// Vector registers for a scalar type. Only specialized for the types and
+// instruction sets the kernel supports.
+template <typename T>
+struct simd;
+
+template <typename T, typename = void>
+struct is_vectorized : std::false_type {};
+template <typename T>
+struct is_vectorized<T, decltype(void(simd<T>::width))> : std::true_type {};
+
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+template <>
+struct simd<uint64_t> {
+  using reg = __m512i;
+  static constexpr int width = 8;
+  static reg load(const uint64_t* p) { return _mm512_loadu_si512(p); }
+  static void store(uint64_t* p, reg x) { _mm512_storeu_si512(p, x); }
+  static reg set1(uint64_t x) { return _mm512_set1_epi64(x); }
+  static reg zero() { return _mm512_setzero_si512(); }
+  static reg add(reg a, reg b) { return _mm512_add_epi64(a, b); }
+  static reg mul(reg a, reg b) { return _mm512_mullo_epi64(a, b); }
+};
+#elif defined(__AVX2__)
+template <>
+struct simd<uint64_t> {
+  using reg = __m256i;
+  static constexpr int width = 4;
+  static reg load(const uint64_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static void store(uint64_t* p, reg x) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x);
+  }
+  static reg set1(uint64_t x) { return _mm256_set1_epi64x(x); }
+  static reg zero() { return _mm256_setzero_si256(); }
+  static reg add(reg a, reg b) { return _mm256_add_epi64(a, b); }
+  // AVX2 has no 64-bit multiplication, so compose it from 32-bit halves:
+  // a * b = lo(a) * lo(b) + ((hi(a) * lo(b) + lo(a) * hi(b)) << 32).
+  static reg mul(reg a, reg b) {
+    reg cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                 _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b),
+                            _mm256_slli_epi64(cross, 32));
+  }
+};
+#endif
+
+#if defined(__AVX512F__)
+template <>
+struct simd<uint32_t> {
+  using reg = __m512i;
+  static constexpr int width = 16;
+  static reg load(const uint32_t* p) { return _mm512_loadu_si512(p); }
+  static void store(uint32_t* p, reg x) { _mm512_storeu_si512(p, x); }
+  static reg set1(uint32_t x) { return _mm512_set1_epi32(x); }
+  static reg zero() { return _mm512_setzero_si512(); }
+  static reg add(reg a, reg b) { return _mm512_add_epi32(a, b); }
+  static reg mul(reg a, reg b) { return _mm512_mullo_epi32(a, b); }
+};
+#elif defined(__AVX2__)
+template <>
+struct simd<uint32_t> {
+  using reg = __m256i;
+  static constexpr int width = 8;
+  static reg load(const uint32_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  }
+  static void store(uint32_t* p, reg x) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x);
+  }
+  static reg set1(uint32_t x) { return _mm256_set1_epi32(x); }
+  static reg zero() { return _mm256_setzero_si256(); }
+  static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+  static reg mul(reg a, reg b) { return _mm256_mullo_epi32(a, b); }
+};
+#endif
+
+// Blocking parameters. A packed (kBlockRows x kBlockDepth) panel of A stays in
+// L2 while it is multiplied with all columns of B; the micro-kernel keeps a
+// (kStripRegisters * width) x kColumns block of C in registers.
+constexpr Index kBlockRows = 128;
+constexpr Index kBlockDepth = 256;
+constexpr Index kColumns = 4;
+constexpr int kStripRegisters = 2;
+// Rows of y that the matrix-vector kernel updates at once.
+constexpr Index kGemvRows = 512;
+// Products with fewer multiplications are left to Eigen.
+constexpr Index kMinKernelSize = 1024;
+
+// Adds the product of a packed strip of A (`depth` columns of `strip` rows
+// each) and `NC` columns of B to the first `rows` rows of C.
+template <typename T, int NC>
+void micro_kernel(Index depth, const T* a, const T* b, Index ldb, T* c,
+                  Index ldc, Index rows) {
+  using S = simd<T>;
+  constexpr Index strip = kStripRegisters * S::width;
+  typename S::reg acc[kStripRegisters][NC];
+  for (int r = 0; r < kStripRegisters; r++) {
+    for (int j = 0; j < NC; j++) {
+      acc[r][j] = S::zero();
+    }
+  }
+  for (Index k = 0; k < depth; k++) {
+    typename S::reg a_k[kStripRegisters];
+    for (int r = 0; r < kStripRegisters; r++) {
+      a_k[r] = S::load(a + k * strip + r * S::width);
+    }
+    for (int j = 0; j < NC; j++) {
+      typename S::reg b_kj = S::set1(b[k + j * ldb]);
+      for (int r = 0; r < kStripRegisters; r++) {
+        acc[r][j] = S::add(acc[r][j], S::mul(a_k[r], b_kj));
+      }
+    }
+  }
+  for (int j = 0; j < NC; j++) {
+    T* c_j = c + j * ldc;
+    if (rows == strip) {
+      for (int r = 0; r < kStripRegisters; r++) {
+        T* dst = c_j + r * S::width;
+        S::store(dst, S::add(S::load(dst), acc[r][j]));
+      }
+    } else {
+      T tmp[strip];
+      for (int r = 0; r < kStripRegisters; r++) {
+        S::store(tmp + r * S::width, acc[r][j]);
+      }
+      for (Index i = 0; i < rows; i++) {
+        c_j[i] += tmp[i];
+      }
+    }
+  }
+}
+
+// C (l x n) += A (l x m) * B (m x n), all column-major with the given leading
+// dimensions.
+template <typename T>
+void gemm(Index l, Index m, Index n, const T* A, Index lda, const T* B,
+          Index ldb, T* C, Index ldc) {
+  constexpr Index strip = kStripRegisters * simd<T>::width;
+  constexpr Index block_rows = (kBlockRows + strip - 1) / strip * strip;
+  std::vector<T> packed(block_rows * kBlockDepth);
+  for (Index k0 = 0; k0 < m; k0 += kBlockDepth) {
+    Index depth = std::min(kBlockDepth, m - k0);
+    for (Index i0 = 0; i0 < l; i0 += block_rows) {
+      Index rows = std::min(block_rows, l - i0);
+      Index num_strips = (rows + strip - 1) / strip;
+      // Pack the block of A strip by strip, so the micro-kernel reads it
+      // sequentially. Rows past the end are zero.
+      for (Index s = 0; s < num_strips; s++) {
+        T* dst = packed.data() + s * depth * strip;
+        Index strip_rows = std::min(strip, rows - s * strip);
+        for (Index k = 0; k < depth; k++) {
+          const T* src = A + (k0 + k) * lda + i0 + s * strip;
+          std::copy(src, src + strip_rows, dst + k * strip);
+          std::fill(dst + k * strip + strip_rows, dst + (k + 1) * strip, T(0));
+        }
+      }
+      for (Index j = 0; j < n; j += kColumns) {
+        const T* b = B + j * ldb + k0;
+        for (Index s = 0; s < num_strips; s++) {
+          const T* a = packed.data() + s * depth * strip;
+          T* c = C + j * ldc + i0 + s * strip;
+          Index strip_rows = std::min(strip, rows - s * strip);
+          switch (std::min(kColumns, n - j)) {
+            case 4:
+              micro_kernel<T, 4>(depth, a, b, ldb, c, ldc, strip_rows);
+              break;
+            case 3:
+              micro_kernel<T, 3>(depth, a, b, ldb, c, ldc, strip_rows);
+              break;
+            case 2:
+              micro_kernel<T, 2>(depth, a, b, ldb, c, ldc, strip_rows);
+              break;
+            default:
+              micro_kernel<T, 1>(depth, a, b, ldb, c, ldc, strip_rows);
+          }
+        }
+      }
+    }
+  }
+}
+
+// y (l) += A (l x m) * x (m), with A column-major. Used for n == 1, where
+// packing does not pay off since every element of A is used only once.
+template <typename T>
+void gemv(Index l, Index m, const T* A, Index lda, const T* x, T* y) {
+  using S = simd<T>;
+  for (Index i0 = 0; i0 < l; i0 += kGemvRows) {
+    Index rows = std::min(kGemvRows, l - i0);
+    Index vector_rows = rows / S::width * S::width;
+    T* y_block = y + i0;
+    Index k = 0;
+    for (; k + 4 <= m; k += 4) {
+      const T* a0 = A + k * lda + i0;
+      const T* a1 = a0 + lda;
+      const T* a2 = a1 + lda;
+      const T* a3 = a2 + lda;
+      typename S::reg x0 = S::set1(x[k]), x1 = S::set1(x[k + 1]);
+      typename S::reg x2 = S::set1(x[k + 2]), x3 = S::set1(x[k + 3]);
+      for (Index i = 0; i < vector_rows; i += S::width) {
+        typename S::reg acc = S::load(y_block + i);
+        acc = S::add(acc, S::mul(S::load(a0 + i), x0));
+        acc = S::add(acc, S::mul(S::load(a1 + i), x1));
+        acc = S::add(acc, S::mul(S::load(a2 + i), x2));
+        acc = S::add(acc, S::mul(S::load(a3 + i), x3));
+        S::store(y_block + i, acc);
+      }
+      for (Index i = vector_rows; i < rows; i++) {
+        y_block[i] += a0[i] * x[k] + a1[i] * x[k + 1] + a2[i] * x[k + 2] +
+                      a3[i] * x[k + 3];
+      }
+    }
+    for (; k < m; k++) {
+      const T* a = A + k * lda + i0;
+      typename S::reg x_k = S::set1(x[k]);
+      for (Index i = 0; i < vector_rows; i += S::width) {
+        S::store(y_block + i,
+                 S::add(S::load(y_block + i), S::mul(S::load(a + i), x_k)));
+      }
+      for (Index i = vector_rows; i < rows; i++) {
+        y_block[i] += a[i] * x[k];
+      }
+    }
+  }
+}
+
+template <typename Derived_A, typename Derived_B, typename Derived_C>
+void ring_gemm(const Derived_A& A, const Derived_B& B, Derived_C& C,
+               std::false_type) {
+  C.noalias() += A * B;
+}
+
+template <typename Derived_A, typename Derived_B, typename Derived_C>
+void ring_gemm(const Derived_A& A, const Derived_B& B, Derived_C& C,
+               std::true_type) {
+  using T = typename Derived_C::Scalar;
+  if (C.innerStride() != 1 || A.rows() * A.cols() * B.cols() < kMinKernelSize) {
+    C.noalias() += A * B;
+    return;
+  }
+  // Binding to a Ref copies operands that are not column-major with unit inner
+  // stride. This is cheap compared to the product itself.
+  using Ref = Eigen::Ref<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>,
+                         0, Eigen::OuterStride<>>;
+  Ref A_ref(A), B_ref(B);
+  if (B.cols() == 1) {
+    gemv<T>(A.rows(), A.cols(), A_ref.data(), A_ref.outerStride(),
+            B_ref.data(), C.data());
+  } else {
+    gemm<T>(A.rows(), A.cols(), B.cols(), A_ref.data(), A_ref.outerStride(),
+            B_ref.data(), B_ref.outerStride(), C.data(), C.outerStride());
+  }
+}
+
+}  // namespace ring_gemm_internal
+
+// Adds A * B to C, wrapping around modulo 2^(8 * sizeof(T)). C must not alias
+// A or B. Uses the vectorized kernel if it supports the scalar type and C is a
+// column-major block with direct access, and Eigen otherwise.
+template <typename Derived_A, typename Derived_B, typename Derived_C>
+void ring_gemm(const Eigen::MatrixBase<Derived_A>& A,
+               const Eigen::MatrixBase<Derived_B>& B,
+               const Eigen::MatrixBase<Derived_C>& C_out) {
+  using T = typename Derived_C::Scalar;
+  static_assert(std::is_same<T, typename Derived_A::Scalar>::value &&
+                    std::is_same<T, typename Derived_B::Scalar>::value,
+                "Scalar types must match");
+  // Eigen's idiom for writing to expressions passed as MatrixBase.
+  Derived_C& C = const_cast<Eigen::MatrixBase<Derived_C>&>(C_out).derived();
+  eigen_assert(A.cols() == B.rows() && A.rows() == C.rows() &&
+               B.cols() == C.cols());
+  using use_kernel = std::integral_constant<
+      bool, ring_gemm_internal::is_vectorized<T>::value &&
+                !(Derived_C::Flags & Eigen::RowMajorBit) &&
+                (Derived_C::Flags & Eigen::DirectAccessBit)>;
+  ring_gemm_internal::ring_gemm(A.derived(), B.derived(), C, use_kernel());
+}
+
+// Returns A * B, computed with ring_gemm.
+template <typename Derived_A, typename Derived_B>
+Eigen::Matrix<typename Derived_A::Scalar, Derived_A::RowsAtCompileTime,
+              Derived_B::ColsAtCompileTime>
+ring_product(const Eigen::MatrixBase<Derived_A>& A,
+             const Eigen::MatrixBase<Derived_B>& B) {
+  using result_type =
+      Eigen::Matrix<typename Derived_A::Scalar, Derived_A::RowsAtCompileTime,
+                    Derived_B::ColsAtCompileTime>;
+  result_type result = result_type::Zero(A.rows(), B.cols());
+  ring_gemm(A, B, result);
+  return result;
+}
@@ -0,0 +1,47 @@
+// Compares ring_gemm against Eigen's integer product for the shapes of the
+// local share products in the dense multiplication protocol. Build with
+// `--config=native` to enable the vectorized kernel.
+
+#include <random>
+#include "benchmark/benchmark.h"
+#include "sparse_linear_algebra/util/randomize_matrix.hpp"
+#include "sparse_linear_algebra/util/ring_gemm.hpp"
+
+namespace {
+
+template <typename T>
+using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+template <typename T, bool use_ring_gemm>
+void BM_Product(benchmark::State& state) {
+  const int l = state.range(0), m = state.range(1), n = state.range(2);
+  std::mt19937 rng(12345);
+  Matrix<T> A(l, m), B(m, n), C = Matrix<T>::Zero(l, n);
+  randomize_matrix(rng, A);
+  randomize_matrix(rng, B);
+  for (auto _ : state) {
+    if (use_ring_gemm) {
+      ring_gemm(A, B, C);
+    } else {
+      C.noalias() += A * B;
+    }
+    benchmark::DoNotOptimize(C.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(l) * m * n);
+}
+
+// Chunk products of KNN and SGD (n = 1) and of general dense multiplication.
+void Shapes(benchmark::internal::Benchmark* b) {
+  b->Args({2048, 4096, 1});
+  b->Args({1024, 16384, 1});
+  b->Args({256, 256, 256});
+  b->Args({2048, 1024, 32});
+}
+
+BENCHMARK_TEMPLATE(BM_Product, uint64_t, false)->Apply(Shapes);
+BENCHMARK_TEMPLATE(BM_Product, uint64_t, true)->Apply(Shapes);
+BENCHMARK_TEMPLATE(BM_Product, uint32_t, false)->Apply(Shapes);
+BENCHMARK_TEMPLATE(BM_Product, uint32_t, true)->Apply(Shapes);
+
+}  // namespace
@@ -0,0 +1,90 @@
+#include "sparse_linear_algebra/util/ring_gemm.hpp"
+#include <random>
+#include "gtest/gtest.h"
+#include "sparse_linear_algebra/util/randomize_matrix.hpp"
+
+namespace {
+
+template <typename T>
+using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+template <typename T>
+class RingGemmTest : public ::testing::Test {
+ protected:
+  RingGemmTest() : rng_(12345) {}
+
+  Matrix<T> Random(int rows, int cols) {
+    Matrix<T> result(rows, cols);
+    randomize_matrix(rng_, result);
+    return result;
+  }
+
+  // Schoolbook product with explicit wrap-around, independent of Eigen's
+  // product code.
+  static Matrix<T> Naive(const Matrix<T>& A, const Matrix<T>& B) {
+    Matrix<T> result = Matrix<T>::Zero(A.rows(), B.cols());
+    for (int i = 0; i < A.rows(); i++) {
+      for (int j = 0; j < B.cols(); j++) {
+        for (int k = 0; k < A.cols(); k++) {
+          result(i, j) += static_cast<T>(static_cast<uint64_t>(A(i, k)) *
+                                         static_cast<uint64_t>(B(k, j)));
+        }
+      }
+    }
+    return result;
+  }
+
+  std::mt19937 rng_;
+};
+
+using MyTypes = ::testing::Types<uint16_t, uint32_t, uint64_t>;
+TYPED_TEST_SUITE(RingGemmTest, MyTypes);
+
+TYPED_TEST(RingGemmTest, MatchesNaiveProduct) {
+  // Covers tiny products handled by Eigen, partial strips and column blocks,
+  // and inner dimensions spanning several depth blocks.
+  for (int l : {1, 7, 33, 150}) {
+    for (int m : {1, 5, 300}) {
+      for (int n : {1, 2, 5, 9}) {
+        auto A = this->Random(l, m);
+        auto B = this->Random(m, n);
+        auto C = this->Random(l, n);
+        Matrix<TypeParam> expected = C + this->Naive(A, B);
+        ring_gemm(A, B, C);
+        EXPECT_EQ(C, expected) << "l = " << l << ", m = " << m << ", n = " << n;
+      }
+    }
+  }
+}
+
+TYPED_TEST(RingGemmTest, Blocks) {
+  auto A = this->Random(70, 40);
+  auto B = this->Random(40, 6);
+  Matrix<TypeParam> C = Matrix<TypeParam>::Zero(100, 6);
+  ring_gemm(A.topRows(50), B, C.middleRows(20, 50));
+  EXPECT_EQ(C.middleRows(20, 50), this->Naive(A.topRows(50), B));
+  EXPECT_TRUE(C.topRows(20).isZero());
+  EXPECT_TRUE(C.bottomRows(30).isZero());
+}
+
+TYPED_TEST(RingGemmTest, RowMajorOperands) {
+  using RowMajor =
+      Eigen::Matrix<TypeParam, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+  auto A = this->Random(60, 30);
+  auto B = this->Random(30, 1);
+  RowMajor A_row = A;
+  RowMajor C_row = RowMajor::Zero(60, 1);
+  Matrix<TypeParam> C = Matrix<TypeParam>::Zero(60, 1);
+  ring_gemm(A_row, B, C);
+  ring_gemm(A, B, C_row);
+  EXPECT_EQ(C, this->Naive(A, B));
+  EXPECT_EQ(Matrix<TypeParam>(C_row), this->Naive(A, B));
+}
+
+TYPED_TEST(RingGemmTest, Product) {
+  auto A = this->Random(40, 64);
+  auto B = this->Random(64, 3);
+  EXPECT_EQ(ring_product(A, B), this->Naive(A, B));
+}
+
+}  // namespace
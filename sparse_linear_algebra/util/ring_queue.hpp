@@ -0,0 +1,407 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A lock-free FIFO queue for any number of producers and consumers, with the
+// same interface as blocking_queue except that elements are moved in and out
+// instead of copied.
+//
+// Elements live in a ring of cells with sequence numbers, as in Dmitry Vyukov's
+// bounded MPMC queue, so that push and pop each take a single CAS on the ring
+// when uncontended. The capacity passed at construction is enforced by a
+// separate counter, so it can be changed at any time. If a ring runs full,
+// producers seal it and continue in a new ring of twice the size, which
+// consumers move on to once the sealed ring is drained. Old rings are only
+// freed with the queue, which takes at most twice the memory of the largest
+// ring.
+//
+// Threads that have to wait spin and yield for a short while and then park on a
+// condition variable. The mutex is only touched if some thread is parked.
+template <typename T>
+class ring_queue {
+ public:
+  explicit ring_queue(ssize_t cap = -1)
+      : first_(new ring(initial_ring_size(cap))),
+        head_(first_),
+        tail_(first_),
+        size_(0),
+        capacity_(cap),
+        closed_(false) {}
+
+  ~ring_queue() {
+    ring* r = first_;
+    while (r != nullptr) {
+      ring* next = r->next.load(std::memory_order_relaxed);
+      delete r;
+      r = next;
+    }
+  }
+
+  ring_queue(const ring_queue&) = delete;
+  ring_queue& operator=(const ring_queue&) = delete;
+
+  // Pushes `value`, blocking while the queue is at capacity.
+  void push(T&& value) {
+    wait(&not_full_, [this] { return try_reserve(); });
+    enqueue(&value);
+    notify(&not_empty_);
+  }
+
+  // Like push(), but returns false instead of blocking if the queue is at
+  // capacity. `value` is left untouched in that case.
+  bool try_push(T&& value) {
+    if (!try_reserve()) {
+      return false;
+    }
+    enqueue(&value);
+    notify(&not_empty_);
+    return true;
+  }
+
+  T pop() {
+    T value;
+    wait(&not_empty_, [&] { return try_pop(&value); });
+    return value;
+  }
+
+  // Like pop(), but returns false instead of blocking if the queue is empty
+  // and has been closed.
+  bool pop(T* value) {
+    bool popped = false;
+    wait(&not_empty_, [&] {
+      popped = try_pop(value);
+      return popped || closed_.load(std::memory_order_acquire);
+    });
+    // Elements pushed before close() are visible once it has been observed.
+    return popped || try_pop(value);
+  }
+
+  // Pops the next element into `value` if there is one. Returns false without
+  // blocking otherwise.
+  bool try_pop(T* value) {
+    if (!dequeue(value)) {
+      return false;
+    }
+    release(1);
+    return true;
+  }
+
+  // Appends up to `max_num` elements to `out` without blocking, and returns
+  // how many were appended. Cheaper than popping them one by one, since
+  // producers are only notified once.
+  size_t try_pop_batch(std::vector<T>* out, size_t max_num) {
+    size_t num = 0;
+    T value;
+    while (num < max_num && dequeue(&value)) {
+      out->push_back(std::move(value));
+      num++;
+    }
+    if (num > 0) {
+      release(num);
+    }
+    return num;
+  }
+
+  // Like try_pop_batch(), but first blocks until at least one element is
+  // available or the queue has been closed. Returns zero only if the queue is
+  // empty and closed, or if `max_num` is zero.
+  size_t pop_batch(std::vector<T>* out, size_t max_num) {
+    if (max_num == 0) {
+      return 0;
+    }
+    T value;
+    if (!pop(&value)) {
+      return 0;
+    }
+    out->push_back(std::move(value));
+    return 1 + try_pop_batch(out, max_num - 1);
+  }
+
+  // Signals that no more elements will be pushed.
+  void close() {
+    closed_.store(true, std::memory_order_release);
+    notify(&not_empty_);
+  }
+
+  // Changes the capacity, waking up producers if there is room now.
+  void set_capacity(ssize_t cap) {
+    capacity_.store(cap, std::memory_order_release);
+    notify(&not_full_);
+  }
+
+  // Number of elements in the queue, including those still being pushed.
+  size_t size() const { return size_.load(std::memory_order_acquire); }
+
+ private:
+  // Number of times a waiting thread spins, and then yields, before parking.
+  // Spinning is skipped on a single core, where it only delays the thread
+  // being waited for.
+  static constexpr int spin_iterations = 128;
+  static constexpr int yield_iterations = 16;
+
+  // Set in a ring's enqueue position once it has been sealed.
+  static constexpr size_t sealed_bit = ~(~size_t(0) >> 1);
+
+  static constexpr size_t min_ring_size = 16;
+
+  // A bounded ring of cells. The cell for position i has sequence number i
+  // while it is free for the i-th push, and i + 1 once that push has
+  // completed. Popping it sets the sequence number to i + size, freeing the
+  // cell for the next lap.
+  struct ring {
+    enum pop_result { popped, empty, drained };
+
+    explicit ring(size_t size) : mask(size - 1), cells(new cell[size]) {
+      for (size_t i = 0; i < size; i++) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      enqueue_pos.store(0, std::memory_order_relaxed);
+      dequeue_pos.store(0, std::memory_order_relaxed);
+      next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    // Destroys the elements that were never popped.
+    ~ring() {
+      size_t end = enqueue_pos.load(std::memory_order_relaxed) & ~sealed_bit;
+      for (size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+           pos < end; pos++) {
+        cells[pos & mask].value()->~T();
+      }
+    }
+
+    size_t size() const { return mask + 1; }
+
+    // Moves `*value` into the ring. Returns false if the ring has been sealed
+    // or was full, in which case this call sealed it.
+    bool try_push(T* value) {
+      size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+      cell* c;
+      for (;;) {
+        if (pos & sealed_bit) {
+          return false;
+        }
+        c = &cells[pos & mask];
+        size_t seq = c->sequence.load(std::memory_order_acquire);
+        intptr_t diff =
+            static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+          if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          if (enqueue_pos.compare_exchange_strong(pos, pos | sealed_bit,
+                                                  std::memory_order_acq_rel)) {
+            return false;
+          }
+        } else {
+          pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+      }
+      new (c->value()) T(std::move(*value));
+      c->sequence.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Moves the next element into `*value`. Returns `empty` if there is none
+    // yet, and `drained` if there will be none since the ring is sealed.
+    pop_result try_pop(T* value) {
+      size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+      cell* c;
+      for (;;) {
+        c = &cells[pos & mask];
+        size_t seq = c->sequence.load(std::memory_order_acquire);
+        intptr_t diff =
+            static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+        if (diff == 0) {
+          if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          // Either empty, or the push for `pos` is still in progress.
+          size_t end = enqueue_pos.load(std::memory_order_acquire);
+          return end == (pos | sealed_bit) ? drained : empty;
+        } else {
+          pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+      }
+      *value = std::move(*c->value());
+      c->value()->~T();
+      c->sequence.store(pos + mask + 1, std::memory_order_release);
+      return popped;
+    }
+
+    struct cell {
+      std::atomic<size_t> sequence;
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+      T* value() { return reinterpret_cast<T*>(&storage); }
+    };
+
+    // Producers and consumers each get their own cache line.
+    std::atomic<size_t> enqueue_pos;
+    char padding1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> dequeue_pos;
+    char padding2[64 - sizeof(std::atomic<size_t>)];
+    const size_t mask;
+    std::unique_ptr<cell[]> cells;
+    std::atomic<ring*> next;
+  };
+
+  // Threads parked until some condition may have changed.
+  struct waiters {
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::atomic<int> count{0};
+  };
+
+  static size_t initial_ring_size(ssize_t cap) {
+    size_t size = min_ring_size;
+    while (cap > 0 && size < static_cast<size_t>(cap)) {
+      size *= 2;
+    }
+    return size;
+  }
+
+  static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+
+  // Waits until `ready()` returns true, calling it repeatedly.
+  template <typename Predicate>
+  static void wait(waiters* w, Predicate ready) {
+    static const int num_spins =
+        std::thread::hardware_concurrency() > 1 ? spin_iterations : 0;
+    for (int i = 0; i < num_spins; i++) {
+      if (ready()) {
+        return;
+      }
+      cpu_relax();
+    }
+    for (int i = 0; i < yield_iterations; i++) {
+      if (ready()) {
+        return;
+      }
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock(w->mutex);
+    // Pairs with the read-modify-write in notify(): either the notifying
+    // thread sees the incremented count, or this one synchronizes with it and
+    // `ready()` sees its update.
+    w->count.fetch_add(1, std::memory_order_acq_rel);
+    w->condition.wait(lock, ready);
+    w->count.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // Wakes up the threads parked on `w`, if any.
+  static void notify(waiters* w) {
+    if (w->count.fetch_add(0, std::memory_order_acq_rel) > 0) {
+      // Taking the mutex ensures that threads which have seen the count
+      // incremented are already waiting.
+      { std::lock_guard<std::mutex> lock(w->mutex); }
+      w->condition.notify_all();
+    }
+  }
+
+  // Reserves room for an element if the queue is below capacity.
+  bool try_reserve() {
+    size_t size = size_.load(std::memory_order_relaxed);
+    for (;;) {
+      ssize_t cap = capacity_.load(std::memory_order_acquire);
+      if (cap != -1 && size >= static_cast<size_t>(cap)) {
+        return false;
+      }
+      if (size_.compare_exchange_weak(size, size + 1,
+                                      std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+  }
+
+  // Returns the room of `num` popped elements.
+  void release(size_t num) {
+    size_.fetch_sub(num, std::memory_order_relaxed);
+    notify(&not_full_);
+  }
+
+  // Moves `*value` into the newest ring, growing the queue if it is full.
+  void enqueue(T* value) {
+    ring* r = tail_.load(std::memory_order_acquire);
+    while (!r->try_push(value)) {
+      ring* next = r->next.load(std::memory_order_acquire);
+      if (next == nullptr) {
+        std::unique_ptr<ring> grown(new ring(2 * r->size()));
+        if (r->next.compare_exchange_strong(next, grown.get(),
+                                            std::memory_order_acq_rel)) {
+          next = grown.release();
+        }
+      }
+      if (tail_.compare_exchange_strong(r, next, std::memory_order_acq_rel)) {
+        r = next;
+      }
+    }
+  }
+
+  // Moves the oldest element into `*value`, if there is one.
+  bool dequeue(T* value) {
+    ring* r = head_.load(std::memory_order_acquire);
+    for (;;) {
+      switch (r->try_pop(value)) {
+        case ring::popped:
+          return true;
+        case ring::empty:
+          return false;
+        case ring::drained: {
+          ring* next = r->next.load(std::memory_order_acquire);
+          if (next == nullptr) {
+            // The producer that sealed `r` has not linked its successor yet.
+            return false;
+          }
+          if (head_.compare_exchange_strong(r, next,
+                                            std::memory_order_acq_rel)) {
+            r = next;
+          }
+        }
+      }
+    }
+  }
+
+  // The oldest ring, from which all others can be reached.
+  ring* const first_;
+
+  // The ring consumers pop from.
+  std::atomic<ring*> head_;
+
+  // The ring producers push to.
+  std::atomic<ring*> tail_;
+
+  // Number of elements, including reserved ones that are still being pushed.
+  std::atomic<size_t> size_;
+
+  std::atomic<ssize_t> capacity_;
+  std::atomic<bool> closed_;
+
+  waiters not_empty_;
+  waiters not_full_;
+};
+
+template <typename T>
+constexpr int ring_queue<T>::spin_iterations;
+template <typename T>
+constexpr int ring_queue<T>::yield_iterations;
+template <typename T>
+constexpr size_t ring_queue<T>::sealed_bit;
+template <typename T>
+constexpr size_t ring_queue<T>::min_ring_size;
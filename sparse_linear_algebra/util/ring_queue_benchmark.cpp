@@ -0,0 +1,71 @@
+// Compares ring_queue against blocking_queue for passing triples from
+// background producers to consumers, as the triple providers do. Arguments
+// are the number of producers, consumers, and the queue capacity (-1 for
+// unbounded).
+
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "Eigen/Dense"
+#include "benchmark/benchmark.h"
+#include "sparse_linear_algebra/util/blocking_queue.hpp"
+#include "sparse_linear_algebra/util/ring_queue.hpp"
+
+namespace {
+
+using Matrix = Eigen::Matrix<uint64_t, Eigen::Dynamic, Eigen::Dynamic>;
+using Triple = std::tuple<Matrix, Matrix, Matrix>;
+
+constexpr int kItemsPerProducer = 20000;
+
+// Small matrices, so that the queue dominates.
+Triple MakeTriple() {
+  return std::make_tuple(Matrix::Zero(4, 4), Matrix::Zero(4, 1),
+                         Matrix::Zero(4, 1));
+}
+
+template <typename Queue>
+void BM_Contention(benchmark::State& state) {
+  const int num_producers = state.range(0), num_consumers = state.range(1);
+  const int total = num_producers * kItemsPerProducer;
+  for (auto _ : state) {
+    Queue queue(state.range(2));
+    std::vector<std::thread> threads;
+    for (int p = 0; p < num_producers; p++) {
+      threads.emplace_back([&] {
+        for (int i = 0; i < kItemsPerProducer; i++) {
+          queue.push(MakeTriple());
+        }
+      });
+    }
+    for (int c = 0; c < num_consumers; c++) {
+      // Split the items evenly, with the first consumers taking the rest.
+      int num = total / num_consumers + (c < total % num_consumers);
+      threads.emplace_back([&queue, num] {
+        for (int i = 0; i < num; i++) {
+          Triple triple = queue.pop();
+          benchmark::DoNotOptimize(std::get<0>(triple).data());
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(total));
+}
+
+void Configurations(benchmark::internal::Benchmark* b) {
+  b->Args({1, 1, 64});
+  b->Args({4, 1, 64});
+  b->Args({1, 4, 64});
+  b->Args({4, 4, 64});
+  b->Args({4, 4, -1});
+  b->UseRealTime();
+}
+
+BENCHMARK_TEMPLATE(BM_Contention, blocking_queue<Triple>)
+    ->Apply(Configurations);
+BENCHMARK_TEMPLATE(BM_Contention, ring_queue<Triple>)->Apply(Configurations);
+
+}  // namespace
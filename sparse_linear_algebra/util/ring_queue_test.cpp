@@ -0,0 +1,164 @@
+#include "sparse_linear_algebra/util/ring_queue.hpp"
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include "gtest/gtest.h"
+
+namespace {
+
+TEST(RingQueueTest, IsFifo) {
+  ring_queue<int> queue;
+  for (int i = 0; i < 100; i++) {
+    queue.push(int(i));
+  }
+  EXPECT_EQ(queue.size(), 100);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(queue.pop(), i);
+  }
+  int value;
+  EXPECT_FALSE(queue.try_pop(&value));
+}
+
+TEST(RingQueueTest, MovesElements) {
+  ring_queue<std::unique_ptr<int>> queue;
+  queue.push(std::unique_ptr<int>(new int(42)));
+  std::unique_ptr<int> value = queue.pop();
+  ASSERT_NE(value, nullptr);
+  EXPECT_EQ(*value, 42);
+}
+
+TEST(RingQueueTest, DestroysRemainingElements) {
+  std::shared_ptr<int> shared(new int(0));
+  {
+    ring_queue<std::shared_ptr<int>> queue;
+    for (int i = 0; i < 50; i++) {
+      queue.push(std::shared_ptr<int>(shared));
+    }
+    queue.pop();
+    EXPECT_EQ(shared.use_count(), 50);
+  }
+  EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST(RingQueueTest, RespectsCapacity) {
+  ring_queue<int> queue(2);
+  EXPECT_TRUE(queue.try_push(1));
+  EXPECT_TRUE(queue.try_push(2));
+  EXPECT_FALSE(queue.try_push(3));
+  queue.set_capacity(3);
+  EXPECT_TRUE(queue.try_push(3));
+  EXPECT_EQ(queue.pop(), 1);
+  EXPECT_TRUE(queue.try_push(4));
+  EXPECT_EQ(queue.size(), 3);
+}
+
+TEST(RingQueueTest, SetCapacityWakesProducer) {
+  ring_queue<int> queue(1);
+  queue.push(1);
+  std::thread producer([&] { queue.push(2); });
+  queue.set_capacity(-1);
+  producer.join();
+  EXPECT_EQ(queue.size(), 2);
+}
+
+TEST(RingQueueTest, PopReturnsFalseWhenClosed) {
+  ring_queue<int> queue;
+  std::thread producer([&] {
+    queue.push(1);
+    queue.close();
+  });
+  int value;
+  EXPECT_TRUE(queue.pop(&value));
+  EXPECT_EQ(value, 1);
+  EXPECT_FALSE(queue.pop(&value));
+  producer.join();
+}
+
+TEST(RingQueueTest, PopBatch) {
+  ring_queue<int> queue;
+  for (int i = 0; i < 5; i++) {
+    queue.push(int(i));
+  }
+  std::vector<int> values;
+  EXPECT_EQ(queue.pop_batch(&values, 3), 3);
+  EXPECT_EQ(queue.try_pop_batch(&values, 10), 2);
+  EXPECT_EQ(values, std::vector<int>({0, 1, 2, 3, 4}));
+  EXPECT_EQ(queue.size(), 0);
+  queue.close();
+  EXPECT_EQ(queue.pop_batch(&values, 3), 0);
+}
+
+// Several producers push increasing values through a small bounded queue
+// while several consumers pop them. Every value arrives exactly once, and the
+// values of each producer arrive in order at each consumer.
+TEST(RingQueueTest, ConcurrentProducersAndConsumers) {
+  const int num_producers = 3, num_consumers = 3, num_values = 20000;
+  ring_queue<std::pair<int, int>> queue(8);
+  std::vector<std::vector<int>> received(num_producers * num_consumers);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < num_producers; p++) {
+    threads.emplace_back([&, p] {
+      for (int i = 0; i < num_values; i++) {
+        queue.push(std::make_pair(p, i));
+      }
+    });
+  }
+  for (int c = 0; c < num_consumers; c++) {
+    threads.emplace_back([&, c] {
+      std::pair<int, int> value;
+      while (queue.pop(&value)) {
+        received[value.first * num_consumers + c].push_back(value.second);
+      }
+    });
+  }
+  for (int p = 0; p < num_producers; p++) {
+    threads[p].join();
+  }
+  queue.close();
+  for (int c = 0; c < num_consumers; c++) {
+    threads[num_producers + c].join();
+  }
+  for (int p = 0; p < num_producers; p++) {
+    std::vector<int> all;
+    for (int c = 0; c < num_consumers; c++) {
+      const std::vector<int>& values = received[p * num_consumers + c];
+      EXPECT_TRUE(std::is_sorted(values.begin(), values.end()));
+      all.insert(all.end(), values.begin(), values.end());
+    }
+    std::sort(all.begin(), all.end());
+    ASSERT_EQ(all.size(), num_values);
+    for (int i = 0; i < num_values; i++) {
+      EXPECT_EQ(all[i], i);
+    }
+  }
+}
+
+// Like above, but unbounded, so that the queue grows while being used.
+TEST(RingQueueTest, GrowsConcurrently) {
+  const int num_producers = 2, num_values = 50000;
+  ring_queue<int> queue;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < num_producers; p++) {
+    producers.emplace_back([&] {
+      for (int i = 0; i < num_values; i++) {
+        queue.push(int(i));
+      }
+    });
+  }
+  std::vector<int> counts(num_values);
+  std::thread consumer([&] {
+    for (int i = 0; i < num_producers * num_values; i++) {
+      counts[queue.pop()]++;
+    }
+  });
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  consumer.join();
+  for (int i = 0; i < num_values; i++) {
+    EXPECT_EQ(counts[i], num_producers);
+  }
+  EXPECT_EQ(queue.size(), 0);
+}
+
+}  // namespace
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <future>
+#include <vector>
+#include "NTL/ZZ_pX.h"
+#include "sparse_linear_algebra/util/thread_pool.hpp"
+
+// Multipoint evaluation and interpolation over ZZ_p using a subproduct tree,
+// like fastpoly's recursive functions, but with the nodes of each level of the
+// tree distributed over a thread pool. The tree only depends on the points, so
+// it is built once and reused for all polynomials evaluated or interpolated at
+// the same points.
+//
+// All functions use the ZZ_p modulus that is current when they are called.
+class subproduct_tree {
+ public:
+  // Builds the tree over the `num_points` points `x`, which must be distinct
+  // for interpolate().
+  subproduct_tree(const NTL::ZZ_p* x, long num_points, thread_pool& pool)
+      : pool_(pool) {
+    if (num_points <= 0) {
+      return;
+    }
+    levels_.emplace_back(num_points);
+    parallel_for(num_points, [&](long i) {
+      NTL::SetX(levels_[0][i]);
+      NTL::SetCoeff(levels_[0][i], 0, -x[i]);
+    });
+    while (levels_.back().size() > 1) {
+      const std::vector<NTL::ZZ_pX>& below = levels_.back();
+      std::vector<NTL::ZZ_pX> level((below.size() + 1) / 2);
+      parallel_for(level.size(), [&](long j) {
+        if (2 * j + 1 < long(below.size())) {
+          NTL::mul(level[j], below[2 * j], below[2 * j + 1]);
+        } else {
+          level[j] = below[2 * j];
+        }
+      });
+      levels_.push_back(std::move(level));
+    }
+  }
+
+  long num_points() const {
+    return levels_.empty() ? 0 : long(levels_[0].size());
+  }
+
+  // Sets y[i] = f(x[i]) for all points.
+  void evaluate(const NTL::ZZ_pX& f, NTL::ZZ_p* y) const {
+    if (levels_.empty()) {
+      return;
+    }
+    // reduce f modulo the nodes from the root down to the leaves X - x[i],
+    // where the remainder is f(x[i])
+    std::vector<NTL::ZZ_pX> remainders(1);
+    NTL::rem(remainders[0], f, levels_.back()[0]);
+    for (size_t k = levels_.size() - 1; k-- > 0;) {
+      const std::vector<NTL::ZZ_pX>& nodes = levels_[k];
+      std::vector<NTL::ZZ_pX> next(nodes.size());
+      parallel_for(nodes.size(), [&](long j) {
+        NTL::rem(next[j], remainders[j / 2], nodes[j]);
+      });
+      remainders = std::move(next);
+    }
+    parallel_for(remainders.size(),
+                 [&](long i) { y[i] = NTL::ConstTerm(remainders[i]); });
+  }
+
+  // Sets f to the polynomial of degree less than num_points() with
+  // f(x[i]) = y[i] for all points.
+  void interpolate(const NTL::ZZ_p* y, NTL::ZZ_pX& f) {
+    if (levels_.empty()) {
+      NTL::clear(f);
+      return;
+    }
+    // Lagrange interpolation: f = sum_i y[i] / M'(x[i]) * M / (X - x[i]),
+    // where M is the product of all X - x[i]. The weights 1 / M'(x[i]) only
+    // depend on the points and are shared by all interpolated polynomials.
+    if (weights_.empty()) {
+      NTL::ZZ_pX derivative;
+      NTL::diff(derivative, levels_.back()[0]);
+      weights_.resize(num_points());
+      evaluate(derivative, weights_.data());
+      parallel_for(weights_.size(),
+                   [&](long i) { NTL::inv(weights_[i], weights_[i]); });
+    }
+    // combine the sums from the leaves up, using that a node's sum is
+    // sum_left * M_right + sum_right * M_left
+    std::vector<NTL::ZZ_pX> sums(num_points());
+    parallel_for(sums.size(), [&](long i) { sums[i] = y[i] * weights_[i]; });
+    for (size_t k = 0; k + 1 < levels_.size(); k++) {
+      const std::vector<NTL::ZZ_pX>& nodes = levels_[k];
+      std::vector<NTL::ZZ_pX> next((sums.size() + 1) / 2);
+      parallel_for(next.size(), [&](long j) {
+        if (2 * j + 1 < long(sums.size())) {
+          NTL::ZZ_pX right;
+          NTL::mul(next[j], sums[2 * j], nodes[2 * j + 1]);
+          NTL::mul(right, sums[2 * j + 1], nodes[2 * j]);
+          NTL::add(next[j], next[j], right);
+        } else {
+          next[j] = std::move(sums[2 * j]);
+        }
+      });
+      sums = std::move(next);
+    }
+    f = std::move(sums[0]);
+  }
+
+ private:
+  // Calls `f(i)` for i in [0, n), split into one contiguous range per worker
+  // of the pool. Workers run with the caller's modulus, since NTL keeps the
+  // current modulus per thread.
+  template <typename F>
+  void parallel_for(size_t n, F f) const {
+    NTL::ZZ_pContext context;
+    context.save();
+    size_t num_tasks = std::min(std::max<size_t>(pool_.size(), 1), n);
+    std::vector<std::future<void>> futures;
+    for (size_t t = 0; t < num_tasks; t++) {
+      size_t begin = n * t / num_tasks, end = n * (t + 1) / num_tasks;
+      futures.push_back(pool_.schedule([&context, &f, begin, end] {
+        context.restore();
+        for (size_t i = begin; i < end; i++) {
+          f(i);
+        }
+      }));
+    }
+    // wait for all tasks before rethrowing, since they reference our stack
+    for (auto& future : futures) {
+      future.wait();
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
+  }
+
+  thread_pool& pool_;
+  // levels_[0] holds X - x[i] for all points, and each node of the following
+  // levels is the product of two neighbouring nodes of the level below, or a
+  // copy of the last node if it has no neighbour. The last level holds M.
+  std::vector<std::vector<NTL::ZZ_pX>> levels_;
+  // 1 / M'(x[i]), computed by the first call to interpolate()
+  std::vector<NTL::ZZ_p> weights_;
+};
+
+// Drop-in replacements for poly_interpolate_zp_recursive() and
+// poly_evaluate_zp_recursive() from fastpoly, for polynomials of degree `d`
+// through or at d + 1 points.
+inline void poly_interpolate_zp_parallel(long d, const NTL::ZZ_p* x,
+                                         const NTL::ZZ_p* y, NTL::ZZ_pX& f,
+                                         thread_pool& pool) {
+  subproduct_tree(x, d + 1, pool).interpolate(y, f);
+}
+
+inline void poly_evaluate_zp_parallel(long d, const NTL::ZZ_pX& f,
+                                      const NTL::ZZ_p* x, NTL::ZZ_p* y,
+                                      thread_pool& pool) {
+  subproduct_tree(x, d + 1, pool).evaluate(f, y);
+}
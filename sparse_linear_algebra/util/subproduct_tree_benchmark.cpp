@@ -0,0 +1,102 @@
+// Compares fastpoly's recursive interpolation and evaluation with the parallel
+// subproduct tree, for the polynomials of poly_oblivious_map. The second
+// argument is the number of workers; zero runs the tree on the calling thread.
+
+#include <thread>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "fastpoly/recursive.h"
+#include "sparse_linear_algebra/util/subproduct_tree.hpp"
+
+namespace {
+
+// The modulus of poly_oblivious_map.
+const NTL::ZZ modulus = (NTL::ZZ(1) << 128) - 159;
+
+NTL::Vec<NTL::ZZ_p> random_points(long n) {
+  NTL::Vec<NTL::ZZ_p> x;
+  x.SetLength(n);
+  for (long i = 0; i < n; i++) {
+    x[i] = NTL::random_ZZ_p();
+  }
+  return x;
+}
+
+void BM_InterpolateFastpoly(benchmark::State& state) {
+  NTL::ZZ_pPush push(modulus);
+  const long n = state.range(0);
+  NTL::Vec<NTL::ZZ_p> x = random_points(n), y = random_points(n);
+  NTL::ZZ_pX f;
+  for (auto _ : state) {
+    poly_interpolate_zp_recursive(n - 1, x.data(), y.data(), f);
+    benchmark::DoNotOptimize(f);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+void BM_InterpolateParallel(benchmark::State& state) {
+  NTL::ZZ_pPush push(modulus);
+  const long n = state.range(0);
+  thread_pool pool(state.range(1));
+  NTL::Vec<NTL::ZZ_p> x = random_points(n), y = random_points(n);
+  NTL::ZZ_pX f;
+  for (auto _ : state) {
+    poly_interpolate_zp_parallel(n - 1, x.data(), y.data(), f, pool);
+    benchmark::DoNotOptimize(f);
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+void BM_EvaluateFastpoly(benchmark::State& state) {
+  NTL::ZZ_pPush push(modulus);
+  const long n = state.range(0);
+  NTL::Vec<NTL::ZZ_p> x = random_points(n), y;
+  y.SetLength(n);
+  NTL::ZZ_pX f = NTL::random_ZZ_pX(n);
+  for (auto _ : state) {
+    poly_evaluate_zp_recursive(n - 1, f, x.data(), y.data());
+    benchmark::DoNotOptimize(y.data());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+void BM_EvaluateParallel(benchmark::State& state) {
+  NTL::ZZ_pPush push(modulus);
+  const long n = state.range(0);
+  thread_pool pool(state.range(1));
+  NTL::Vec<NTL::ZZ_p> x = random_points(n), y;
+  y.SetLength(n);
+  NTL::ZZ_pX f = NTL::random_ZZ_pX(n);
+  for (auto _ : state) {
+    poly_evaluate_zp_parallel(n - 1, f, x.data(), y.data(), pool);
+    benchmark::DoNotOptimize(y.data());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+// Up to the ~100k entries of the Movies and Newsgroups datasets.
+void Sizes(benchmark::internal::Benchmark* b) {
+  for (long n : {1 << 12, 1 << 15, 100000}) {
+    b->Args({n});
+  }
+}
+
+void SizesAndWorkers(benchmark::internal::Benchmark* b) {
+  for (long n : {1 << 12, 1 << 15, 100000}) {
+    b->Args({n, 0});
+    b->Args({n, long(std::thread::hardware_concurrency())});
+  }
+}
+
+BENCHMARK(BM_InterpolateFastpoly)->Apply(Sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_InterpolateParallel)
+    ->Apply(SizesAndWorkers)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_EvaluateFastpoly)->Apply(Sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_EvaluateParallel)
+    ->Apply(SizesAndWorkers)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,99 @@
+#include "sparse_linear_algebra/util/subproduct_tree.hpp"
+#include <vector>
+#include "gtest/gtest.h"
+
+namespace {
+
+// The modulus of poly_oblivious_map.
+const NTL::ZZ modulus = (NTL::ZZ(1) << 128) - 159;
+
+std::vector<NTL::ZZ_p> random_points(long n) {
+  std::vector<NTL::ZZ_p> x(n);
+  for (long i = 0; i < n; i++) {
+    x[i] = NTL::random_ZZ_p();
+  }
+  return x;
+}
+
+class SubproductTreeTest
+    : public ::testing::TestWithParam<int /* num_workers */> {};
+
+TEST_P(SubproductTreeTest, EvaluatesAtAllPoints) {
+  NTL::ZZ_pPush push(modulus);
+  thread_pool pool(GetParam());
+  // sizes around powers of two, so that some levels have an odd node
+  for (long n : {1, 2, 3, 8, 100, 257}) {
+    std::vector<NTL::ZZ_p> x = random_points(n), y(n);
+    subproduct_tree tree(x.data(), n, pool);
+    // polynomials of both lower and higher degree than the tree
+    for (long degree : {n / 2, n + 5}) {
+      NTL::ZZ_pX f = NTL::random_ZZ_pX(degree + 1);
+      tree.evaluate(f, y.data());
+      for (long i = 0; i < n; i++) {
+        NTL::ZZ_p expected;
+        NTL::eval(expected, f, x[i]);
+        EXPECT_EQ(y[i], expected) << "n = " << n << ", i = " << i;
+      }
+    }
+  }
+}
+
+TEST_P(SubproductTreeTest, InterpolatesThroughAllPoints) {
+  NTL::ZZ_pPush push(modulus);
+  thread_pool pool(GetParam());
+  for (long n : {1, 2, 3, 8, 100, 257}) {
+    std::vector<NTL::ZZ_p> x = random_points(n), actual(n);
+    subproduct_tree tree(x.data(), n, pool);
+    // the tree is reused for several polynomials
+    for (int run = 0; run < 2; run++) {
+      std::vector<NTL::ZZ_p> y = random_points(n);
+      NTL::ZZ_pX f;
+      tree.interpolate(y.data(), f);
+      EXPECT_LT(NTL::deg(f), n);
+      tree.evaluate(f, actual.data());
+      EXPECT_EQ(actual, y) << "n = " << n;
+    }
+  }
+}
+
+TEST_P(SubproductTreeTest, MatchesFastpolyInterface) {
+  NTL::ZZ_pPush push(modulus);
+  thread_pool pool(GetParam());
+  const long n = 50;
+  std::vector<NTL::ZZ_p> x = random_points(n), y = random_points(n),
+                         actual(n);
+  NTL::ZZ_pX f;
+  poly_interpolate_zp_parallel(n - 1, x.data(), y.data(), f, pool);
+  poly_evaluate_zp_parallel(n - 1, f, x.data(), actual.data(), pool);
+  EXPECT_EQ(actual, y);
+}
+
+TEST_P(SubproductTreeTest, WorkersUseCurrentModulus) {
+  NTL::ZZ_pPush push(NTL::ZZ(1000003));
+  thread_pool pool(GetParam());
+  const long n = 64;
+  std::vector<NTL::ZZ_p> x = random_points(n), y(n);
+  NTL::ZZ_pX f = NTL::random_ZZ_pX(n);
+  subproduct_tree(x.data(), n, pool).evaluate(f, y.data());
+  for (long i = 0; i < n; i++) {
+    NTL::ZZ_p expected;
+    NTL::eval(expected, f, x[i]);
+    EXPECT_EQ(y[i], expected);
+  }
+}
+
+TEST_P(SubproductTreeTest, HandlesNoPoints) {
+  NTL::ZZ_pPush push(modulus);
+  thread_pool pool(GetParam());
+  subproduct_tree tree(nullptr, 0, pool);
+  EXPECT_EQ(tree.num_points(), 0);
+  NTL::ZZ_pX f = NTL::random_ZZ_pX(3);
+  tree.interpolate(nullptr, f);
+  EXPECT_EQ(NTL::deg(f), -1);
+}
+
+// Zero workers run everything on the calling thread.
+INSTANTIATE_TEST_SUITE_P(NumWorkers, SubproductTreeTest,
+                         ::testing::Values(0, 1, 4));
+
+}  // namespace
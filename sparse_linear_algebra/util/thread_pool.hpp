@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "sparse_linear_algebra/util/blocking_queue.hpp"
+
+// A fixed set of worker threads that execute scheduled tasks in FIFO order.
+// With zero workers, tasks run synchronously inside schedule(), which makes it
+// easy to fall back to single-threaded execution.
+class thread_pool {
+ public:
+  explicit thread_pool(size_t num_threads = std::thread::hardware_concurrency())
+      : tasks_() {
+    for (size_t i = 0; i < num_threads; i++) {
+      workers_.emplace_back([this] {
+        for (;;) {
+          std::function<void()> task = tasks_.pop();
+          if (!task) {  // empty task signals shutdown
+            return;
+          }
+          task();
+        }
+      });
+    }
+  }
+
+  // Waits for all scheduled tasks to finish.
+  ~thread_pool() {
+    for (size_t i = 0; i < workers_.size(); i++) {
+      tasks_.push(std::function<void()>());
+    }
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  // Number of worker threads; zero if tasks run synchronously.
+  size_t size() const { return workers_.size(); }
+
+  // Schedules `f` for execution. Exceptions thrown by `f` are rethrown by the
+  // returned future's get().
+  template <typename F>
+  std::future<typename std::result_of<F()>::type> schedule(F&& f) {
+    using result_type = typename std::result_of<F()>::type;
+    // std::function needs a copyable target, so share the packaged_task.
+    auto task = std::make_shared<std::packaged_task<result_type()>>(
+        std::forward<F>(f));
+    std::future<result_type> result = task->get_future();
+    if (workers_.empty()) {
+      (*task)();
+    } else {
+      tasks_.push([task] { (*task)(); });
+    }
+    return result;
+  }
+
+ private:
+  blocking_queue<std::function<void()>> tasks_;
+  std::vector<std::thread> workers_;
+};
@@ -2,7 +2,8 @@
 #include <stdint.h>
 
 typedef struct {
-  size_t element_size;
+  size_t element_size;  // bytes per row, i.e., per index
+  size_t value_size;    // bytes per value; rows consist of several values
   size_t num_ciphertexts;
   uint8_t *indexes_server;
   uint8_t *values;
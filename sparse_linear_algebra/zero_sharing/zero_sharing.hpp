@@ -1,6 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <numeric>
 #include <random>
+#include <thread>
 #include "Eigen/Dense"
 #include "NTL/ZZ.h"
 #include "NTL/ZZ_pX.h"
@@ -9,34 +12,70 @@
 #include "boost/exception/all.hpp"
 #include "boost/range/algorithm/sort.hpp"
 #include "boost/serialization/vector.hpp"
-#include "fastpoly/recursive.h"
 #include "gcrypt.h"
 #include "mpc_utils/comm_channel.hpp"
 #include "mpc_utils/comm_channel_oblivc_adapter.hpp"
+#include "sparse_linear_algebra/util/aes_ctr.hpp"
 #include "sparse_linear_algebra/util/serialize_le.hpp"
+#include "sparse_linear_algebra/util/subproduct_tree.hpp"
 extern "C" {
 #include "obliv_common.h"
 #include "zero_sharing.h"
 }
 
 // Inputs:
-// Server - A share of a short vector v of length l
-//        - A mapping I of all [l] positions to indexes in [n]
-// Client - A second share of v
+// Server - A share of an (l x c) matrix V
+//        - A mapping I of all [l] rows to row indexes in [n]
+// Client - A second share of V
 //
 // Outputs:
-// Both parties: Shares of a vector v' of length n with values from v at
+// Both parties: Shares of an (n x c) matrix V' with the rows of V at the row
 //               indexes from I and zeros everywhere else
+//
+// All c columns are expanded in a single execution of the OT extension, the
+// key interpolation and the Yao protocol. Each row is encrypted with as many
+// AES-CTR blocks as it needs (see aes_ctr), which zero_sharing.oc mirrors.
+
+namespace zero_sharing_internal {
+
+const size_t block_size = 16;
 
 template <typename T>
-std::vector<T> zero_sharing_server(
-    std::vector<T> v, std::vector<size_t> I, size_t n, comm_channel &chan,
+using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+template <typename T>
+using RowMajorMatrix =
+    Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+// Output parameter of the functions below, in a non-deduced context so that
+// any column-major dynamic matrix or block of one converts to it.
+template <typename T>
+struct output {
+  using type = Eigen::Ref<Matrix<T>, 0, Eigen::OuterStride<>>;
+};
+
+inline void check_output_size(size_t rows, size_t cols, size_t n, size_t c) {
+  if (rows != n || cols != c) {
+    BOOST_THROW_EXCEPTION(
+        std::invalid_argument("Output size must be n x V.cols()"));
+  }
+}
+
+}  // namespace zero_sharing_internal
+
+// Writes the server's (n x c) share to `S`, which must have that size.
+template <typename T>
+void zero_sharing_server(
+    const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> &V,
+    const std::vector<size_t> &I, size_t n, comm_channel &chan,
+    typename zero_sharing_internal::output<T>::type S,
     mpc_utils::Benchmarker *benchmarker = nullptr) {
-  size_t l = v.size();
-  if (I.size() != v.size()) {
+  using zero_sharing_internal::block_size;
+  size_t l = V.rows(), c = V.cols();
+  if (I.size() != l) {
     BOOST_THROW_EXCEPTION(
-        std::runtime_error("v and I need to have the same length"));
+        std::runtime_error("V and I need to have the same number of rows"));
   }
+  zero_sharing_internal::check_output_size(S.rows(), S.cols(), n, c);
   // sort I but remember original positions
   std::vector<std::pair<size_t, size_t>> I_order(l);
   for (size_t i = 0; i < l; i++) {
@@ -48,11 +87,9 @@ std::vector<T> zero_sharing_server(
   NTL::ZZ modulus((NTL::ZZ(1) << 128) - 159);
   NTL::ZZ_pPush push(modulus);
   gcryDefaultLibInit();
-  auto cipher = GCRY_CIPHER_AES128;
-  gcry_cipher_hd_t handle;
   dhRandomInit();
-  const size_t block_size = 16;
-  const size_t element_size = sizeof(T) + block_size;
+  const size_t row_size = c * sizeof(T);
+  const size_t element_size = row_size + block_size;
 
   // set up OT arguments
   bool *choices = (bool *)calloc(n, sizeof(bool));
@@ -77,8 +114,8 @@ std::vector<T> zero_sharing_server(
   honestOTExtRecverRelease(ot);
 
   // unpack
-  std::vector<T> s(n);
-  std::vector<T> t(l);  // encrypted shares corresponding to indices in I
+  // encrypted shares corresponding to indices in I
+  std::vector<uint8_t> ciphertexts_server_bytes(l * row_size);
   NTL::Vec<NTL::ZZ_p> share_K;
   NTL::Vec<NTL::ZZ_p> interpolate_pos;
   share_K.SetLength(l);
@@ -86,56 +123,54 @@ std::vector<T> zero_sharing_server(
   size_t num_shares = 0;
   for (size_t i = 0; i < n; i++) {
     if (choices[i]) {
-      deserialize_le(&t[I_order[num_shares].second],
-                     &ot_result[i * element_size], 1);
+      std::copy_n(&ot_result[i * element_size], row_size,
+                  &ciphertexts_server_bytes[I_order[num_shares].second *
+                                            row_size]);
       NTL::conv(share_K[num_shares],
-                NTL::ZZFromBytes(&ot_result[i * element_size + sizeof(T)],
+                NTL::ZZFromBytes(&ot_result[i * element_size + row_size],
                                  block_size));
       NTL::conv(interpolate_pos[num_shares], i + 1);
       num_shares++;
-    } else {
-      deserialize_le(&s[i], &ot_result[i * element_size], 1);
     }
   }
   // combine shares to get Key
   NTL::ZZ_pX poly;
-  poly_interpolate_zp_recursive(l - 1, interpolate_pos.data(), share_K.data(),
-                                poly);
-  // std::cout << "interpolate_pos = " << interpolate_pos << "\n";
-  // std::cout << "share_K = " << share_K << "\n";
-  // std::cout << "poly = " << poly << "\n";
+  thread_pool pool;
+  poly_interpolate_zp_parallel(l - 1, interpolate_pos.data(), share_K.data(),
+                               poly, pool);
   std::vector<uint8_t> K(block_size);
   NTL::BytesFromZZ(K.data(), NTL::conv<NTL::ZZ>(NTL::ConstTerm(poly)),
                    block_size);
 
-  // decrypt shares not in I
-  gcry_cipher_open(&handle, cipher, GCRY_CIPHER_MODE_CTR, 0);
-  gcry_cipher_setkey(handle, K.data(), block_size);
+  // decrypt shares not in I; the keystream for all rows is computed in one
+  // batch
+  std::vector<uint8_t> keystream(n * row_size);
+  aes_ctr(K.data()).keystream_rows(keystream.data(), row_size, n, 0,
+                                   std::thread::hardware_concurrency());
   for (size_t i = 0; i < n; i++) {
     if (choices[i]) {
       continue;
     }
-    uint8_t buf[block_size] = {0};
-    uint8_t ctr[block_size] = {0};
-    serialize_le(&ctr[0], &i, 1);
-    gcry_cipher_setctr(handle, ctr, block_size);
-    gcry_cipher_encrypt(handle, buf, block_size, nullptr, 0);
-    T r;
-    deserialize_le(&r, buf, 1);
-    s[i] = -(s[i] ^ r);
+    uint8_t *buf = &keystream[i * row_size];
+    for (size_t j = 0; j < row_size; j++) {
+      buf[j] ^= ot_result[i * element_size + j];
+    }
+    for (size_t j = 0; j < c; j++) {
+      deserialize_le(&S(i, j), &buf[j * sizeof(T)], 1);
+      S(i, j) = -S(i, j);
+    }
   }
-  gcry_cipher_close(handle);
 
   // compute shares of nonzero values in yao protocol
+  zero_sharing_internal::RowMajorMatrix<T> V_rows = V;
   std::vector<uint8_t> indexes_server_bytes(sizeof(size_t) * l);
-  std::vector<uint8_t> ciphertexts_server_bytes(sizeof(T) * l);
-  std::vector<uint8_t> values_server_bytes(sizeof(T) * l);
-  std::vector<uint8_t> result_server_bytes(sizeof(T) * l);
+  std::vector<uint8_t> values_server_bytes(l * row_size);
+  std::vector<uint8_t> result_server_bytes(l * row_size);
   serialize_le(indexes_server_bytes.begin(), I.begin(), l);
-  serialize_le(ciphertexts_server_bytes.begin(), t.begin(), l);
-  serialize_le(values_server_bytes.begin(), v.begin(), l);
+  serialize_le(values_server_bytes.begin(), V_rows.data(), l * c);
   zero_sharing_oblivc_args args = {
-      .element_size = sizeof(T),
+      .element_size = row_size,
+      .value_size = sizeof(T),
       .num_ciphertexts = l,
       .indexes_server = indexes_server_bytes.data(),
       .values = values_server_bytes.data(),
@@ -147,7 +182,10 @@ std::vector<T> zero_sharing_server(
 
   // copy computed shares to their indexes
   for (size_t i = 0; i < l; i++) {
-    deserialize_le(&s[I[i]], &result_server_bytes[i * sizeof(T)], 1);
+    for (size_t j = 0; j < c; j++) {
+      deserialize_le(&S(I[i], j),
+                     &result_server_bytes[i * row_size + j * sizeof(T)], 1);
+    }
   }
 
   free(choices);
@@ -157,56 +195,48 @@ std::vector<T> zero_sharing_server(
   }
 
   cleanupProtocol(&pd);
-  return s;
 }
 
 template <typename T>
-std::vector<T> zero_sharing_client(
-    std::vector<T> v, size_t n, comm_channel &chan,
+Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> zero_sharing_server(
+    const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> &V,
+    const std::vector<size_t> &I, size_t n, comm_channel &chan,
+    mpc_utils::Benchmarker *benchmarker = nullptr) {
+  zero_sharing_internal::Matrix<T> S(n, V.cols());
+  zero_sharing_server(V, I, n, chan, S, benchmarker);
+  return S;
+}
+
+// Writes the client's (n x c) share to `S`, which must have that size.
+template <typename T>
+void zero_sharing_client(
+    const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> &V, size_t n,
+    comm_channel &chan, typename zero_sharing_internal::output<T>::type S,
     mpc_utils::Benchmarker *benchmarker = nullptr) {
-  size_t l = v.size();
+  using zero_sharing_internal::block_size;
+  size_t l = V.rows(), c = V.cols();
+  const size_t row_size = c * sizeof(T);
+  zero_sharing_internal::check_output_size(S.rows(), S.cols(), n, c);
 
   // setup encryption and generate keys
-  const size_t block_size = 16;
   gcryDefaultLibInit();
-  auto cipher = GCRY_CIPHER_AES128;
-  gcry_cipher_hd_t handle;
   std::vector<uint8_t> K(block_size);
   std::vector<uint8_t> K2(block_size);
   gcry_randomize(K.data(), block_size, GCRY_STRONG_RANDOM);
   gcry_randomize(K2.data(), block_size, GCRY_STRONG_RANDOM);
-  gcry_cipher_open(&handle, cipher, GCRY_CIPHER_MODE_CTR, 0);
 
   // generate seeds
-  std::vector<T> r(n);
-  gcry_randomize(r.data(), n * sizeof(T), GCRY_STRONG_RANDOM);
+  std::vector<uint8_t> r(n * row_size);
+  gcry_randomize(r.data(), r.size(), GCRY_STRONG_RANDOM);
 
   // encrypt to get our own shares
-  gcry_cipher_setkey(handle, K.data(), block_size);
-  std::vector<T> s(n);
-  for (size_t i = 0; i < n; i++) {
-    uint8_t buf[block_size] = {0};
-    uint8_t ctr[block_size] = {0};
-    serialize_le(&ctr[0], &i, 1);
-    gcry_cipher_setctr(handle, ctr, block_size);
-    gcry_cipher_encrypt(handle, buf, block_size, nullptr, 0);
-    deserialize_le(&s[i], buf, 1);
-    s[i] ^= r[i];
-  }
+  int num_threads = std::thread::hardware_concurrency();
+  std::vector<uint8_t> s(r);
+  aes_ctr(K.data()).crypt_rows(s.data(), row_size, n, 0, num_threads);
 
   // encrypt again under second key
-  gcry_cipher_setkey(handle, K2.data(), block_size);
-  std::vector<T> t(n);
-  for (size_t i = 0; i < n; i++) {
-    uint8_t buf[block_size] = {0};
-    uint8_t ctr[block_size] = {0};
-    serialize_le(&ctr[0], &i, 1);
-    gcry_cipher_setctr(handle, ctr, block_size);
-    gcry_cipher_encrypt(handle, buf, block_size, nullptr, 0);
-    deserialize_le(&t[i], buf, 1);
-    t[i] ^= s[i];
-  }
-  gcry_cipher_close(handle);
+  std::vector<uint8_t> t(s);
+  aes_ctr(K2.data()).crypt_rows(t.data(), row_size, n, 0, num_threads);
 
   // secret-share K
   NTL::ZZ modulus((NTL::ZZ(1) << 128) - 159);
@@ -225,19 +255,18 @@ std::vector<T> zero_sharing_client(
   NTL::ZZ_p K_coeff;
   NTL::conv(K_coeff, NTL::ZZFromBytes(K.data(), block_size));
   NTL::SetCoeff(poly, 0, K_coeff);
-  poly_evaluate_zp_recursive(n - 1, poly, eval_pos.data(), share_K.data());
-  // std::cout << "eval_pos = " << eval_pos << "\n";
-  // std::cout << "share_K = " << share_K << "\n";
-  // std::cout << "poly = " << poly << "\n";
+  thread_pool pool(num_threads);
+  poly_evaluate_zp_parallel(n - 1, poly, eval_pos.data(), share_K.data(),
+                            pool);
   // set up OT arguments (we are the sender)
   const size_t element_size =
-      sizeof(T) + block_size;  // one element of t + one share of K
+      row_size + block_size;  // one row of t + one share of K
   std::vector<uint8_t> opt0(element_size * n, 0);
   std::vector<uint8_t> opt1(element_size * n, 0);
   for (size_t i = 0; i < n; i++) {
-    serialize_le(&opt0[i * element_size], &r[i], 1);
-    serialize_le(&opt1[i * element_size], &t[i], 1);
-    NTL::BytesFromZZ(&opt1[i * element_size + sizeof(T)],
+    std::copy_n(&r[i * row_size], row_size, &opt0[i * element_size]);
+    std::copy_n(&t[i * row_size], row_size, &opt1[i * element_size]);
+    NTL::BytesFromZZ(&opt1[i * element_size + row_size],
                      NTL::conv<NTL::ZZ>(share_K[i]), block_size);
   }
 
@@ -258,10 +287,12 @@ std::vector<T> zero_sharing_client(
   honestOTExtSenderRelease(ot);
 
   // run yao protocol to generate server's shares
-  std::vector<uint8_t> values_client_bytes(sizeof(T) * l);
-  serialize_le(values_client_bytes.begin(), v.begin(), l);
+  zero_sharing_internal::RowMajorMatrix<T> V_rows = V;
+  std::vector<uint8_t> values_client_bytes(l * row_size);
+  serialize_le(values_client_bytes.begin(), V_rows.data(), l * c);
   zero_sharing_oblivc_args args = {
-      .element_size = sizeof(T),
+      .element_size = row_size,
+      .value_size = sizeof(T),
       .num_ciphertexts = l,
       .indexes_server = nullptr,
       .values = values_client_bytes.data(),
@@ -276,5 +307,39 @@ std::vector<T> zero_sharing_client(
   }
 
   cleanupProtocol(&pd);
-  return s;
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < c; j++) {
+      deserialize_le(&S(i, j), &s[i * row_size + j * sizeof(T)], 1);
+    }
+  }
+}
+
+template <typename T>
+Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> zero_sharing_client(
+    const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> &V, size_t n,
+    comm_channel &chan, mpc_utils::Benchmarker *benchmarker = nullptr) {
+  zero_sharing_internal::Matrix<T> S(n, V.cols());
+  zero_sharing_client(V, n, chan, S, benchmarker);
+  return S;
+}
+
+// Single-column versions of the above for a vector v of length l.
+template <typename T>
+std::vector<T> zero_sharing_server(
+    std::vector<T> v, std::vector<size_t> I, size_t n, comm_channel &chan,
+    mpc_utils::Benchmarker *benchmarker = nullptr) {
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> S = zero_sharing_server<T>(
+      Eigen::Map<const zero_sharing_internal::Matrix<T>>(v.data(), v.size(), 1),
+      I, n, chan, benchmarker);
+  return std::vector<T>(S.data(), S.data() + S.size());
+}
+
+template <typename T>
+std::vector<T> zero_sharing_client(
+    std::vector<T> v, size_t n, comm_channel &chan,
+    mpc_utils::Benchmarker *benchmarker = nullptr) {
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> S = zero_sharing_client<T>(
+      Eigen::Map<const zero_sharing_internal::Matrix<T>>(v.data(), v.size(), 1),
+      n, chan, benchmarker);
+  return std::vector<T>(S.data(), S.data() + S.size());
 }